@@ -0,0 +1,1483 @@
+/**
+ * @file FqdnBench.cpp
+ * @brief Benchmarks for the refresh hot paths
+ *
+ * Runs against synthetic datasets (1k, 100k and 1M records by default) with
+ * a stub resolver and the simulated firewall backend, and writes one result
+ * row per benchmark and dataset size as JSON or CSV so runs can be compared
+ * between releases.
+ *
+ * The store_* rows compare the streaming audit store reader and writer
+ * with the DOM-based implementation they replaced. Each of those runs in a
+ * fresh child process so its peak resident set growth can be reported.
+ *
+ * Usage: fqdn_bench [--sizes 1000,100000,1000000] [--format json|csv]
+ *                   [--output <file>] [--dir <scratch dir>] [--churn <0..1>]
+ *                   [--readers <n>]
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "AuditLogger.h"
+#include "AuditStoreFile.h"
+#include "CancellationToken.h"
+#include "CompiledBlocklist.h"
+#include "Commands.h"
+#include "DnsMessage.h"
+#include "FirewallManager.h"
+#include "FqdnCanonicalizer.h"
+#include "FirewallWriteQueue.h"
+#include "Metrics.h"
+#include "PassiveDnsIngest.h"
+#include "RefreshCoordinator.h"
+#include "Resolver.h"
+#include "Scheduler.h"
+#include "json.hpp"
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+/**
+ * @brief Stream buffer that discards everything
+ */
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+};
+
+/**
+ * @brief Silences std::cout and std::cerr for the lifetime of the scope
+ *
+ * The components under test report every operation on the console, which
+ * would otherwise dominate the measurements.
+ */
+class MuteConsole {
+public:
+    MuteConsole() : savedOut(std::cout.rdbuf(&sink)), savedErr(std::cerr.rdbuf(&sink)) {}
+    ~MuteConsole() {
+        std::cout.rdbuf(savedOut);
+        std::cerr.rdbuf(savedErr);
+    }
+
+private:
+    NullBuffer sink;
+    std::streambuf* savedOut;
+    std::streambuf* savedErr;
+};
+
+struct BenchResult {
+    std::string name;
+    size_t records;
+    size_t iterations;
+    size_t itemsPerIteration;
+    double minMs;
+    double medianMs;
+    double meanMs;
+    double peakRssMb = -1;   // Peak resident set growth, negative when not measured
+};
+
+struct BenchOptions {
+    std::vector<size_t> sizes = { 1000, 100000, 1000000 };
+    std::string format = "json";
+    std::string outputPath;
+    std::string scratchDir = ".";
+    double churn = 0.01;
+    int readers = 4;
+};
+
+// Progress goes to the real stderr even while the console is muted
+std::ostream progress(std::cerr.rdbuf());
+
+// This executable, re-run as a child for the store format measurements
+std::string selfPath;
+
+// Correctness checks made alongside the measurements that failed; any fails the run
+size_t failedChecks = 0;
+
+/**
+ * @brief Record the outcome of a correctness check
+ * @param ok Whether the check passed
+ * @param what What was expected, reported if it did not hold
+ */
+void Check(bool ok, const std::string& what) {
+    if (!ok) {
+        failedChecks++;
+        progress << "  CHECK FAILED: " << what << std::endl;
+    }
+}
+
+double ElapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+/**
+ * @brief Time a benchmark body
+ * @param setup Untimed preparation run before every iteration
+ * @param body Timed body
+ */
+BenchResult Measure(const std::string& name, size_t records, size_t iterations, size_t items,
+                    const std::function<void()>& setup, const std::function<void()>& body) {
+    std::vector<double> samples;
+    samples.reserve(iterations);
+
+    for (size_t i = 0; i < iterations; i++) {
+        MuteConsole mute;
+        setup();
+        auto start = Clock::now();
+        body();
+        samples.push_back(ElapsedMs(start));
+    }
+
+    std::sort(samples.begin(), samples.end());
+    double total = 0;
+    for (double sample : samples) {
+        total += sample;
+    }
+
+    BenchResult result;
+    result.name = name;
+    result.records = records;
+    result.iterations = iterations;
+    result.itemsPerIteration = items;
+    result.minMs = samples.front();
+    result.medianMs = samples[samples.size() / 2];
+    result.meanMs = total / samples.size();
+
+    progress << "  " << name << ": median " << result.medianMs << " ms over "
+             << iterations << " iteration(s)" << std::endl;
+    return result;
+}
+
+/**
+ * @brief Fewer repetitions for larger datasets so a full run stays practical
+ */
+size_t Iterations(size_t records, size_t small, size_t medium, size_t large) {
+    if (records <= 10000) {
+        return small;
+    }
+    return records <= 200000 ? medium : large;
+}
+
+std::string SyntheticIPv4(std::mt19937_64& rng) {
+    std::uniform_int_distribution<int> octet(1, 254);
+    return std::to_string(octet(rng)) + "." + std::to_string(octet(rng)) + "." +
+           std::to_string(octet(rng)) + "." + std::to_string(octet(rng));
+}
+
+std::vector<std::string> SyntheticAddresses(std::mt19937_64& rng) {
+    std::uniform_int_distribution<int> count(1, 4);
+    std::vector<std::string> ips;
+    int n = count(rng);
+    for (int i = 0; i < n; i++) {
+        ips.push_back(SyntheticIPv4(rng));
+    }
+    if (rng() % 4 == 0) {
+        ips.push_back("2001:db8::" + std::to_string(rng() % 0xffff));
+    }
+    return ips;
+}
+
+std::vector<Record> MakeDataset(size_t count) {
+    static const int intervals[] = { 15, 30, 60, 120, 1440 };
+    std::mt19937_64 rng(count);
+    std::vector<Record> records;
+    records.reserve(count);
+
+    for (size_t i = 0; i < count; i++) {
+        Record record;
+        record.fqdn = "host" + std::to_string(i) + ".zone" + std::to_string(i % 997) + ".bench.example";
+        char guid[64];
+        std::snprintf(guid, sizeof(guid), "%08llx-0000-4000-8000-%012llx",
+                      static_cast<unsigned long long>(rng() & 0xffffffffULL),
+                      static_cast<unsigned long long>(i));
+        record.keywordId = guid;
+        record.ruleName = "Block " + record.fqdn;
+        record.blockedAt = std::time(nullptr);
+        record.interval = intervals[i % 5];
+        record.lastResolvedIPs = SyntheticAddresses(rng);
+        records.push_back(std::move(record));
+    }
+
+    return records;
+}
+
+/**
+ * @brief Stub resolver: stable answers, with a fraction of names rotating
+ */
+Resolver::Backend StubResolver(const std::vector<Record>& records, double churn) {
+    auto answers = std::make_shared<std::vector<std::pair<std::string, std::vector<std::string>>>>();
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> pick(0.0, 1.0);
+
+    for (const auto& record : records) {
+        answers->emplace_back(record.fqdn,
+            pick(rng) < churn ? SyntheticAddresses(rng) : record.lastResolvedIPs);
+    }
+    std::sort(answers->begin(), answers->end());
+
+    return [answers](const std::string& fqdn) {
+        auto it = std::lower_bound(answers->begin(), answers->end(),
+            std::make_pair(fqdn, std::vector<std::string>()));
+        if (it == answers->end() || it->first != fqdn) {
+            return std::vector<std::string>();
+        }
+        return it->second;
+    };
+}
+
+/**
+ * @brief Lookup throughput of snapshot readers while a writer keeps publishing
+ *
+ * Reader threads take a snapshot, look up a burst of FQDNs and repeat until
+ * the writer has published a fixed number of batch updates. Each write holds
+ * the writer lock for a full save of the store, which is exactly the window
+ * in which readers used to stall. Reports total lookups over wall time.
+ */
+BenchResult MeasureSnapshotContention(const std::vector<Record>& dataset, int readerCount, std::mt19937_64& rng) {
+    const size_t writes = 3;
+    const size_t burst = 64;
+    const size_t batchSize = std::max<size_t>(1, dataset.size() / 100);
+
+    std::vector<std::vector<std::pair<std::string, std::vector<std::string>>>> batches(writes);
+    for (auto& batch : batches) {
+        for (size_t i = 0; i < batchSize; i++) {
+            batch.emplace_back(dataset[rng() % dataset.size()].fqdn, SyntheticAddresses(rng));
+        }
+    }
+
+    MuteConsole mute;
+    AuditLogger::Snapshot();   // Load outside the measurement
+
+    std::atomic<bool> done(false);
+    std::atomic<size_t> lookups(0);
+    std::atomic<size_t> misses(0);
+    std::atomic<size_t> regressions(0);
+    std::vector<std::thread> readers;
+
+    auto start = Clock::now();
+    for (int r = 0; r < readerCount; r++) {
+        readers.emplace_back([&, r]() {
+            std::mt19937_64 local(static_cast<uint64_t>(r) + 1);
+            uint64_t lastVersion = 0;
+            size_t count = 0;
+            while (!done.load(std::memory_order_relaxed)) {
+                AuditSnapshotPtr snapshot = AuditLogger::Snapshot();
+                if (snapshot->version < lastVersion) {
+                    regressions++;
+                }
+                lastVersion = snapshot->version;
+                for (size_t i = 0; i < burst; i++) {
+                    if (snapshot->store.Find(dataset[local() % dataset.size()].fqdn) == RecordStore::InvalidSlot) {
+                        misses++;
+                    }
+                }
+                count += burst;
+            }
+            lookups += count;
+        });
+    }
+
+    for (const auto& batch : batches) {
+        AuditLogger::UpdateRecords(batch);
+    }
+    done = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    double elapsed = ElapsedMs(start);
+
+    BenchResult result;
+    result.name = "audit_snapshot_contention";
+    result.records = dataset.size();
+    result.iterations = 1;
+    result.itemsPerIteration = std::max<size_t>(1, lookups.load());
+    result.minMs = elapsed;
+    result.medianMs = elapsed;
+    result.meanMs = elapsed;
+
+    progress << "  " << result.name << ": " << readerCount << " reader(s), " << result.itemsPerIteration
+             << " lookup(s) during " << writes << " write(s) in " << elapsed << " ms";
+    if (misses > 0 || regressions > 0) {
+        progress << " (" << misses << " missing, " << regressions << " version regression(s))";
+    }
+    progress << std::endl;
+    return result;
+}
+
+/**
+ * @brief Peak resident set size of this process so far, in bytes
+ */
+size_t PeakResidentBytes() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss);
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+}
+
+/**
+ * @brief Reference loader: the former DOM-based implementation
+ */
+void LoadStoreDom(const std::string& path, RecordStore& store) {
+    std::ifstream file(path);
+    json j;
+    file >> j;
+    // Current files wrap the array in a checksummed object
+    const json& items = j.is_object() ? j["records"] : j;
+
+    store.Reserve(items.size());
+    for (const auto& item : items) {
+        Record record;
+        record.fqdn = item["fqdn"];
+        record.keywordId = item["keywordId"];
+        record.ruleName = item["ruleName"];
+        record.blockedAt = item["blockedAt"];
+        record.interval = item["interval"];
+        for (const auto& ip : item["lastResolvedIPs"]) {
+            record.lastResolvedIPs.push_back(ip);
+        }
+        store.Insert(record);
+    }
+    store.ShrinkToFit();
+}
+
+/**
+ * @brief Reference writer: the former DOM-based implementation
+ */
+void SaveStoreDom(const std::string& path, const RecordStore& store) {
+    json j = json::array();
+    for (RecordStore::Slot slot : store.LiveSlots()) {
+        json item;
+        item["fqdn"] = store.Fqdn(slot);
+        item["keywordId"] = store.KeywordId(slot);
+        item["ruleName"] = store.RuleName(slot);
+        item["blockedAt"] = store.BlockedAt(slot);
+        item["interval"] = store.Interval(slot);
+        item["lastResolvedIPs"] = store.Addresses(slot);
+        j.push_back(item);
+    }
+
+    std::ofstream file(path);
+    file << j.dump(4);
+}
+
+/**
+ * @brief Child side of MeasureStoreFormat: run one operation, print "<ms> <peak growth bytes>"
+ * @param operation load_dom, load_stream, save_dom or save_stream
+ * @param storePath Existing audit store file; saves write next to it
+ */
+int RunStoreChild(const std::string& operation, const std::string& storePath) {
+    RecordStore store;
+    const bool save = operation == "save_dom" || operation == "save_stream";
+    if (save) {
+        MuteConsole mute;
+        AuditStoreFile::Read(storePath, store);
+    }
+
+    const std::string outputPath = storePath + ".child";
+    size_t baseline = PeakResidentBytes();
+    auto start = Clock::now();
+    {
+        MuteConsole mute;
+        if (operation == "load_dom") {
+            LoadStoreDom(storePath, store);
+        }
+        else if (operation == "load_stream") {
+            AuditStoreFile::Read(storePath, store);
+        }
+        else if (operation == "save_dom") {
+            SaveStoreDom(outputPath, store);
+        }
+        else if (operation == "save_stream") {
+            AuditStoreFile::Write(outputPath, store);
+        }
+        else {
+            return 1;
+        }
+    }
+    double elapsed = ElapsedMs(start);
+    size_t peak = PeakResidentBytes();
+    std::remove(outputPath.c_str());
+
+    std::cout << elapsed << " " << (peak > baseline ? peak - baseline : 0) << std::endl;
+    return 0;
+}
+
+std::string ShellQuote(const std::string& text) {
+    std::string quoted = "'";
+    for (char c : text) {
+        quoted += c == '\'' ? std::string("'\\''") : std::string(1, c);
+    }
+    return quoted + "'";
+}
+
+/**
+ * @brief Time one audit store format operation in fresh child processes
+ *
+ * A fresh process has no freed heap to reuse, so the growth of its peak
+ * resident set is the memory the operation itself needed.
+ */
+BenchResult MeasureStoreFormat(const std::string& operation, size_t records, size_t iterations,
+                               const std::string& storePath) {
+    const std::string command = ShellQuote(selfPath) + " --store-child " + operation + " " + ShellQuote(storePath);
+    std::vector<double> samples;
+    size_t peakBytes = 0;
+
+    for (size_t i = 0; i < iterations; i++) {
+        FILE* child = popen(command.c_str(), "r");
+        double ms = 0;
+        unsigned long long bytes = 0;
+        int fields = child ? std::fscanf(child, "%lf %llu", &ms, &bytes) : 0;
+        int status = child ? pclose(child) : -1;
+        if (fields != 2 || status != 0) {
+            progress << "  store_" << operation << ": child run failed" << std::endl;
+            continue;
+        }
+        samples.push_back(ms);
+        peakBytes = std::max<size_t>(peakBytes, static_cast<size_t>(bytes));
+    }
+    if (samples.empty()) {
+        samples.push_back(0);
+    }
+
+    std::sort(samples.begin(), samples.end());
+    double total = 0;
+    for (double sample : samples) {
+        total += sample;
+    }
+
+    BenchResult result;
+    result.name = "store_" + operation;
+    result.records = records;
+    result.iterations = samples.size();
+    result.itemsPerIteration = std::max<size_t>(1, records);
+    result.minMs = samples.front();
+    result.medianMs = samples[samples.size() / 2];
+    result.meanMs = total / samples.size();
+    result.peakRssMb = peakBytes / (1024.0 * 1024.0);
+
+    progress << "  " << result.name << ": median " << result.medianMs << " ms, peak +"
+             << result.peakRssMb << " MB over " << result.iterations << " run(s)" << std::endl;
+    return result;
+}
+
+/**
+ * @brief Delete a scratch store together with the files saving it leaves behind
+ */
+void RemoveStore(const std::string& storePath) {
+    for (const std::string& path : { storePath, AuditStoreFile::BackupPath(storePath),
+                                     AuditStoreFile::TempPath(storePath), storePath + ".corrupt" }) {
+        std::remove(path.c_str());
+    }
+}
+
+/**
+ * @brief Two overlapping refreshes, as when a scheduled tick meets the refresh command
+ *
+ * The first run covers the first two thirds of the records and the second
+ * the last two thirds, so the middle third is requested by both. Reports
+ * the firewall writes against the FQDNs whose addresses changed.
+ */
+BenchResult MeasureRefreshOverlap(const std::vector<Record>& dataset, const std::string& storePath) {
+    static Histogram& updateOps = Metrics::GetHistogram("fqdn_firewall_op_seconds",
+        "Time spent in firewall operations", "op=\"update_keyword\"");
+
+    MuteConsole mute;
+    RemoveStore(storePath);
+    AuditLogger::Initialize(storePath);
+    AuditLogger::AddRecords(dataset);
+    RefreshCoordinator::Reset();
+
+    AuditSnapshotPtr snapshot = AuditLogger::Snapshot();
+    std::vector<RecordStore::Slot> slots = snapshot->store.LiveSlots();
+    const size_t third = slots.size() / 3;
+    std::vector<RecordStore::Slot> first(slots.begin(), slots.end() - third);
+    std::vector<RecordStore::Slot> second(slots.begin() + third, slots.end());
+
+    RefreshPipeline::Options options = RefreshPipeline::OptionsFromConfig();
+    options.freshnessSeconds = 30;
+    RefreshPipeline::Result firstResult;
+    RefreshPipeline::Result secondResult;
+
+    const uint64_t writesBefore = updateOps.Count();
+    auto start = Clock::now();
+    std::thread other([&]() { secondResult = RefreshCoordinator::Refresh(snapshot, second, options); });
+    firstResult = RefreshCoordinator::Refresh(snapshot, first, options);
+    other.join();
+    double elapsed = ElapsedMs(start);
+    const uint64_t writes = updateOps.Count() - writesBefore;
+
+    std::set<std::string> changed;
+    for (const auto* result : { &firstResult, &secondResult }) {
+        for (const auto& item : result->items) {
+            if (item.outcome == RefreshPipeline::ItemResult::Updated) {
+                changed.insert(item.fqdn);
+            }
+        }
+    }
+
+    BenchResult result;
+    result.name = "refresh_overlap";
+    result.records = dataset.size();
+    result.iterations = 1;
+    result.itemsPerIteration = first.size() + second.size();
+    result.minMs = elapsed;
+    result.medianMs = elapsed;
+    result.meanMs = elapsed;
+
+    progress << "  " << result.name << ": " << elapsed << " ms, " << writes << " firewall write(s) for "
+             << changed.size() << " changed FQDN(s), " << firstResult.joined + secondResult.joined
+             << " joined, " << firstResult.skipped + secondResult.skipped << " skipped" << std::endl;
+    return result;
+}
+
+/**
+ * @brief Repeated refreshes of names that rotate through a larger address pool
+ *
+ * Each name owns a pool of eight addresses and every refresh answers with
+ * the next two, as CDN round-robin does. Runs a fixed number of cycles over
+ * up to 10k records and reports the firewall writes per cycle.
+ * @param graceSeconds Sticky aging grace period, 0 to follow every answer
+ */
+BenchResult MeasureRefreshRotating(const std::vector<Record>& dataset, const std::string& storePath,
+                                   const std::string& name, int graceSeconds) {
+    static Histogram& updateOps = Metrics::GetHistogram("fqdn_firewall_op_seconds",
+        "Time spent in firewall operations", "op=\"update_keyword\"");
+    const size_t cycles = 40;
+    const size_t poolSize = 8;
+
+    MuteConsole mute;
+    RemoveStore(storePath);
+    AuditLogger::Initialize(storePath);
+    std::vector<Record> records(dataset.begin(), dataset.begin() + std::min<size_t>(dataset.size(), 10000));
+    AuditLogger::AddRecords(records);
+
+    auto round = std::make_shared<std::atomic<size_t>>(0);
+    Resolver::SetBackend([round](const std::string& fqdn) {
+        size_t base = std::hash<std::string>()(fqdn);
+        std::vector<std::string> ips;
+        for (size_t k = 0; k < 2; k++) {
+            size_t member = (round->load() * 2 + k) % poolSize;
+            ips.push_back("10." + std::to_string((base >> 8) & 0xFF) + "." +
+                          std::to_string(base & 0xFF) + "." + std::to_string(member + 1));
+        }
+        return ips;
+    });
+
+    RefreshPipeline::Options pipelineOptions;
+    pipelineOptions.graceSeconds = graceSeconds;
+    std::vector<double> samples;
+    const uint64_t writesBefore = updateOps.Count();
+    for (size_t cycle = 0; cycle < cycles; cycle++) {
+        round->store(cycle);
+        AuditSnapshotPtr current = AuditLogger::Snapshot();
+        auto start = Clock::now();
+        RefreshPipeline::Run(current, current->store.LiveSlots(), pipelineOptions);
+        samples.push_back(ElapsedMs(start));
+    }
+    const uint64_t writes = updateOps.Count() - writesBefore;
+    Resolver::SetBackend(Resolver::Backend());
+
+    std::vector<double> sorted = samples;
+    std::sort(sorted.begin(), sorted.end());
+    double total = 0;
+    for (double sample : samples) {
+        total += sample;
+    }
+
+    BenchResult result;
+    result.name = name;
+    result.records = dataset.size();
+    result.iterations = cycles;
+    result.itemsPerIteration = records.size();
+    result.minMs = sorted.front();
+    result.medianMs = sorted[sorted.size() / 2];
+    result.meanMs = total / cycles;
+
+    progress << "  " << result.name << ": median " << result.medianMs << " ms, "
+             << static_cast<double>(writes) / cycles << " firewall write(s) per cycle for "
+             << records.size() << " rotating FQDN(s)" << std::endl;
+    return result;
+}
+
+/**
+ * @brief Burst of keyword updates through the rate-limited write queue
+ *
+ * Eight threads push four back-to-back updates each for up to 1000
+ * keywords (in random keyword order), as a flapping name would, at 5000
+ * writes/s with a burst of 500. Reports the writes that reached the
+ * firewall, the updates coalesced away and the achieved rate.
+ */
+BenchResult MeasureFirewallGovernor(const std::vector<Record>& dataset) {
+    const size_t keywords = std::min<size_t>(dataset.size(), 1000);
+    const size_t threads = 8;
+    const double rate = 5000;
+    const double burst = 500;
+
+    std::vector<size_t> order(keywords);
+    for (size_t k = 0; k < keywords; k++) {
+        order[k] = k;
+    }
+    std::mt19937_64 rng(keywords);
+    std::shuffle(order.begin(), order.end(), rng);
+    std::vector<size_t> work;
+    for (size_t k : order) {
+        work.insert(work.end(), 4, k);
+    }
+
+    MuteConsole mute;
+    FirewallWriteQueue::Configure(rate, burst);
+    const FirewallWriteQueue::Stats before = FirewallWriteQueue::GetStats();
+    std::atomic<size_t> next(0);
+    auto start = Clock::now();
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; t++) {
+        workers.emplace_back([&]() {
+            std::mt19937_64 local(next.load() + 1);
+            for (size_t i = next++; i < work.size(); i = next++) {
+                FirewallWriteQueue::Update(dataset[work[i]].keywordId, SyntheticAddresses(local));
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    double elapsed = ElapsedMs(start);
+    const FirewallWriteQueue::Stats after = FirewallWriteQueue::GetStats();
+    FirewallWriteQueue::Configure(0, 1);
+
+    const uint64_t applied = after.applied + after.failed - before.applied - before.failed;
+    BenchResult result;
+    result.name = "firewall_governor";
+    result.records = dataset.size();
+    result.iterations = 1;
+    result.itemsPerIteration = work.size();
+    result.minMs = elapsed;
+    result.medianMs = elapsed;
+    result.meanMs = elapsed;
+
+    progress << "  " << result.name << ": " << elapsed << " ms, " << work.size() << " update(s) -> "
+             << applied << " write(s), " << after.coalesced - before.coalesced << " coalesced, "
+             << applied * 1000.0 / elapsed << " writes/s (limit " << rate << "/s, burst " << burst
+             << "), deepest backlog " << after.maxPending << std::endl;
+    return result;
+}
+
+/**
+ * @brief Append a name in DNS wire format, uncompressed
+ */
+void AppendWireName(const std::string& name, std::vector<uint8_t>& out) {
+    size_t start = 0;
+    while (start < name.size()) {
+        size_t dot = name.find('.', start);
+        if (dot == std::string::npos) {
+            dot = name.size();
+        }
+        out.push_back(static_cast<uint8_t>(dot - start));
+        out.insert(out.end(), name.begin() + start, name.begin() + dot);
+        start = dot + 1;
+    }
+    out.push_back(0);
+}
+
+void AppendU16(std::vector<uint8_t>& out, size_t value) {
+    out.push_back(static_cast<uint8_t>((value >> 8) & 0xFF));
+    out.push_back(static_cast<uint8_t>(value & 0xFF));
+}
+
+/**
+ * @brief Passive DNS traffic: one answer per response, every fourth via a CNAME
+ *
+ * Half of the responses are for blocked names (each answered with an
+ * address it does not have yet), the other half for names that are not.
+ */
+struct PassiveDnsAnswer {
+    std::string name;
+    std::string cnameTarget;   // Empty when answered directly
+    std::string address;
+};
+
+std::vector<PassiveDnsAnswer> MakePassiveDnsAnswers(const std::vector<Record>& dataset, size_t count) {
+    std::mt19937_64 rng(count);
+    std::vector<PassiveDnsAnswer> answers;
+    answers.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        PassiveDnsAnswer answer;
+        answer.name = i % 2 == 0 ? dataset[rng() % dataset.size()].fqdn
+                                 : "other" + std::to_string(i) + ".passive.example";
+        if (i % 4 == 0) {
+            answer.cnameTarget = "edge" + std::to_string(i % 64) + ".cdn.example";
+        }
+        answer.address = "198.18." + std::to_string((i >> 8) & 0xFF) + "." + std::to_string(i & 0xFF);
+        answers.push_back(std::move(answer));
+    }
+    return answers;
+}
+
+/**
+ * @brief Write the answers as Ethernet/IPv4/UDP responses in a classic pcap file
+ */
+void WritePassiveDnsPcap(const std::vector<PassiveDnsAnswer>& answers, const std::string& path) {
+    std::ofstream file(path, std::ios::binary);
+    // Host byte order throughout, which readers detect from the magic number
+    const uint32_t magic = 0xA1B2C3D4u;
+    const uint16_t version[] = { 2, 4 };
+    const uint32_t header[] = { 0, 0, 65535, 1 };   // Zone, accuracy, snap length, Ethernet
+    file.write(reinterpret_cast<const char*>(&magic), sizeof(magic));
+    file.write(reinterpret_cast<const char*>(version), sizeof(version));
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+    const uint32_t now = static_cast<uint32_t>(std::time(nullptr));
+    std::vector<uint8_t> dns, frame;
+    for (size_t i = 0; i < answers.size(); i++) {
+        const PassiveDnsAnswer& answer = answers[i];
+        dns.clear();
+        AppendU16(dns, i & 0xFFFF);
+        AppendU16(dns, 0x8180);
+        AppendU16(dns, 1);
+        AppendU16(dns, answer.cnameTarget.empty() ? 1 : 2);
+        AppendU16(dns, 0);
+        AppendU16(dns, 0);
+        AppendWireName(answer.name, dns);
+        AppendU16(dns, DnsMessage::TypeA);
+        AppendU16(dns, DnsMessage::ClassIN);
+        std::string owner = answer.name;
+        if (!answer.cnameTarget.empty()) {
+            std::vector<uint8_t> target;
+            AppendWireName(answer.cnameTarget, target);
+            dns.push_back(0xC0);   // Pointer to the question name
+            dns.push_back(12);
+            AppendU16(dns, 5);
+            AppendU16(dns, DnsMessage::ClassIN);
+            dns.insert(dns.end(), { 0, 0, 0, 60 });
+            AppendU16(dns, target.size());
+            dns.insert(dns.end(), target.begin(), target.end());
+            owner = answer.cnameTarget;
+        }
+        AppendWireName(owner, dns);
+        AppendU16(dns, DnsMessage::TypeA);
+        AppendU16(dns, DnsMessage::ClassIN);
+        dns.insert(dns.end(), { 0, 0, 0, 60 });
+        uint8_t address[16];
+        size_t addressSize = 0;
+        DnsMessage::ParseAddress(answer.address, address, addressSize);
+        AppendU16(dns, addressSize);
+        dns.insert(dns.end(), address, address + addressSize);
+
+        frame.assign(12, 0x02);
+        AppendU16(frame, 0x0800);
+        frame.insert(frame.end(), { 0x45, 0 });
+        AppendU16(frame, 20 + 8 + dns.size());
+        frame.insert(frame.end(), { 0, 0, 0, 0, 64, 17, 0, 0, 10, 0, 0, 53, 10, 0, 0, 2 });
+        AppendU16(frame, 53);
+        AppendU16(frame, 40000 + i % 20000);
+        AppendU16(frame, 8 + dns.size());
+        AppendU16(frame, 0);
+        frame.insert(frame.end(), dns.begin(), dns.end());
+
+        const uint32_t record[] = { now, 0, static_cast<uint32_t>(frame.size()), static_cast<uint32_t>(frame.size()) };
+        file.write(reinterpret_cast<const char*>(record), sizeof(record));
+        file.write(reinterpret_cast<const char*>(frame.data()), static_cast<std::streamsize>(frame.size()));
+    }
+}
+
+/**
+ * @brief Write the answers as dnsmasq log-queries lines
+ */
+void WritePassiveDnsLog(const std::vector<PassiveDnsAnswer>& answers, const std::string& path) {
+    std::ofstream file(path);
+    for (size_t i = 0; i < answers.size(); i++) {
+        const PassiveDnsAnswer& answer = answers[i];
+        const std::string prefix = "Oct 18 12:00:00 dnsmasq[812]: " + std::to_string(i) + " 10.0.0.2/40000 ";
+        file << prefix << "query[A] " << answer.name << " from 10.0.0.2\n";
+        file << prefix << "forwarded " << answer.name << " to 10.0.0.53\n";
+        if (!answer.cnameTarget.empty()) {
+            file << prefix << "reply " << answer.name << " is <CNAME>\n";
+            file << prefix << "reply " << answer.cnameTarget << " is " << answer.address << "\n";
+        }
+        else {
+            file << prefix << "reply " << answer.name << " is " << answer.address << "\n";
+        }
+    }
+}
+
+/**
+ * @brief Local UDP DNS server answering every A query with one address
+ *
+ * Drops a share of the queries and delays the answer to the rest, to stand
+ * in for a degraded upstream. Answers are sent one at a time.
+ */
+class BenchDnsServer {
+public:
+    BenchDnsServer(double dropRate, int delayMs)
+        : dropRate(dropRate), delayMs(delayMs), sock(-1), port(0), stopping(false) {}
+
+    ~BenchDnsServer() {
+        stopping = true;
+        if (thread.joinable()) {
+            thread.join();
+        }
+        if (sock >= 0) {
+            close(sock);
+        }
+    }
+
+    bool Start() {
+        sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(address);
+        if (sock < 0 || bind(sock, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            getsockname(sock, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+            return false;
+        }
+        port = ntohs(address.sin_port);
+        thread = std::thread([this]() { Serve(); });
+        return true;
+    }
+
+    std::string Address() const { return "127.0.0.1:" + std::to_string(port); }
+
+private:
+    void Serve() {
+        std::mt19937_64 rng(port);
+        std::uniform_real_distribution<double> pick(0.0, 1.0);
+        uint8_t buffer[512];
+        while (!stopping) {
+            pollfd pfd = {};
+            pfd.fd = sock;
+            pfd.events = POLLIN;
+            if (poll(&pfd, 1, 50) <= 0) {
+                continue;
+            }
+            sockaddr_in from = {};
+            socklen_t fromLength = sizeof(from);
+            ssize_t received = recvfrom(sock, buffer, sizeof(buffer), 0, reinterpret_cast<sockaddr*>(&from), &fromLength);
+            DnsMessage::Message query;
+            if (received <= 0 || !DnsMessage::Decode(buffer, static_cast<size_t>(received), query) ||
+                query.questions.empty() || pick(rng) < dropRate) {
+                continue;
+            }
+            if (delayMs > 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(delayMs));
+            }
+
+            DnsMessage::Message response = query;
+            response.flags = DnsMessage::FlagResponse | DnsMessage::FlagRecursionDesired | DnsMessage::FlagRecursionAvailable;
+            if (query.questions[0].type == DnsMessage::TypeA) {
+                DnsMessage::ResourceRecord answer;
+                answer.name = query.questions[0].name;
+                answer.type = DnsMessage::TypeA;
+                answer.rclass = DnsMessage::ClassIN;
+                answer.ttl = 60;
+                answer.data = { 192, 0, 2, 1 };
+                response.answers.push_back(answer);
+            }
+            std::vector<uint8_t> packet;
+            if (DnsMessage::Encode(response, packet)) {
+                sendto(sock, packet.data(), packet.size(), 0, reinterpret_cast<sockaddr*>(&from), fromLength);
+            }
+        }
+    }
+
+    double dropRate;
+    int delayMs;
+    int sock;
+    uint16_t port;
+    std::atomic<bool> stopping;
+    std::thread thread;
+};
+
+/**
+ * @brief Resolution latency with the fastest-upstream policy, with and without a partial outage
+ *
+ * Resolves 1000 names one after another through local DNS servers. In the
+ * outage run the servers listed first drop half of their queries and
+ * answer the rest 20 ms late, and drop everything, ahead of a healthy one.
+ * Reports the median and, on stderr, the p99 against the healthy baseline.
+ */
+BenchResult MeasureUpstreamSelection(size_t records, const std::string& name, bool outage) {
+    const size_t resolutions = 1000;
+    BenchDnsServer healthy(0.0, 0);
+    BenchDnsServer degraded(0.5, 20);
+    BenchDnsServer dead(1.0, 0);
+    healthy.Start();
+    degraded.Start();
+    dead.Start();
+
+    std::vector<std::string> servers;
+    if (outage) {
+        servers = { degraded.Address(), dead.Address(), healthy.Address() };
+    }
+    else {
+        servers = { healthy.Address() };
+    }
+
+    std::vector<double> samples;
+    size_t failed = 0;
+    {
+        MuteConsole mute;
+        Resolver::SetBackend(Resolver::Backend());
+        Resolver::SetUpstreams(servers, 500, Resolver::Policy::Fastest);
+        for (size_t i = 0; i < resolutions; i++) {
+            auto start = Clock::now();
+            failed += Resolver::Resolve("host" + std::to_string(i) + ".upstream.bench.example").addresses.empty() ? 1 : 0;
+            samples.push_back(ElapsedMs(start));
+        }
+        Resolver::SetUpstreams({}, 0);
+    }
+
+    std::vector<double> sorted = samples;
+    std::sort(sorted.begin(), sorted.end());
+    double total = 0;
+    for (double sample : samples) {
+        total += sample;
+    }
+
+    BenchResult result;
+    result.name = name;
+    result.records = records;
+    result.iterations = resolutions;
+    result.itemsPerIteration = 1;
+    result.minMs = sorted.front();
+    result.medianMs = sorted[sorted.size() / 2];
+    result.meanMs = total / resolutions;
+
+    progress << "  " << result.name << ": median " << result.medianMs << " ms, p99 "
+             << sorted[sorted.size() * 99 / 100] << " ms, max " << sorted.back() << " ms, "
+             << failed << " unanswered of " << resolutions << std::endl;
+    return result;
+}
+
+/**
+ * @brief Time from cancelling a refresh to its return, with every lookup stuck
+ *
+ * Refreshes up to 1000 records with 64 resolve workers through a local
+ * DNS server that answers nothing, with a 30 s DNS deadline, and cancels
+ * the run after 100 ms. Reports on stderr how many records were cancelled.
+ */
+BenchResult MeasureRefreshCancel(const std::vector<Record>& dataset, const std::string& storePath) {
+    const size_t count = std::min<size_t>(dataset.size(), 1000);
+    BenchDnsServer unresponsive(1.0, 0);
+    unresponsive.Start();
+
+    double elapsed;
+    RefreshPipeline::Result refresh;
+    {
+        MuteConsole mute;
+        RemoveStore(storePath);
+        AuditLogger::Initialize(storePath);
+        AuditLogger::AddRecords(std::vector<Record>(dataset.begin(), dataset.begin() + count));
+        RefreshCoordinator::Reset();
+        Resolver::SetBackend(Resolver::Backend());
+        Resolver::SetUpstreams({ unresponsive.Address() }, 30000);
+
+        AuditSnapshotPtr snapshot = AuditLogger::Snapshot();
+        CancellationToken cancel;
+        RefreshPipeline::Options options;
+        options.resolveWorkers = 64;
+        options.cancel = &cancel;
+        std::thread run([&]() { refresh = RefreshCoordinator::Refresh(snapshot, snapshot->store.LiveSlots(), options); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        auto start = Clock::now();
+        cancel.Cancel();
+        run.join();
+        elapsed = ElapsedMs(start);
+        Resolver::SetUpstreams({}, 0);
+    }
+
+    BenchResult result;
+    result.name = "refresh_cancel";
+    result.records = dataset.size();
+    result.iterations = 1;
+    result.itemsPerIteration = count;
+    result.minMs = elapsed;
+    result.medianMs = elapsed;
+    result.meanMs = elapsed;
+
+    progress << "  " << result.name << ": returned " << elapsed << " ms after cancel, " << refresh.cancelled
+             << " of " << count << " record(s) cancelled, " << refresh.failed << " failed" << std::endl;
+    // Scheduler::Stop() waits for this with the default 5000 ms shutdownTimeoutMs
+    Check(elapsed < 1000, "a cancelled refresh returns within 1000 ms");
+    return result;
+}
+
+void RunDataset(size_t size, const BenchOptions& options, std::vector<BenchResult>& results) {
+    progress << "Dataset: " << size << " record(s)" << std::endl;
+
+    const std::vector<Record> dataset = MakeDataset(size);
+    const std::string storePath = options.scratchDir + "/fqdn_bench_" + std::to_string(size) + ".json";
+    RemoveStore(storePath);
+
+    // Audit store
+    results.push_back(Measure("audit_save", size, Iterations(size, 10, 3, 1), size,
+        [&]() {
+            RemoveStore(storePath);
+            AuditLogger::Initialize(storePath);
+        },
+        [&]() { AuditLogger::AddRecords(dataset); }));
+
+    results.push_back(Measure("audit_load", size, Iterations(size, 10, 3, 1), size,
+        [&]() { AuditLogger::Initialize(storePath); },
+        [&]() { AuditLogger::Snapshot(); }));
+
+    for (const char* operation : { "save_dom", "save_stream", "load_dom", "load_stream" }) {
+        results.push_back(MeasureStoreFormat(operation, size, Iterations(size, 5, 3, 1), storePath));
+    }
+
+    std::mt19937_64 rng(size);
+    const size_t lookupCount = std::min<size_t>(size, 100000);
+    results.push_back(Measure("audit_snapshot_read", size, Iterations(size, 20, 5, 3), lookupCount,
+        []() {},
+        [&]() {
+            AuditSnapshotPtr snapshot = AuditLogger::Snapshot();
+            size_t found = 0;
+            for (size_t i = 0; i < lookupCount; i++) {
+                found += snapshot->store.Find(dataset[rng() % dataset.size()].fqdn) != RecordStore::InvalidSlot ? 1 : 0;
+            }
+            Check(found == lookupCount,
+                  "audit_snapshot_read: " + std::to_string(lookupCount - found) + " lookup(s) missed");
+        }));
+
+    results.push_back(MeasureSnapshotContention(dataset, options.readers, rng));
+
+    results.push_back(Measure("audit_update_one", size, Iterations(size, 20, 3, 1), 1,
+        []() {},
+        [&]() {
+            const Record& record = dataset[rng() % dataset.size()];
+            AuditLogger::UpdateRecord(record.fqdn, SyntheticAddresses(rng));
+        }));
+
+    const size_t batchSize = std::max<size_t>(1, size / 100);
+    results.push_back(Measure("audit_update_batch", size, Iterations(size, 10, 3, 1), batchSize,
+        []() {},
+        [&]() {
+            std::vector<std::pair<std::string, std::vector<std::string>>> updates;
+            for (size_t i = 0; i < batchSize; i++) {
+                updates.emplace_back(dataset[rng() % dataset.size()].fqdn, SyntheticAddresses(rng));
+            }
+            AuditLogger::UpdateRecords(updates);
+        }));
+
+    // Name canonicalization, as applied to every name of an imported list
+    std::vector<std::string> typed;
+    typed.reserve(size);
+    for (const auto& record : dataset) {
+        std::string name = record.fqdn + ".";
+        for (size_t i = 0; i < name.size(); i += 3) {
+            name[i] = static_cast<char>(std::toupper(static_cast<unsigned char>(name[i])));
+        }
+        typed.push_back(std::move(name));
+    }
+    for (bool vector : { true, false }) {
+        results.push_back(Measure(vector ? "fqdn_canonicalize" : "fqdn_canonicalize_scalar", size,
+            Iterations(size, 20, 5, 3), size,
+            []() {},
+            [&]() {
+                char canonical[FqdnCanonicalizer::MaxLength];
+                size_t length = 0;
+                size_t valid = 0;
+                for (const auto& name : typed) {
+                    FqdnCanonicalizer::Status status = vector
+                        ? FqdnCanonicalizer::Canonicalize(name, canonical, length)
+                        : FqdnCanonicalizer::CanonicalizeScalar(name, canonical, length);
+                    valid += status == FqdnCanonicalizer::Status::Ok ? 1 : 0;
+                }
+                Check(valid == typed.size(), std::string(vector ? "fqdn_canonicalize" : "fqdn_canonicalize_scalar") +
+                      ": " + std::to_string(typed.size() - valid) + " valid name(s) rejected");
+            }));
+    }
+
+    // Names from lists, resolver logs and captures may be nothing but dots; run under FQDN_SANITIZE
+    const std::vector<std::string> malformed = {
+        std::string(250, '.') + "a", std::string(253, '.'), "a" + std::string(251, '.') + "a",
+        "." + std::string(252, 'a'), "a..b"
+    };
+    for (const auto& name : malformed) {
+        char canonical[FqdnCanonicalizer::MaxLength];
+        size_t length = 0;
+        for (bool vector : { true, false }) {
+            FqdnCanonicalizer::Status status = vector
+                ? FqdnCanonicalizer::Canonicalize(name, canonical, length)
+                : FqdnCanonicalizer::CanonicalizeScalar(name, canonical, length);
+            Check(status == FqdnCanonicalizer::Status::EmptyLabel,
+                  std::string(vector ? "" : "scalar ") + "canonicalization rejects a " + std::to_string(name.size()) +
+                  "-character name with empty labels");
+        }
+    }
+
+    // Filtered listing: one index build per snapshot, then range lookups
+    RecordIndex::Filter filter;
+    RecordIndex::ParseNetwork("100.0.0.0/8", filter.network);
+    filter.hasNetwork = true;
+    filter.interval = 60;
+    results.push_back(Measure("list_index_build", size, Iterations(size, 10, 3, 1), size,
+        []() {},
+        [&]() { RecordIndex index(AuditLogger::Snapshot()->store); }));
+
+    results.push_back(Measure("list_query_scan", size, Iterations(size, 20, 5, 2), size,
+        []() {},
+        [&]() {
+            // What an unindexed list does: parse every address of every record
+            AuditSnapshotPtr snapshot = AuditLogger::Snapshot();
+            RecordIndex::Network single;
+            size_t matched = 0;
+            for (RecordStore::Slot slot : snapshot->store.LiveSlots()) {
+                if (snapshot->store.Interval(slot) != filter.interval) {
+                    continue;
+                }
+                for (const auto& ip : snapshot->store.Addresses(slot)) {
+                    if (RecordIndex::ParseNetwork(ip, single) && single.first >= filter.network.first &&
+                        single.first <= filter.network.last) {
+                        matched++;
+                        break;
+                    }
+                }
+            }
+            Check(matched > 0, "list_query_scan: no records matched");
+        }));
+
+    AuditSnapshotPtr indexed = AuditLogger::Snapshot();
+    indexed->Index();
+    results.push_back(Measure("list_query_indexed", size, Iterations(size, 20, 5, 2), size,
+        []() {},
+        [&]() {
+            Check(!indexed->Index().Select(filter).empty(), "list_query_indexed: no records matched");
+        }));
+    indexed.reset();
+
+    results.push_back(Measure("list_jsonl", size, Iterations(size, 5, 2, 1), size,
+        []() {},
+        [&]() {
+            std::ostringstream out, err;
+            Commands::Execute({ "list", "--format", "jsonl" }, out, err);
+        }));
+
+    // Compiled blocklist: build once, then map and query without loading
+    const std::string blocklistPath = storePath + ".blocklist";
+    results.push_back(Measure("blocklist_compile", size, Iterations(size, 5, 2, 1), size,
+        []() {},
+        [&]() {
+            size_t compiled = 0;
+            size_t truncated = 0;
+            bool written = CompiledBlocklist::Compile(blocklistPath, AuditLogger::Snapshot()->store, compiled, truncated);
+            Check(written && compiled == size && truncated == 0,
+                  "blocklist_compile: expected " + std::to_string(size) + " complete record(s), got " +
+                  std::to_string(compiled) + " (" + std::to_string(truncated) + " cut)");
+        }));
+
+    results.push_back(Measure("blocklist_open", size, Iterations(size, 20, 20, 20), 1,
+        []() {},
+        [&]() {
+            CompiledBlocklist blocklist;
+            bool opened = blocklist.Open(blocklistPath);
+            Check(opened && blocklist.Size() == size,
+                  "blocklist_open: the compiled blocklist did not open with " + std::to_string(size) + " record(s)");
+        }));
+
+    {
+        CompiledBlocklist blocklist;
+        Check(blocklist.Open(blocklistPath), "blocklist_check: the compiled blocklist did not open");
+        std::vector<std::string> present;
+        std::vector<std::string> absent;
+        for (size_t i = 0; i < lookupCount; i++) {
+            present.push_back(dataset[rng() % dataset.size()].fqdn);
+            absent.push_back("absent" + std::to_string(i) + ".bench.example");
+        }
+        results.push_back(Measure("blocklist_check_hit", size, Iterations(size, 20, 5, 3), lookupCount,
+            []() {},
+            [&]() {
+                size_t found = 0;
+                for (const auto& fqdn : present) {
+                    found += blocklist.Contains(fqdn) ? 1 : 0;
+                }
+                Check(found == present.size(),
+                      "blocklist_check_hit: " + std::to_string(present.size() - found) + " blocked name(s) missed");
+            }));
+        results.push_back(Measure("blocklist_check_miss", size, Iterations(size, 20, 5, 3), lookupCount,
+            []() {},
+            [&]() {
+                size_t found = 0;
+                for (const auto& fqdn : absent) {
+                    found += blocklist.Contains(fqdn) ? 1 : 0;
+                }
+                Check(found == 0, "blocklist_check_miss: " + std::to_string(found) + " absent name(s) reported present");
+            }));
+    }
+    std::remove(blocklistPath.c_str());
+
+    // Passive DNS: synthetic captures and logs merged into a fresh copy of the store
+    const std::vector<PassiveDnsAnswer> passiveAnswers = MakePassiveDnsAnswers(dataset, lookupCount);
+    const std::string pcapPath = storePath + ".pcap";
+    const std::string dnsLogPath = storePath + ".dnsmasq.log";
+    WritePassiveDnsPcap(passiveAnswers, pcapPath);
+    WritePassiveDnsLog(passiveAnswers, dnsLogPath);
+    for (bool pcap : { true, false }) {
+        PassiveDnsIngest::Stats stats = {};
+        results.push_back(Measure(pcap ? "passive_dns_pcap" : "passive_dns_log", size,
+            Iterations(size, 10, 3, 1), passiveAnswers.size(),
+            [&]() {
+                RemoveStore(storePath);
+                AuditLogger::Initialize(storePath);
+                AuditLogger::AddRecords(dataset);
+                stats = PassiveDnsIngest::Stats();
+            },
+            [&]() {
+                PassiveDnsIngest::Options ingestOptions;
+                if (pcap) {
+                    PassiveDnsIngest::IngestPcap(pcapPath, ingestOptions, stats);
+                }
+                else {
+                    PassiveDnsIngest::IngestLog(dnsLogPath, ingestOptions, stats);
+                }
+            }));
+        progress << "    " << stats.answers << " answer(s), " << stats.matched << " matched, "
+                 << stats.added << " address(es) added to " << stats.recordsUpdated << " record(s)" << std::endl;
+    }
+    std::remove(pcapPath.c_str());
+    std::remove(dnsLogPath.c_str());
+
+    // Scheduler
+    results.push_back(Measure("scheduler_add", size, 1, size,
+        []() {},
+        [&]() {
+            for (const auto& record : dataset) {
+                Scheduler::AddTask(record.fqdn);
+            }
+        }));
+
+    results.push_back(Measure("scheduler_tick_idle", size, Iterations(size, 100, 10, 3), size,
+        []() {},
+        []() { Scheduler::CollectDueTasks(Clock::now()); }));
+
+    // Every tick reschedules what it collects, so each iteration looks further ahead
+    auto horizon = Clock::now();
+    results.push_back(Measure("scheduler_tick_all_due", size, Iterations(size, 10, 3, 1), size,
+        [&]() { horizon += std::chrono::hours(48); },
+        [&]() { Scheduler::CollectDueTasks(horizon); }));
+
+    results.push_back(Measure("scheduler_remove", size, 1, size,
+        []() {},
+        [&]() {
+            for (const auto& record : dataset) {
+                Scheduler::RemoveTask(record.fqdn);
+            }
+        }));
+
+    // Change detection
+    std::vector<std::vector<std::string>> fresh;
+    fresh.reserve(size);
+    for (size_t i = 0; i < size; i++) {
+        fresh.push_back(i % 2 == 0 ? dataset[i].lastResolvedIPs : SyntheticAddresses(rng));
+        std::shuffle(fresh.back().begin(), fresh.back().end(), rng);
+    }
+    results.push_back(Measure("ipset_diff", size, Iterations(size, 20, 5, 2), size,
+        []() {},
+        [&]() {
+            size_t changed = 0;
+            for (size_t i = 0; i < size; i++) {
+                changed += RefreshPipeline::SameAddresses(fresh[i], dataset[i].lastResolvedIPs) ? 0 : 1;
+            }
+            Check(changed > 0, "ipset_diff: no changes detected");
+        }));
+
+    // End-to-end refresh: stub resolver -> diff -> simulated firewall -> audit commit
+    Resolver::SetBackend(StubResolver(dataset, options.churn));
+    RefreshPipeline::Options pipelineOptions;
+    AuditSnapshotPtr current;
+    results.push_back(Measure("refresh_cycle", size, Iterations(size, 5, 2, 1), size,
+        [&]() {
+            // Start every cycle from the original dataset so each sees the same churn
+            RemoveStore(storePath);
+            AuditLogger::Initialize(storePath);
+            AuditLogger::AddRecords(dataset);
+            current = AuditLogger::Snapshot();
+        },
+        [&]() { RefreshPipeline::Run(current, current->store.LiveSlots(), pipelineOptions); }));
+    results.push_back(MeasureRefreshOverlap(dataset, storePath));
+    Resolver::SetBackend(Resolver::Backend());
+
+    results.push_back(MeasureRefreshRotating(dataset, storePath, "refresh_rotating", 0));
+    results.push_back(MeasureRefreshRotating(dataset, storePath, "refresh_rotating_sticky", 3600));
+    results.push_back(MeasureFirewallGovernor(dataset));
+    results.push_back(MeasureUpstreamSelection(size, "resolve_fastest_healthy", false));
+    results.push_back(MeasureUpstreamSelection(size, "resolve_fastest_outage", true));
+    results.push_back(MeasureRefreshCancel(dataset, storePath));
+    results.push_back(Measure("scheduler_stop", size, 3, 1,
+        []() {
+            Scheduler::Start();
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        },
+        []() {
+            const int timeoutMs = 1000;
+            auto start = Clock::now();
+            bool stopped = Scheduler::Stop(timeoutMs);
+            Check(stopped && ElapsedMs(start) <= timeoutMs, "Scheduler::Stop() returns within its timeout");
+        }));
+
+    RemoveStore(storePath);
+}
+
+bool ParseOptions(int argc, char* argv[], BenchOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--sizes" && hasValue) {
+            options.sizes.clear();
+            std::stringstream list(argv[++i]);
+            std::string item;
+            while (std::getline(list, item, ',')) {
+                options.sizes.push_back(static_cast<size_t>(std::stoull(item)));
+            }
+        }
+        else if (arg == "--format" && hasValue) {
+            options.format = argv[++i];
+            if (options.format != "json" && options.format != "csv") {
+                std::cerr << "Unknown format: " << options.format << std::endl;
+                return false;
+            }
+        }
+        else if (arg == "--output" && hasValue) {
+            options.outputPath = argv[++i];
+        }
+        else if (arg == "--dir" && hasValue) {
+            options.scratchDir = argv[++i];
+        }
+        else if (arg == "--churn" && hasValue) {
+            options.churn = std::stod(argv[++i]);
+        }
+        else if (arg == "--readers" && hasValue) {
+            options.readers = std::max(1, std::stoi(argv[++i]));
+        }
+        else {
+            std::cerr << "Usage: fqdn_bench [--sizes 1000,100000,1000000] [--format json|csv]" << std::endl;
+            std::cerr << "                  [--output <file>] [--dir <scratch dir>] [--churn <0..1>]" << std::endl;
+            std::cerr << "                  [--readers <n>]" << std::endl;
+            return false;
+        }
+    }
+    return !options.sizes.empty();
+}
+
+void WriteResults(const std::vector<BenchResult>& results, const BenchOptions& options, std::ostream& out) {
+    if (options.format == "csv") {
+        out << "benchmark,records,iterations,items,min_ms,median_ms,mean_ms,ns_per_item,items_per_sec,peak_rss_mb\n";
+        for (const auto& r : results) {
+            out << r.name << "," << r.records << "," << r.iterations << "," << r.itemsPerIteration << ","
+                << r.minMs << "," << r.medianMs << "," << r.meanMs << ","
+                << r.medianMs * 1e6 / r.itemsPerIteration << ","
+                << (r.medianMs > 0 ? r.itemsPerIteration * 1000.0 / r.medianMs : 0.0) << ",";
+            if (r.peakRssMb >= 0) {
+                out << r.peakRssMb;
+            }
+            out << "\n";
+        }
+        return;
+    }
+
+    json document;
+    document["suite"] = "fqdn_bench";
+    document["timestamp"] = static_cast<long long>(std::time(nullptr));
+    document["churn"] = options.churn;
+    document["results"] = json::array();
+    for (const auto& r : results) {
+        json row;
+        row["benchmark"] = r.name;
+        row["records"] = r.records;
+        row["iterations"] = r.iterations;
+        row["items"] = r.itemsPerIteration;
+        row["min_ms"] = r.minMs;
+        row["median_ms"] = r.medianMs;
+        row["mean_ms"] = r.meanMs;
+        row["ns_per_item"] = r.medianMs * 1e6 / r.itemsPerIteration;
+        row["items_per_sec"] = r.medianMs > 0 ? r.itemsPerIteration * 1000.0 / r.medianMs : 0.0;
+        if (r.peakRssMb >= 0) {
+            row["peak_rss_mb"] = r.peakRssMb;
+        }
+        document["results"].push_back(row);
+    }
+    out << document.dump(2) << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc == 4 && std::string(argv[1]) == "--store-child") {
+        return RunStoreChild(argv[2], argv[3]);
+    }
+
+    char exePath[4096];
+    ssize_t length = readlink("/proc/self/exe", exePath, sizeof(exePath) - 1);
+    selfPath = length > 0 ? std::string(exePath, static_cast<size_t>(length)) : std::string(argv[0]);
+
+    BenchOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        return 1;
+    }
+
+    {
+        MuteConsole mute;
+        FirewallManager::Initialize();
+        Scheduler::Initialize();
+    }
+
+    std::vector<BenchResult> results;
+    for (size_t size : options.sizes) {
+        RunDataset(size, options, results);
+    }
+
+    {
+        MuteConsole mute;
+        FirewallManager::Cleanup();
+    }
+
+    if (options.outputPath.empty()) {
+        WriteResults(results, options, std::cout);
+    }
+    else {
+        std::ofstream file(options.outputPath, std::ios::trunc);
+        if (!file.is_open()) {
+            std::cerr << "Failed to open output file: " << options.outputPath << std::endl;
+            return 1;
+        }
+        WriteResults(results, options, file);
+        progress << "Results written to: " << options.outputPath << std::endl;
+    }
+
+    if (failedChecks > 0) {
+        progress << failedChecks << " check(s) failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -4,46 +4,171 @@
 #include <algorithm>
 #include <iomanip>
 #include <sstream>
+#include <cctype>
 
-#include "../lib/json.hpp"
+#include "AuditStoreFile.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "Platform.h"
 
-using json = nlohmann::json;
+namespace {
+
+AuditChange RemovalOf(const std::string& fqdn) {
+    AuditChange change;
+    change.type = AuditChange::Remove;
+    change.record.fqdn = fqdn;
+    return change;
+}
+
+} // namespace
+
+const RecordIndex& AuditSnapshot::Index() const {
+    std::call_once(indexOnce, [this]() { index.reset(new RecordIndex(store)); });
+    return *index;
+}
 
 // Initialize static members
 std::string AuditLogger::auditStorePath;
 std::string AuditLogger::logFilePath;
 std::mutex AuditLogger::auditMutex;
-
-// Record implementation
-Record::Record() : blockedAt(0), interval(0) {}
-
-Record::Record(const std::string& fqdn, const std::string& keywordId,
-               const std::string& ruleName, const std::vector<std::string>& ips, int interval)
-    : fqdn(fqdn), keywordId(keywordId), ruleName(ruleName),
-      blockedAt(std::time(nullptr)), lastResolvedIPs(ips), interval(interval) {}
+AuditSnapshotPtr AuditLogger::published;
+uint64_t AuditLogger::savedVersion = 0;
+AuditLogger::ChangeListener AuditLogger::changeListener;
 
 // AuditLogger implementation
 void AuditLogger::Initialize(const std::string& auditPath) {
+    std::lock_guard<std::mutex> lock(auditMutex);
+    FlushLocked();
     auditStorePath = auditPath;
+    savedVersion = 0;
+    std::atomic_store(&published, AuditSnapshotPtr());
+}
+
+AuditSnapshotPtr AuditLogger::Snapshot() {
+    AuditSnapshotPtr snapshot = std::atomic_load(&published);
+    if (snapshot) {
+        return snapshot;
+    }
+
+    // Not loaded yet: only the first readers after Initialize get here
+    std::lock_guard<std::mutex> lock(auditMutex);
+    return CurrentSnapshot();
+}
+
+AuditSnapshotPtr AuditLogger::CurrentSnapshot() {
+    AuditSnapshotPtr snapshot = std::atomic_load(&published);
+    if (!snapshot) {
+        auto loaded = std::make_shared<AuditSnapshot>();
+        LoadFromFile(loaded->store);
+        snapshot = loaded;
+        std::atomic_store(&published, snapshot);
+    }
+    return snapshot;
+}
+
+bool AuditLogger::Publish(const std::shared_ptr<AuditSnapshot>& next, const std::vector<AuditChange>* changes,
+                          bool deferSave) {
+    AuditSnapshotPtr previous = std::atomic_load(&published);
+    next->version = previous ? previous->version + 1 : 1;
+
+    if (!deferSave) {
+        if (!SaveToFile(next->store)) {
+            return false;
+        }
+        savedVersion = next->version;
+    }
+
+    std::atomic_store(&published, AuditSnapshotPtr(next));
+    if (changeListener) {
+        changeListener(next->version, changes);
+    }
+    return true;
+}
+
+uint64_t AuditLogger::SetChangeListener(ChangeListener listener) {
+    std::lock_guard<std::mutex> lock(auditMutex);
+    changeListener = std::move(listener);
+    return CurrentSnapshot()->version;
+}
+
+bool AuditLogger::ApplyChanges(const std::vector<AuditChange>& changes) {
+    std::lock_guard<std::mutex> lock(auditMutex);
+
+    try {
+        auto next = std::make_shared<AuditSnapshot>(*CurrentSnapshot());
+        for (const auto& change : changes) {
+            RecordStore::Slot slot = next->store.Find(change.record.fqdn);
+            if (slot != RecordStore::InvalidSlot) {
+                next->store.Erase(slot);
+            }
+            if (change.type != AuditChange::Remove) {
+                next->store.Insert(change.record);
+            }
+        }
+        return Publish(next, &changes);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error applying replicated changes: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool AuditLogger::ReplaceRecords(RecordStore store) {
+    std::lock_guard<std::mutex> lock(auditMutex);
+
+    try {
+        CurrentSnapshot();
+        auto next = std::make_shared<AuditSnapshot>();
+        next->store = std::move(store);
+        if (!Publish(next, nullptr)) {
+            return false;
+        }
+        LogAction("Replaced the audit store with " + std::to_string(next->store.Size()) + " replicated record(s)");
+        return true;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error replacing records: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool AuditLogger::Flush() {
+    std::lock_guard<std::mutex> lock(auditMutex);
+    return FlushLocked();
+}
+
+bool AuditLogger::FlushLocked() {
+    AuditSnapshotPtr current = std::atomic_load(&published);
+    if (!current || current->version == savedVersion) {
+        return true;
+    }
+
+    if (!SaveToFile(current->store)) {
+        return false;
+    }
+    savedVersion = current->version;
+    return true;
 }
 
 bool AuditLogger::AddRecord(const Record& record) {
     std::lock_guard<std::mutex> lock(auditMutex);
 
     try {
-        auto records = LoadFromFile();
+        auto current = CurrentSnapshot();
 
         // Check if record already exists
-        auto it = std::find_if(records.begin(), records.end(),
-            [&record](const Record& r) { return r.fqdn == record.fqdn; });
-
-        if (it != records.end()) {
+        if (current->store.Find(record.fqdn) != RecordStore::InvalidSlot) {
             std::cerr << "Record for FQDN '" << record.fqdn << "' already exists" << std::endl;
             return false;
         }
 
-        records.push_back(record);
-        bool success = SaveToFile(records);
+        auto next = std::make_shared<AuditSnapshot>(*current);
+        RecordStore::Slot slot = next->store.Insert(record);
+        std::vector<AuditChange> changes;
+        if (changeListener) {
+            changes.push_back(AuditChange{ AuditChange::Add, next->store.Get(slot), {} });
+        }
+        bool success = Publish(next, &changes);
 
         if (success) {
             std::ostringstream oss;
@@ -64,18 +189,25 @@ bool AuditLogger::UpdateRecord(const std::string& fqdn, const std::vector<std::s
     std::lock_guard<std::mutex> lock(auditMutex);
 
     try {
-        auto records = LoadFromFile();
-
-        auto it = std::find_if(records.begin(), records.end(),
-            [&fqdn](const Record& r) { return r.fqdn == fqdn; });
+        auto current = CurrentSnapshot();
 
-        if (it == records.end()) {
+        RecordStore::Slot slot = current->store.Find(fqdn);
+        if (slot == RecordStore::InvalidSlot) {
             std::cerr << "Record not found for FQDN: " << fqdn << std::endl;
             return false;
         }
 
-        it->lastResolvedIPs = newIPs;
-        bool success = SaveToFile(records);
+        auto next = std::make_shared<AuditSnapshot>(*current);
+        std::vector<std::string> previousIPs;
+        if (changeListener) {
+            previousIPs = next->store.Addresses(slot);
+        }
+        next->store.SetAddresses(slot, newIPs);
+        std::vector<AuditChange> changes;
+        if (changeListener) {
+            changes.push_back(AuditChange{ AuditChange::Update, next->store.Get(slot), std::move(previousIPs) });
+        }
+        bool success = Publish(next, &changes);
 
         if (success) {
             std::ostringstream oss;
@@ -93,21 +225,22 @@ bool AuditLogger::UpdateRecord(const std::string& fqdn, const std::vector<std::s
 }
 
 std::vector<Record> AuditLogger::ListRecords() {
-    std::lock_guard<std::mutex> lock(auditMutex);
-    return LoadFromFile();
+    auto snapshot = Snapshot();
+
+    std::vector<Record> records;
+    records.reserve(snapshot->store.Size());
+    for (RecordStore::Slot slot : snapshot->store.LiveSlots()) {
+        records.push_back(snapshot->store.Get(slot));
+    }
+    return records;
 }
 
 bool AuditLogger::GetRecord(const std::string& fqdn, Record& record) {
-    std::lock_guard<std::mutex> lock(auditMutex);
-
     try {
-        auto records = LoadFromFile();
-
-        auto it = std::find_if(records.begin(), records.end(),
-            [&fqdn](const Record& r) { return r.fqdn == fqdn; });
-
-        if (it != records.end()) {
-            record = *it;
+        auto snapshot = Snapshot();
+        RecordStore::Slot slot = snapshot->store.Find(fqdn);
+        if (slot != RecordStore::InvalidSlot) {
+            record = snapshot->store.Get(slot);
             return true;
         }
 
@@ -123,18 +256,21 @@ bool AuditLogger::RemoveRecord(const std::string& fqdn) {
     std::lock_guard<std::mutex> lock(auditMutex);
 
     try {
-        auto records = LoadFromFile();
+        auto current = CurrentSnapshot();
 
-        auto it = std::remove_if(records.begin(), records.end(),
-            [&fqdn](const Record& r) { return r.fqdn == fqdn; });
-
-        if (it == records.end()) {
+        RecordStore::Slot slot = current->store.Find(fqdn);
+        if (slot == RecordStore::InvalidSlot) {
             std::cerr << "Record not found for FQDN: " << fqdn << std::endl;
             return false;
         }
 
-        records.erase(it, records.end());
-        bool success = SaveToFile(records);
+        auto next = std::make_shared<AuditSnapshot>(*current);
+        next->store.Erase(slot);
+        std::vector<AuditChange> changes;
+        if (changeListener) {
+            changes.push_back(RemovalOf(fqdn));
+        }
+        bool success = Publish(next, &changes);
 
         if (success) {
             std::ostringstream oss;
@@ -150,96 +286,276 @@ bool AuditLogger::RemoveRecord(const std::string& fqdn) {
     }
 }
 
-void AuditLogger::LogAction(const std::string& message) {
+std::vector<bool> AuditLogger::AddRecords(const std::vector<Record>& newRecords) {
+    std::lock_guard<std::mutex> lock(auditMutex);
+    std::vector<bool> results(newRecords.size(), false);
+
     try {
-        std::ofstream logFile(logFilePath, std::ios::app);
-        if (!logFile.is_open()) {
-            std::cerr << "Failed to open log file: " << logFilePath << std::endl;
-            return;
+        auto next = std::make_shared<AuditSnapshot>(*CurrentSnapshot());
+        size_t added = 0;
+        std::vector<AuditChange> changes;
+
+        next->store.Reserve(next->store.Size() + newRecords.size());
+
+        for (size_t i = 0; i < newRecords.size(); i++) {
+            const Record& record = newRecords[i];
+
+            RecordStore::Slot slot = next->store.Insert(record);
+            if (slot == RecordStore::InvalidSlot) {
+                std::cerr << "Record for FQDN '" << record.fqdn << "' already exists" << std::endl;
+                continue;
+            }
+            if (changeListener) {
+                changes.push_back(AuditChange{ AuditChange::Add, next->store.Get(slot), {} });
+            }
+
+            results[i] = true;
+            added++;
         }
 
-        // Get current time
-        std::time_t now = std::time(nullptr);
-        std::tm tm;
-        localtime_s(&tm, &now);
+        if (added == 0) {
+            return results;
+        }
 
-        logFile << std::put_time(&tm, "%Y-%m-%d %H:%M:%S") << " - " << message << std::endl;
-        logFile.close();
+        if (!Publish(next, &changes)) {
+            std::fill(results.begin(), results.end(), false);
+            return results;
+        }
+
+        std::ostringstream oss;
+        oss << "Added " << added << " record(s) in batch";
+        LogAction(oss.str());
     }
     catch (const std::exception& e) {
-        std::cerr << "Error logging action: " << e.what() << std::endl;
+        std::cerr << "Error adding records: " << e.what() << std::endl;
+        std::fill(results.begin(), results.end(), false);
     }
+
+    return results;
 }
 
-std::vector<Record> AuditLogger::LoadFromFile() {
-    std::vector<Record> records;
+std::vector<bool> AuditLogger::UpdateRecords(
+    const std::vector<std::pair<std::string, std::vector<std::string>>>& updates,
+    const std::vector<std::vector<std::time_t>>& lastSeen, bool deferSave) {
+    std::lock_guard<std::mutex> lock(auditMutex);
+    std::vector<bool> results(updates.size(), false);
 
     try {
-        std::ifstream file(auditStorePath);
-        if (!file.is_open()) {
-            // File doesn't exist yet, return empty vector
-            return records;
-        }
-
-        json j;
-        file >> j;
-        file.close();
-
-        if (j.is_array()) {
-            for (const auto& item : j) {
-                Record record;
-                record.fqdn = item["fqdn"];
-                record.keywordId = item["keywordId"];
-                record.ruleName = item["ruleName"];
-                record.blockedAt = item["blockedAt"];
-                record.interval = item["interval"];
-
-                if (item.contains("lastResolvedIPs") && item["lastResolvedIPs"].is_array()) {
-                    for (const auto& ip : item["lastResolvedIPs"]) {
-                        record.lastResolvedIPs.push_back(ip);
-                    }
-                }
-
-                records.push_back(record);
+        auto next = std::make_shared<AuditSnapshot>(*CurrentSnapshot());
+        size_t updated = 0;
+        std::vector<AuditChange> changes;
+
+        for (size_t i = 0; i < updates.size(); i++) {
+            const std::string& fqdn = updates[i].first;
+            RecordStore::Slot slot = next->store.Find(fqdn);
+
+            if (slot == RecordStore::InvalidSlot) {
+                std::cerr << "Record not found for FQDN: " << fqdn << std::endl;
+                continue;
+            }
+
+            std::vector<std::string> previousIPs;
+            if (changeListener) {
+                previousIPs = next->store.Addresses(slot);
+            }
+            next->store.SetAddresses(slot, updates[i].second,
+                i < lastSeen.size() ? lastSeen[i] : std::vector<std::time_t>());
+            if (changeListener) {
+                changes.push_back(AuditChange{ AuditChange::Update, next->store.Get(slot), std::move(previousIPs) });
             }
+            results[i] = true;
+            updated++;
         }
+
+        if (updated == 0) {
+            return results;
+        }
+
+        if (!Publish(next, &changes, deferSave)) {
+            std::fill(results.begin(), results.end(), false);
+            return results;
+        }
+
+        std::ostringstream oss;
+        oss << "Updated " << updated << " record(s) in batch";
+        LogAction(oss.str());
     }
     catch (const std::exception& e) {
-        std::cerr << "Error loading from file: " << e.what() << std::endl;
+        std::cerr << "Error updating records: " << e.what() << std::endl;
+        std::fill(results.begin(), results.end(), false);
     }
 
-    return records;
+    return results;
 }
 
-bool AuditLogger::SaveToFile(const std::vector<Record>& records) {
+std::vector<bool> AuditLogger::RemoveRecords(const std::vector<std::string>& fqdns) {
+    std::lock_guard<std::mutex> lock(auditMutex);
+    std::vector<bool> results(fqdns.size(), false);
+
     try {
-        json j = json::array();
+        auto next = std::make_shared<AuditSnapshot>(*CurrentSnapshot());
+        size_t removed = 0;
+        std::vector<AuditChange> changes;
 
-        for (const auto& record : records) {
-            json item;
-            item["fqdn"] = record.fqdn;
-            item["keywordId"] = record.keywordId;
-            item["ruleName"] = record.ruleName;
-            item["blockedAt"] = record.blockedAt;
-            item["interval"] = record.interval;
-            item["lastResolvedIPs"] = record.lastResolvedIPs;
+        for (size_t i = 0; i < fqdns.size(); i++) {
+            const std::string& fqdn = fqdns[i];
+            RecordStore::Slot slot = next->store.Find(fqdn);
 
-            j.push_back(item);
+            if (slot == RecordStore::InvalidSlot) {
+                std::cerr << "Record not found for FQDN: " << fqdn << std::endl;
+                continue;
+            }
+
+            next->store.Erase(slot);
+            if (changeListener) {
+                changes.push_back(RemovalOf(fqdn));
+            }
+            results[i] = true;
+            removed++;
         }
 
-        std::ofstream file(auditStorePath);
-        if (!file.is_open()) {
-            std::cerr << "Failed to open audit store for writing: " << auditStorePath << std::endl;
+        if (removed == 0) {
+            return results;
+        }
+
+        if (!Publish(next, &changes)) {
+            std::fill(results.begin(), results.end(), false);
+            return results;
+        }
+
+        std::ostringstream oss;
+        oss << "Removed " << removed << " record(s) in batch";
+        LogAction(oss.str());
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error removing records: " << e.what() << std::endl;
+        std::fill(results.begin(), results.end(), false);
+    }
+
+    return results;
+}
+
+std::vector<Record> AuditLogger::FindRecords(const std::string& pattern) {
+    auto snapshot = Snapshot();
+
+    std::vector<Record> matches;
+    for (RecordStore::Slot slot : snapshot->store.LiveSlots()) {
+        if (MatchesGlob(pattern, snapshot->store.Fqdn(slot))) {
+            matches.push_back(snapshot->store.Get(slot));
+        }
+    }
+    return matches;
+}
+
+bool AuditLogger::MatchesGlob(const std::string& pattern, std::string_view text) {
+    // Iterative wildcard match with single-star backtracking
+    size_t p = 0, t = 0;
+    size_t starP = std::string::npos, starT = 0;
+
+    while (t < text.size()) {
+        if (p < pattern.size() &&
+            (pattern[p] == '?' ||
+             std::tolower(static_cast<unsigned char>(pattern[p])) ==
+             std::tolower(static_cast<unsigned char>(text[t])))) {
+            p++;
+            t++;
+        }
+        else if (p < pattern.size() && pattern[p] == '*') {
+            starP = p++;
+            starT = t;
+        }
+        else if (starP != std::string::npos) {
+            p = starP + 1;
+            t = ++starT;
+        }
+        else {
             return false;
         }
+    }
 
-        file << j.dump(4);  // Pretty print
-        file.close();
+    while (p < pattern.size() && pattern[p] == '*') {
+        p++;
+    }
+    return p == pattern.size();
+}
 
-        return true;
+void AuditLogger::LogAction(const std::string& message) {
+    try {
+        std::ofstream logFile(logFilePath, std::ios::app);
+        if (!logFile.is_open()) {
+            std::cerr << "Failed to open log file: " << logFilePath << std::endl;
+            return;
+        }
+
+        // Get current time
+        std::time_t now = std::time(nullptr);
+        std::tm tm;
+        Platform::LocalTime(now, tm);
+
+        logFile << std::put_time(&tm, "%Y-%m-%d %H:%M:%S") << " - " << message << std::endl;
+        logFile.close();
     }
     catch (const std::exception& e) {
-        std::cerr << "Error saving to file: " << e.what() << std::endl;
-        return false;
+        std::cerr << "Error logging action: " << e.what() << std::endl;
+    }
+}
+
+void AuditLogger::LoadFromFile(RecordStore& store) {
+    static Histogram& loadSeconds = Metrics::GetHistogram("fqdn_audit_load_seconds",
+        "Time spent loading the audit store");
+    ScopedTimer timer(loadSeconds);
+    TraceSpan span("audit_load", "audit");
+
+    AuditStoreFile::ReadStatus status = AuditStoreFile::Read(auditStorePath, store);
+    if (status == AuditStoreFile::ReadStatus::Ok) {
+        return;
     }
+
+    if (status == AuditStoreFile::ReadStatus::Missing) {
+        // First run, unless a save was interrupted after moving the store
+        // aside (no hard links) but before moving the new version in
+        const std::string tempPath = AuditStoreFile::TempPath(auditStorePath);
+        std::ifstream pending(tempPath);
+        if (pending.is_open()) {
+            pending.close();
+            RecordStore fromTemp;
+            if (AuditStoreFile::Read(tempPath, fromTemp) == AuditStoreFile::ReadStatus::Ok &&
+                std::rename(tempPath.c_str(), auditStorePath.c_str()) == 0) {
+                store = std::move(fromTemp);
+                std::cerr << "Completed an interrupted audit store save (" << store.Size() << " record(s))" << std::endl;
+            }
+        }
+        return;
+    }
+
+    // Damaged or truncated: keep the file for inspection, out of the way of
+    // the next save, and fall back to the previous generation
+    const std::string damagedPath = auditStorePath + ".corrupt";
+    std::remove(damagedPath.c_str());
+    std::rename(auditStorePath.c_str(), damagedPath.c_str());
+    std::cerr << "Audit store is damaged, moved to: " << damagedPath << std::endl;
+
+    const std::string backupPath = AuditStoreFile::BackupPath(auditStorePath);
+    RecordStore fromBackup;
+    if (AuditStoreFile::Read(backupPath, fromBackup) == AuditStoreFile::ReadStatus::Ok) {
+        store = std::move(fromBackup);
+        std::cerr << "Restored " << store.Size() << " record(s) from backup: " << backupPath << std::endl;
+        LogAction("Restored " + std::to_string(store.Size()) + " record(s) from backup " + backupPath);
+    }
+    else {
+        std::cerr << "No usable backup; continuing with the " << store.Size()
+                  << " record(s) that could be read" << std::endl;
+    }
+}
+
+bool AuditLogger::SaveToFile(const RecordStore& store) {
+    static Histogram& saveSeconds = Metrics::GetHistogram("fqdn_audit_save_seconds",
+        "Time spent writing the audit store");
+    static Gauge& recordCount = Metrics::GetGauge("fqdn_audit_records",
+        "Records in the audit store after the last write");
+    ScopedTimer timer(saveSeconds);
+    TraceSpan span("audit_save", "audit", std::to_string(store.Size()) + " record(s)");
+    recordCount.Set(static_cast<int64_t>(store.Size()));
+
+    return AuditStoreFile::Write(auditStorePath, store);
 }
@@ -5,38 +5,83 @@
 #include <vector>
 #include <mutex>
 #include <ctime>
+#include <utility>
+#include <memory>
+#include <functional>
+#include <cstdint>
+
+#include "RecordStore.h"
+#include "RecordIndex.h"
 
 /**
- * @brief Record structure for tracking blocked FQDNs
+ * @brief Immutable view of the audit store at one version
+ *
+ * Nothing in a published snapshot changes, so a reader can hold one for as
+ * long as it likes and look records up by FQDN or slot without locking.
  */
-struct Record {
-    std::string fqdn;                      // Fully Qualified Domain Name
-    std::string keywordId;                 // GUID for dynamic keyword address
-    std::string ruleName;                  // Firewall rule name
-    std::time_t blockedAt;                 // Timestamp when blocked
-    std::vector<std::string> lastResolvedIPs;  // Last resolved IP addresses
-    int interval;                          // Refresh interval in minutes
+struct AuditSnapshot {
+    RecordStore store;
+    uint64_t version;     // Increases with every published write
+
+    AuditSnapshot() : version(0) {}
 
     /**
-     * @brief Default constructor
+     * @brief Copy the records of another snapshot; the index is not copied
      */
-    Record();
+    AuditSnapshot(const AuditSnapshot& other) : store(other.store), version(other.version) {}
+    AuditSnapshot& operator=(const AuditSnapshot&) = delete;
 
     /**
-     * @brief Parameterized constructor
+     * @brief Secondary indexes over the store, built by the first caller
+     * @note Only valid on a published snapshot, whose store no longer changes
      */
-    Record(const std::string& fqdn, const std::string& keywordId, 
-           const std::string& ruleName, const std::vector<std::string>& ips, int interval);
+    const RecordIndex& Index() const;
+
+private:
+    mutable std::once_flag indexOnce;
+    mutable std::unique_ptr<RecordIndex> index;
+};
+
+typedef std::shared_ptr<const AuditSnapshot> AuditSnapshotPtr;
+
+/**
+ * @brief One record-level change made by a published audit store version
+ */
+struct AuditChange {
+    enum Type : uint8_t {
+        Add,
+        Update,     // Addresses changed
+        Remove
+    };
+
+    Type type;
+    Record record;                          // The record after the change; only fqdn is set for Remove
+    std::vector<std::string> previousIPs;   // Update: the addresses before the change
 };
 
 /**
  * @brief Audit logging and persistence management
  * 
  * Manages the audit store (JSON file) containing records of all blocked FQDNs.
- * Thread-safe for concurrent access.
+ * The store is read once and kept in memory; every mutation is written through
+ * to the file, except refresh commits that ask to defer it (UpdateRecords);
+ * the next write or Flush() covers those. Thread-safe for concurrent access.
+ *
+ * Readers take a snapshot and never wait on auditMutex; writers serialize on
+ * auditMutex, write the file, then publish the new snapshot atomically.
+ * Writes are atomic and durable (see AuditStoreFile); a damaged or missing
+ * store is recovered from the previous generation on load.
  */
 class AuditLogger {
 public:
+    /**
+     * @brief Callback told about every published version, in order
+     * @param version Version that was published
+     * @param changes Record changes from the previous version, or nullptr if
+     *        the whole store was replaced (ReplaceRecords)
+     */
+    using ChangeListener = std::function<void(uint64_t version, const std::vector<AuditChange>* changes)>;
+
     /**
      * @brief Initialize the audit logger
      * @param auditStorePath Path to the audit store file
@@ -58,8 +103,18 @@ public:
      */
     static bool UpdateRecord(const std::string& fqdn, const std::vector<std::string>& newIPs);
 
+    /**
+     * @brief Current read-only view of the audit store
+     *
+     * Cheap to call from any thread: copies one shared pointer. The first
+     * call after Initialize loads the store file.
+     * @return Snapshot that stays valid and unchanged while it is held
+     */
+    static AuditSnapshotPtr Snapshot();
+
     /**
      * @brief List all records in the audit store
+     * @note Copies every record; prefer Snapshot() for read-only access
      * @return Vector of all records
      */
     static std::vector<Record> ListRecords();
@@ -79,6 +134,81 @@ public:
      */
     static bool RemoveRecord(const std::string& fqdn);
 
+    /**
+     * @brief Add several records with a single load/save of the audit store
+     * @param records Records to add
+     * @return Per-record success flags, in the same order as the input
+     */
+    static std::vector<bool> AddRecords(const std::vector<Record>& records);
+
+    /**
+     * @brief Update the IPs of several records with a single save of the audit store
+     * @param updates Pairs of FQDN and new IP addresses
+     * @param lastSeen Per update, when each of its IPs was last returned by
+     *        DNS (see Record::lastSeen); empty if every address is current
+     * @param deferSave Publish without writing the file; the caller calls
+     *        Flush() once its last update is in (refresh commits)
+     * @return Per-update success flags, in the same order as the input
+     */
+    static std::vector<bool> UpdateRecords(
+        const std::vector<std::pair<std::string, std::vector<std::string>>>& updates,
+        const std::vector<std::vector<std::time_t>>& lastSeen = {}, bool deferSave = false);
+
+    /**
+     * @brief Remove several records with a single load/save of the audit store
+     * @param fqdns FQDNs to remove
+     * @return Per-FQDN success flags, in the same order as the input
+     */
+    static std::vector<bool> RemoveRecords(const std::vector<std::string>& fqdns);
+
+    /**
+     * @brief Apply changes made elsewhere (replication) as one version
+     *
+     * Add and Update replace the whole record of that FQDN, so the store
+     * ends up exactly as where the changes were made.
+     * @param changes Changes to apply, in order
+     * @return true if the version was published
+     */
+    static bool ApplyChanges(const std::vector<AuditChange>& changes);
+
+    /**
+     * @brief Replace every record with those of another store (replication catch-up)
+     * @param store Records to keep
+     * @return true if the version was published
+     */
+    static bool ReplaceRecords(RecordStore store);
+
+    /**
+     * @brief Install the callback told about every published version
+     *
+     * The listener runs while writers are serialized, so it must not call
+     * back into AuditLogger and should return quickly.
+     * @param listener Callback, or an empty function to remove it
+     * @return Version published when the listener was installed
+     */
+    static uint64_t SetChangeListener(ChangeListener listener);
+
+    /**
+     * @brief Write deferred changes to the audit store file now
+     * @return true if the file holds the current version
+     */
+    static bool Flush();
+
+    /**
+     * @brief Find all records whose FQDN matches a glob pattern
+     * @param pattern Glob pattern ('*' matches any run of characters, '?' matches one)
+     * @return Matching records
+     */
+    static std::vector<Record> FindRecords(const std::string& pattern);
+
+    /**
+     * @brief Case-insensitive glob match used by FindRecords
+     * @param pattern Glob pattern ('*' and '?' wildcards)
+     * @param text Text to match
+     * @return true if the whole text matches the pattern
+     */
+    static bool MatchesGlob(const std::string& pattern, std::string_view text);
+
     /**
      * @brief Log an action to the log file
      * @param message Message to log
@@ -87,21 +217,51 @@ public:
 
 private:
     /**
-     * @brief Load all records from the audit store file
-     * @return Vector of records
+     * @brief Published snapshot, loaded from file on first use
+     * @note Caller must hold auditMutex
+     * @return Current snapshot
+     */
+    static AuditSnapshotPtr CurrentSnapshot();
+
+    /**
+     * @brief Write a new version to the file and publish it to readers
+     *
+     * Writing the file also saves any earlier versions that were deferred.
+     * @note Caller must hold auditMutex
+     * @param next New version, built from a copy of the current snapshot
+     * @param changes Record changes it makes, for the change listener; nullptr if all records were replaced
+     * @param deferSave Publish without writing the file (see UpdateRecords)
+     * @return true if the file was written and the version published
+     */
+    static bool Publish(const std::shared_ptr<AuditSnapshot>& next, const std::vector<AuditChange>* changes,
+                        bool deferSave = false);
+
+    /**
+     * @brief Write the published version if the file is behind it
+     * @note Caller must hold auditMutex
+     * @return true if the file holds the published version
+     */
+    static bool FlushLocked();
+
+    /**
+     * @brief Load all records from the audit store file, falling back to its backup
+     * @param store Store to fill
      */
-    static std::vector<Record> LoadFromFile();
+    static void LoadFromFile(RecordStore& store);
 
     /**
      * @brief Save all records to the audit store file
-     * @param records Vector of records to save
+     * @param store Records to save
      * @return true if successful, false otherwise
      */
-    static bool SaveToFile(const std::vector<Record>& records);
+    static bool SaveToFile(const RecordStore& store);
 
     static std::string auditStorePath;
     static std::string logFilePath;
-    static std::mutex auditMutex;  // For thread-safe access
+    static std::mutex auditMutex;        // Serializes writers
+    static AuditSnapshotPtr published;   // Mirrors the audit store file; read with std::atomic_load
+    static uint64_t savedVersion;        // Version last written to the file
+    static ChangeListener changeListener;
 };
 
 #endif // AUDITLOGGER_H
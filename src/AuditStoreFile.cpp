@@ -0,0 +1,562 @@
+#include "AuditStoreFile.h"
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "Trace.h"
+#include "json.hpp"
+
+using json = nlohmann::json;
+
+namespace {
+
+// Data is written and checksummed in chunks of about this size
+const size_t kWriteChunkBytes = 64 * 1024;
+
+// Format 2 starts with this header line; the checksum covers everything after it
+const char kHeaderPrefix[] = "{\"format\":2,\"crc32\":\"";
+const char kHeaderSuffix[] = "\",\"records\":[\n";
+
+/**
+ * @brief CRC-32 (IEEE 802.3), eight bytes per step
+ */
+class Crc32 {
+public:
+    Crc32() : value(0xFFFFFFFFu) {}
+
+    void Update(const char* data, size_t length) {
+        static const Tables tables;
+        const uint32_t (&t)[8][256] = tables.entries;
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+        uint32_t crc = value;
+
+        while (length >= 8) {
+            uint32_t low = crc ^ (p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24));
+            uint32_t high = p[4] | (p[5] << 8) | (p[6] << 16) | (static_cast<uint32_t>(p[7]) << 24);
+            crc = t[7][low & 0xFF] ^ t[6][(low >> 8) & 0xFF] ^ t[5][(low >> 16) & 0xFF] ^ t[4][low >> 24] ^
+                  t[3][high & 0xFF] ^ t[2][(high >> 8) & 0xFF] ^ t[1][(high >> 16) & 0xFF] ^ t[0][high >> 24];
+            p += 8;
+            length -= 8;
+        }
+        while (length-- > 0) {
+            crc = t[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+        }
+        value = crc;
+    }
+
+    uint32_t Value() const { return value ^ 0xFFFFFFFFu; }
+
+private:
+    struct Tables {
+        uint32_t entries[8][256];
+
+        Tables() {
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t crc = i;
+                for (int bit = 0; bit < 8; bit++) {
+                    crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320u : 0);
+                }
+                entries[0][i] = crc;
+            }
+            for (int k = 1; k < 8; k++) {
+                for (uint32_t i = 0; i < 256; i++) {
+                    entries[k][i] = (entries[k - 1][i] >> 8) ^ entries[0][entries[k - 1][i] & 0xFF];
+                }
+            }
+        }
+    };
+
+    uint32_t value;
+};
+
+/**
+ * @brief SAX handler that turns the record array into store inserts
+ *
+ * The record array is either the whole document (format 1) or the
+ * "records" member of the top-level object (format 2). Unknown keys and
+ * nested values are skipped.
+ */
+class RecordReader {
+public:
+    explicit RecordReader(RecordStore& store)
+        : store(store), depth(0), recordsDepth(-1), recordsKey(false), inAddresses(false), inLastSeen(false),
+          field(Field::None) {}
+
+    bool null() { return true; }
+    bool boolean(bool) { return true; }
+
+    bool number_integer(json::number_integer_t value) {
+        SetNumber(static_cast<long long>(value));
+        return true;
+    }
+
+    bool number_unsigned(json::number_unsigned_t value) {
+        SetNumber(static_cast<long long>(std::min<json::number_unsigned_t>(
+            value, static_cast<json::number_unsigned_t>(std::numeric_limits<long long>::max()))));
+        return true;
+    }
+
+    bool number_float(json::number_float_t value, const json::string_t&) {
+        SetNumber(static_cast<long long>(value));
+        return true;
+    }
+
+    bool string(json::string_t& value) {
+        if (inAddresses && depth == recordsDepth + 2) {
+            record.lastResolvedIPs.push_back(std::move(value));
+        }
+        else if (InRecord()) {
+            switch (field) {
+            case Field::Fqdn: record.fqdn.assign(value); break;
+            case Field::KeywordId: record.keywordId.assign(value); break;
+            case Field::RuleName: record.ruleName.assign(value); break;
+            default: break;
+            }
+        }
+        return true;
+    }
+
+    bool binary(json::binary_t&) { return true; }
+
+    bool start_object(std::size_t) {
+        if (recordsDepth > 0 && depth == recordsDepth) {
+            // Reuse the string capacity of the previous record
+            record.fqdn.clear();
+            record.keywordId.clear();
+            record.ruleName.clear();
+            record.lastResolvedIPs.clear();
+            record.lastSeen.clear();
+            record.blockedAt = 0;
+            record.changedAt = 0;
+            record.interval = 0;
+            field = Field::None;
+        }
+        depth++;
+        return true;
+    }
+
+    bool key(json::string_t& name) {
+        if (depth == 1) {
+            recordsKey = name == "records";
+        }
+        else if (InRecord()) {
+            field = FieldOf(name);
+        }
+        return true;
+    }
+
+    bool end_object() {
+        depth--;
+        if (recordsDepth > 0 && depth == recordsDepth) {
+            Commit();
+        }
+        return true;
+    }
+
+    bool start_array(std::size_t) {
+        if (depth == 0 || (depth == 1 && recordsKey && recordsDepth < 0)) {
+            recordsDepth = depth + 1;
+        }
+        else if (InRecord() && field == Field::Addresses) {
+            inAddresses = true;
+        }
+        else if (InRecord() && field == Field::LastSeen) {
+            inLastSeen = true;
+        }
+        depth++;
+        return true;
+    }
+
+    bool end_array() {
+        depth--;
+        if (recordsDepth > 0 && depth == recordsDepth + 1) {
+            inAddresses = false;
+            inLastSeen = false;
+        }
+        return true;
+    }
+
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& e) {
+        error = e.what();
+        return false;
+    }
+
+    const std::string& Error() const { return error; }
+
+private:
+    enum class Field { None, Fqdn, KeywordId, RuleName, BlockedAt, ChangedAt, Interval, Addresses, LastSeen };
+
+    static Field FieldOf(const std::string& name) {
+        if (name == "fqdn") return Field::Fqdn;
+        if (name == "keywordId") return Field::KeywordId;
+        if (name == "ruleName") return Field::RuleName;
+        if (name == "blockedAt") return Field::BlockedAt;
+        if (name == "changedAt") return Field::ChangedAt;
+        if (name == "interval") return Field::Interval;
+        if (name == "lastResolvedIPs") return Field::Addresses;
+        if (name == "lastSeen") return Field::LastSeen;
+        return Field::None;
+    }
+
+    bool InRecord() const { return recordsDepth > 0 && depth == recordsDepth + 1; }
+
+    void SetNumber(long long value) {
+        if (inLastSeen && depth == recordsDepth + 2) {
+            record.lastSeen.push_back(static_cast<std::time_t>(value));
+            return;
+        }
+        if (!InRecord()) {
+            return;
+        }
+        if (field == Field::BlockedAt) {
+            record.blockedAt = static_cast<std::time_t>(value);
+        }
+        else if (field == Field::ChangedAt) {
+            record.changedAt = static_cast<std::time_t>(value);
+        }
+        else if (field == Field::Interval) {
+            record.interval = static_cast<int>(value);
+        }
+    }
+
+    void Commit() {
+        if (record.fqdn.empty()) {
+            std::cerr << "Skipping audit record without FQDN" << std::endl;
+            return;
+        }
+        if (store.Insert(record) == RecordStore::InvalidSlot) {
+            std::cerr << "Skipping duplicate record for FQDN: " << record.fqdn << std::endl;
+        }
+    }
+
+    RecordStore& store;
+    Record record;
+    int depth;
+    int recordsDepth;     // Depth inside the record array, -1 until it starts
+    bool recordsKey;      // Last top-level key was "records"
+    bool inAddresses;
+    bool inLastSeen;
+    Field field;
+    std::string error;
+};
+
+/**
+ * @brief Append a JSON string literal
+ */
+void AppendString(std::string& out, std::string_view text) {
+    static const char hex[] = "0123456789abcdef";
+    out += '"';
+
+    size_t run = 0;   // Start of the pending run of characters that need no escaping
+    for (size_t i = 0; i < text.size(); i++) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+
+        out.append(text.data() + run, i - run);
+        run = i + 1;
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\b': out += "\\b"; break;
+        case '\f': out += "\\f"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            out += "\\u00";
+            out += hex[c >> 4];
+            out += hex[c & 0x0F];
+            break;
+        }
+    }
+    out.append(text.data() + run, text.size() - run);
+    out += '"';
+}
+
+void AppendNumber(std::string& out, long long value) {
+    char digits[24];
+    auto end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+    out.append(digits, end);
+}
+
+/**
+ * @brief Check the format 2 header checksum against the rest of the file
+ * @param file Stream positioned at the start of the file
+ * @param error Reason for a failed check
+ * @return true if the checksum matches or the file is a format 1 array without one
+ */
+bool VerifyChecksum(std::istream& file, std::string& error) {
+    const size_t headerLength = sizeof(kHeaderPrefix) - 1 + 8 + sizeof(kHeaderSuffix) - 1;
+    std::string header(headerLength, '\0');
+    file.read(&header[0], static_cast<std::streamsize>(headerLength));
+    header.resize(static_cast<size_t>(file.gcount()));
+
+    if (header.compare(0, sizeof(kHeaderPrefix) - 1, kHeaderPrefix) != 0) {
+        size_t first = header.find_first_not_of(" \t\r\n");
+        if (first != std::string::npos && header[first] == '[') {
+            return true;   // Format 1: a bare array written before checksums existed
+        }
+        error = header.empty() ? "file is empty" : "unrecognized header";
+        return false;
+    }
+
+    if (header.size() != headerLength ||
+        header.compare(headerLength - (sizeof(kHeaderSuffix) - 1), std::string::npos, kHeaderSuffix) != 0) {
+        error = "malformed header";
+        return false;
+    }
+
+    uint32_t expected = 0;
+    const char* digits = header.data() + sizeof(kHeaderPrefix) - 1;
+    auto parsed = std::from_chars(digits, digits + 8, expected, 16);
+    if (parsed.ptr != digits + 8) {
+        error = "malformed checksum";
+        return false;
+    }
+
+    Crc32 crc;
+    std::vector<char> chunk(kWriteChunkBytes);
+    while (file) {
+        file.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+        crc.Update(chunk.data(), static_cast<size_t>(file.gcount()));
+    }
+    if (crc.Value() != expected) {
+        error = "checksum mismatch (truncated or damaged)";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Write the records in format 2 with the body checksum patched into the header
+ */
+bool WriteRecords(std::FILE* file, const RecordStore& store) {
+    std::string buffer;
+    buffer.reserve(kWriteChunkBytes + 1024);
+    buffer += kHeaderPrefix;
+    buffer += "00000000";
+    buffer += kHeaderSuffix;
+    const size_t bodyStart = buffer.size();
+
+    Crc32 crc;
+    auto flush = [&](size_t from) {
+        crc.Update(buffer.data() + from, buffer.size() - from);
+        bool written = std::fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+        buffer.clear();
+        return written;
+    };
+
+    size_t chunkStart = bodyStart;
+    bool first = true;
+    for (RecordStore::Slot slot = 0; slot < store.SlotCount(); slot++) {
+        if (!store.IsLive(slot)) {
+            continue;
+        }
+        if (!first) {
+            buffer += ",\n";
+        }
+        first = false;
+        AuditStoreFile::AppendRecord(buffer, store, slot);
+
+        if (buffer.size() >= kWriteChunkBytes) {
+            if (!flush(chunkStart)) {
+                return false;
+            }
+            chunkStart = 0;
+        }
+    }
+    buffer += first ? "]}\n" : "\n]}\n";
+    if (!flush(chunkStart)) {
+        return false;
+    }
+
+    char digits[9];
+    std::snprintf(digits, sizeof(digits), "%08x", static_cast<unsigned int>(crc.Value()));
+    return std::fseek(file, static_cast<long>(sizeof(kHeaderPrefix) - 1), SEEK_SET) == 0 &&
+           std::fwrite(digits, 1, 8, file) == 8;
+}
+
+/**
+ * @brief Push a written file to stable storage
+ */
+bool SyncFile(std::FILE* file) {
+    if (std::fflush(file) != 0) {
+        return false;
+    }
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+/**
+ * @brief Keep the current file as the backup and move the new one into its place
+ *
+ * The store path always names a complete version, except where hard links
+ * are unsupported and the current file has to be renamed to the backup
+ * first; a crash right after that leaves the complete temporary file.
+ */
+bool ReplaceWithBackup(const std::string& tempPath, const std::string& path, const std::string& backupPath) {
+#ifdef _WIN32
+    if (GetFileAttributesA(path.c_str()) != INVALID_FILE_ATTRIBUTES) {
+        return ReplaceFileA(path.c_str(), tempPath.c_str(), backupPath.c_str(), 0, nullptr, nullptr) != 0;
+    }
+    return MoveFileExA(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    struct stat info;
+    if (stat(path.c_str(), &info) == 0) {
+        std::remove(backupPath.c_str());
+        if (link(path.c_str(), backupPath.c_str()) != 0 && std::rename(path.c_str(), backupPath.c_str()) != 0) {
+            return false;
+        }
+    }
+    if (std::rename(tempPath.c_str(), path.c_str()) != 0) {
+        return false;
+    }
+
+    // Make the directory changes themselves durable
+    size_t slash = path.find_last_of('/');
+    std::string directory = slash == std::string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+    int fd = open(directory.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+    return true;
+#endif
+}
+
+} // namespace
+
+void AuditStoreFile::AppendRecord(std::string& out, const RecordStore& store, RecordStore::Slot slot) {
+    out += "{\"fqdn\":";
+    AppendString(out, store.Fqdn(slot));
+    out += ",\"keywordId\":";
+    AppendString(out, store.KeywordId(slot));
+    out += ",\"ruleName\":";
+    AppendString(out, store.RuleName(slot));
+    out += ",\"blockedAt\":";
+    AppendNumber(out, static_cast<long long>(store.BlockedAt(slot)));
+    out += ",\"changedAt\":";
+    AppendNumber(out, static_cast<long long>(store.ChangedAt(slot)));
+    out += ",\"interval\":";
+    AppendNumber(out, store.Interval(slot));
+    out += ",\"lastResolvedIPs\":[";
+
+    bool first = true;
+    for (const auto& ip : store.Addresses(slot)) {
+        if (!first) {
+            out += ',';
+        }
+        first = false;
+        AppendString(out, ip);
+    }
+    out += ']';
+
+    // Only records still holding addresses DNS stopped returning
+    std::vector<std::time_t> lastSeen = store.LastSeen(slot);
+    if (!lastSeen.empty()) {
+        out += ",\"lastSeen\":[";
+        for (size_t i = 0; i < lastSeen.size(); i++) {
+            if (i > 0) {
+                out += ',';
+            }
+            AppendNumber(out, static_cast<long long>(lastSeen[i]));
+        }
+        out += ']';
+    }
+    out += '}';
+}
+
+std::string AuditStoreFile::BackupPath(const std::string& path) {
+    return path + ".bak";
+}
+
+std::string AuditStoreFile::TempPath(const std::string& path) {
+    return path + ".tmp";
+}
+
+AuditStoreFile::ReadStatus AuditStoreFile::Read(const std::string& path, RecordStore& store) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return ReadStatus::Missing;
+    }
+
+    try {
+        TraceSpan span("audit_parse", "audit");
+
+        std::string error;
+        if (!VerifyChecksum(file, error)) {
+            std::cerr << "Audit store " << path << " failed verification: " << error << std::endl;
+            return ReadStatus::Corrupt;
+        }
+        file.clear();
+        file.seekg(0);
+
+        RecordReader reader(store);
+        bool complete = json::sax_parse(file, &reader);
+        store.ShrinkToFit();
+
+        if (!complete) {
+            std::cerr << "Error loading from file: " << reader.Error() << std::endl;
+            return ReadStatus::Corrupt;
+        }
+        return ReadStatus::Ok;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error loading from file: " << e.what() << std::endl;
+        return ReadStatus::Corrupt;
+    }
+}
+
+bool AuditStoreFile::Write(const std::string& path, const RecordStore& store) {
+    TraceSpan span("audit_write", "audit");
+    const std::string tempPath = TempPath(path);
+
+    try {
+        std::unique_ptr<std::FILE, int (*)(std::FILE*)> file(std::fopen(tempPath.c_str(), "wb"), &std::fclose);
+        if (!file) {
+            std::cerr << "Failed to open audit store for writing: " << tempPath << std::endl;
+            return false;
+        }
+
+        bool written = WriteRecords(file.get(), store) && SyncFile(file.get());
+        written = std::fclose(file.release()) == 0 && written;
+        if (!written) {
+            std::cerr << "Failed to write audit store: " << tempPath << std::endl;
+            std::remove(tempPath.c_str());
+            return false;
+        }
+
+        if (!ReplaceWithBackup(tempPath, path, BackupPath(path))) {
+            std::cerr << "Failed to replace audit store: " << path << std::endl;
+            std::remove(tempPath.c_str());
+            return false;
+        }
+        return true;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error saving to file: " << e.what() << std::endl;
+        std::remove(tempPath.c_str());
+        return false;
+    }
+}
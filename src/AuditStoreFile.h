@@ -0,0 +1,76 @@
+#ifndef AUDITSTOREFILE_H
+#define AUDITSTOREFILE_H
+
+#include <string>
+#include "RecordStore.h"
+
+/**
+ * @brief Streaming, crash-safe reader and writer for the audit store file
+ *
+ * The file is a JSON object whose first line carries a CRC-32 of the rest
+ * of the file, followed by a "records" array with one object per line:
+ *
+ *   {"format":2,"crc32":"1c291ca3","records":[
+ *   {"fqdn":"example.com",...},
+ *   ...
+ *   ]}
+ *
+ * Reading verifies the checksum, then runs a SAX parser that fills a single
+ * Record and inserts it into the store as soon as its object closes. Files
+ * written before the checksum existed (a bare array) are still accepted.
+ * Writing goes to TempPath(), which is flushed to disk and renamed over the
+ * store after the previous generation has been linked to BackupPath().
+ * Neither direction holds more than one record outside the store.
+ */
+class AuditStoreFile {
+public:
+    enum class ReadStatus {
+        Ok,         // Read completely
+        Missing,    // No file at the path
+        Corrupt     // Failed verification or parsing; the store may hold some records
+    };
+
+    /**
+     * @brief Load the records of a file into a store
+     * @param path File to read
+     * @param store Store to fill
+     * @return Outcome of the read
+     */
+    static ReadStatus Read(const std::string& path, RecordStore& store);
+
+    /**
+     * @brief Atomically replace a file with the records of a store
+     *
+     * At every point either the file or, briefly where hard links are
+     * unsupported, TempPath(path) holds a complete version; the previous
+     * version is kept at BackupPath(path).
+     * @param path File to write
+     * @param store Store to write
+     * @return true once the new version is on stable storage
+     */
+    static bool Write(const std::string& path, const RecordStore& store);
+
+    /**
+     * @brief Append one record as the single-line JSON object used in the file
+     * @param out Buffer to append to
+     * @param store Store holding the record
+     * @param slot Slot of the record
+     */
+    static void AppendRecord(std::string& out, const RecordStore& store, RecordStore::Slot slot);
+
+    /**
+     * @brief Path of the previous generation of a file
+     * @param path Store file path
+     * @return Backup path
+     */
+    static std::string BackupPath(const std::string& path);
+
+    /**
+     * @brief Path a new version is written to before it replaces a file
+     * @param path Store file path
+     * @return Temporary path
+     */
+    static std::string TempPath(const std::string& path);
+};
+
+#endif // AUDITSTOREFILE_H
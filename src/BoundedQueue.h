@@ -0,0 +1,122 @@
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+
+/**
+ * @brief Fixed-capacity blocking FIFO connecting pipeline stages
+ *
+ * Push() blocks while the queue is full, which applies backpressure to the
+ * producing stage. Pop() blocks while the queue is empty and returns false
+ * once the queue has been closed and drained.
+ */
+template <typename T>
+class BoundedQueue {
+public:
+    /**
+     * @brief Construct a queue
+     * @param capacity Maximum number of queued items (at least 1)
+     */
+    explicit BoundedQueue(size_t capacity)
+        : capacity(capacity > 0 ? capacity : 1), closed(false), maxDepth(0) {}
+
+    /**
+     * @brief Enqueue an item, waiting for space if the queue is full
+     * @param item Item to enqueue
+     * @return true if enqueued, false if the queue was closed
+     */
+    bool Push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this]() { return closed || items.size() < capacity; });
+        if (closed) {
+            return false;
+        }
+
+        items.push_back(std::move(item));
+        if (items.size() > maxDepth) {
+            maxDepth = items.size();
+        }
+        lock.unlock();
+        notEmpty.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Dequeue an item, waiting until one is available
+     * @param item Output parameter for the dequeued item
+     * @return true if an item was dequeued, false if closed and empty
+     */
+    bool Pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this]() { return closed || !items.empty(); });
+        if (items.empty()) {
+            return false;
+        }
+
+        item = std::move(items.front());
+        items.pop_front();
+        lock.unlock();
+        notFull.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Dequeue an item only if one is immediately available
+     * @param item Output parameter for the dequeued item
+     * @return true if an item was dequeued
+     */
+    bool TryPop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (items.empty()) {
+            return false;
+        }
+
+        item = std::move(items.front());
+        items.pop_front();
+        lock.unlock();
+        notFull.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Close the queue; pending items can still be popped
+     */
+    void Close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+
+    /**
+     * @brief Current number of queued items
+     */
+    size_t Depth() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return items.size();
+    }
+
+    /**
+     * @brief Highest number of queued items observed
+     */
+    size_t MaxDepth() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return maxDepth;
+    }
+
+private:
+    const size_t capacity;
+    std::deque<T> items;
+    bool closed;
+    size_t maxDepth;
+    mutable std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+};
+
+#endif // BOUNDEDQUEUE_H
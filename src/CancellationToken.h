@@ -0,0 +1,95 @@
+#ifndef CANCELLATIONTOKEN_H
+#define CANCELLATIONTOKEN_H
+
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+/**
+ * @brief Flag telling long-running work to give up early
+ *
+ * The owner of a piece of work (the scheduler for its refreshes) calls
+ * Cancel(); the resolver, the refresh pipeline and the firewall write
+ * queue check IsCancelled() between steps and wake up to check it at
+ * least every CheckInterval() while they wait for sockets or other
+ * threads. WaitFor() is a sleep that ends as soon as the token is
+ * cancelled. Functions taking a token accept nullptr for "never".
+ */
+class CancellationToken {
+public:
+    CancellationToken() : cancelled(false) {}
+
+    CancellationToken(const CancellationToken&) = delete;
+    CancellationToken& operator=(const CancellationToken&) = delete;
+
+    /**
+     * @brief Cancel the work and wake every WaitFor()
+     */
+    void Cancel() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            cancelled = true;
+        }
+        changed.notify_all();
+    }
+
+    /**
+     * @brief Make the token usable again for new work
+     */
+    void Reset() {
+        std::lock_guard<std::mutex> lock(mutex);
+        cancelled = false;
+    }
+
+    /**
+     * @brief Check whether Cancel() was called
+     */
+    bool IsCancelled() const {
+        return cancelled.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Sleep for a while unless cancelled first
+     * @param duration Time to sleep
+     * @return true if cancelled
+     */
+    template <typename Rep, typename Period>
+    bool WaitFor(std::chrono::duration<Rep, Period> duration) {
+        std::unique_lock<std::mutex> lock(mutex);
+        return changed.wait_for(lock, duration, [this]() { return cancelled.load(); });
+    }
+
+    /**
+     * @brief Longest a waiter may go without checking the token
+     */
+    static std::chrono::milliseconds CheckInterval() {
+        return std::chrono::milliseconds(20);
+    }
+
+    /**
+     * @brief Check whether an optional token was cancelled
+     * @param token Token, or nullptr
+     */
+    static bool IsCancelled(const CancellationToken* token) {
+        return token != nullptr && token->IsCancelled();
+    }
+
+    /**
+     * @brief Time to wait before checking an optional token again
+     * @param wait Time the caller intends to wait
+     * @param token Token, or nullptr to wait the whole time
+     */
+    template <typename Duration>
+    static Duration Slice(Duration wait, const CancellationToken* token) {
+        return token != nullptr ? std::min(wait, std::chrono::duration_cast<Duration>(CheckInterval())) : wait;
+    }
+
+private:
+    std::atomic<bool> cancelled;
+    std::mutex mutex;
+    std::condition_variable changed;
+};
+
+#endif // CANCELLATIONTOKEN_H
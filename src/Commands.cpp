@@ -0,0 +1,1351 @@
+#include "Commands.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <deque>
+#include <set>
+#include <unordered_set>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+
+#include "Config.h"
+#include "AuditLogger.h"
+#include "AuditStoreFile.h"
+#include "CompiledBlocklist.h"
+#include "FqdnCanonicalizer.h"
+#include "FirewallManager.h"
+#include "FirewallWriteQueue.h"
+#include "PassiveDnsIngest.h"
+#include "Resolver.h"
+#include "Replication.h"
+#include "Scheduler.h"
+#include "RefreshCoordinator.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "Platform.h"
+
+const CancellationToken* Commands::cancel = nullptr;
+Commands::ReplicationSettings Commands::replication;
+
+int Commands::Execute(const std::vector<std::string>& args, std::ostream& out, std::ostream& err) {
+    if (args.empty()) {
+        PrintUsage(out);
+        return 1;
+    }
+
+    const std::string& command = args[0];
+
+    // A standby's records come from its leader; changing them here would be overwritten
+    if (Replication::IsFollowing() &&
+        (command == "block" || command == "refresh" || command == "remove" || command == "block-many" ||
+         command == "remove-many" || command == "ingest")) {
+        err << "Error: This service is a replication standby of " << Replication::GetStatus().leader
+            << "; run '" << command << "' on the leader, or 'takeover' first" << std::endl;
+        return 1;
+    }
+
+    if (command == "block") {
+        HandleBlockCommand(args, out, err);
+    }
+    else if (command == "refresh") {
+        HandleRefreshCommand(out, err);
+    }
+    else if (command == "list") {
+        HandleListCommand(args, out, err);
+    }
+    else if (command == "remove") {
+        HandleRemoveCommand(args, out, err);
+    }
+    else if (command == "block-many") {
+        HandleBlockManyCommand(args, out, err);
+    }
+    else if (command == "remove-many") {
+        HandleRemoveManyCommand(args, out, err);
+    }
+    else if (command == "set-interval") {
+        HandleSetIntervalCommand(args, out, err);
+    }
+    else if (command == "compile") {
+        HandleCompileCommand(args, out, err);
+    }
+    else if (command == "check") {
+        return HandleCheckCommand(args, out, err) ? 0 : 1;
+    }
+    else if (command == "ingest") {
+        return HandleIngestCommand(args, out, err) ? 0 : 1;
+    }
+    else if (command == "resolve") {
+        return HandleResolveCommand(args, out, err) ? 0 : 1;
+    }
+    else if (command == "upstreams") {
+        HandleUpstreamsCommand(out);
+    }
+    else if (command == "replication") {
+        HandleReplicationCommand(out);
+    }
+    else if (command == "takeover") {
+        return HandleTakeoverCommand(out, err) ? 0 : 1;
+    }
+    else if (command == "metrics") {
+        out << Metrics::Expose() << std::flush;
+    }
+    else if (command == "help" || command == "--help" || command == "-h") {
+        PrintUsage(out);
+    }
+    else {
+        err << "Unknown command: " << command << std::endl;
+        PrintUsage(out);
+        return 1;
+    }
+
+    return 0;
+}
+
+bool Commands::NeedsHydration(const std::string& command) {
+    // Read-only commands are answered from the audit store as-is
+    return command != "list" && command != "metrics" && command != "compile" && command != "check" &&
+           command != "ingest" && command != "resolve" && command != "upstreams" && command != "replication" && command != "takeover" &&
+           command != "help" && command != "--help" && command != "-h";
+}
+
+bool Commands::IsReadOnly(const std::string& command) {
+    return command == "list" || command == "metrics" || command == "check" || command == "resolve" ||
+           command == "upstreams" || command == "replication" ||
+           command == "help" || command == "--help" || command == "-h";
+}
+
+void Commands::SetCancellation(const CancellationToken* token) {
+    cancel = token;
+}
+
+void Commands::SetReplicationSettings(const ReplicationSettings& settings) {
+    replication = settings;
+}
+
+void Commands::PrintUsage(std::ostream& out) {
+    out << "Usage: FqdnBlockerCli <command> [options]" << std::endl;
+    out << std::endl;
+    out << "Commands:" << std::endl;
+    out << "  block <fqdn> [interval]    Block an FQDN with optional refresh interval (minutes)" << std::endl;
+    out << "                             Example: FqdnBlockerCli block example.com 60" << std::endl;
+    out << std::endl;
+    out << "  refresh                    Manually refresh all blocked FQDNs" << std::endl;
+    out << "                             Example: FqdnBlockerCli refresh" << std::endl;
+    out << std::endl;
+    out << "  list [filters] [--limit N] [--offset N] [--format text|jsonl|csv]" << std::endl;
+    out << "                             List blocked FQDNs, optionally filtered by --interval N," << std::endl;
+    out << "                             --blocked-before/--blocked-after, --changed-before/--changed-after" << std::endl;
+    out << "                             (YYYY-MM-DD or an age such as 30d) and --ip <address|cidr>" << std::endl;
+    out << "                             Example: FqdnBlockerCli list --ip 203.0.113.0/24 --format csv" << std::endl;
+    out << std::endl;
+    out << "  remove <fqdn>              Remove a blocked FQDN and its firewall rule" << std::endl;
+    out << "                             Example: FqdnBlockerCli remove example.com" << std::endl;
+    out << std::endl;
+    out << "  block-many [--interval N] [--file <path>] [fqdn ...]" << std::endl;
+    out << "                             Block a list of FQDNs in one batch (reads stdin if no list given)" << std::endl;
+    out << "                             Example: FqdnBlockerCli block-many --file campaign.txt" << std::endl;
+    out << std::endl;
+    out << "  remove-many [--file <path>] [pattern ...]" << std::endl;
+    out << "                             Remove blocked FQDNs matching names or glob patterns" << std::endl;
+    out << "                             Example: FqdnBlockerCli remove-many \"*.ads.example\"" << std::endl;
+    out << std::endl;
+    out << "  set-interval <minutes>     Set the default refresh interval" << std::endl;
+    out << "                             Example: FqdnBlockerCli set-interval 120" << std::endl;
+    out << std::endl;
+    out << "  compile [path]             Compile the blocked FQDNs into a memory-mapped lookup file" << std::endl;
+    out << "                             (default: compiledBlocklistPath from the configuration)" << std::endl;
+    out << std::endl;
+    out << "  check <fqdn> [--file path] Look an FQDN up in the compiled blocklist (exit code 0 if blocked)" << std::endl;
+    out << "                             Example: FqdnBlockerCli check www.example.com" << std::endl;
+    out << std::endl;
+    out << "  ingest [--pcap <file>]... [--log <file>]..." << std::endl;
+    out << "                             Add addresses other resolvers answered for blocked FQDNs, from" << std::endl;
+    out << "                             DNS packet captures or dnsmasq/BIND-style logs" << std::endl;
+    out << "                             Example: FqdnBlockerCli ingest --pcap /var/tmp/dns.pcap" << std::endl;
+    out << std::endl;
+    out << "  resolve <fqdn>             Resolve an FQDN without blocking it, showing which DNS server" << std::endl;
+    out << "                             returned each address" << std::endl;
+    out << std::endl;
+    out << "  upstreams                  Show latency, health and address contribution of each DNS server" << std::endl;
+    out << std::endl;
+    out << "  replication                Show the replication role, versions and connected followers" << std::endl;
+    out << std::endl;
+    out << "  takeover                   Promote a standby service: stop following its leader and start" << std::endl;
+    out << "                             refreshing the replicated FQDNs itself" << std::endl;
+    out << std::endl;
+    out << "  metrics                    Print resolver, scheduler, firewall and audit store metrics" << std::endl;
+    out << "                             (text exposition format; most useful against a running service)" << std::endl;
+    out << std::endl;
+    out << "  service                    Run as a resident service that owns the scheduler and firewall session" << std::endl;
+    out << "                             While it runs, other commands are forwarded to it" << std::endl;
+    out << std::endl;
+    out << "  shutdown                   Stop the running service" << std::endl;
+    out << std::endl;
+    out << "  reload                     Reload config/config.json in the running service and apply only" << std::endl;
+    out << "                             the settings that changed (also on file change and SIGHUP)" << std::endl;
+    out << std::endl;
+    out << "  help                       Display this help message" << std::endl;
+    out << std::endl;
+    out << "Options:" << std::endl;
+    out << "  --trace <file>             Write a Chrome trace-event file of hydration and the command" << std::endl;
+    out << "                             (for 'service': of everything until shutdown)" << std::endl;
+    out << "  --verbose, -v              Show per-FQDN resolver, firewall and scheduler detail" << std::endl;
+    out << "  --quiet, -q                Show only warnings and errors from background components" << std::endl;
+    out << std::endl;
+    out << "Note: This application requires Administrator privileges." << std::endl;
+}
+
+void Commands::HandleBlockCommand(const std::vector<std::string>& args, std::ostream& out, std::ostream& err) {
+    if (args.size() < 2) {
+        err << "Error: Missing FQDN parameter" << std::endl;
+        out << "Usage: FqdnBlockerCli block <fqdn> [interval]" << std::endl;
+        return;
+    }
+
+    std::string fqdn;
+    FqdnCanonicalizer::Status status = FqdnCanonicalizer::Canonicalize(args[1], fqdn);
+    if (status != FqdnCanonicalizer::Status::Ok) {
+        err << "Error: Invalid FQDN '" << args[1] << "': " << FqdnCanonicalizer::Describe(status) << std::endl;
+        return;
+    }
+    int interval = Config::GetDefaultInterval();
+
+    if (args.size() >= 3) {
+        try {
+            interval = std::stoi(args[2]);
+            if (interval <= 0) {
+                err << "Error: Interval must be a positive number" << std::endl;
+                return;
+            }
+        }
+        catch (const std::exception&) {
+            err << "Error: Invalid interval value" << std::endl;
+            return;
+        }
+    }
+
+    out << "\nBlocking FQDN: " << fqdn << std::endl;
+    out << "Refresh interval: " << interval << " minutes" << std::endl;
+    out << std::endl;
+
+    // Resolve the FQDN
+    out << "Resolving " << fqdn << "..." << std::endl;
+    std::vector<std::string> ips = Resolver::ResolveFqdn(fqdn);
+
+    if (ips.empty()) {
+        err << "Error: Could not resolve FQDN" << std::endl;
+        return;
+    }
+
+    // User-initiated: bypasses the firewall write queue
+    FirewallWriteQueue::ChargeUrgent(2);
+
+    // Create dynamic keyword address
+    out << "Creating dynamic keyword address..." << std::endl;
+    std::string keywordId = FirewallManager::CreateDynamicKeywordAddress(fqdn, ips, true);
+
+    if (keywordId.empty()) {
+        err << "Error: Failed to create dynamic keyword address" << std::endl;
+        return;
+    }
+
+    // Create firewall rule
+    std::string ruleName = "Block " + fqdn;
+    out << "Creating firewall rule: " << ruleName << std::endl;
+    
+    if (!FirewallManager::CreateFirewallRule(ruleName, keywordId, "Outbound", "Block")) {
+        err << "Error: Failed to create firewall rule" << std::endl;
+        FirewallManager::DeleteDynamicKeywordAddress(keywordId);
+        return;
+    }
+
+    // Add to audit logger
+    Record record(fqdn, keywordId, ruleName, ips, interval);
+    if (!AuditLogger::AddRecord(record)) {
+        err << "Error: Failed to add audit record" << std::endl;
+        FirewallManager::DeleteFirewallRule(ruleName);
+        FirewallManager::DeleteDynamicKeywordAddress(keywordId);
+        return;
+    }
+
+    // Add to scheduler
+    Scheduler::AddTask(fqdn);
+
+    out << "\nSuccessfully blocked " << fqdn << std::endl;
+    out << "Resolved to " << ips.size() << " IP address(es):" << std::endl;
+    for (const auto& ip : ips) {
+        out << "  - " << ip << std::endl;
+    }
+}
+
+void Commands::HandleRefreshCommand(std::ostream& out, std::ostream& err) {
+    out << "\nRefreshing all blocked FQDNs..." << std::endl;
+
+    auto snapshot = AuditLogger::Snapshot();
+
+    if (snapshot->store.Size() == 0) {
+        out << "No FQDNs are currently blocked." << std::endl;
+        return;
+    }
+
+    RefreshPipeline::Options options = RefreshPipeline::OptionsFromConfig();
+    options.cancel = cancel;
+    auto result = RefreshCoordinator::Refresh(snapshot, snapshot->store.LiveSlots(), options);
+
+    for (const auto& item : result.items) {
+        bool failed = item.outcome != RefreshPipeline::ItemResult::Updated &&
+                      item.outcome != RefreshPipeline::ItemResult::Unchanged &&
+                      item.outcome != RefreshPipeline::ItemResult::Skipped;
+        (failed ? err : out) << "  " << item.fqdn << ": "
+                             << RefreshPipeline::DescribeOutcome(item.outcome) << "\n";
+    }
+
+    out << "\n==================================================" << std::endl;
+    out << "Refresh complete: " << (result.updated + result.unchanged) << " successful, "
+        << result.failed << " failed";
+    if (result.skipped > 0) {
+        out << ", " << result.skipped << " skipped (refreshed in the last "
+            << Config::GetRefreshFreshnessSeconds() << " s)";
+    }
+    out << std::endl;
+    RefreshPipeline::PrintStats(result, out);
+
+    if (FirewallWriteQueue::IsLimited()) {
+        FirewallWriteQueue::Stats queue = FirewallWriteQueue::GetStats();
+        out << "Firewall write queue: " << queue.applied << " applied, " << queue.coalesced << " coalesced, "
+            << queue.failed << " failed, " << queue.queued << " queued (deepest backlog "
+            << queue.maxPending << ") since startup" << std::endl;
+    }
+}
+
+namespace {
+
+const size_t kListBufferBytes = 64 * 1024;
+
+/**
+ * @brief Collects list output and hands it to the stream in large pieces
+ */
+class ListWriter {
+public:
+    explicit ListWriter(std::ostream& out) : out(out) { buffer.reserve(kListBufferBytes + 1024); }
+    ~ListWriter() { Flush(); }
+
+    std::string& Buffer() { return buffer; }
+
+    void EndRecord() {
+        if (buffer.size() >= kListBufferBytes) {
+            Flush();
+        }
+    }
+
+    void Flush() {
+        out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        buffer.clear();
+    }
+
+private:
+    std::ostream& out;
+    std::string buffer;
+};
+
+void AppendTime(std::string& out, std::time_t time) {
+    std::tm tm;
+    Platform::LocalTime(time, tm);
+    char text[32];
+    size_t length = std::strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &tm);
+    out.append(text, length);
+}
+
+void AppendCsvField(std::string& out, std::string_view field) {
+    if (field.find_first_of(",\"\r\n ") == std::string_view::npos) {
+        out.append(field.data(), field.size());
+        return;
+    }
+    out += '"';
+    for (char c : field) {
+        if (c == '"') {
+            out += '"';
+        }
+        out += c;
+    }
+    out += '"';
+}
+
+void AppendTextRecord(std::string& out, const RecordStore& store, RecordStore::Slot slot) {
+    std::vector<std::string> ips = store.Addresses(slot);
+    out += "\nFQDN: ";
+    out.append(store.Fqdn(slot));
+    out += "\n  Rule Name: " + store.RuleName(slot);
+    out += "\n  Keyword ID: " + store.KeywordId(slot);
+    out += "\n  Refresh Interval: " + std::to_string(store.Interval(slot)) + " minutes";
+    out += "\n  IP Addresses (" + std::to_string(ips.size()) + "):\n";
+    for (const auto& ip : ips) {
+        out += "    - " + ip + "\n";
+    }
+    out += "  Blocked At: ";
+    AppendTime(out, store.BlockedAt(slot));
+    out += "\n  Addresses Changed At: ";
+    AppendTime(out, store.ChangedAt(slot));
+    out += '\n';
+}
+
+void AppendCsvRecord(std::string& out, const RecordStore& store, RecordStore::Slot slot) {
+    AppendCsvField(out, store.Fqdn(slot));
+    out += ',';
+    AppendCsvField(out, store.KeywordId(slot));
+    out += ',';
+    AppendCsvField(out, store.RuleName(slot));
+    out += ',' + std::to_string(static_cast<long long>(store.BlockedAt(slot)));
+    out += ',' + std::to_string(static_cast<long long>(store.ChangedAt(slot)));
+    out += ',' + std::to_string(store.Interval(slot)) + ',';
+
+    std::string ips;
+    for (const auto& ip : store.Addresses(slot)) {
+        if (!ips.empty()) {
+            ips += ' ';
+        }
+        ips += ip;
+    }
+    AppendCsvField(out, ips);
+    out += '\n';
+}
+
+} // namespace
+
+bool Commands::ParseTimeArgument(const std::string& text, std::time_t now, std::time_t& time) {
+    int year = 0, month = 0, day = 0;
+    char extra = 0;
+    if (std::sscanf(text.c_str(), "%4d-%2d-%2d%c", &year, &month, &day, &extra) == 3) {
+        if (month < 1 || month > 12 || day < 1 || day > 31) {
+            return false;
+        }
+        std::tm tm = {};
+        tm.tm_year = year - 1900;
+        tm.tm_mon = month - 1;
+        tm.tm_mday = day;
+        tm.tm_isdst = -1;
+        time = std::mktime(&tm);
+        return time != static_cast<std::time_t>(-1);
+    }
+
+    // Age relative to now: a number followed by d, h or m
+    if (text.size() < 2 || !std::all_of(text.begin(), text.end() - 1, [](char c) { return c >= '0' && c <= '9'; })) {
+        return false;
+    }
+    long long amount = 0;
+    try {
+        amount = std::stoll(text.substr(0, text.size() - 1));
+    }
+    catch (const std::exception&) {
+        return false;
+    }
+    switch (text.back()) {
+    case 'd': time = now - static_cast<std::time_t>(amount * 86400); return true;
+    case 'h': time = now - static_cast<std::time_t>(amount * 3600); return true;
+    case 'm': time = now - static_cast<std::time_t>(amount * 60); return true;
+    default: return false;
+    }
+}
+
+bool Commands::ParseListArguments(const std::vector<std::string>& args, ListOptions& options, std::ostream& err) {
+    const std::time_t now = std::time(nullptr);
+
+    for (size_t i = 1; i < args.size(); i++) {
+        const std::string& arg = args[i];
+        if (arg.compare(0, 2, "--") != 0) {
+            err << "Error: Unexpected argument: " << arg << std::endl;
+            return false;
+        }
+        if (i + 1 >= args.size()) {
+            err << "Error: Missing value for " << arg << std::endl;
+            return false;
+        }
+        const std::string& value = args[++i];
+
+        if (arg == "--blocked-before" || arg == "--blocked-after" ||
+            arg == "--changed-before" || arg == "--changed-after") {
+            std::time_t time = 0;
+            if (!ParseTimeArgument(value, now, time)) {
+                err << "Error: Invalid time for " << arg << ": " << value
+                    << " (use YYYY-MM-DD or an age such as 30d, 12h)" << std::endl;
+                return false;
+            }
+            if (arg == "--blocked-before") options.filter.blockedTo = time;
+            else if (arg == "--blocked-after") options.filter.blockedFrom = time;
+            else if (arg == "--changed-before") options.filter.changedTo = time;
+            else options.filter.changedFrom = time;
+        }
+        else if (arg == "--ip") {
+            if (!RecordIndex::ParseNetwork(value, options.filter.network)) {
+                err << "Error: Invalid address or network: " << value << std::endl;
+                return false;
+            }
+            options.filter.hasNetwork = true;
+        }
+        else if (arg == "--interval" || arg == "--limit" || arg == "--offset") {
+            long long number = -1;
+            try {
+                number = std::stoll(value);
+            }
+            catch (const std::exception&) {
+                number = -1;
+            }
+            if (number < 0 || (arg == "--interval" && number == 0)) {
+                err << "Error: " << arg << " must be a " << (arg == "--interval" ? "positive" : "non-negative")
+                    << " number" << std::endl;
+                return false;
+            }
+            if (arg == "--interval") options.filter.interval = static_cast<int>(number);
+            else if (arg == "--limit") options.limit = static_cast<size_t>(number);
+            else options.offset = static_cast<size_t>(number);
+        }
+        else if (arg == "--format") {
+            if (value != "text" && value != "jsonl" && value != "csv") {
+                err << "Error: Unknown format: " << value << " (use text, jsonl or csv)" << std::endl;
+                return false;
+            }
+            options.format = value;
+        }
+        else {
+            err << "Error: Unknown option: " << arg << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+void Commands::HandleListCommand(const std::vector<std::string>& args, std::ostream& out, std::ostream& err) {
+    ListOptions options;
+    if (!ParseListArguments(args, options, err)) {
+        out << "Usage: FqdnBlockerCli list [filters] [--limit N] [--offset N] [--format text|jsonl|csv]" << std::endl;
+        return;
+    }
+
+    auto snapshot = AuditLogger::Snapshot();
+    const RecordStore& store = snapshot->store;
+
+    // An unfiltered listing needs no index; build it only when a filter asks
+    std::vector<RecordStore::Slot> slots = options.filter.IsEmpty()
+        ? store.LiveSlots() : snapshot->Index().Select(options.filter);
+    const size_t matched = slots.size();
+    size_t first = std::min(options.offset, slots.size());
+    size_t last = options.limit == 0 ? slots.size() : std::min(slots.size(), first + options.limit);
+
+    ListWriter writer(out);
+    std::string& buffer = writer.Buffer();
+
+    if (options.format == "jsonl") {
+        for (size_t i = first; i < last; i++) {
+            AuditStoreFile::AppendRecord(buffer, store, slots[i]);
+            buffer += '\n';
+            writer.EndRecord();
+        }
+        return;
+    }
+    if (options.format == "csv") {
+        buffer += "fqdn,keywordId,ruleName,blockedAt,changedAt,interval,ips\n";
+        for (size_t i = first; i < last; i++) {
+            AppendCsvRecord(buffer, store, slots[i]);
+            writer.EndRecord();
+        }
+        return;
+    }
+
+    if (store.Size() == 0) {
+        buffer += "\nNo FQDNs are currently blocked.\n";
+        return;
+    }
+    if (matched == 0) {
+        buffer += "\nNo blocked FQDNs match the filter.\n";
+        return;
+    }
+
+    buffer += "\n==================================================\n";
+    if (last - first == store.Size()) {
+        buffer += "Blocked FQDNs (" + std::to_string(store.Size()) + ")\n";
+    }
+    else {
+        buffer += "Blocked FQDNs (showing " + std::to_string(last - first) + " of " + std::to_string(matched) +
+                  " matching, " + std::to_string(store.Size()) + " total)\n";
+    }
+    buffer += "==================================================\n";
+
+    for (size_t i = first; i < last; i++) {
+        AppendTextRecord(buffer, store, slots[i]);
+        writer.EndRecord();
+    }
+
+    buffer += "==================================================\n";
+}
+
+void Commands::HandleRemoveCommand(const std::vector<std::string>& args, std::ostream& out, std::ostream& err) {
+    if (args.size() < 2) {
+        err << "Error: Missing FQDN parameter" << std::endl;
+        out << "Usage: FqdnBlockerCli remove <fqdn>" << std::endl;
+        return;
+    }
+
+    // Records from before canonicalization may only match the name as typed
+    std::string fqdn;
+    FqdnCanonicalizer::Canonicalize(args[1], fqdn);
+    Record record;
+    if (fqdn.empty() || !AuditLogger::GetRecord(fqdn, record)) {
+        fqdn = args[1];
+        if (!AuditLogger::GetRecord(fqdn, record)) {
+            out << "\nRemoving block for: " << args[1] << std::endl;
+            err << "Error: FQDN not found in blocked list" << std::endl;
+            return;
+        }
+    }
+
+    out << "\nRemoving block for: " << fqdn << std::endl;
+
+    // User-initiated: bypasses the firewall write queue
+    FirewallWriteQueue::ChargeUrgent(2);
+
+    // Delete firewall rule
+    out << "Deleting firewall rule..." << std::endl;
+    if (!FirewallManager::DeleteFirewallRule(record.ruleName)) {
+        err << "Warning: Failed to delete firewall rule" << std::endl;
+    }
+
+    // Delete dynamic keyword address
+    out << "Deleting dynamic keyword address..." << std::endl;
+    if (!FirewallManager::DeleteDynamicKeywordAddress(record.keywordId)) {
+        err << "Warning: Failed to delete dynamic keyword address" << std::endl;
+    }
+
+    // Remove from scheduler while the FQDN still maps to its audit slot
+    Scheduler::RemoveTask(fqdn);
+
+    // Remove from audit logger
+    if (!AuditLogger::RemoveRecord(fqdn)) {
+        err << "Error: Failed to remove audit record" << std::endl;
+        Scheduler::AddTask(fqdn);
+        return;
+    }
+
+    out << "\nSuccessfully removed block for: " << fqdn << std::endl;
+}
+
+void Commands::ReadBatchList(std::istream& in, std::vector<std::string>& items) {
+    std::string line;
+    while (std::getline(in, line)) {
+        // Strip comments and take the first token of each line
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) {
+            line.erase(comment);
+        }
+
+        std::istringstream tokens(line);
+        std::string item;
+        if (tokens >> item) {
+            items.push_back(item);
+        }
+    }
+}
+
+std::vector<std::string> Commands::ExpandBatchInputs(const std::vector<std::string>& args,
+                                                    std::ostream& err, bool& ok) {
+    ok = true;
+    if (args.empty() || (args[0] != "block-many" && args[0] != "remove-many")) {
+        return args;
+    }
+
+    std::vector<std::string> expanded;
+    std::vector<std::string> items;
+    bool readStdin = false;
+    bool hasSource = false;
+
+    expanded.push_back(args[0]);
+    for (size_t i = 1; i < args.size(); i++) {
+        const std::string& arg = args[i];
+
+        if (arg == "--interval") {
+            expanded.push_back(arg);
+            if (i + 1 < args.size()) {
+                expanded.push_back(args[++i]);
+            }
+        }
+        else if (arg == "--file") {
+            if (i + 1 >= args.size()) {
+                err << "Error: Missing value for --file" << std::endl;
+                ok = false;
+                return args;
+            }
+            const std::string& path = args[++i];
+            hasSource = true;
+
+            if (path == "-") {
+                readStdin = true;
+                continue;
+            }
+
+            std::ifstream file(path);
+            if (!file.is_open()) {
+                err << "Error: Could not open list file: " << path << std::endl;
+                ok = false;
+                return args;
+            }
+            ReadBatchList(file, items);
+        }
+        else if (arg == "-") {
+            readStdin = true;
+            hasSource = true;
+        }
+        else {
+            items.push_back(arg);
+            hasSource = true;
+        }
+    }
+
+    if (readStdin || !hasSource) {
+        ReadBatchList(std::cin, items);
+    }
+
+    expanded.insert(expanded.end(), items.begin(), items.end());
+    return expanded;
+}
+
+bool Commands::ParseBatchArguments(const std::vector<std::string>& args, bool allowInterval,
+                                   int& interval, std::vector<std::string>& items, std::ostream& err) {
+    for (size_t i = 1; i < args.size(); i++) {
+        const std::string& arg = args[i];
+
+        if (arg == "--interval" && allowInterval) {
+            if (i + 1 >= args.size()) {
+                err << "Error: Missing value for --interval" << std::endl;
+                return false;
+            }
+            try {
+                interval = std::stoi(args[++i]);
+            }
+            catch (const std::exception&) {
+                interval = 0;
+            }
+            if (interval <= 0) {
+                err << "Error: Interval must be a positive number" << std::endl;
+                return false;
+            }
+        }
+        else {
+            items.push_back(arg);
+        }
+    }
+
+    // Drop duplicates while preserving input order
+    std::set<std::string> seen;
+    items.erase(std::remove_if(items.begin(), items.end(),
+        [&seen](const std::string& item) { return !seen.insert(item).second; }), items.end());
+
+    return true;
+}
+
+void Commands::HandleBlockManyCommand(const std::vector<std::string>& args, std::ostream& out, std::ostream& err) {
+    int interval = Config::GetDefaultInterval();
+    std::vector<std::string> fqdns;
+
+    if (!ParseBatchArguments(args, true, interval, fqdns, err)) {
+        out << "Usage: FqdnBlockerCli block-many [--interval N] [--file <path>] [fqdn ...]" << std::endl;
+        return;
+    }
+
+    if (fqdns.empty()) {
+        err << "Error: No FQDNs given" << std::endl;
+        return;
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    out << "\nBlocking " << fqdns.size() << " FQDN(s) in batch" << std::endl;
+    out << "Refresh interval: " << interval << " minutes" << std::endl;
+
+    std::vector<bool> success(fqdns.size(), false);
+    std::vector<std::string> detail(fqdns.size());
+
+    // Skip anything that is already blocked before spending DNS queries on it
+    auto snapshot = AuditLogger::Snapshot();
+
+    std::vector<size_t> pending;
+    std::unordered_set<std::string> listed;
+    std::string canonical;
+    for (size_t i = 0; i < fqdns.size(); i++) {
+        FqdnCanonicalizer::Status status = FqdnCanonicalizer::Canonicalize(fqdns[i], canonical);
+        if (status != FqdnCanonicalizer::Status::Ok) {
+            detail[i] = std::string("invalid FQDN: ") + FqdnCanonicalizer::Describe(status);
+            continue;
+        }
+        fqdns[i] = canonical;
+
+        if (!listed.insert(canonical).second) {
+            detail[i] = "listed more than once";
+        }
+        else if (snapshot->store.Find(canonical) != RecordStore::InvalidSlot) {
+            detail[i] = "already blocked";
+        }
+        else {
+            pending.push_back(i);
+        }
+    }
+
+    // Stage 1: resolver workers push results onto a queue as they complete
+    const size_t kResolverThreads = 8;
+    std::mutex queueMutex;
+    std::condition_variable queueCv;
+    std::deque<std::pair<size_t, std::vector<std::string>>> resolved;
+    std::atomic<size_t> nextPending(0);
+
+    std::vector<std::thread> resolvers;
+    size_t resolverCount = std::min(kResolverThreads, pending.size());
+    for (size_t w = 0; w < resolverCount; w++) {
+        resolvers.emplace_back([&]() {
+            for (;;) {
+                size_t slot = nextPending++;
+                if (slot >= pending.size()) {
+                    break;
+                }
+
+                size_t index = pending[slot];
+                std::vector<std::string> ips = Resolver::ResolveFqdn(fqdns[index]);
+                {
+                    std::lock_guard<std::mutex> lock(queueMutex);
+                    resolved.emplace_back(index, std::move(ips));
+                }
+                queueCv.notify_one();
+            }
+        });
+    }
+
+    // Stage 2: firewall objects are created here while later names still resolve
+    std::vector<Record> newRecords;
+    std::vector<size_t> recordIndex;
+
+    for (size_t done = 0; done < pending.size(); done++) {
+        std::pair<size_t, std::vector<std::string>> item;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueCv.wait(lock, [&resolved]() { return !resolved.empty(); });
+            item = std::move(resolved.front());
+            resolved.pop_front();
+        }
+
+        size_t index = item.first;
+        const std::string& fqdn = fqdns[index];
+        const std::vector<std::string>& ips = item.second;
+
+        if (ips.empty()) {
+            detail[index] = "could not resolve";
+            continue;
+        }
+
+        FirewallWriteQueue::Throttle(2);
+        std::string keywordId = FirewallManager::CreateDynamicKeywordAddress(fqdn, ips, true);
+        if (keywordId.empty()) {
+            detail[index] = "failed to create dynamic keyword address";
+            continue;
+        }
+
+        std::string ruleName = "Block " + fqdn;
+        if (!FirewallManager::CreateFirewallRule(ruleName, keywordId, "Outbound", "Block")) {
+            FirewallManager::DeleteDynamicKeywordAddress(keywordId);
+            detail[index] = "failed to create firewall rule";
+            continue;
+        }
+
+        newRecords.emplace_back(fqdn, keywordId, ruleName, ips, interval);
+        recordIndex.push_back(index);
+    }
+
+    for (auto& resolver : resolvers) {
+        resolver.join();
+    }
+
+    // Stage 3: a single audit store write covers the whole batch
+    std::vector<bool> added = AuditLogger::AddRecords(newRecords);
+
+    for (size_t r = 0; r < newRecords.size(); r++) {
+        const Record& record = newRecords[r];
+        size_t index = recordIndex[r];
+
+        if (!added[r]) {
+            FirewallManager::DeleteFirewallRule(record.ruleName);
+            FirewallManager::DeleteDynamicKeywordAddress(record.keywordId);
+            detail[index] = "failed to add audit record";
+            continue;
+        }
+
+        Scheduler::AddTask(record.fqdn);
+        success[index] = true;
+        detail[index] = std::to_string(record.lastResolvedIPs.size()) + " IP(s)";
+    }
+
+    auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - startTime).count();
+
+    int successCount = 0;
+    out << "\n==================================================" << std::endl;
+    for (size_t i = 0; i < fqdns.size(); i++) {
+        out << (success[i] ? "  [OK]   " : "  [FAIL] ") << fqdns[i]
+                  << " - " << detail[i] << "\n";
+        successCount += success[i] ? 1 : 0;
+    }
+    out << "==================================================" << std::endl;
+    out << "Batch complete: " << successCount << " blocked, "
+              << (fqdns.size() - successCount) << " failed in " << elapsedMs << " ms" << std::endl;
+}
+
+void Commands::HandleRemoveManyCommand(const std::vector<std::string>& args, std::ostream& out, std::ostream& err) {
+    int unusedInterval = 0;
+    std::vector<std::string> patterns;
+
+    if (!ParseBatchArguments(args, false, unusedInterval, patterns, err)) {
+        out << "Usage: FqdnBlockerCli remove-many [--file <path>] [pattern ...]" << std::endl;
+        return;
+    }
+
+    if (patterns.empty()) {
+        err << "Error: No FQDNs or patterns given" << std::endl;
+        return;
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    // Expand names and glob patterns against a single read of the audit store
+    auto snapshot = AuditLogger::Snapshot();
+    const RecordStore& store = snapshot->store;
+    std::vector<RecordStore::Slot> slots = store.LiveSlots();
+    std::vector<Record> targets;
+    std::set<RecordStore::Slot> selected;
+
+    for (auto& pattern : patterns) {
+        // Exact names in canonical form; glob patterns already ignore case
+        std::string canonical;
+        if (pattern.find_first_of("*?") == std::string::npos &&
+            FqdnCanonicalizer::Canonicalize(pattern, canonical) == FqdnCanonicalizer::Status::Ok) {
+            pattern = canonical;
+        }
+
+        size_t matched = 0;
+        for (RecordStore::Slot slot : slots) {
+            if (AuditLogger::MatchesGlob(pattern, store.Fqdn(slot))) {
+                matched++;
+                if (selected.insert(slot).second) {
+                    targets.push_back(store.Get(slot));
+                }
+            }
+        }
+
+        if (matched == 0) {
+            err << "Warning: No blocked FQDN matches '" << pattern << "'" << std::endl;
+        }
+    }
+
+    if (targets.empty()) {
+        out << "\nNothing to remove." << std::endl;
+        return;
+    }
+
+    out << "\nRemoving " << targets.size() << " blocked FQDN(s) in batch" << std::endl;
+
+    std::vector<std::string> detail(targets.size());
+    std::vector<std::string> fqdns;
+    fqdns.reserve(targets.size());
+
+    for (size_t i = 0; i < targets.size(); i++) {
+        const Record& record = targets[i];
+        fqdns.push_back(record.fqdn);
+
+        FirewallWriteQueue::Throttle(2);
+        if (!FirewallManager::DeleteFirewallRule(record.ruleName)) {
+            detail[i] = "warning: failed to delete firewall rule";
+        }
+        if (!FirewallManager::DeleteDynamicKeywordAddress(record.keywordId)) {
+            detail[i] = "warning: failed to delete dynamic keyword address";
+        }
+    }
+
+    // Unschedule while the FQDNs still map to their audit slots
+    for (const auto& fqdn : fqdns) {
+        Scheduler::RemoveTask(fqdn);
+    }
+
+    // One audit store write for the whole batch
+    std::vector<bool> removed = AuditLogger::RemoveRecords(fqdns);
+
+    int successCount = 0;
+    for (size_t i = 0; i < targets.size(); i++) {
+        if (removed[i]) {
+            successCount++;
+            if (detail[i].empty()) {
+                detail[i] = "removed";
+            }
+        }
+        else {
+            detail[i] = "failed to remove audit record";
+            Scheduler::AddTask(fqdns[i]);
+        }
+    }
+
+    auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - startTime).count();
+
+    out << "\n==================================================" << std::endl;
+    for (size_t i = 0; i < targets.size(); i++) {
+        out << (removed[i] ? "  [OK]   " : "  [FAIL] ") << fqdns[i]
+                  << " - " << detail[i] << "\n";
+    }
+    out << "==================================================" << std::endl;
+    out << "Batch complete: " << successCount << " removed, "
+              << (targets.size() - successCount) << " failed in " << elapsedMs << " ms" << std::endl;
+}
+
+void Commands::HandleSetIntervalCommand(const std::vector<std::string>& args, std::ostream& out, std::ostream& err) {
+    if (args.size() < 2) {
+        err << "Error: Missing interval parameter" << std::endl;
+        out << "Usage: FqdnBlockerCli set-interval <minutes>" << std::endl;
+        return;
+    }
+
+    try {
+        int interval = std::stoi(args[1]);
+        
+        if (interval <= 0) {
+            err << "Error: Interval must be a positive number" << std::endl;
+            return;
+        }
+
+        Config::SetDefaultInterval(interval);
+        Config::Save("config/config.json");
+
+        out << "\nDefault refresh interval set to: " << interval << " minutes" << std::endl;
+    }
+    catch (const std::exception&) {
+        err << "Error: Invalid interval value" << std::endl;
+    }
+}
+
+void Commands::PerformBootPreHydration() {
+    auto snapshot = AuditLogger::Snapshot();
+    std::vector<RecordStore::Slot> records = snapshot->store.LiveSlots();
+
+    if (records.empty()) {
+        return;
+    }
+
+    TraceSpan span("boot_hydration", "hydration", std::to_string(records.size()) + " record(s)");
+
+    std::cout << "\n==================================================" << std::endl;
+    std::cout << "Performing boot pre-hydration for " << records.size() << " FQDN(s)..." << std::endl;
+    std::cout << "==================================================" << std::endl;
+
+    // Push current addresses to the firewall even when the stored IPs match
+    RefreshPipeline::Options options = RefreshPipeline::OptionsFromConfig();
+    options.forceApply = true;
+    auto result = RefreshCoordinator::Refresh(snapshot, records, options);
+
+    for (const auto& item : result.items) {
+        if (item.outcome != RefreshPipeline::ItemResult::Updated) {
+            std::cerr << "  Warning: " << item.fqdn << ": "
+                      << RefreshPipeline::DescribeOutcome(item.outcome) << std::endl;
+        }
+    }
+
+    // Re-add to scheduler
+    for (RecordStore::Slot slot : records) {
+        Scheduler::AddTask(slot);
+    }
+
+    std::cout << "\nHydrated " << result.updated << " of " << records.size() << " FQDN(s)" << std::endl;
+    RefreshPipeline::PrintStats(result, std::cout);
+    std::cout << "\nBoot pre-hydration complete." << std::endl;
+    std::cout << "==================================================" << std::endl;
+}
+
+void Commands::HandleCompileCommand(const std::vector<std::string>& args, std::ostream& out, std::ostream& err) {
+    if (args.size() > 2) {
+        err << "Error: Too many arguments" << std::endl;
+        out << "Usage: FqdnBlockerCli compile [path]" << std::endl;
+        return;
+    }
+    const std::string path = args.size() == 2 ? args[1] : Config::GetCompiledBlocklistPath();
+
+    auto snapshot = AuditLogger::Snapshot();
+    auto start = std::chrono::steady_clock::now();
+    size_t compiled = 0;
+    size_t truncated = 0;
+    if (!CompiledBlocklist::Compile(path, snapshot->store, compiled, truncated)) {
+        err << "Error: Failed to compile the blocklist to " << path << std::endl;
+        return;
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+    out << "Compiled " << compiled << " FQDN(s) to " << path << " in " << elapsed.count() << " ms" << std::endl;
+    if (compiled < snapshot->store.Size()) {
+        out << (snapshot->store.Size() - compiled) << " record(s) skipped: not a valid FQDN, or the same FQDN in another case"
+            << std::endl;
+    }
+    if (truncated > 0) {
+        err << "Warning: " << truncated << " record(s) compiled incompletely: only the first 255 IPv4 and 255 IPv6 "
+            << "addresses, 255 bytes of keyword and 65535 bytes of rule name are kept; 'check' shows them cut"
+            << std::endl;
+    }
+}
+
+bool Commands::HandleCheckCommand(const std::vector<std::string>& args, std::ostream& out, std::ostream& err) {
+    std::string fqdn;
+    std::string path = Config::GetCompiledBlocklistPath();
+    for (size_t i = 1; i < args.size(); i++) {
+        if (args[i] == "--file" && i + 1 < args.size()) {
+            path = args[++i];
+        }
+        else if (fqdn.empty()) {
+            fqdn = args[i];
+        }
+        else {
+            fqdn.clear();
+            break;
+        }
+    }
+    if (fqdn.empty()) {
+        err << "Error: Missing FQDN parameter" << std::endl;
+        out << "Usage: FqdnBlockerCli check <fqdn> [--file path]" << std::endl;
+        return false;
+    }
+
+    CompiledBlocklist blocklist;
+    if (!blocklist.Open(path)) {
+        err << "Error: Could not open compiled blocklist " << path << " (run 'compile' first)" << std::endl;
+        return false;
+    }
+
+    CompiledBlocklist::Entry entry;
+    if (!blocklist.Find(fqdn, entry)) {
+        out << fqdn << ": not blocked" << std::endl;
+        return false;
+    }
+
+    std::tm tm;
+    Platform::LocalTime(entry.blockedAt, tm);
+    out << fqdn << ": blocked" << std::endl;
+    out << "  Rule Name: " << entry.ruleName << std::endl;
+    out << "  Keyword ID: " << entry.keywordId << std::endl;
+    out << "  Refresh Interval: " << entry.interval << " minutes" << std::endl;
+    out << "  Blocked At: " << std::put_time(&tm, "%Y-%m-%d %H:%M:%S") << std::endl;
+    out << "  IP Addresses (" << entry.ipv4Count + entry.ipv6Count << "):" << std::endl;
+    for (const auto& ip : entry.Addresses()) {
+        out << "    - " << ip << std::endl;
+    }
+    return true;
+}
+
+bool Commands::HandleIngestCommand(const std::vector<std::string>& args, std::ostream& out, std::ostream& err) {
+    std::vector<std::pair<bool, std::string>> inputs;   // (is pcap, path)
+    for (size_t i = 1; i < args.size(); i++) {
+        if ((args[i] == "--pcap" || args[i] == "--log") && i + 1 < args.size()) {
+            inputs.emplace_back(args[i] == "--pcap", args[i + 1]);
+            i++;
+        }
+        else {
+            err << "Error: Unexpected argument: " << args[i] << std::endl;
+            inputs.clear();
+            break;
+        }
+    }
+    if (inputs.empty()) {
+        out << "Usage: FqdnBlockerCli ingest [--pcap <file>]... [--log <file>]..." << std::endl;
+        return false;
+    }
+
+    PassiveDnsIngest::Options options;
+    options.graceSeconds = Config::GetAddressGraceMinutes() * 60;
+    PassiveDnsIngest::Stats stats = {};
+    bool ok = true;
+
+    auto start = std::chrono::steady_clock::now();
+    for (const auto& input : inputs) {
+        bool read = input.first ? PassiveDnsIngest::IngestPcap(input.second, options, stats)
+                                : PassiveDnsIngest::IngestLog(input.second, options, stats);
+        if (!read) {
+            err << "Error: Could not ingest " << input.second << " (see the log for details)" << std::endl;
+            ok = false;
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    out << "Read " << stats.bytes << " bytes: " << stats.messages << " response(s) or line(s), "
+        << stats.answers << " address answer(s)";
+    if (stats.malformed > 0) {
+        out << ", " << stats.malformed << " malformed";
+    }
+    out << std::endl;
+    out << "Matched " << stats.matched << " answer(s) for blocked FQDNs";
+    if (stats.stale > 0) {
+        out << " (" << stats.stale << " older than the grace period, skipped)";
+    }
+    out << std::endl;
+    out << "Added " << stats.added << " address(es), refreshed " << stats.refreshed
+        << " lingering address(es) in " << stats.recordsUpdated << " record(s)" << std::endl;
+    if (stats.failed > 0) {
+        out << "Firewall update failed for " << stats.failed << " record(s)" << std::endl;
+        ok = false;
+    }
+    if (seconds > 0) {
+        out << std::fixed << std::setprecision(2) << "Took " << seconds << " s ("
+            << static_cast<uint64_t>(stats.messages / seconds) << " per second)" << std::endl;
+    }
+    return ok;
+}
+
+bool Commands::HandleResolveCommand(const std::vector<std::string>& args, std::ostream& out, std::ostream& err) {
+    if (args.size() != 2) {
+        err << "Error: Missing FQDN parameter" << std::endl;
+        out << "Usage: FqdnBlockerCli resolve <fqdn>" << std::endl;
+        return false;
+    }
+    std::string fqdn;
+    FqdnCanonicalizer::Status status = FqdnCanonicalizer::Canonicalize(args[1], fqdn);
+    if (status != FqdnCanonicalizer::Status::Ok) {
+        err << "Error: Invalid FQDN '" << args[1] << "': " << FqdnCanonicalizer::Describe(status) << std::endl;
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    Resolver::Resolution resolution = Resolver::Resolve(fqdn);
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    if (resolution.addresses.empty()) {
+        out << fqdn << ": no addresses (" << elapsed.count() << " ms)" << std::endl;
+        return false;
+    }
+
+    out << fqdn << ": " << resolution.addresses.size() << " address(es) in " << elapsed.count() << " ms";
+    if (resolution.ttlSeconds > 0) {
+        out << ", TTL " << resolution.ttlSeconds << " s";
+    }
+    out << std::endl;
+
+    const std::vector<Resolver::UpstreamStats> upstreams = Resolver::GetUpstreamStats();
+    for (size_t i = 0; i < resolution.addresses.size(); i++) {
+        out << "  " << std::left << std::setw(40) << resolution.addresses[i] << std::right;
+        std::string sources;
+        for (size_t u = 0; u < upstreams.size(); u++) {
+            if (resolution.sources[i] & (1u << u)) {
+                sources += (sources.empty() ? "" : ", ") + upstreams[u].server;
+            }
+        }
+        out << (sources.empty() ? "system resolver" : sources) << std::endl;
+    }
+    return true;
+}
+
+void Commands::HandleUpstreamsCommand(std::ostream& out) {
+    const std::vector<Resolver::UpstreamStats> upstreams = Resolver::GetUpstreamStats();
+    if (upstreams.empty()) {
+        out << "Resolving through the system resolver (set dnsUpstream or dnsUpstreams to query DNS servers directly)"
+            << std::endl;
+        return;
+    }
+
+    out << std::left << std::setw(24) << "SERVER" << std::right << std::setw(9) << "STATE"
+        << std::setw(12) << "RESOLUTIONS" << std::setw(10) << "TIMEOUTS" << std::setw(9) << "EWMA MS"
+        << std::setw(9) << "P95 MS" << std::setw(9) << "HEDGED" << std::setw(7) << "LOST"
+        << std::setw(8) << "EJECTED" << std::setw(11) << "ADDRESSES" << std::setw(8) << "UNIQUE" << std::endl;
+    for (const auto& upstream : upstreams) {
+        out << std::left << std::setw(24) << upstream.server << std::right
+            << std::setw(9) << (upstream.healthy ? "up" : "ejected")
+            << std::setw(12) << upstream.resolutions << std::setw(10) << upstream.timeouts
+            << std::fixed << std::setprecision(1) << std::setw(9) << upstream.ewmaMs << std::setw(9) << upstream.p95Ms
+            << std::setw(9) << upstream.hedged << std::setw(7) << upstream.hedgeWins << std::setw(8) << upstream.ejections
+            << std::setw(11) << upstream.addresses << std::setw(8) << upstream.uniqueAddresses << std::endl;
+    }
+    if (upstreams.size() > 1) {
+        out << "HEDGED: resolutions sent on to another server after this one passed its p95; LOST: of those," << std::endl;
+        out << "answered by the other server first. UNIQUE (fanout): addresses no other server returned for the" << std::endl;
+        out << "same FQDN; a server with few of those and a high EWMA adds latency without adding coverage." << std::endl;
+    }
+}
+
+void Commands::HandleReplicationCommand(std::ostream& out) {
+    const Replication::Status status = Replication::GetStatus();
+
+    if (status.leading) {
+        out << "Leader on " << status.listen << ", epoch " << std::hex << status.epoch << std::dec
+            << ", version " << status.version << std::endl;
+        out << "Journal: " << status.journalEntries << " version(s)";
+        if (status.journalEntries > 0) {
+            out << " from " << status.journalFirstVersion;
+        }
+        out << ", " << (status.journalBytes + 1023) / 1024 << " KiB" << std::endl;
+        if (status.followers.empty()) {
+            out << "No followers connected" << std::endl;
+            return;
+        }
+        out << std::left << std::setw(28) << "FOLLOWER" << std::right << std::setw(10) << "STATE"
+            << std::setw(12) << "ACKED" << std::setw(8) << "LAG" << std::setw(11) << "SNAPSHOTS" << std::endl;
+        for (const auto& follower : status.followers) {
+            uint64_t lag = status.version > follower.ackedVersion ? status.version - follower.ackedVersion : 0;
+            out << std::left << std::setw(28) << follower.address << std::right
+                << std::setw(10) << (follower.streaming ? "streaming" : "snapshot")
+                << std::setw(12) << follower.ackedVersion << std::setw(8) << lag
+                << std::setw(11) << follower.snapshots << std::endl;
+        }
+        return;
+    }
+
+    if (status.following) {
+        out << "Standby of " << status.leader << ", " << (status.connected ? "connected" : "disconnected")
+            << ", last message " << std::fixed << std::setprecision(1) << status.sinceLastMessageSeconds
+            << " s ago" << std::endl;
+        out << "Applied leader version " << status.version << " (epoch " << std::hex << status.epoch << std::dec
+            << "): " << status.snapshotsReceived << " snapshot(s), " << status.versionsApplied
+            << " version(s) streamed" << std::endl;
+        return;
+    }
+
+    out << "Replication is not running (set replicationListen on the leader and replicationLeader on a standby)"
+        << std::endl;
+}
+
+bool Commands::HandleTakeoverCommand(std::ostream& out, std::ostream& err) {
+    if (!Replication::IsFollowing()) {
+        err << "Error: This service is not a replication standby" << std::endl;
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t version = Replication::StopFollower();
+    // Our records now move on their own; a later run as a follower must start from a snapshot
+    if (!replication.statePath.empty()) {
+        std::remove(replication.statePath.c_str());
+    }
+
+    // The replicated records and firewall are current: schedule them without resolving or pushing
+    auto snapshot = AuditLogger::Snapshot();
+    std::vector<RecordStore::Slot> records = snapshot->store.LiveSlots();
+    for (RecordStore::Slot slot : records) {
+        Scheduler::AddTask(slot);
+    }
+    Scheduler::Start();
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+    out << "Took over at leader version " << version << ": scheduling " << records.size() << " FQDN(s) after "
+        << elapsed.count() << " ms" << std::endl;
+
+    if (!replication.listen.empty()) {
+        if (Replication::StartLeader(replication.listen, replication.secret)) {
+            out << "Accepting replication followers on " << replication.listen << std::endl;
+        }
+        else {
+            err << "Warning: Failed to listen for replication followers on " << replication.listen << std::endl;
+        }
+    }
+    out << "Set replicationLeader to \"\" in this service's configuration so it stays the leader after a restart"
+        << std::endl;
+    return true;
+}
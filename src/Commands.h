@@ -0,0 +1,149 @@
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <ctime>
+#include <cstddef>
+
+#include "CancellationToken.h"
+#include "RecordIndex.h"
+
+/**
+ * @brief CLI command handlers
+ *
+ * Executes a parsed command line against the already-initialized modules.
+ * Output is written to caller-supplied streams so the same handlers serve
+ * both a local invocation (console) and the resident service (captured and
+ * sent back over the control channel).
+ */
+class Commands {
+public:
+    /**
+     * @brief Execute a command
+     * @param args Command line arguments (args[0] is the command)
+     * @param out Stream for regular output
+     * @param err Stream for error output
+     * @return Process exit code
+     */
+    static int Execute(const std::vector<std::string>& args, std::ostream& out, std::ostream& err);
+
+    /**
+     * @brief Inline list files and stdin for batch commands
+     *
+     * Replaces `--file <path>` and `-` arguments of block-many/remove-many with
+     * the items they contain, so the command can be executed somewhere else
+     * (e.g. in the service) without access to the caller's files or stdin.
+     *
+     * @param args Command line arguments (args[0] is the command)
+     * @param err Stream for error output
+     * @param ok Output parameter, false if a list could not be read
+     * @return Expanded arguments (unchanged for other commands)
+     */
+    static std::vector<std::string> ExpandBatchInputs(const std::vector<std::string>& args,
+                                                      std::ostream& err, bool& ok);
+
+    /**
+     * @brief Check whether a command needs boot pre-hydration when run locally
+     * @param command Command name
+     * @return true if hydration should run before the command
+     */
+    static bool NeedsHydration(const std::string& command);
+
+    /**
+     * @brief Check whether a command only reads state, so it may run alongside others
+     * @param command Command name
+     * @return true if the command changes no records, configuration or firewall rules
+     */
+    static bool IsReadOnly(const std::string& command);
+
+    /**
+     * @brief Set the token that abandons a refresh command in progress (service shutdown)
+     * @param token Token, or nullptr for none
+     */
+    static void SetCancellation(const CancellationToken* token);
+
+    /**
+     * @brief Replication settings a service started with
+     *
+     * They are read once at startup, so takeover uses these rather than
+     * values a configuration reload has changed since.
+     */
+    struct ReplicationSettings {
+        std::string listen;
+        std::string secret;
+        std::string statePath;
+    };
+
+    /**
+     * @brief Record the replication settings the service started with
+     * @param settings Settings in use
+     */
+    static void SetReplicationSettings(const ReplicationSettings& settings);
+
+    /**
+     * @brief Refresh all existing records and re-add their scheduled tasks
+     */
+    static void PerformBootPreHydration();
+
+    /**
+     * @brief Print usage information
+     * @param out Stream to print to
+     */
+    static void PrintUsage(std::ostream& out);
+
+private:
+    static void HandleBlockCommand(const std::vector<std::string>& args, std::ostream& out, std::ostream& err);
+    static void HandleRefreshCommand(std::ostream& out, std::ostream& err);
+    static void HandleListCommand(const std::vector<std::string>& args, std::ostream& out, std::ostream& err);
+    static void HandleRemoveCommand(const std::vector<std::string>& args, std::ostream& out, std::ostream& err);
+    static void HandleBlockManyCommand(const std::vector<std::string>& args, std::ostream& out, std::ostream& err);
+    static void HandleRemoveManyCommand(const std::vector<std::string>& args, std::ostream& out, std::ostream& err);
+    static void HandleSetIntervalCommand(const std::vector<std::string>& args, std::ostream& out, std::ostream& err);
+    static void HandleCompileCommand(const std::vector<std::string>& args, std::ostream& out, std::ostream& err);
+    static bool HandleCheckCommand(const std::vector<std::string>& args, std::ostream& out, std::ostream& err);
+    static bool HandleIngestCommand(const std::vector<std::string>& args, std::ostream& out, std::ostream& err);
+    static bool HandleResolveCommand(const std::vector<std::string>& args, std::ostream& out, std::ostream& err);
+    static void HandleUpstreamsCommand(std::ostream& out);
+    static void HandleReplicationCommand(std::ostream& out);
+    static bool HandleTakeoverCommand(std::ostream& out, std::ostream& err);
+
+    /**
+     * @brief Filter, page and output format of a list command
+     */
+    struct ListOptions {
+        RecordIndex::Filter filter;
+        size_t offset;
+        size_t limit;          // 0 for no limit
+        std::string format;    // "text", "jsonl" or "csv"
+
+        ListOptions() : offset(0), limit(0), format("text") {}
+    };
+
+    /**
+     * @brief Parse the options of a list command
+     */
+    static bool ParseListArguments(const std::vector<std::string>& args, ListOptions& options, std::ostream& err);
+
+    /**
+     * @brief Parse a date (YYYY-MM-DD, local midnight) or an age before now (30d, 12h, 45m)
+     */
+    static bool ParseTimeArgument(const std::string& text, std::time_t now, std::time_t& time);
+
+    /**
+     * @brief Read one FQDN or pattern per line, ignoring blanks and '#' comments
+     */
+    static void ReadBatchList(std::istream& in, std::vector<std::string>& items);
+
+    /**
+     * @brief Parse `--interval` and positional items of an expanded batch command
+     */
+    static bool ParseBatchArguments(const std::vector<std::string>& args, bool allowInterval,
+                                    int& interval, std::vector<std::string>& items, std::ostream& err);
+
+    static const CancellationToken* cancel;
+    static ReplicationSettings replication;
+};
+
+#endif // COMMANDS_H
@@ -0,0 +1,591 @@
+#include "CompiledBlocklist.h"
+#include "DnsMessage.h"
+#include "FqdnCanonicalizer.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <unordered_set>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+struct CompiledBlocklist::Header {
+    char magic[8];
+    uint32_t formatVersion;
+    uint32_t count;                 // FQDNs, and positions of the perfect hash
+    uint64_t seed;
+    uint32_t bucketCount;
+    uint32_t bloomBlocks;           // 64-byte Bloom filter blocks
+    uint64_t bloomOffset;
+    uint64_t displacementOffset;    // uint32_t per bucket
+    uint64_t positionOffset;        // uint32_t record offset per position
+    uint64_t recordOffset;
+    uint64_t recordSize;
+    uint64_t fileSize;
+    int64_t compiledAt;
+};
+
+namespace {
+
+const char kMagic[8] = { 'F', 'Q', 'D', 'N', 'B', 'L', 'K', '\0' };
+const uint32_t kFormatVersion = 1;
+const size_t kSectionAlign = 64;
+const size_t kBucketSize = 4;           // Average FQDNs per perfect hash bucket
+const size_t kBloomBitsPerKey = 10;     // About 1% false positives with 6 probes
+const int kBloomProbes = 6;
+const int kSeedAttempts = 16;
+
+// Fixed part of a packed record: blockedAt, changedAt, interval, rule name
+// length, FQDN length, keyword length, IPv4 count, IPv6 count
+const size_t kRecordFixedSize = 4 + 4 + 4 + 2 + 1 + 1 + 1 + 1;
+
+uint64_t HashName(const char* data, size_t size, uint64_t seed) {
+    // MurmurHash64A
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    uint64_t h = seed ^ (size * m);
+    while (size >= 8) {
+        uint64_t k;
+        std::memcpy(&k, data, 8);
+        k *= m;
+        k ^= k >> 47;
+        k *= m;
+        h ^= k;
+        h *= m;
+        data += 8;
+        size -= 8;
+    }
+    if (size > 0) {
+        uint64_t tail = 0;
+        std::memcpy(&tail, data, size);
+        h ^= tail;
+        h *= m;
+    }
+    h ^= h >> 47;
+    h *= m;
+    h ^= h >> 47;
+    return h;
+}
+
+uint64_t Mix(uint64_t x) {
+    // splitmix64 finalizer
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+/**
+ * @brief Map a 32-bit hash onto 0..range-1 without a division
+ */
+uint32_t Reduce(uint32_t hash, uint32_t range) {
+    return static_cast<uint32_t>((static_cast<uint64_t>(hash) * range) >> 32);
+}
+
+uint32_t BucketOf(uint64_t hash, uint32_t bucketCount) {
+    return Reduce(static_cast<uint32_t>(hash >> 32), bucketCount);
+}
+
+uint32_t PositionOf(uint64_t hash, uint32_t displacement, uint32_t count) {
+    return Reduce(static_cast<uint32_t>(Mix(hash ^ (displacement * 0x9e3779b97f4a7c15ULL)) >> 32), count);
+}
+
+bool BloomMayContain(const uint8_t* bloom, uint32_t blocks, uint64_t hash) {
+    const uint8_t* block = bloom + static_cast<size_t>(Reduce(static_cast<uint32_t>(hash), blocks)) * 64;
+    uint64_t bits = Mix(hash);
+    for (int i = 0; i < kBloomProbes; i++, bits >>= 9) {
+        uint32_t bit = static_cast<uint32_t>(bits & 511);
+        if ((block[bit >> 3] & (1u << (bit & 7))) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void BloomAdd(uint8_t* bloom, uint32_t blocks, uint64_t hash) {
+    uint8_t* block = bloom + static_cast<size_t>(Reduce(static_cast<uint32_t>(hash), blocks)) * 64;
+    uint64_t bits = Mix(hash);
+    for (int i = 0; i < kBloomProbes; i++, bits >>= 9) {
+        uint32_t bit = static_cast<uint32_t>(bits & 511);
+        block[bit >> 3] |= static_cast<uint8_t>(1u << (bit & 7));
+    }
+}
+
+/**
+ * @brief Canonical key of an FQDN
+ * @return Length written to out, 0 if the name is not valid
+ */
+size_t Canonicalize(std::string_view fqdn, char (&out)[FqdnCanonicalizer::MaxLength]) {
+    size_t length = 0;
+    FqdnCanonicalizer::Status status = FqdnCanonicalizer::Canonicalize(fqdn, out, length);
+    return status == FqdnCanonicalizer::Status::Ok || status == FqdnCanonicalizer::Status::NeedsPunycode ? length : 0;
+}
+
+size_t AlignSection(size_t offset) {
+    return (offset + kSectionAlign - 1) & ~(kSectionAlign - 1);
+}
+
+template <typename T>
+void Put(std::vector<uint8_t>& out, T value) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+T Get(const uint8_t* data) {
+    T value;
+    std::memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+uint32_t ClampTime(std::time_t time) {
+    return static_cast<uint32_t>(std::min<int64_t>(std::max<int64_t>(time, 0), 0xFFFFFFFFLL));
+}
+
+/**
+ * @brief Append one packed record
+ * @param ipv4 Scratch buffer, reused between records
+ * @param ipv6 Scratch buffer, reused between records
+ * @return false if the record had to be cut to fit its count and length fields
+ */
+bool AppendRecord(std::vector<uint8_t>& out, std::string_view fqdn, const RecordStore& store, RecordStore::Slot slot,
+                  std::vector<uint8_t>& ipv4, std::vector<uint8_t>& ipv6) {
+    std::string keywordId = store.KeywordId(slot);
+    std::string ruleName = store.RuleName(slot);
+    bool complete = keywordId.size() <= 255 && ruleName.size() <= 0xFFFF;
+    keywordId.resize(std::min<size_t>(keywordId.size(), 255));
+    ruleName.resize(std::min<size_t>(ruleName.size(), 0xFFFF));
+
+    ipv4.clear();
+    ipv6.clear();
+    for (const auto& ip : store.Addresses(slot)) {
+        uint8_t bytes[16];
+        size_t size = 0;
+        if (!DnsMessage::ParseAddress(ip, bytes, size)) {
+            continue;
+        }
+        std::vector<uint8_t>& family = size == 4 ? ipv4 : ipv6;
+        if (family.size() / size < 255) {
+            family.insert(family.end(), bytes, bytes + size);
+        }
+        else {
+            complete = false;
+        }
+    }
+
+    Put<uint32_t>(out, ClampTime(store.BlockedAt(slot)));
+    Put<uint32_t>(out, ClampTime(store.ChangedAt(slot)));
+    Put<int32_t>(out, store.Interval(slot));
+    Put<uint16_t>(out, static_cast<uint16_t>(ruleName.size()));
+    Put<uint8_t>(out, static_cast<uint8_t>(fqdn.size()));
+    Put<uint8_t>(out, static_cast<uint8_t>(keywordId.size()));
+    Put<uint8_t>(out, static_cast<uint8_t>(ipv4.size() / 4));
+    Put<uint8_t>(out, static_cast<uint8_t>(ipv6.size() / 16));
+    out.insert(out.end(), fqdn.begin(), fqdn.end());
+    out.insert(out.end(), keywordId.begin(), keywordId.end());
+    out.insert(out.end(), ruleName.begin(), ruleName.end());
+    out.insert(out.end(), ipv4.begin(), ipv4.end());
+    out.insert(out.end(), ipv6.begin(), ipv6.end());
+    return complete;
+}
+
+/**
+ * @brief Find a displacement for every bucket so all keys get distinct positions
+ * @return false if some bucket could not be placed with this seed
+ */
+bool BuildPerfectHash(const std::vector<uint64_t>& hashes, uint32_t bucketCount,
+                      std::vector<uint32_t>& displacements, std::vector<uint32_t>& keyAtPosition) {
+    const uint32_t count = static_cast<uint32_t>(hashes.size());
+
+    // Group keys by bucket (counting sort), then place the largest buckets first
+    std::vector<uint32_t> bucketStart(bucketCount + 1, 0);
+    for (uint64_t hash : hashes) {
+        bucketStart[BucketOf(hash, bucketCount) + 1]++;
+    }
+    for (uint32_t b = 0; b < bucketCount; b++) {
+        bucketStart[b + 1] += bucketStart[b];
+    }
+    std::vector<uint32_t> keysByBucket(count);
+    std::vector<uint32_t> fill(bucketStart.begin(), bucketStart.end() - 1);
+    for (uint32_t key = 0; key < count; key++) {
+        keysByBucket[fill[BucketOf(hashes[key], bucketCount)]++] = key;
+    }
+
+    std::vector<uint32_t> order(bucketCount);
+    for (uint32_t b = 0; b < bucketCount; b++) {
+        order[b] = b;
+    }
+    std::stable_sort(order.begin(), order.end(), [&bucketStart](uint32_t a, uint32_t b) {
+        return bucketStart[a + 1] - bucketStart[a] > bucketStart[b + 1] - bucketStart[b];
+    });
+
+    displacements.assign(bucketCount, 0);
+    keyAtPosition.assign(count, 0xFFFFFFFFu);
+    const uint64_t maxTries = static_cast<uint64_t>(count) * 32 + 1024;
+    std::vector<uint32_t> positions;
+
+    for (uint32_t bucket : order) {
+        const uint32_t first = bucketStart[bucket];
+        const uint32_t size = bucketStart[bucket + 1] - first;
+        if (size == 0) {
+            break;
+        }
+
+        bool placed = false;
+        for (uint64_t d = 0; d < maxTries && !placed; d++) {
+            positions.clear();
+            placed = true;
+            for (uint32_t i = 0; i < size && placed; i++) {
+                uint32_t position = PositionOf(hashes[keysByBucket[first + i]], static_cast<uint32_t>(d), count);
+                placed = keyAtPosition[position] == 0xFFFFFFFFu &&
+                         std::find(positions.begin(), positions.end(), position) == positions.end();
+                positions.push_back(position);
+            }
+            if (placed) {
+                displacements[bucket] = static_cast<uint32_t>(d);
+                for (uint32_t i = 0; i < size; i++) {
+                    keyAtPosition[positions[i]] = keysByBucket[first + i];
+                }
+            }
+        }
+        if (!placed) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ReplaceFile(const std::string& tempPath, const std::string& path) {
+#ifdef _WIN32
+    return MoveFileExA(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return std::rename(tempPath.c_str(), path.c_str()) == 0;
+#endif
+}
+
+} // namespace
+
+std::vector<std::string> CompiledBlocklist::Entry::Addresses() const {
+    std::vector<std::string> ips;
+    ips.reserve(ipv4Count + ipv6Count);
+    for (size_t i = 0; i < ipv4Count; i++) {
+        ips.push_back(DnsMessage::AddressToString(addressBytes + i * 4, 4));
+    }
+    const uint8_t* ipv6 = addressBytes + ipv4Count * 4;
+    for (size_t i = 0; i < ipv6Count; i++) {
+        ips.push_back(DnsMessage::AddressToString(ipv6 + i * 16, 16));
+    }
+    return ips;
+}
+
+CompiledBlocklist::CompiledBlocklist()
+    : mapped(nullptr), mappedSize(0),
+#ifdef _WIN32
+      fileHandle(nullptr), mappingHandle(nullptr)
+#else
+      fileDescriptor(-1)
+#endif
+{}
+
+CompiledBlocklist::~CompiledBlocklist() {
+    Close();
+}
+
+bool CompiledBlocklist::Compile(const std::string& path, const RecordStore& store, size_t& compiled,
+                                size_t& truncated) {
+    compiled = 0;
+    truncated = 0;
+
+    // Distinct canonical FQDNs; the first record wins when two differ only in case
+    std::vector<std::string> keys;
+    std::vector<RecordStore::Slot> slots;
+    std::unordered_set<std::string> seen;
+    keys.reserve(store.Size());
+    slots.reserve(store.Size());
+    seen.reserve(store.Size());
+    char canonical[FqdnCanonicalizer::MaxLength];
+    for (RecordStore::Slot slot : store.LiveSlots()) {
+        size_t length = Canonicalize(store.Fqdn(slot), canonical);
+        if (length == 0 || !seen.emplace(canonical, length).second) {
+            continue;
+        }
+        keys.emplace_back(canonical, length);
+        slots.push_back(slot);
+    }
+    if (keys.size() > 0xFFFFFFFFull / 2) {
+        std::cerr << "Too many records to compile: " << keys.size() << std::endl;
+        return false;
+    }
+
+    const uint32_t count = static_cast<uint32_t>(keys.size());
+    const uint32_t bucketCount = static_cast<uint32_t>(std::max<size_t>(1, (keys.size() + kBucketSize - 1) / kBucketSize));
+    std::vector<uint64_t> hashes(count);
+    std::vector<uint32_t> displacements;
+    std::vector<uint32_t> keyAtPosition;
+
+    uint64_t seed = 0;
+    bool built = false;
+    for (int attempt = 0; attempt < kSeedAttempts && !built; attempt++) {
+        seed = Mix(0x46514442ULL + static_cast<uint64_t>(attempt));
+        for (uint32_t i = 0; i < count; i++) {
+            hashes[i] = HashName(keys[i].data(), keys[i].size(), seed);
+        }
+
+        // Two names with the same 64-bit hash can never be separated; try another seed
+        std::vector<uint64_t> sorted(hashes);
+        std::sort(sorted.begin(), sorted.end());
+        if (std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end()) {
+            continue;
+        }
+        built = BuildPerfectHash(hashes, bucketCount, displacements, keyAtPosition);
+    }
+    if (!built) {
+        std::cerr << "Failed to build the perfect hash for " << count << " FQDN(s)" << std::endl;
+        return false;
+    }
+
+    // Records in position order, so a scan of the file reads them sequentially
+    std::vector<uint8_t> records;
+    std::vector<uint32_t> recordAt(count);
+    std::vector<uint8_t> ipv4;
+    std::vector<uint8_t> ipv6;
+    records.reserve(static_cast<size_t>(count) * 96);
+    for (uint32_t position = 0; position < count; position++) {
+        if (records.size() > 0xFFFFFFFFull) {
+            std::cerr << "Compiled records exceed 4 GiB" << std::endl;
+            return false;
+        }
+        recordAt[position] = static_cast<uint32_t>(records.size());
+        uint32_t key = keyAtPosition[position];
+        if (!AppendRecord(records, keys[key], store, slots[key], ipv4, ipv6)) {
+            truncated++;
+        }
+    }
+
+    const uint32_t bloomBlocks = static_cast<uint32_t>(std::max<size_t>(1, (keys.size() * kBloomBitsPerKey + 511) / 512));
+    std::vector<uint8_t> bloom(static_cast<size_t>(bloomBlocks) * 64, 0);
+    for (uint64_t hash : hashes) {
+        BloomAdd(bloom.data(), bloomBlocks, hash);
+    }
+
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.formatVersion = kFormatVersion;
+    header.count = count;
+    header.seed = seed;
+    header.bucketCount = bucketCount;
+    header.bloomBlocks = bloomBlocks;
+    header.bloomOffset = AlignSection(sizeof(Header));
+    header.displacementOffset = AlignSection(header.bloomOffset + bloom.size());
+    header.positionOffset = AlignSection(header.displacementOffset + displacements.size() * sizeof(uint32_t));
+    header.recordOffset = AlignSection(header.positionOffset + recordAt.size() * sizeof(uint32_t));
+    header.recordSize = records.size();
+    header.fileSize = header.recordOffset + header.recordSize;
+    header.compiledAt = static_cast<int64_t>(std::time(nullptr));
+
+    const std::string tempPath = path + ".tmp";
+    FILE* file = std::fopen(tempPath.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Failed to open compiled blocklist for writing: " << tempPath << std::endl;
+        return false;
+    }
+
+    auto writeAt = [file](uint64_t offset, const void* data, size_t size) {
+        static const char padding[kSectionAlign] = {};
+        long position = std::ftell(file);
+        if (position < 0 || static_cast<uint64_t>(position) > offset ||
+            std::fwrite(padding, 1, static_cast<size_t>(offset - position), file) != offset - position) {
+            return false;
+        }
+        return size == 0 || std::fwrite(data, 1, size, file) == size;
+    };
+    bool written = writeAt(0, &header, sizeof(header)) &&
+                   writeAt(header.bloomOffset, bloom.data(), bloom.size()) &&
+                   writeAt(header.displacementOffset, displacements.data(), displacements.size() * sizeof(uint32_t)) &&
+                   writeAt(header.positionOffset, recordAt.data(), recordAt.size() * sizeof(uint32_t)) &&
+                   writeAt(header.recordOffset, records.data(), records.size());
+    written = std::fclose(file) == 0 && written;
+
+    if (!written || !ReplaceFile(tempPath, path)) {
+        std::cerr << "Failed to write compiled blocklist: " << path << std::endl;
+        std::remove(tempPath.c_str());
+        return false;
+    }
+
+    compiled = count;
+    return true;
+}
+
+bool CompiledBlocklist::Open(const std::string& path) {
+    Close();
+
+    size_t size = 0;
+    const void* view = nullptr;
+#ifdef _WIN32
+    fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                             OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE) {
+        fileHandle = nullptr;
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (GetFileSizeEx(fileHandle, &fileSize) && fileSize.QuadPart >= static_cast<LONGLONG>(sizeof(Header))) {
+        size = static_cast<size_t>(fileSize.QuadPart);
+        mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mappingHandle) {
+            view = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+        }
+    }
+#else
+    fileDescriptor = ::open(path.c_str(), O_RDONLY);
+    if (fileDescriptor < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fileDescriptor, &info) == 0 && info.st_size >= static_cast<off_t>(sizeof(Header))) {
+        size = static_cast<size_t>(info.st_size);
+        void* address = mmap(nullptr, size, PROT_READ, MAP_SHARED, fileDescriptor, 0);
+        if (address != MAP_FAILED) {
+            view = address;
+        }
+    }
+#endif
+    if (!view) {
+        Close();
+        return false;
+    }
+    mapped = static_cast<const uint8_t*>(view);
+    mappedSize = size;
+
+    // Reject anything that could send a lookup outside the mapping
+    const Header* header = GetHeader();
+    bool valid = std::memcmp(header->magic, kMagic, sizeof(kMagic)) == 0 &&
+                 header->formatVersion == kFormatVersion &&
+                 header->fileSize == size &&
+                 header->bucketCount > 0 && header->bloomBlocks > 0 &&
+                 header->bloomOffset + static_cast<uint64_t>(header->bloomBlocks) * 64 <= size &&
+                 header->displacementOffset + static_cast<uint64_t>(header->bucketCount) * 4 <= size &&
+                 header->positionOffset + static_cast<uint64_t>(header->count) * 4 <= size &&
+                 header->recordOffset + header->recordSize <= size;
+    if (!valid) {
+        std::cerr << "Not a valid compiled blocklist: " << path << std::endl;
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void CompiledBlocklist::Close() {
+#ifdef _WIN32
+    if (mapped) {
+        UnmapViewOfFile(mapped);
+    }
+    if (mappingHandle) {
+        CloseHandle(mappingHandle);
+    }
+    if (fileHandle) {
+        CloseHandle(fileHandle);
+    }
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+#else
+    if (mapped) {
+        munmap(const_cast<uint8_t*>(mapped), mappedSize);
+    }
+    if (fileDescriptor >= 0) {
+        ::close(fileDescriptor);
+    }
+    fileDescriptor = -1;
+#endif
+    mapped = nullptr;
+    mappedSize = 0;
+}
+
+size_t CompiledBlocklist::Size() const {
+    return mapped ? GetHeader()->count : 0;
+}
+
+std::time_t CompiledBlocklist::CompiledAt() const {
+    return mapped ? static_cast<std::time_t>(GetHeader()->compiledAt) : 0;
+}
+
+const uint8_t* CompiledBlocklist::Lookup(std::string_view fqdn) const {
+    if (!mapped || GetHeader()->count == 0) {
+        return nullptr;
+    }
+    const Header* header = GetHeader();
+
+    char canonical[FqdnCanonicalizer::MaxLength];
+    size_t length = Canonicalize(fqdn, canonical);
+    if (length == 0) {
+        return nullptr;
+    }
+
+    uint64_t hash = HashName(canonical, length, header->seed);
+    if (!BloomMayContain(mapped + header->bloomOffset, header->bloomBlocks, hash)) {
+        return nullptr;
+    }
+
+    uint32_t displacement = Get<uint32_t>(mapped + header->displacementOffset +
+                                          static_cast<size_t>(BucketOf(hash, header->bucketCount)) * 4);
+    uint32_t position = PositionOf(hash, displacement, header->count);
+    uint64_t offset = Get<uint32_t>(mapped + header->positionOffset + static_cast<size_t>(position) * 4);
+
+    // Any name maps to some position; the stored FQDN decides
+    if (offset + kRecordFixedSize > header->recordSize) {
+        return nullptr;
+    }
+    const uint8_t* record = mapped + header->recordOffset + offset;
+    size_t storedLength = record[14];
+    if (storedLength != length || offset + kRecordFixedSize + length > header->recordSize ||
+        std::memcmp(record + kRecordFixedSize, canonical, length) != 0) {
+        return nullptr;
+    }
+    return record;
+}
+
+bool CompiledBlocklist::Contains(std::string_view fqdn) const {
+    return Lookup(fqdn) != nullptr;
+}
+
+bool CompiledBlocklist::Find(std::string_view fqdn, Entry& entry) const {
+    const uint8_t* record = Lookup(fqdn);
+    if (!record) {
+        return false;
+    }
+
+    const Header* header = GetHeader();
+    size_t ruleLength = Get<uint16_t>(record + 12);
+    size_t fqdnLength = record[14];
+    size_t keywordLength = record[15];
+    size_t ipv4Count = record[16];
+    size_t ipv6Count = record[17];
+    size_t total = kRecordFixedSize + fqdnLength + keywordLength + ruleLength + ipv4Count * 4 + ipv6Count * 16;
+    if (static_cast<uint64_t>(record - (mapped + header->recordOffset)) + total > header->recordSize) {
+        return false;
+    }
+
+    const char* text = reinterpret_cast<const char*>(record + kRecordFixedSize);
+    entry.blockedAt = static_cast<std::time_t>(Get<uint32_t>(record));
+    entry.changedAt = static_cast<std::time_t>(Get<uint32_t>(record + 4));
+    entry.interval = Get<int32_t>(record + 8);
+    entry.fqdn = std::string_view(text, fqdnLength);
+    entry.keywordId = std::string_view(text + fqdnLength, keywordLength);
+    entry.ruleName = std::string_view(text + fqdnLength + keywordLength, ruleLength);
+    entry.addressBytes = record + kRecordFixedSize + fqdnLength + keywordLength + ruleLength;
+    entry.ipv4Count = ipv4Count;
+    entry.ipv6Count = ipv6Count;
+    return true;
+}
@@ -0,0 +1,137 @@
+#ifndef COMPILEDBLOCKLIST_H
+#define COMPILEDBLOCKLIST_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <ctime>
+#include <cstdint>
+#include <cstddef>
+
+#include "RecordStore.h"
+
+/**
+ * @brief Immutable, memory-mapped blocklist for membership checks
+ *
+ * Compile() turns the records of an audit store into a file that is mapped
+ * read-only and queried in place, so opening it costs no parsing and no
+ * allocation regardless of its size. The file holds, each section aligned
+ * to a cache line:
+ *
+ * - A header with the section offsets, record count and hash seed.
+ * - A blocked Bloom filter: every FQDN sets its bits inside one 64-byte
+ *   block, so most absent names are rejected after touching one line.
+ * - A minimal perfect hash (hash and displace): FQDNs hash into buckets,
+ *   and each bucket stores the displacement that sends its FQDNs to free
+ *   positions, giving every FQDN its own position in 0..count-1.
+ * - The offset of each position's record.
+ * - The packed records: times, interval, FQDN, keyword, rule name and
+ *   binary addresses.
+ *
+ * A lookup canonicalizes the FQDN (FqdnCanonicalizer), tests the
+ * Bloom filter, then reads one displacement, one offset and the record,
+ * whose FQDN confirms the match. The file uses the byte order of the host
+ * that compiled it.
+ */
+class CompiledBlocklist {
+public:
+    /**
+     * @brief One record, pointing into the mapped file
+     */
+    struct Entry {
+        std::string_view fqdn;
+        std::string_view keywordId;
+        std::string_view ruleName;
+        std::time_t blockedAt;
+        std::time_t changedAt;
+        int interval;
+        const uint8_t* addressBytes;   // IPv4 addresses (4 bytes each), then IPv6 (16 bytes each)
+        size_t ipv4Count;
+        size_t ipv6Count;
+
+        /**
+         * @brief Addresses in text form, IPv4 first
+         */
+        std::vector<std::string> Addresses() const;
+    };
+
+    CompiledBlocklist();
+    ~CompiledBlocklist();
+
+    CompiledBlocklist(const CompiledBlocklist&) = delete;
+    CompiledBlocklist& operator=(const CompiledBlocklist&) = delete;
+
+    /**
+     * @brief Write the records of a store as a compiled blocklist
+     *
+     * The file is written next to the target and renamed over it, so a
+     * reader that already has the previous version mapped keeps it intact.
+     * @param path File to write
+     * @param store Records to compile
+     * @param compiled Number of distinct canonical FQDNs written
+     * @param truncated Number of those records written without some of
+     *        their data: addresses past 255 per family, a keyword longer
+     *        than 255 bytes or a rule name longer than 65535 bytes
+     * @return true if the file was written
+     */
+    static bool Compile(const std::string& path, const RecordStore& store, size_t& compiled, size_t& truncated);
+
+    /**
+     * @brief Map a compiled blocklist and check its header
+     * @param path File to open
+     * @return true if the file is a valid compiled blocklist
+     */
+    bool Open(const std::string& path);
+
+    /**
+     * @brief Unmap the file; entries returned earlier become invalid
+     */
+    void Close();
+
+    /**
+     * @brief Check whether an FQDN is in the blocklist
+     * @param fqdn Name in any case, with or without a trailing dot
+     * @return true if present
+     */
+    bool Contains(std::string_view fqdn) const;
+
+    /**
+     * @brief Look an FQDN up
+     * @param fqdn Name in any case, with or without a trailing dot
+     * @param entry Record of the FQDN, valid while the file stays open
+     * @return true if present
+     */
+    bool Find(std::string_view fqdn, Entry& entry) const;
+
+    /**
+     * @brief Number of FQDNs in the open file
+     */
+    size_t Size() const;
+
+    /**
+     * @brief Size of the open file in bytes
+     */
+    size_t FileSize() const { return mappedSize; }
+
+    /**
+     * @brief Time the open file was compiled
+     */
+    std::time_t CompiledAt() const;
+
+private:
+    struct Header;
+
+    const uint8_t* Lookup(std::string_view fqdn) const;
+    const Header* GetHeader() const { return reinterpret_cast<const Header*>(mapped); }
+
+    const uint8_t* mapped;
+    size_t mappedSize;
+#ifdef _WIN32
+    void* fileHandle;
+    void* mappingHandle;
+#else
+    int fileDescriptor;
+#endif
+};
+
+#endif // COMPILEDBLOCKLIST_H
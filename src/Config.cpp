@@ -3,15 +3,189 @@
 #include <iostream>
 
 // NOTE: You need to download json.hpp from https://github.com/nlohmann/json/releases/latest/download/json.hpp
-// and place it in the lib/ directory
-#include "../lib/json.hpp"
+// and place it in the lib/ directory (or install nlohmann_json system-wide)
+#include "json.hpp"
 
 using json = nlohmann::json;
 
 // Initialize static members with default values
+std::mutex Config::mutex;
 int Config::defaultInterval = 60;  // 60 minutes default
 std::string Config::logFilePath = "logs/fqdn_blocker.log";
 std::string Config::auditStorePath = "data/audit_store.json";
+int Config::pipelineResolveWorkers = 8;
+int Config::pipelineApplyWorkers = 1;
+int Config::pipelineQueueCapacity = 256;
+std::string Config::metricsFilePath;
+int Config::metricsIntervalSeconds = 15;
+std::string Config::traceFilePath;
+std::string Config::dnsUpstream;
+int Config::dnsTimeoutMs = 2000;
+std::vector<std::string> Config::dnsUpstreams;
+std::string Config::dnsUpstreamPolicy = "fanout";
+int Config::shutdownTimeoutMs = 5000;
+std::string Config::replicationListen;
+std::string Config::replicationLeader;
+std::string Config::replicationSecret;
+std::string Config::replicationStatePath = "data/replication.state";
+int Config::refreshFreshnessSeconds = 30;
+int Config::addressGraceMinutes = 60;
+int Config::addressGraceTtlMultiple = 0;
+int Config::firewallMaxOpsPerSecond = 200;
+int Config::firewallBurst = 400;
+std::string Config::compiledBlocklistPath = "data/blocklist.bin";
+int Config::minRefreshIntervalMinutes = 0;
+#ifdef _WIN32
+std::string Config::controlChannelPath = "\\\\.\\pipe\\FqdnBlockerCli";
+#else
+std::string Config::controlChannelPath = "data/fqdn_blocker.sock";
+#endif
+
+namespace {
+
+// Settings before the configuration file was first loaded
+json defaults;
+
+} // namespace
+
+template <typename Json>
+void Config::ToJson(Json& configJson) {
+    configJson["defaultInterval"] = defaultInterval;
+    configJson["logFilePath"] = logFilePath;
+    configJson["auditStorePath"] = auditStorePath;
+    configJson["controlChannelPath"] = controlChannelPath;
+    configJson["pipelineResolveWorkers"] = pipelineResolveWorkers;
+    configJson["pipelineApplyWorkers"] = pipelineApplyWorkers;
+    configJson["pipelineQueueCapacity"] = pipelineQueueCapacity;
+    configJson["metricsFilePath"] = metricsFilePath;
+    configJson["metricsIntervalSeconds"] = metricsIntervalSeconds;
+    configJson["traceFilePath"] = traceFilePath;
+    configJson["dnsUpstream"] = dnsUpstream;
+    configJson["dnsTimeoutMs"] = dnsTimeoutMs;
+    configJson["dnsUpstreams"] = dnsUpstreams;
+    configJson["dnsUpstreamPolicy"] = dnsUpstreamPolicy;
+    configJson["shutdownTimeoutMs"] = shutdownTimeoutMs;
+    configJson["replicationListen"] = replicationListen;
+    configJson["replicationLeader"] = replicationLeader;
+    configJson["replicationSecret"] = replicationSecret;
+    configJson["replicationStatePath"] = replicationStatePath;
+    configJson["refreshFreshnessSeconds"] = refreshFreshnessSeconds;
+    configJson["addressGraceMinutes"] = addressGraceMinutes;
+    configJson["addressGraceTtlMultiple"] = addressGraceTtlMultiple;
+    configJson["firewallMaxOpsPerSecond"] = firewallMaxOpsPerSecond;
+    configJson["firewallBurst"] = firewallBurst;
+    configJson["compiledBlocklistPath"] = compiledBlocklistPath;
+    configJson["minRefreshIntervalMinutes"] = minRefreshIntervalMinutes;
+}
+
+template <typename Json>
+void Config::FromJson(const Json& configJson) {
+    if (configJson.contains("defaultInterval")) {
+        defaultInterval = configJson["defaultInterval"];
+    }
+    if (configJson.contains("logFilePath")) {
+        logFilePath = configJson["logFilePath"];
+    }
+    if (configJson.contains("auditStorePath")) {
+        auditStorePath = configJson["auditStorePath"];
+    }
+    if (configJson.contains("controlChannelPath")) {
+        controlChannelPath = configJson["controlChannelPath"];
+    }
+    if (configJson.contains("pipelineResolveWorkers")) {
+        pipelineResolveWorkers = configJson["pipelineResolveWorkers"];
+    }
+    if (configJson.contains("pipelineApplyWorkers")) {
+        pipelineApplyWorkers = configJson["pipelineApplyWorkers"];
+    }
+    if (configJson.contains("pipelineQueueCapacity")) {
+        pipelineQueueCapacity = configJson["pipelineQueueCapacity"];
+    }
+    if (configJson.contains("metricsFilePath")) {
+        metricsFilePath = configJson["metricsFilePath"];
+    }
+    if (configJson.contains("metricsIntervalSeconds")) {
+        metricsIntervalSeconds = configJson["metricsIntervalSeconds"];
+    }
+    if (configJson.contains("traceFilePath")) {
+        traceFilePath = configJson["traceFilePath"];
+    }
+    if (configJson.contains("dnsUpstream")) {
+        dnsUpstream = configJson["dnsUpstream"];
+    }
+    if (configJson.contains("dnsTimeoutMs")) {
+        dnsTimeoutMs = configJson["dnsTimeoutMs"];
+    }
+    if (configJson.contains("dnsUpstreams")) {
+        dnsUpstreams = configJson["dnsUpstreams"].template get<std::vector<std::string>>();
+    }
+    if (configJson.contains("dnsUpstreamPolicy")) {
+        dnsUpstreamPolicy = configJson["dnsUpstreamPolicy"];
+    }
+    if (configJson.contains("shutdownTimeoutMs")) {
+        shutdownTimeoutMs = configJson["shutdownTimeoutMs"];
+    }
+    if (configJson.contains("replicationListen")) {
+        replicationListen = configJson["replicationListen"];
+    }
+    if (configJson.contains("replicationLeader")) {
+        replicationLeader = configJson["replicationLeader"];
+    }
+    if (configJson.contains("replicationSecret")) {
+        replicationSecret = configJson["replicationSecret"];
+    }
+    if (configJson.contains("replicationStatePath")) {
+        replicationStatePath = configJson["replicationStatePath"];
+    }
+    if (configJson.contains("refreshFreshnessSeconds")) {
+        refreshFreshnessSeconds = configJson["refreshFreshnessSeconds"];
+    }
+    if (configJson.contains("addressGraceMinutes")) {
+        addressGraceMinutes = configJson["addressGraceMinutes"];
+    }
+    if (configJson.contains("addressGraceTtlMultiple")) {
+        addressGraceTtlMultiple = configJson["addressGraceTtlMultiple"];
+    }
+    if (configJson.contains("firewallMaxOpsPerSecond")) {
+        firewallMaxOpsPerSecond = configJson["firewallMaxOpsPerSecond"];
+    }
+    if (configJson.contains("firewallBurst")) {
+        firewallBurst = configJson["firewallBurst"];
+    }
+    if (configJson.contains("compiledBlocklistPath")) {
+        compiledBlocklistPath = configJson["compiledBlocklistPath"];
+    }
+    if (configJson.contains("minRefreshIntervalMinutes")) {
+        minRefreshIntervalMinutes = configJson["minRefreshIntervalMinutes"];
+    }
+}
+
+bool Config::Validate(std::string& error) {
+    if (defaultInterval <= 0) {
+        error = "defaultInterval must be a positive number of minutes";
+    }
+    else if (pipelineResolveWorkers <= 0 || pipelineApplyWorkers <= 0 || pipelineQueueCapacity <= 0) {
+        error = "pipelineResolveWorkers, pipelineApplyWorkers and pipelineQueueCapacity must be positive";
+    }
+    else if (metricsIntervalSeconds <= 0) {
+        error = "metricsIntervalSeconds must be positive";
+    }
+    else if (dnsTimeoutMs <= 0) {
+        error = "dnsTimeoutMs must be positive";
+    }
+    else if (dnsUpstreamPolicy != "fanout" && dnsUpstreamPolicy != "fastest") {
+        error = "dnsUpstreamPolicy must be \"fanout\" or \"fastest\"";
+    }
+    else if (shutdownTimeoutMs < 0 || refreshFreshnessSeconds < 0 || addressGraceMinutes < 0 ||
+             addressGraceTtlMultiple < 0 || firewallMaxOpsPerSecond < 0 || firewallBurst < 0 ||
+             minRefreshIntervalMinutes < 0) {
+        error = "timeouts, grace periods, firewall limits and minRefreshIntervalMinutes cannot be negative";
+    }
+    else {
+        return true;
+    }
+    return false;
+}
 
 bool Config::Load(const std::string& configPath) {
     try {
@@ -25,17 +199,14 @@ bool Config::Load(const std::string& configPath) {
         configFile >> configJson;
         configFile.close();
 
-        // Load configuration values
-        if (configJson.contains("defaultInterval")) {
-            defaultInterval = configJson["defaultInterval"];
-        }
-        if (configJson.contains("logFilePath")) {
-            logFilePath = configJson["logFilePath"];
-        }
-        if (configJson.contains("auditStorePath")) {
-            auditStorePath = configJson["auditStorePath"];
+        std::lock_guard<std::mutex> lock(mutex);
+        if (defaults.is_null()) {
+            ToJson(defaults);
         }
 
+        // Load configuration values
+        FromJson(configJson);
+
         std::cout << "Configuration loaded successfully from: " << configPath << std::endl;
         return true;
     }
@@ -45,12 +216,64 @@ bool Config::Load(const std::string& configPath) {
     }
 }
 
+bool Config::Reload(const std::string& configPath, std::vector<std::string>& changedKeys, std::string& error) {
+    changedKeys.clear();
+    error.clear();
+
+    json configJson;
+    try {
+        std::ifstream configFile(configPath);
+        if (!configFile.is_open()) {
+            error = "cannot open " + configPath;
+            return false;
+        }
+        configFile >> configJson;
+        if (!configJson.is_object()) {
+            error = "the configuration must be a JSON object";
+            return false;
+        }
+    }
+    catch (const std::exception& e) {
+        error = e.what();
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    json previous;
+    ToJson(previous);
+    if (defaults.is_null()) {
+        defaults = previous;
+    }
+
+    try {
+        FromJson(defaults);
+        FromJson(configJson);
+    }
+    catch (const std::exception& e) {
+        error = e.what();
+    }
+    if (!error.empty() || !Validate(error)) {
+        FromJson(previous);
+        return false;
+    }
+
+    json current;
+    ToJson(current);
+    for (auto it = current.begin(); it != current.end(); ++it) {
+        if (previous[it.key()] != it.value()) {
+            changedKeys.push_back(it.key());
+        }
+    }
+    return true;
+}
+
 bool Config::Save(const std::string& configPath) {
     try {
         json configJson;
-        configJson["defaultInterval"] = defaultInterval;
-        configJson["logFilePath"] = logFilePath;
-        configJson["auditStorePath"] = auditStorePath;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ToJson(configJson);
+        }
 
         std::ofstream configFile(configPath);
         if (!configFile.is_open()) {
@@ -71,25 +294,154 @@ bool Config::Save(const std::string& configPath) {
 }
 
 int Config::GetDefaultInterval() {
+    std::lock_guard<std::mutex> lock(mutex);
     return defaultInterval;
 }
 
 void Config::SetDefaultInterval(int intervalMinutes) {
+    std::lock_guard<std::mutex> lock(mutex);
     defaultInterval = intervalMinutes;
 }
 
 std::string Config::GetLogFilePath() {
+    std::lock_guard<std::mutex> lock(mutex);
     return logFilePath;
 }
 
 void Config::SetLogFilePath(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex);
     logFilePath = path;
 }
 
 std::string Config::GetAuditStorePath() {
+    std::lock_guard<std::mutex> lock(mutex);
     return auditStorePath;
 }
 
 void Config::SetAuditStorePath(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex);
     auditStorePath = path;
 }
+
+std::string Config::GetControlChannelPath() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return controlChannelPath;
+}
+
+void Config::SetControlChannelPath(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    controlChannelPath = path;
+}
+
+int Config::GetPipelineResolveWorkers() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return pipelineResolveWorkers;
+}
+
+int Config::GetPipelineApplyWorkers() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return pipelineApplyWorkers;
+}
+
+int Config::GetPipelineQueueCapacity() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return pipelineQueueCapacity;
+}
+
+std::string Config::GetMetricsFilePath() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return metricsFilePath;
+}
+
+int Config::GetMetricsIntervalSeconds() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return metricsIntervalSeconds;
+}
+
+std::string Config::GetTraceFilePath() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return traceFilePath;
+}
+
+std::string Config::GetDnsUpstream() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return dnsUpstream;
+}
+
+int Config::GetDnsTimeoutMs() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return dnsTimeoutMs;
+}
+
+std::string Config::GetDnsUpstreamPolicy() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return dnsUpstreamPolicy;
+}
+
+int Config::GetShutdownTimeoutMs() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return shutdownTimeoutMs;
+}
+
+std::string Config::GetReplicationListen() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return replicationListen;
+}
+
+std::string Config::GetReplicationLeader() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return replicationLeader;
+}
+
+std::string Config::GetReplicationSecret() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return replicationSecret;
+}
+
+std::string Config::GetReplicationStatePath() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return replicationStatePath;
+}
+
+std::vector<std::string> Config::GetDnsUpstreams() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (dnsUpstreams.empty() && !dnsUpstream.empty()) {
+        return { dnsUpstream };
+    }
+    return dnsUpstreams;
+}
+
+int Config::GetRefreshFreshnessSeconds() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return refreshFreshnessSeconds;
+}
+
+int Config::GetAddressGraceMinutes() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return addressGraceMinutes;
+}
+
+int Config::GetAddressGraceTtlMultiple() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return addressGraceTtlMultiple;
+}
+
+int Config::GetFirewallMaxOpsPerSecond() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return firewallMaxOpsPerSecond;
+}
+
+int Config::GetFirewallBurst() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return firewallBurst;
+}
+
+std::string Config::GetCompiledBlocklistPath() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return compiledBlocklistPath;
+}
+
+int Config::GetMinRefreshIntervalMinutes() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return minRefreshIntervalMinutes;
+}
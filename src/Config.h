@@ -2,6 +2,8 @@
 #define CONFIG_H
 
 #include <string>
+#include <vector>
+#include <mutex>
 
 /**
  * @brief Configuration management for FQDN Blocker CLI
@@ -10,6 +12,15 @@
  * - Default refresh interval for DNS resolution
  * - Log file path
  * - Audit store path
+ * - Control channel endpoint used by the service mode
+ * - Refresh pipeline concurrency and queue sizes
+ * - Metrics export file and interval
+ * - Trace output file
+ * - Upstream DNS server for the built-in resolver
+ * - Compiled blocklist path
+ *
+ * A running service can reload the file (Reload); values are guarded by a
+ * mutex so other threads always read either the old or the new settings.
  */
 class Config {
 public:
@@ -27,6 +38,18 @@ public:
      */
     static bool Save(const std::string& configPath);
 
+    /**
+     * @brief Reload the configuration file, keeping the current settings if it is invalid
+     *
+     * Keys missing from the file go back to their defaults, as if the
+     * process had just started.
+     * @param configPath Path to the configuration file (JSON)
+     * @param changedKeys Receives the keys whose value changed
+     * @param error Receives why the file was rejected
+     * @return false if the file cannot be read, parsed or validated; nothing changes then
+     */
+    static bool Reload(const std::string& configPath, std::vector<std::string>& changedKeys, std::string& error);
+
     /**
      * @brief Get the default refresh interval in minutes
      * @return Default interval in minutes
@@ -63,10 +86,197 @@ public:
      */
     static void SetAuditStorePath(const std::string& path);
 
+    /**
+     * @brief Get the control channel endpoint of the service
+     * @return Named pipe name on Windows, Unix socket path elsewhere
+     */
+    static std::string GetControlChannelPath();
+
+    /**
+     * @brief Set the control channel endpoint of the service
+     * @param path Named pipe name or Unix socket path
+     */
+    static void SetControlChannelPath(const std::string& path);
+
+    /**
+     * @brief Get the number of concurrent DNS resolutions in the refresh pipeline
+     * @return Resolver worker count
+     */
+    static int GetPipelineResolveWorkers();
+
+    /**
+     * @brief Get the number of concurrent firewall writers in the refresh pipeline
+     * @return Firewall apply worker count
+     */
+    static int GetPipelineApplyWorkers();
+
+    /**
+     * @brief Get the capacity of each queue between refresh pipeline stages
+     * @return Queue capacity in items
+     */
+    static int GetPipelineQueueCapacity();
+
+    /**
+     * @brief Get the file that metrics are periodically written to
+     * @return Metrics file path, empty if periodic export is disabled
+     */
+    static std::string GetMetricsFilePath();
+
+    /**
+     * @brief Get the interval between metrics file writes
+     * @return Interval in seconds
+     */
+    static int GetMetricsIntervalSeconds();
+
+    /**
+     * @brief Get the file that span traces are written to
+     * @return Trace file path, empty if tracing is disabled
+     */
+    static std::string GetTraceFilePath();
+
+    /**
+     * @brief Get the DNS server queried instead of the system resolver
+     * @return Server address ("host[:port]"), empty to use the system resolver
+     */
+    static std::string GetDnsUpstream();
+
+    /**
+     * @brief Get the time allowed for the DNS server to answer
+     * @return Timeout in milliseconds
+     */
+    static int GetDnsTimeoutMs();
+
+    /**
+     * @brief Get the DNS servers each FQDN is sent to at once
+     * @return dnsUpstreams, or dnsUpstream alone when only that is set; empty to use the system resolver
+     */
+    static std::vector<std::string> GetDnsUpstreams();
+
+    /**
+     * @brief Get how several DNS servers share the queries
+     * @return "fanout" (all at once, answers merged) or "fastest" (lowest latency, hedged)
+     */
+    static std::string GetDnsUpstreamPolicy();
+
+    /**
+     * @brief Get how long shutdown waits for a scheduled refresh to wind down
+     * @return Timeout in milliseconds
+     */
+    static int GetShutdownTimeoutMs();
+
+    /**
+     * @brief Get the address the service accepts standby followers on
+     * @return "host:port", empty if replication to followers is off
+     */
+    static std::string GetReplicationListen();
+
+    /**
+     * @brief Get the leader this service follows as a warm standby
+     * @return "host:port", empty if this service is not a standby
+     */
+    static std::string GetReplicationLeader();
+
+    /**
+     * @brief Get the shared secret followers present to the leader
+     * @return Secret, empty if none is required
+     */
+    static std::string GetReplicationSecret();
+
+    /**
+     * @brief Get the file a follower keeps its leader position in
+     * @return Path, empty to take a full snapshot on every start
+     */
+    static std::string GetReplicationStatePath();
+
+    /**
+     * @brief Get the window in which a refreshed FQDN is not refreshed again
+     * @return Window in seconds, 0 to refresh on every request
+     */
+    static int GetRefreshFreshnessSeconds();
+
+    /**
+     * @brief Get how long an address DNS stopped returning stays blocked
+     * @return Grace period in minutes, 0 to drop addresses at once
+     */
+    static int GetAddressGraceMinutes();
+
+    /**
+     * @brief Get the grace period as a multiple of the answer TTL
+     * @return Multiple of the TTL; the longer of this and the grace period applies
+     */
+    static int GetAddressGraceTtlMultiple();
+
+    /**
+     * @brief Get the sustained rate of firewall writes
+     * @return Operations per second, 0 for no limit
+     */
+    static int GetFirewallMaxOpsPerSecond();
+
+    /**
+     * @brief Get the number of firewall writes allowed at once after an idle period
+     * @return Burst allowance in operations
+     */
+    static int GetFirewallBurst();
+
+    /**
+     * @brief Get the path of the compiled blocklist used by compile and check
+     * @return Path to the compiled blocklist file
+     */
+    static std::string GetCompiledBlocklistPath();
+
+    /**
+     * @brief Get the shortest refresh interval of any scheduled task
+     * @return Interval in minutes; longer record intervals apply as they are, 0 for no floor
+     */
+    static int GetMinRefreshIntervalMinutes();
+
 private:
+    /**
+     * @brief Write every setting to a JSON object
+     */
+    template <typename Json>
+    static void ToJson(Json& configJson);
+
+    /**
+     * @brief Read the settings present in a JSON object
+     * @throws if a value has the wrong type
+     */
+    template <typename Json>
+    static void FromJson(const Json& configJson);
+
+    /**
+     * @brief Check that the current settings are usable
+     * @param error Receives the first problem found
+     */
+    static bool Validate(std::string& error);
+
+    static std::mutex mutex;              // Guards every setting below
     static int defaultInterval;           // in minutes
     static std::string logFilePath;
     static std::string auditStorePath;
+    static std::string controlChannelPath;
+    static int pipelineResolveWorkers;
+    static int pipelineApplyWorkers;
+    static int pipelineQueueCapacity;
+    static std::string metricsFilePath;
+    static int metricsIntervalSeconds;
+    static std::string traceFilePath;
+    static std::string dnsUpstream;
+    static int dnsTimeoutMs;
+    static std::vector<std::string> dnsUpstreams;
+    static std::string dnsUpstreamPolicy;
+    static int shutdownTimeoutMs;
+    static std::string replicationListen;
+    static std::string replicationLeader;
+    static std::string replicationSecret;
+    static std::string replicationStatePath;
+    static int refreshFreshnessSeconds;
+    static int addressGraceMinutes;
+    static int addressGraceTtlMultiple;
+    static int firewallMaxOpsPerSecond;
+    static int firewallBurst;
+    static std::string compiledBlocklistPath;
+    static int minRefreshIntervalMinutes;
 };
 
 #endif // CONFIG_H
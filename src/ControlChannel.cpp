@@ -0,0 +1,538 @@
+#include "ControlChannel.h"
+#include <algorithm>
+#include <iostream>
+#include <cstring>
+#include <chrono>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <sddl.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+// Initialize static members
+std::string ControlChannel::serverEndpoint;
+ControlChannel::RequestHandler ControlChannel::requestHandler;
+std::thread ControlChannel::serverThread;
+std::atomic<bool> ControlChannel::running(false);
+intptr_t ControlChannel::listenHandle = -1;
+std::mutex ControlChannel::clientMutex;
+std::vector<ControlChannel::Client> ControlChannel::clients;
+
+namespace {
+
+// Upper bounds on a single request so a bad client cannot exhaust memory
+const uint32_t kMaxArgs = 1u << 20;
+const uint32_t kMaxArgLength = 64 * 1024;
+
+// A client that makes no progress sending its request or reading the
+// response for this long is dropped
+const int kClientStallMs = 10000;
+
+// Connections served at once; further clients wait in the backlog
+const size_t kMaxClients = 16;
+
+// How often blocked waits check whether the server is stopping
+const int kPollSliceMs = 250;
+
+#ifdef _WIN32
+using ChannelHandle = HANDLE;
+
+// Full access for SYSTEM, Administrators and the owner (the service account)
+const char kPipeSecurity[] = "D:P(A;;GA;;;SY)(A;;GA;;;BA)(A;;GA;;;OW)";
+
+/**
+ * @brief Wait for an overlapped read or write to finish
+ * @param stallMs Give up after this long, or -1 to wait indefinitely
+ * @param running Give up once this turns false, or nullptr
+ */
+bool FinishIo(HANDLE h, OVERLAPPED& ov, BOOL started, DWORD& transferred, int stallMs,
+              const std::atomic<bool>* running) {
+    if (!started && GetLastError() != ERROR_IO_PENDING) {
+        return false;
+    }
+
+    int waited = 0;
+    while (WaitForSingleObject(ov.hEvent, kPollSliceMs) == WAIT_TIMEOUT) {
+        waited += kPollSliceMs;
+        if ((stallMs >= 0 && waited >= stallMs) || (running && !*running)) {
+            CancelIo(h);
+            GetOverlappedResult(h, &ov, &transferred, TRUE);
+            return false;
+        }
+    }
+    return GetOverlappedResult(h, &ov, &transferred, FALSE) && transferred > 0;
+}
+
+bool TransferAll(ChannelHandle h, char* ptr, size_t length, bool write, int stallMs,
+                 const std::atomic<bool>* running) {
+    OVERLAPPED ov = {};
+    ov.hEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+    if (!ov.hEvent) {
+        return false;
+    }
+
+    bool ok = true;
+    while (ok && length > 0) {
+        DWORD chunk = static_cast<DWORD>(std::min<size_t>(length, 64 * 1024));
+        DWORD transferred = 0;
+        ResetEvent(ov.hEvent);
+        BOOL started = write ? WriteFile(h, ptr, chunk, nullptr, &ov) : ReadFile(h, ptr, chunk, nullptr, &ov);
+        ok = FinishIo(h, ov, started, transferred, stallMs, running);
+        ptr += transferred;
+        length -= transferred;
+    }
+
+    CloseHandle(ov.hEvent);
+    return ok;
+}
+
+bool WriteAll(ChannelHandle h, const void* data, size_t length, int stallMs = -1,
+              const std::atomic<bool>* running = nullptr) {
+    return TransferAll(h, const_cast<char*>(static_cast<const char*>(data)), length, true, stallMs, running);
+}
+
+bool ReadAll(ChannelHandle h, void* data, size_t length, int stallMs = -1,
+             const std::atomic<bool>* running = nullptr) {
+    return TransferAll(h, static_cast<char*>(data), length, false, stallMs, running);
+}
+
+void CloseChannel(ChannelHandle h) {
+    FlushFileBuffers(h);
+    DisconnectNamedPipe(h);
+    CloseHandle(h);
+}
+
+HANDLE CreatePipeInstance(const std::string& endpoint, PSECURITY_DESCRIPTOR security, bool first) {
+    SECURITY_ATTRIBUTES attributes = {};
+    attributes.nLength = sizeof(attributes);
+    attributes.lpSecurityDescriptor = security;
+    attributes.bInheritHandle = FALSE;
+
+    // The first instance fails if another process already owns the name
+    return CreateNamedPipeA(endpoint.c_str(),
+                            PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | (first ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0),
+                            PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+                            PIPE_UNLIMITED_INSTANCES,
+                            64 * 1024, 64 * 1024, 0, &attributes);
+}
+
+PSECURITY_DESCRIPTOR pipeSecurity = nullptr;
+#else
+using ChannelHandle = int;
+
+/**
+ * @brief Wait until a socket is ready for one more send or recv
+ * @param stallMs Give up after this long, or -1 to wait indefinitely
+ * @param running Give up once this turns false, or nullptr
+ */
+bool WaitReady(ChannelHandle fd, short events, int stallMs, const std::atomic<bool>* running) {
+    pollfd pfd = {};
+    pfd.fd = fd;
+    pfd.events = events;
+
+    int waited = 0;
+    for (;;) {
+        int ready = poll(&pfd, 1, kPollSliceMs);
+        if (ready > 0) {
+            return true;
+        }
+        if (ready < 0 && errno != EINTR) {
+            return false;
+        }
+        waited += kPollSliceMs;
+        if ((stallMs >= 0 && waited >= stallMs) || (running && !*running)) {
+            return false;
+        }
+    }
+}
+
+bool WriteAll(ChannelHandle fd, const void* data, size_t length, int stallMs = -1,
+              const std::atomic<bool>* running = nullptr) {
+    const char* ptr = static_cast<const char*>(data);
+    while (length > 0) {
+        if (!WaitReady(fd, POLLOUT, stallMs, running)) {
+            return false;
+        }
+        ssize_t written = send(fd, ptr, length, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        ptr += written;
+        length -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+bool ReadAll(ChannelHandle fd, void* data, size_t length, int stallMs = -1,
+             const std::atomic<bool>* running = nullptr) {
+    char* ptr = static_cast<char*>(data);
+    while (length > 0) {
+        if (!WaitReady(fd, POLLIN, stallMs, running)) {
+            return false;
+        }
+        ssize_t read = recv(fd, ptr, length, MSG_DONTWAIT);
+        if (read < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            continue;
+        }
+        if (read <= 0) {
+            return false;
+        }
+        ptr += read;
+        length -= static_cast<size_t>(read);
+    }
+    return true;
+}
+
+void CloseChannel(ChannelHandle fd) {
+    close(fd);
+}
+
+bool MakeSocketAddress(const std::string& path, sockaddr_un& addr) {
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Control channel path too long: " << path << std::endl;
+        return false;
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+/**
+ * @brief Check whether a server accepts connections on a socket path
+ */
+bool SocketInUse(const sockaddr_un& addr) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return false;
+    }
+    bool inUse = connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == 0;
+    close(fd);
+    return inUse;
+}
+#endif
+
+bool WriteString(ChannelHandle h, const std::string& value, int stallMs = -1,
+                 const std::atomic<bool>* running = nullptr) {
+    uint32_t length = static_cast<uint32_t>(value.size());
+    return WriteAll(h, &length, sizeof(length), stallMs, running) &&
+           WriteAll(h, value.data(), value.size(), stallMs, running);
+}
+
+bool ReadString(ChannelHandle h, std::string& value, uint32_t maxLength, int stallMs = -1,
+                const std::atomic<bool>* running = nullptr) {
+    uint32_t length = 0;
+    if (!ReadAll(h, &length, sizeof(length), stallMs, running) || length > maxLength) {
+        return false;
+    }
+    value.resize(length);
+    return length == 0 || ReadAll(h, &value[0], length, stallMs, running);
+}
+
+/**
+ * Request:  uint32 argc, then argc x (uint32 length, bytes)
+ * Response: int32 exit code, uint32 length, bytes
+ */
+void ServeRequest(ChannelHandle h, const ControlChannel::RequestHandler& handler,
+                  const std::atomic<bool>& running) {
+    uint32_t argCount = 0;
+    if (!ReadAll(h, &argCount, sizeof(argCount), kClientStallMs, &running) ||
+        argCount == 0 || argCount > kMaxArgs) {
+        return;
+    }
+
+    std::vector<std::string> args(argCount);
+    for (auto& arg : args) {
+        if (!ReadString(h, arg, kMaxArgLength, kClientStallMs, &running)) {
+            return;
+        }
+    }
+
+    std::string response;
+    int32_t exitCode = 1;
+    try {
+        exitCode = handler(args, response);
+    }
+    catch (const std::exception& e) {
+        response = std::string("Error: ") + e.what() + "\n";
+        exitCode = 1;
+    }
+
+    // The command has run: deliver its result even while stopping
+    WriteAll(h, &exitCode, sizeof(exitCode), kClientStallMs);
+    WriteString(h, response, kClientStallMs);
+}
+
+} // namespace
+
+bool ControlChannel::StartServer(const std::string& endpoint, RequestHandler handler) {
+    if (running) {
+        return true;
+    }
+
+#ifdef _WIN32
+    if (!ConvertStringSecurityDescriptorToSecurityDescriptorA(kPipeSecurity, SDDL_REVISION_1,
+                                                              &pipeSecurity, nullptr)) {
+        std::cerr << "Failed to build the control pipe security descriptor: " << GetLastError() << std::endl;
+        return false;
+    }
+
+    HANDLE first = CreatePipeInstance(endpoint, pipeSecurity, true);
+    if (first == INVALID_HANDLE_VALUE) {
+        DWORD error = GetLastError();
+        if (error == ERROR_ACCESS_DENIED || error == ERROR_PIPE_BUSY) {
+            std::cerr << "Another service is already listening on: " << endpoint << std::endl;
+        }
+        else {
+            std::cerr << "CreateNamedPipe failed with error: " << error << std::endl;
+        }
+        LocalFree(pipeSecurity);
+        pipeSecurity = nullptr;
+        return false;
+    }
+    listenHandle = reinterpret_cast<intptr_t>(first);
+#else
+    sockaddr_un addr;
+    if (!MakeSocketAddress(endpoint, addr)) {
+        return false;
+    }
+
+    // Refuse to take over the endpoint of a service that is still alive;
+    // only a socket nobody answers on is a stale one to remove
+    if (SocketInUse(addr)) {
+        std::cerr << "Another service is already listening on: " << endpoint << std::endl;
+        return false;
+    }
+    unlink(endpoint.c_str());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        std::cerr << "Failed to create control socket" << std::endl;
+        return false;
+    }
+
+    // Only the owner (the elevated service account) may issue commands;
+    // the socket is created with those permissions, never wider
+    mode_t previousMask = umask(077);
+    bool bound = bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+    umask(previousMask);
+
+    if (!bound || listen(fd, 16) != 0) {
+        std::cerr << "Failed to bind control socket: " << endpoint << std::endl;
+        close(fd);
+        return false;
+    }
+    listenHandle = fd;
+#endif
+
+    serverEndpoint = endpoint;
+    requestHandler = std::move(handler);
+    running = true;
+    serverThread = std::thread(ServerLoop);
+
+    std::cout << "Control channel listening on: " << endpoint << std::endl;
+    return true;
+}
+
+void ControlChannel::StopServer() {
+    if (!running) {
+        return;
+    }
+
+    running = false;
+
+    if (serverThread.joinable()) {
+        serverThread.join();
+    }
+
+    // Clients still reading their request give up within one poll slice;
+    // commands already running finish and send their result
+    ReapClients(true);
+
+#ifdef _WIN32
+    if (listenHandle != -1) {
+        CloseHandle(reinterpret_cast<HANDLE>(listenHandle));
+    }
+    listenHandle = -1;
+    LocalFree(pipeSecurity);
+    pipeSecurity = nullptr;
+#else
+    close(static_cast<int>(listenHandle));
+    listenHandle = -1;
+    unlink(serverEndpoint.c_str());
+#endif
+
+    std::cout << "Control channel stopped" << std::endl;
+}
+
+void ControlChannel::StartClient(intptr_t handle) {
+    auto done = std::make_shared<std::atomic<bool>>(false);
+    std::thread thread([handle, done]() {
+#ifdef _WIN32
+        ChannelHandle h = reinterpret_cast<HANDLE>(handle);
+#else
+        ChannelHandle h = static_cast<int>(handle);
+#endif
+        ServeRequest(h, requestHandler, running);
+        CloseChannel(h);
+        *done = true;
+    });
+
+    std::lock_guard<std::mutex> lock(clientMutex);
+    clients.push_back(Client{ std::move(thread), done });
+}
+
+size_t ControlChannel::ReapClients(bool all) {
+    std::vector<Client> finished;
+    {
+        std::lock_guard<std::mutex> lock(clientMutex);
+        for (size_t i = 0; i < clients.size(); ) {
+            if (all || *clients[i].done) {
+                finished.push_back(std::move(clients[i]));
+                clients[i] = std::move(clients.back());
+                clients.pop_back();
+            }
+            else {
+                i++;
+            }
+        }
+    }
+
+    for (auto& client : finished) {
+        client.thread.join();
+    }
+
+    std::lock_guard<std::mutex> lock(clientMutex);
+    return clients.size();
+}
+
+void ControlChannel::ServerLoop() {
+    while (running) {
+        // Leave further clients in the backlog until a connection finishes
+        if (ReapClients(false) >= kMaxClients) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(kPollSliceMs));
+            continue;
+        }
+
+#ifdef _WIN32
+        HANDLE pipe = INVALID_HANDLE_VALUE;
+        if (listenHandle != -1) {
+            pipe = reinterpret_cast<HANDLE>(listenHandle);   // Created by StartServer
+            listenHandle = -1;
+        }
+        else {
+            pipe = CreatePipeInstance(serverEndpoint, pipeSecurity, false);
+        }
+        if (pipe == INVALID_HANDLE_VALUE) {
+            std::cerr << "CreateNamedPipe failed with error: " << GetLastError() << std::endl;
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            continue;
+        }
+
+        OVERLAPPED ov = {};
+        ov.hEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+        bool connected = ConnectNamedPipe(pipe, &ov) != FALSE || GetLastError() == ERROR_PIPE_CONNECTED;
+        if (!connected && GetLastError() == ERROR_IO_PENDING) {
+            // Wake up periodically so StopServer() is noticed
+            while (running && WaitForSingleObject(ov.hEvent, kPollSliceMs) == WAIT_TIMEOUT) {
+            }
+            DWORD unused = 0;
+            if (!running) {
+                CancelIo(pipe);
+            }
+            connected = GetOverlappedResult(pipe, &ov, &unused, TRUE) != FALSE;
+        }
+        CloseHandle(ov.hEvent);
+
+        if (connected && running) {
+            StartClient(reinterpret_cast<intptr_t>(pipe));
+        }
+        else {
+            DisconnectNamedPipe(pipe);
+            CloseHandle(pipe);
+        }
+#else
+        pollfd pfd = {};
+        pfd.fd = static_cast<int>(listenHandle);
+        pfd.events = POLLIN;
+
+        // Wake up periodically so StopServer() is noticed
+        if (poll(&pfd, 1, kPollSliceMs) <= 0) {
+            continue;
+        }
+
+        int client = accept(static_cast<int>(listenHandle), nullptr, nullptr);
+        if (client < 0) {
+            continue;
+        }
+
+        StartClient(client);
+#endif
+    }
+}
+
+bool ControlChannel::SendRequest(const std::string& endpoint, const std::vector<std::string>& args,
+                                 int& exitCode, std::string& response) {
+#ifdef _WIN32
+    HANDLE h = INVALID_HANDLE_VALUE;
+    for (int attempt = 0; attempt < 5; attempt++) {
+        h = CreateFileA(endpoint.c_str(), GENERIC_READ | GENERIC_WRITE,
+                        0, nullptr, OPEN_EXISTING, FILE_FLAG_OVERLAPPED, nullptr);
+        if (h != INVALID_HANDLE_VALUE || GetLastError() != ERROR_PIPE_BUSY) {
+            break;
+        }
+        WaitNamedPipeA(endpoint.c_str(), 2000);
+    }
+
+    if (h == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+#else
+    sockaddr_un addr;
+    if (!MakeSocketAddress(endpoint, addr)) {
+        return false;
+    }
+
+    int h = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (h < 0) {
+        return false;
+    }
+
+    if (connect(h, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(h);
+        return false;
+    }
+#endif
+
+    // Commands may run for minutes (refresh), so the response has no timeout
+    bool ok = true;
+    uint32_t argCount = static_cast<uint32_t>(args.size());
+    ok = ok && WriteAll(h, &argCount, sizeof(argCount));
+    for (size_t i = 0; ok && i < args.size(); i++) {
+        ok = WriteString(h, args[i]);
+    }
+
+    int32_t code = 1;
+    ok = ok && ReadAll(h, &code, sizeof(code));
+    ok = ok && ReadString(h, response, UINT32_MAX);
+    exitCode = code;
+
+#ifdef _WIN32
+    CloseHandle(h);
+#else
+    close(h);
+#endif
+
+    return ok;
+}
@@ -0,0 +1,93 @@
+#ifndef CONTROLCHANNEL_H
+#define CONTROLCHANNEL_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+
+/**
+ * @brief Local IPC channel between CLI invocations and the resident service
+ *
+ * The service listens on a named pipe (Windows) or a Unix domain socket
+ * (other platforms). A client sends its command line as a list of arguments
+ * and receives the command's exit code and captured output in return.
+ * Each connection is served on its own thread, so a long command does not
+ * hold up others; the handler decides which commands must not overlap.
+ * A client that stops sending or reading is dropped after a timeout.
+ */
+class ControlChannel {
+public:
+    /**
+     * @brief Callback that executes one request inside the service
+     *
+     * Called concurrently from the connection threads.
+     * @param args Command line arguments (args[0] is the command)
+     * @param response Output to send back to the client
+     * @return Exit code to report to the client
+     */
+    using RequestHandler = std::function<int(const std::vector<std::string>& args, std::string& response)>;
+
+    /**
+     * @brief Start listening for client requests on a background thread
+     * @param endpoint Named pipe name or Unix socket path
+     * @param handler Callback invoked for every request
+     * @return true if the listener was started, false if the endpoint is
+     *         unavailable or another service is listening on it
+     */
+    static bool StartServer(const std::string& endpoint, RequestHandler handler);
+
+    /**
+     * @brief Stop the listener, wait for the requests in progress and release the endpoint
+     */
+    static void StopServer();
+
+    /**
+     * @brief Send a request to a running service
+     * @param endpoint Named pipe name or Unix socket path
+     * @param args Command line arguments (args[0] is the command)
+     * @param exitCode Output exit code reported by the service
+     * @param response Output captured by the service
+     * @return true if a service answered, false if none is running
+     */
+    static bool SendRequest(const std::string& endpoint, const std::vector<std::string>& args,
+                            int& exitCode, std::string& response);
+
+private:
+    struct Client {
+        std::thread thread;
+        std::shared_ptr<std::atomic<bool>> done;
+    };
+
+    /**
+     * @brief Accept loop (runs in background thread)
+     */
+    static void ServerLoop();
+
+    /**
+     * @brief Serve one connection on its own thread
+     * @param handle Connected socket or pipe instance; closed when done
+     */
+    static void StartClient(intptr_t handle);
+
+    /**
+     * @brief Join client threads that have finished
+     * @param all Wait for every client thread, finished or not
+     * @return Number of client threads still running
+     */
+    static size_t ReapClients(bool all);
+
+    static std::string serverEndpoint;
+    static RequestHandler requestHandler;
+    static std::thread serverThread;
+    static std::atomic<bool> running;
+    static intptr_t listenHandle;  // Listening socket (unused with named pipes)
+    static std::mutex clientMutex;
+    static std::vector<Client> clients;   // Guarded by clientMutex
+};
+
+#endif // CONTROLCHANNEL_H
@@ -0,0 +1,370 @@
+#include "DnsMessage.h"
+#include <cstdio>
+#include <cctype>
+
+namespace {
+
+// Longest name accepted, per RFC 1035 section 2.3.4
+const size_t kMaxNameLength = 255;
+const size_t kMaxLabelLength = 63;
+
+void PutU16(std::vector<uint8_t>& packet, uint16_t value) {
+    packet.push_back(static_cast<uint8_t>(value >> 8));
+    packet.push_back(static_cast<uint8_t>(value & 0xFF));
+}
+
+void PutU32(std::vector<uint8_t>& packet, uint32_t value) {
+    PutU16(packet, static_cast<uint16_t>(value >> 16));
+    PutU16(packet, static_cast<uint16_t>(value & 0xFFFF));
+}
+
+bool GetU16(const uint8_t* data, size_t size, size_t& offset, uint16_t& value) {
+    if (offset + 2 > size) {
+        return false;
+    }
+    value = static_cast<uint16_t>((data[offset] << 8) | data[offset + 1]);
+    offset += 2;
+    return true;
+}
+
+bool GetU32(const uint8_t* data, size_t size, size_t& offset, uint32_t& value) {
+    uint16_t high = 0;
+    uint16_t low = 0;
+    if (!GetU16(data, size, offset, high) || !GetU16(data, size, offset, low)) {
+        return false;
+    }
+    value = (static_cast<uint32_t>(high) << 16) | low;
+    return true;
+}
+
+} // namespace
+
+bool DnsMessage::EncodeName(const std::string& name, std::vector<uint8_t>& packet) {
+    std::string trimmed = name;
+    if (!trimmed.empty() && trimmed.back() == '.') {
+        trimmed.pop_back();
+    }
+    if (trimmed.size() + 2 > kMaxNameLength) {
+        return false;
+    }
+
+    size_t start = 0;
+    while (start < trimmed.size()) {
+        size_t dot = trimmed.find('.', start);
+        if (dot == std::string::npos) {
+            dot = trimmed.size();
+        }
+
+        size_t length = dot - start;
+        if (length == 0 || length > kMaxLabelLength) {
+            return false;
+        }
+
+        packet.push_back(static_cast<uint8_t>(length));
+        packet.insert(packet.end(), trimmed.begin() + start, trimmed.begin() + dot);
+        start = dot + 1;
+    }
+
+    packet.push_back(0);
+    return true;
+}
+
+bool DnsMessage::DecodeName(const uint8_t* data, size_t size, size_t& offset, std::string& name) {
+    name.clear();
+    size_t cursor = offset;
+    bool jumped = false;
+    int jumps = 0;
+
+    while (true) {
+        if (cursor >= size) {
+            return false;
+        }
+
+        uint8_t length = data[cursor];
+        if ((length & 0xC0) == 0xC0) {
+            // Compression pointer; bound the number of jumps to reject loops
+            if (cursor + 1 >= size || ++jumps > 16) {
+                return false;
+            }
+            size_t target = static_cast<size_t>(((length & 0x3F) << 8) | data[cursor + 1]);
+            if (!jumped) {
+                offset = cursor + 2;
+                jumped = true;
+            }
+            cursor = target;
+            continue;
+        }
+        if (length & 0xC0) {
+            return false;
+        }
+
+        cursor++;
+        if (length == 0) {
+            break;
+        }
+        if (cursor + length > size) {
+            return false;
+        }
+
+        if (!name.empty()) {
+            name.push_back('.');
+        }
+        name.append(reinterpret_cast<const char*>(data + cursor), length);
+        cursor += length;
+
+        if (name.size() > kMaxNameLength) {
+            return false;
+        }
+    }
+
+    if (!jumped) {
+        offset = cursor;
+    }
+    return true;
+}
+
+bool DnsMessage::Encode(const Message& message, std::vector<uint8_t>& packet) {
+    packet.clear();
+    PutU16(packet, message.id);
+    PutU16(packet, message.flags);
+    PutU16(packet, static_cast<uint16_t>(message.questions.size()));
+    PutU16(packet, static_cast<uint16_t>(message.answers.size()));
+    PutU16(packet, 0);   // Authority records
+    PutU16(packet, 0);   // Additional records
+
+    for (const auto& question : message.questions) {
+        if (!EncodeName(question.name, packet)) {
+            return false;
+        }
+        PutU16(packet, question.type);
+        PutU16(packet, question.qclass);
+    }
+
+    for (const auto& answer : message.answers) {
+        if (!EncodeName(answer.name, packet) || answer.data.size() > 0xFFFF) {
+            return false;
+        }
+        PutU16(packet, answer.type);
+        PutU16(packet, answer.rclass);
+        PutU32(packet, answer.ttl);
+        PutU16(packet, static_cast<uint16_t>(answer.data.size()));
+        packet.insert(packet.end(), answer.data.begin(), answer.data.end());
+    }
+
+    return true;
+}
+
+bool DnsMessage::Decode(const uint8_t* data, size_t size, Message& message) {
+    size_t offset = 0;
+    uint16_t questionCount = 0;
+    uint16_t answerCount = 0;
+    uint16_t authorityCount = 0;
+    uint16_t additionalCount = 0;
+
+    if (!GetU16(data, size, offset, message.id) ||
+        !GetU16(data, size, offset, message.flags) ||
+        !GetU16(data, size, offset, questionCount) ||
+        !GetU16(data, size, offset, answerCount) ||
+        !GetU16(data, size, offset, authorityCount) ||
+        !GetU16(data, size, offset, additionalCount)) {
+        return false;
+    }
+
+    message.questions.clear();
+    message.answers.clear();
+
+    for (uint16_t i = 0; i < questionCount; i++) {
+        Question question;
+        if (!DecodeName(data, size, offset, question.name) ||
+            !GetU16(data, size, offset, question.type) ||
+            !GetU16(data, size, offset, question.qclass)) {
+            return false;
+        }
+        message.questions.push_back(std::move(question));
+    }
+
+    for (uint16_t i = 0; i < answerCount; i++) {
+        ResourceRecord record;
+        uint16_t length = 0;
+        if (!DecodeName(data, size, offset, record.name) ||
+            !GetU16(data, size, offset, record.type) ||
+            !GetU16(data, size, offset, record.rclass) ||
+            !GetU32(data, size, offset, record.ttl) ||
+            !GetU16(data, size, offset, length) ||
+            offset + length > size) {
+            return false;
+        }
+        record.data.assign(data + offset, data + offset + length);
+        offset += length;
+        message.answers.push_back(std::move(record));
+    }
+
+    return true;
+}
+
+DnsMessage::Message DnsMessage::MakeQuery(uint16_t id, const std::string& name, uint16_t type) {
+    Message query;
+    query.id = id;
+    query.flags = FlagRecursionDesired;
+
+    Question question;
+    question.name = name;
+    question.type = type;
+    question.qclass = ClassIN;
+    query.questions.push_back(question);
+
+    return query;
+}
+
+std::string DnsMessage::AddressToString(const ResourceRecord& record) {
+    if ((record.type == TypeA && record.data.size() == 4) ||
+        (record.type == TypeAAAA && record.data.size() == 16)) {
+        return AddressToString(record.data.data(), record.data.size());
+    }
+    return "";
+}
+
+std::string DnsMessage::AddressToString(const uint8_t* b, size_t size) {
+    if (size == 4) {
+        char text[16];
+        std::snprintf(text, sizeof(text), "%u.%u.%u.%u", b[0], b[1], b[2], b[3]);
+        return text;
+    }
+
+    if (size == 16) {
+        uint16_t groups[8];
+        for (int i = 0; i < 8; i++) {
+            groups[i] = static_cast<uint16_t>((b[2 * i] << 8) | b[2 * i + 1]);
+        }
+
+        // RFC 5952: compress the longest run of two or more zero groups
+        int bestStart = -1;
+        int bestLength = 0;
+        for (int i = 0; i < 8; ) {
+            if (groups[i] != 0) {
+                i++;
+                continue;
+            }
+            int j = i;
+            while (j < 8 && groups[j] == 0) {
+                j++;
+            }
+            if (j - i > bestLength && j - i >= 2) {
+                bestStart = i;
+                bestLength = j - i;
+            }
+            i = j;
+        }
+
+        std::string text;
+        char group[8];
+        for (int i = 0; i < 8; i++) {
+            if (i == bestStart) {
+                text += "::";
+                i += bestLength - 1;
+                continue;
+            }
+            if (!text.empty() && text.back() != ':') {
+                text += ":";
+            }
+            std::snprintf(group, sizeof(group), "%x", groups[i]);
+            text += group;
+        }
+        return text;
+    }
+
+    return "";
+}
+
+bool DnsMessage::ParseAddress(const std::string& text, uint8_t* bytes, size_t& size) {
+    if (text.find(':') == std::string::npos) {
+        // IPv4: four decimal octets without leading zeros
+        size_t pos = 0;
+        for (int octet = 0; octet < 4; octet++) {
+            if (octet > 0) {
+                if (pos >= text.size() || text[pos] != '.') {
+                    return false;
+                }
+                pos++;
+            }
+
+            size_t start = pos;
+            unsigned value = 0;
+            while (pos < text.size() && pos - start < 3 && text[pos] >= '0' && text[pos] <= '9') {
+                value = value * 10 + static_cast<unsigned>(text[pos] - '0');
+                pos++;
+            }
+            if (pos == start || value > 255 || (pos - start > 1 && text[start] == '0')) {
+                return false;
+            }
+            bytes[octet] = static_cast<uint8_t>(value);
+        }
+
+        size = 4;
+        return pos == text.size();
+    }
+
+    // IPv6: up to eight hex groups with at most one "::"
+    uint16_t head[8];
+    uint16_t tail[8];
+    int headCount = 0;
+    int tailCount = 0;
+    bool compressed = false;
+    size_t pos = 0;
+
+    if (text.compare(0, 2, "::") == 0) {
+        compressed = true;
+        pos = 2;
+    }
+
+    while (pos < text.size()) {
+        size_t start = pos;
+        unsigned value = 0;
+        while (pos < text.size() && pos - start < 4 && std::isxdigit(static_cast<unsigned char>(text[pos]))) {
+            char c = static_cast<char>(std::tolower(static_cast<unsigned char>(text[pos])));
+            value = value * 16 + static_cast<unsigned>(c <= '9' ? c - '0' : c - 'a' + 10);
+            pos++;
+        }
+        if (pos == start || headCount + tailCount >= 8) {
+            return false;
+        }
+        (compressed ? tail[tailCount++] : head[headCount++]) = static_cast<uint16_t>(value);
+
+        if (pos == text.size()) {
+            break;
+        }
+        if (text[pos] != ':') {
+            return false;
+        }
+        pos++;
+        if (pos < text.size() && text[pos] == ':') {
+            if (compressed) {
+                return false;
+            }
+            compressed = true;
+            pos++;
+        }
+        else if (pos == text.size()) {
+            return false;
+        }
+    }
+
+    if ((compressed && headCount + tailCount > 7) || (!compressed && headCount != 8)) {
+        return false;
+    }
+
+    uint16_t groups[8] = { 0 };
+    for (int i = 0; i < headCount; i++) {
+        groups[i] = head[i];
+    }
+    for (int i = 0; i < tailCount; i++) {
+        groups[8 - tailCount + i] = tail[i];
+    }
+    for (int i = 0; i < 8; i++) {
+        bytes[2 * i] = static_cast<uint8_t>(groups[i] >> 8);
+        bytes[2 * i + 1] = static_cast<uint8_t>(groups[i] & 0xFF);
+    }
+
+    size = 16;
+    return true;
+}
@@ -0,0 +1,117 @@
+#ifndef DNSMESSAGE_H
+#define DNSMESSAGE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief Minimal DNS wire format (RFC 1035) encoder and decoder
+ *
+ * Covers what the built-in resolver and the synthetic load server need:
+ * a header, questions and answer records. Names in decoded messages may
+ * use compression pointers; encoded names are never compressed.
+ */
+class DnsMessage {
+public:
+    static const uint16_t TypeA = 1;
+    static const uint16_t TypeAAAA = 28;
+    static const uint16_t ClassIN = 1;
+
+    static const uint16_t FlagResponse = 0x8000;
+    static const uint16_t FlagAuthoritative = 0x0400;
+    static const uint16_t FlagTruncated = 0x0200;
+    static const uint16_t FlagRecursionDesired = 0x0100;
+    static const uint16_t FlagRecursionAvailable = 0x0080;
+
+    static const uint16_t RcodeNoError = 0;
+    static const uint16_t RcodeServFail = 2;
+    static const uint16_t RcodeNxDomain = 3;
+    static const uint16_t RcodeRefused = 5;
+
+    struct Question {
+        std::string name;
+        uint16_t type;
+        uint16_t qclass;
+    };
+
+    struct ResourceRecord {
+        std::string name;
+        uint16_t type;
+        uint16_t rclass;
+        uint32_t ttl;
+        std::vector<uint8_t> data;
+    };
+
+    struct Message {
+        uint16_t id;
+        uint16_t flags;                        // Includes the response code in the low 4 bits
+        std::vector<Question> questions;
+        std::vector<ResourceRecord> answers;   // Authority and additional sections are skipped
+
+        Message() : id(0), flags(0) {}
+
+        uint16_t Rcode() const { return flags & 0x000F; }
+    };
+
+    /**
+     * @brief Serialize a message
+     * @param message Message to encode
+     * @param packet Output buffer (replaced)
+     * @return true if successful, false if a name is not encodable
+     */
+    static bool Encode(const Message& message, std::vector<uint8_t>& packet);
+
+    /**
+     * @brief Parse a message
+     * @param data Packet bytes
+     * @param size Packet length
+     * @param message Output message
+     * @return true if the packet is well formed
+     */
+    static bool Decode(const uint8_t* data, size_t size, Message& message);
+
+    /**
+     * @brief Build a recursive query for one name and type
+     * @param id Transaction ID
+     * @param name Name to query
+     * @param type Query type (TypeA or TypeAAAA)
+     * @return Query message
+     */
+    static Message MakeQuery(uint16_t id, const std::string& name, uint16_t type);
+
+    /**
+     * @brief Render the address in an A or AAAA record
+     * @param record Answer record
+     * @return Address text, empty if the record is not an address record
+     */
+    static std::string AddressToString(const ResourceRecord& record);
+
+    /**
+     * @brief Render a raw IPv4 or IPv6 address (RFC 5952 form for IPv6)
+     * @param bytes Address in network byte order
+     * @param size 4 or 16
+     * @return Address text, empty for any other size
+     */
+    static std::string AddressToString(const uint8_t* bytes, size_t size);
+
+    /**
+     * @brief Parse dotted-quad IPv4 or colon-hex IPv6 text
+     *
+     * Strict: rejects leading zeros in IPv4 octets and embedded IPv4 in
+     * IPv6, so AddressToString reproduces any text it accepts in the
+     * canonical case.
+     * @param text Address text
+     * @param bytes Output buffer of at least 16 bytes, network byte order
+     * @param size Set to 4 or 16
+     * @return true if the text is an address
+     */
+    static bool ParseAddress(const std::string& text, uint8_t* bytes, size_t& size);
+
+private:
+    static bool EncodeName(const std::string& name, std::vector<uint8_t>& packet);
+    static bool DecodeName(const uint8_t* data, size_t size, size_t& offset, std::string& name);
+};
+
+#endif // DNSMESSAGE_H
@@ -1,17 +1,30 @@
 #include "FirewallManager.h"
+#include "Log.h"
+#include "Metrics.h"
+#include "Trace.h"
 #include <iostream>
 #include <sstream>
 #include <iomanip>
+
+#ifdef _WIN32
 #include <WinSock2.h>
 #include <WS2tcpip.h>
+#include <Windows.h>
 #include <fwpmu.h>
 #include <rpc.h>
 
 #pragma comment(lib, "fwpuclnt.lib")
 #pragma comment(lib, "rpcrt4.lib")
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#endif
 
 // Initialize static members
-HANDLE FirewallManager::engineHandle = nullptr;
+void* FirewallManager::engineHandle = nullptr;
 bool FirewallManager::initialized = false;
 
 bool FirewallManager::Initialize() {
@@ -19,6 +32,7 @@ bool FirewallManager::Initialize() {
         return true;
     }
 
+#ifdef _WIN32
     // Open a session to the filter engine
     DWORD result = FwpmEngineOpen0(
         nullptr,                    // Local machine
@@ -29,37 +43,50 @@ bool FirewallManager::Initialize() {
     );
 
     if (result != ERROR_SUCCESS) {
-        std::cerr << "FwpmEngineOpen0 failed with error: " << result << std::endl;
+        LOG_ERROR("FwpmEngineOpen0 failed with error: " << result);
         return false;
     }
+#else
+    // Simulated backend: no filter engine, use a non-null sentinel handle
+    static int simulatedEngine = 0;
+    engineHandle = &simulatedEngine;
+#endif
 
     initialized = true;
-    std::cout << "Firewall Manager initialized successfully" << std::endl;
+    LOG_INFO("Firewall Manager initialized successfully");
     return true;
 }
 
 void FirewallManager::Cleanup() {
     if (engineHandle != nullptr) {
+#ifdef _WIN32
         FwpmEngineClose0(engineHandle);
+#endif
         engineHandle = nullptr;
         initialized = false;
-        std::cout << "Firewall Manager cleaned up" << std::endl;
+        LOG_INFO("Firewall Manager cleaned up");
     }
 }
 
 std::string FirewallManager::CreateDynamicKeywordAddress(const std::string& fqdn,
                                                          const std::vector<std::string>& ips,
-                                                         bool autoResolve) {
+                                                         bool autoResolve,
+                                                         const std::string& keywordId) {
+    static Histogram& opSeconds = Metrics::GetHistogram("fqdn_firewall_op_seconds",
+        "Time spent in firewall operations", "op=\"create_keyword\"");
+    ScopedTimer timer(opSeconds);
+    TraceSpan span("create_keyword", "firewall", fqdn);
+
     if (!initialized) {
-        std::cerr << "FirewallManager not initialized" << std::endl;
+        LOG_ERROR("FirewallManager not initialized");
         return "";
     }
 
-    // Generate a GUID for this keyword address
-    std::string guidStr = GenerateGUID();
+    // Generate a GUID for this keyword address unless one was given
+    std::string guidStr = keywordId.empty() ? GenerateGUID() : keywordId;
 
-    std::cout << "Creating dynamic keyword address for: " << fqdn << std::endl;
-    std::cout << "GUID: " << guidStr << std::endl;
+    LOG_DEBUG("Creating dynamic keyword address for: " << fqdn);
+    LOG_DEBUG("GUID: " << guidStr);
 
     // NOTE: Windows Filtering Platform Dynamic Keyword Addresses
     // This is a placeholder implementation. The actual WFP API for dynamic keyword addresses
@@ -75,9 +102,9 @@ std::string FirewallManager::CreateDynamicKeywordAddress(const std::string& fqdn
     // the structure. In production, you would call the actual WFP APIs here.
 
     // Store the keyword-IP mapping (in a real implementation, this would be in WFP)
-    std::cout << "Dynamic keyword address created with " << ips.size() << " IP(s)" << std::endl;
+    LOG_DEBUG("Dynamic keyword address created with " << ips.size() << " IP(s)");
     for (const auto& ip : ips) {
-        std::cout << "  - " << ip << std::endl;
+        LOG_DEBUG("  - " << ip);
     }
 
     // Return the GUID
@@ -86,32 +113,42 @@ std::string FirewallManager::CreateDynamicKeywordAddress(const std::string& fqdn
 
 bool FirewallManager::UpdateDynamicKeywordAddress(const std::string& keywordId,
                                                   const std::vector<std::string>& ips) {
+    static Histogram& opSeconds = Metrics::GetHistogram("fqdn_firewall_op_seconds",
+        "Time spent in firewall operations", "op=\"update_keyword\"");
+    ScopedTimer timer(opSeconds);
+    TraceSpan span("update_keyword", "firewall", keywordId);
+
     if (!initialized) {
-        std::cerr << "FirewallManager not initialized" << std::endl;
+        LOG_ERROR("FirewallManager not initialized");
         return false;
     }
 
-    std::cout << "Updating dynamic keyword address: " << keywordId << std::endl;
-    std::cout << "New IP count: " << ips.size() << std::endl;
+    LOG_DEBUG("Updating dynamic keyword address: " << keywordId);
+    LOG_DEBUG("New IP count: " << ips.size());
 
     // NOTE: Production implementation would use:
     // - FwpmDynamicKeywordAddressUpdate0() to update the IP list
     // This would replace all IPs associated with the keyword ID
 
     for (const auto& ip : ips) {
-        std::cout << "  - " << ip << std::endl;
+        LOG_DEBUG("  - " << ip);
     }
 
     return true;
 }
 
 bool FirewallManager::DeleteDynamicKeywordAddress(const std::string& keywordId) {
+    static Histogram& opSeconds = Metrics::GetHistogram("fqdn_firewall_op_seconds",
+        "Time spent in firewall operations", "op=\"delete_keyword\"");
+    ScopedTimer timer(opSeconds);
+    TraceSpan span("delete_keyword", "firewall", keywordId);
+
     if (!initialized) {
-        std::cerr << "FirewallManager not initialized" << std::endl;
+        LOG_ERROR("FirewallManager not initialized");
         return false;
     }
 
-    std::cout << "Deleting dynamic keyword address: " << keywordId << std::endl;
+    LOG_DEBUG("Deleting dynamic keyword address: " << keywordId);
 
     // NOTE: Production implementation would use:
     // - FwpmDynamicKeywordAddressDelete0() to remove the keyword address
@@ -123,20 +160,27 @@ bool FirewallManager::CreateFirewallRule(const std::string& ruleName,
                                         const std::string& keywordId,
                                         const std::string& direction,
                                         const std::string& action) {
+    static Histogram& opSeconds = Metrics::GetHistogram("fqdn_firewall_op_seconds",
+        "Time spent in firewall operations", "op=\"create_rule\"");
+    ScopedTimer timer(opSeconds);
+    TraceSpan span("create_rule", "firewall", ruleName);
+
     if (!initialized) {
-        std::cerr << "FirewallManager not initialized" << std::endl;
+        LOG_ERROR("FirewallManager not initialized");
         return false;
     }
 
-    std::cout << "Creating firewall rule: " << ruleName << std::endl;
-    std::cout << "  Direction: " << direction << std::endl;
-    std::cout << "  Action: " << action << std::endl;
-    std::cout << "  Keyword ID: " << keywordId << std::endl;
+    LOG_DEBUG("Creating firewall rule: " << ruleName);
+    LOG_DEBUG("  Direction: " << direction);
+    LOG_DEBUG("  Action: " << action);
+    LOG_DEBUG("  Keyword ID: " << keywordId);
 
+#ifdef _WIN32
     // Convert rule name to wide string
     int size = MultiByteToWideChar(CP_UTF8, 0, ruleName.c_str(), -1, nullptr, 0);
     std::wstring wRuleName(size, 0);
     MultiByteToWideChar(CP_UTF8, 0, ruleName.c_str(), -1, &wRuleName[0], size);
+#endif
 
     // NOTE: Full WFP implementation would:
     // 1. Create a filter condition that references the dynamic keyword address
@@ -167,17 +211,22 @@ bool FirewallManager::CreateFirewallRule(const std::string& ruleName,
     DWORD result = FwpmFilterAdd0(engineHandle, &filter, nullptr, &filterId);
     */
 
-    std::cout << "Firewall rule created successfully (simulation)" << std::endl;
+    LOG_DEBUG("Firewall rule created successfully (simulation)");
     return true;
 }
 
 bool FirewallManager::DeleteFirewallRule(const std::string& ruleName) {
+    static Histogram& opSeconds = Metrics::GetHistogram("fqdn_firewall_op_seconds",
+        "Time spent in firewall operations", "op=\"delete_rule\"");
+    ScopedTimer timer(opSeconds);
+    TraceSpan span("delete_rule", "firewall", ruleName);
+
     if (!initialized) {
-        std::cerr << "FirewallManager not initialized" << std::endl;
+        LOG_ERROR("FirewallManager not initialized");
         return false;
     }
 
-    std::cout << "Deleting firewall rule: " << ruleName << std::endl;
+    LOG_DEBUG("Deleting firewall rule: " << ruleName);
 
     // NOTE: Production implementation would:
     // 1. Enumerate filters to find the one with matching name
@@ -206,18 +255,43 @@ bool FirewallManager::DeleteFirewallRule(const std::string& ruleName) {
     }
     */
 
-    std::cout << "Firewall rule deleted successfully (simulation)" << std::endl;
+    LOG_DEBUG("Firewall rule deleted successfully (simulation)");
     return true;
 }
 
 std::string FirewallManager::GenerateGUID() {
+#ifdef _WIN32
     GUID guid;
     HRESULT hr = CoCreateGuid(&guid);
     
     if (FAILED(hr)) {
-        std::cerr << "Failed to generate GUID" << std::endl;
+        LOG_ERROR("Failed to generate GUID");
         return "";
     }
+#else
+    // Random (version 4) GUID for the simulated backend
+    struct {
+        uint32_t Data1;
+        uint16_t Data2;
+        uint16_t Data3;
+        uint8_t Data4[8];
+    } guid;
+
+    static std::mutex rngMutex;
+    static std::mt19937_64 rng(std::random_device{}());
+    {
+        std::lock_guard<std::mutex> lock(rngMutex);
+        uint64_t high = rng();
+        uint64_t low = rng();
+        guid.Data1 = static_cast<uint32_t>(high >> 32);
+        guid.Data2 = static_cast<uint16_t>(high >> 16);
+        guid.Data3 = static_cast<uint16_t>((high & 0x0FFF) | 0x4000);
+        for (int i = 0; i < 8; i++) {
+            guid.Data4[i] = static_cast<uint8_t>(low >> (i * 8));
+        }
+        guid.Data4[0] = static_cast<uint8_t>((guid.Data4[0] & 0x3F) | 0x80);
+    }
+#endif
 
     // Convert GUID to string
     std::ostringstream oss;
@@ -237,14 +311,14 @@ std::string FirewallManager::GenerateGUID() {
     return oss.str();
 }
 
-std::vector<BYTE> FirewallManager::IPStringToBytes(const std::string& ipStr, bool& isIPv6) {
-    std::vector<BYTE> bytes;
+std::vector<unsigned char> FirewallManager::IPStringToBytes(const std::string& ipStr, bool& isIPv6) {
+    std::vector<unsigned char> bytes;
     
     // Try IPv4 first
     struct in_addr addr4;
     if (inet_pton(AF_INET, ipStr.c_str(), &addr4) == 1) {
         isIPv6 = false;
-        BYTE* ptr = reinterpret_cast<BYTE*>(&addr4);
+        unsigned char* ptr = reinterpret_cast<unsigned char*>(&addr4);
         bytes.assign(ptr, ptr + sizeof(in_addr));
         return bytes;
     }
@@ -253,7 +327,7 @@ std::vector<BYTE> FirewallManager::IPStringToBytes(const std::string& ipStr, boo
     struct in6_addr addr6;
     if (inet_pton(AF_INET6, ipStr.c_str(), &addr6) == 1) {
         isIPv6 = true;
-        BYTE* ptr = reinterpret_cast<BYTE*>(&addr6);
+        unsigned char* ptr = reinterpret_cast<unsigned char*>(&addr6);
         bytes.assign(ptr, ptr + sizeof(in6_addr));
         return bytes;
     }
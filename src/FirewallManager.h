@@ -3,7 +3,6 @@
 
 #include <string>
 #include <vector>
-#include <Windows.h>
 
 /**
  * @brief Windows Firewall Platform (WFP) management
@@ -13,6 +12,8 @@
  * 
  * Dynamic Keyword Addresses allow creating named sets of IP addresses that
  * can be updated dynamically and referenced in firewall rules.
+ *
+ * Non-Windows builds use a simulated backend that only logs operations.
  */
 class FirewallManager {
 public:
@@ -36,11 +37,14 @@ public:
      * @param fqdn FQDN to use as the keyword name
      * @param ips Initial IP addresses to add
      * @param autoResolve Enable auto-resolution (currently not used, for future extension)
+     * @param keywordId GUID to create it with (a replica of another service's keyword),
+     *        or empty to generate one
      * @return GUID of the created keyword address, or empty string on failure
      */
     static std::string CreateDynamicKeywordAddress(const std::string& fqdn,
                                                    const std::vector<std::string>& ips,
-                                                   bool autoResolve = true);
+                                                   bool autoResolve = true,
+                                                   const std::string& keywordId = "");
 
     /**
      * @brief Update a dynamic keyword address with new IP addresses
@@ -89,7 +93,7 @@ public:
     static std::string GenerateGUID();
 
 private:
-    static HANDLE engineHandle;  // Handle to WFP engine
+    static void* engineHandle;  // Handle to WFP engine (HANDLE on Windows)
     static bool initialized;
 
     /**
@@ -98,7 +102,7 @@ private:
      * @param isIPv6 Output parameter indicating if IPv6
      * @return Byte array representation
      */
-    static std::vector<BYTE> IPStringToBytes(const std::string& ipStr, bool& isIPv6);
+    static std::vector<unsigned char> IPStringToBytes(const std::string& ipStr, bool& isIPv6);
 };
 
 #endif // FIREWALLMANAGER_H
@@ -0,0 +1,213 @@
+#include "FirewallWriteQueue.h"
+#include "CancellationToken.h"
+#include "FirewallManager.h"
+#include "Log.h"
+#include "Metrics.h"
+#include <algorithm>
+
+namespace {
+
+Counter& OpsCounter(const char* result) {
+    return Metrics::GetCounter("fqdn_firewall_queue_ops_total",
+        "Firewall operations by how the write queue handled them", std::string("result=\"") + result + "\"");
+}
+
+Gauge& PendingGauge() {
+    static Gauge& gauge = Metrics::GetGauge("fqdn_firewall_queue_pending",
+        "Keyword updates waiting in the firewall write queue");
+    return gauge;
+}
+
+} // namespace
+
+// Initialize static members
+std::mutex FirewallWriteQueue::queueMutex;
+std::condition_variable FirewallWriteQueue::queueChanged;
+std::unordered_map<std::string, FirewallWriteQueue::Entry> FirewallWriteQueue::entries;
+std::deque<std::string> FirewallWriteQueue::order;
+std::unordered_set<std::string> FirewallWriteQueue::inFlight;
+double FirewallWriteQueue::ratePerSecond = 0;
+double FirewallWriteQueue::burstSize = 1;
+double FirewallWriteQueue::tokens = 1;
+FirewallWriteQueue::Clock::time_point FirewallWriteQueue::lastRefill = FirewallWriteQueue::Clock::now();
+FirewallWriteQueue::Stats FirewallWriteQueue::stats = {};
+
+void FirewallWriteQueue::Configure(double opsPerSecond, double burst) {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    ratePerSecond = std::max(0.0, opsPerSecond);
+    burstSize = std::max(1.0, burst);
+    tokens = burstSize;
+    lastRefill = Clock::now();
+    queueChanged.notify_all();
+
+    if (ratePerSecond > 0) {
+        LOG_DEBUG("Firewall writes limited to " << ratePerSecond << "/s, burst " << burstSize);
+    }
+}
+
+bool FirewallWriteQueue::IsLimited() {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    return ratePerSecond > 0;
+}
+
+bool FirewallWriteQueue::Update(const std::string& keywordId, const std::vector<std::string>& ips,
+                                const CancellationToken* cancel) {
+    static Counter& queuedTotal = OpsCounter("queued");
+    static Counter& coalescedTotal = OpsCounter("coalesced");
+    static Counter& appliedTotal = OpsCounter("applied");
+    static Counter& failedTotal = OpsCounter("failed");
+    static Counter& cancelledTotal = OpsCounter("cancelled");
+
+    std::unique_lock<std::mutex> lock(queueMutex);
+    if (CancellationToken::IsCancelled(cancel)) {
+        return false;
+    }
+    if (ratePerSecond <= 0) {
+        lock.unlock();
+        return Apply(keywordId, ips);
+    }
+
+    auto it = entries.find(keywordId);
+    if (it != entries.end()) {
+        // Only the latest addresses matter; ride on the write already queued
+        it->second.ips = ips;
+        std::shared_ptr<Outcome> outcome = it->second.outcome;
+        stats.coalesced++;
+        coalescedTotal.Increment();
+        if (cancel == nullptr) {
+            queueChanged.wait(lock, [&outcome]() { return outcome->done; });
+        }
+        while (!outcome->done && !cancel->IsCancelled()) {
+            queueChanged.wait_for(lock, CancellationToken::CheckInterval());
+        }
+        return outcome->done && outcome->applied;
+    }
+
+    std::shared_ptr<Outcome> outcome = std::make_shared<Outcome>();
+    entries.emplace(keywordId, Entry{ ips, outcome });
+    order.push_back(keywordId);
+    stats.queued++;
+    stats.maxPending = std::max(stats.maxPending, order.size());
+    queuedTotal.Increment();
+    PendingGauge().Set(static_cast<int64_t>(order.size()));
+
+    bool turn = WaitForToken(lock, [&keywordId]() { return IsNext(keywordId); }, cancel);
+
+    auto entry = entries.find(keywordId);
+    std::vector<std::string> latest = std::move(entry->second.ips);
+    entries.erase(entry);
+    order.erase(std::find(order.begin(), order.end(), keywordId));
+    PendingGauge().Set(static_cast<int64_t>(order.size()));
+    queueChanged.notify_all();   // Next in line may proceed
+
+    if (!turn) {
+        // Cancelled while queued; updates merged into this one fail with it
+        stats.cancelled++;
+        cancelledTotal.Increment();
+        outcome->done = true;
+        return false;
+    }
+
+    inFlight.insert(keywordId);
+    lock.unlock();
+    bool applied = Apply(keywordId, latest);
+    lock.lock();
+    inFlight.erase(keywordId);
+
+    (applied ? stats.applied : stats.failed)++;
+    (applied ? appliedTotal : failedTotal).Increment();
+    outcome->applied = applied;
+    outcome->done = true;
+    queueChanged.notify_all();
+    return applied;
+}
+
+void FirewallWriteQueue::Throttle(size_t operations) {
+    static Counter& throttledTotal = OpsCounter("throttled");
+
+    std::unique_lock<std::mutex> lock(queueMutex);
+    if (ratePerSecond <= 0) {
+        return;
+    }
+    for (size_t i = 0; i < operations; i++) {
+        WaitForToken(lock, []() { return true; });
+    }
+    stats.throttled += operations;
+    throttledTotal.Increment(operations);
+    queueChanged.notify_all();
+}
+
+void FirewallWriteQueue::ChargeUrgent(size_t operations) {
+    static Counter& urgentTotal = OpsCounter("urgent");
+
+    std::lock_guard<std::mutex> lock(queueMutex);
+    if (ratePerSecond > 0) {
+        // May go into debt, but never by more than one burst
+        Refill(Clock::now());
+        tokens = std::max(-burstSize, tokens - static_cast<double>(operations));
+    }
+    stats.urgent += operations;
+    urgentTotal.Increment(operations);
+}
+
+FirewallWriteQueue::Stats FirewallWriteQueue::GetStats() {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    Stats current = stats;
+    current.pending = order.size();
+    return current;
+}
+
+void FirewallWriteQueue::Refill(Clock::time_point now) {
+    double elapsed = std::chrono::duration<double>(now - lastRefill).count();
+    tokens = std::min(burstSize, tokens + elapsed * ratePerSecond);
+    lastRefill = now;
+}
+
+bool FirewallWriteQueue::WaitForToken(std::unique_lock<std::mutex>& lock, const std::function<bool()>& myTurn,
+                                      const CancellationToken* cancel) {
+    for (;;) {
+        bool turn = myTurn();
+        if (turn && ratePerSecond <= 0) {
+            return true;   // Limit lifted while waiting
+        }
+        if (CancellationToken::IsCancelled(cancel)) {
+            return false;
+        }
+        if (turn) {
+            Refill(Clock::now());
+            if (tokens >= 1) {
+                tokens -= 1;
+                return true;
+            }
+            auto wait = std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>((1 - tokens) / ratePerSecond));
+            queueChanged.wait_for(lock, CancellationToken::Slice(wait, cancel));
+        }
+        else if (cancel != nullptr) {
+            queueChanged.wait_for(lock, CancellationToken::CheckInterval());
+        }
+        else {
+            queueChanged.wait(lock);
+        }
+    }
+}
+
+bool FirewallWriteQueue::IsNext(const std::string& keywordId) {
+    // Oldest queued keyword that is not still being written
+    for (const std::string& queued : order) {
+        if (inFlight.count(queued) == 0) {
+            return queued == keywordId;
+        }
+    }
+    return false;
+}
+
+bool FirewallWriteQueue::Apply(const std::string& keywordId, const std::vector<std::string>& ips) {
+    try {
+        return FirewallManager::UpdateDynamicKeywordAddress(keywordId, ips);
+    }
+    catch (const std::exception& e) {
+        LOG_ERROR("Error updating firewall keyword " << keywordId << ": " << e.what());
+        return false;
+    }
+}
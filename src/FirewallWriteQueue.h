@@ -0,0 +1,142 @@
+#ifndef FIREWALLWRITEQUEUE_H
+#define FIREWALLWRITEQUEUE_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <unordered_set>
+#include <memory>
+#include <functional>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+class CancellationToken;
+
+/**
+ * @brief Write-rate governor and coalescing queue in front of FirewallManager
+ *
+ * Keeps bursts of firewall writes (a CDN rotating at boot, a mass import)
+ * from reaching the filter engine faster than a configured rate:
+ *
+ * - Writes spend tokens from a bucket that refills at the configured
+ *   operations per second and holds up to the burst allowance.
+ * - Keyword updates wait in a FIFO queue. An update to a keyword that is
+ *   already queued replaces the queued addresses, so only the latest set
+ *   is written; both callers receive the outcome of that write.
+ * - Writes to one keyword never overlap. An update for a keyword whose
+ *   write is still running stays queued, collecting later updates, until
+ *   that write completes; updates for other keywords pass it.
+ * - Other bulk operations (creating or deleting keywords and rules) wait
+ *   for a token with Throttle().
+ * - User-initiated operations bypass the queue. ChargeUrgent() takes their
+ *   tokens without waiting, so later queued writes make up for them.
+ *
+ * There is no worker thread: each caller performs its own write once it
+ * reaches the head of the queue and a token is available. With a rate of
+ * zero every call goes straight to FirewallManager.
+ *
+ * An update given a cancellation token leaves the queue when the token is
+ * cancelled before its write starts; updates that were merged into it see
+ * it fail.
+ */
+class FirewallWriteQueue {
+public:
+    /**
+     * @brief Operation counts since startup
+     */
+    struct Stats {
+        uint64_t queued;       // Keyword updates that entered the queue
+        uint64_t coalesced;    // Updates merged into one already queued for the same keyword
+        uint64_t applied;      // Queued updates written to the firewall
+        uint64_t failed;       // Queued updates the firewall rejected
+        uint64_t cancelled;    // Queued updates abandoned before their write
+        uint64_t throttled;    // Other operations that waited for a token
+        uint64_t urgent;       // Operations that bypassed the queue
+        size_t pending;        // Updates waiting now
+        size_t maxPending;     // Deepest backlog seen
+    };
+
+    /**
+     * @brief Set the write rate
+     * @param opsPerSecond Sustained firewall operations per second, 0 for no limit
+     * @param burst Operations that may be issued at once after an idle period
+     */
+    static void Configure(double opsPerSecond, double burst);
+
+    /**
+     * @brief Replace the addresses of a dynamic keyword through the queue
+     *
+     * Blocks until the write (or the later one it was merged into) is done,
+     * or until cancelled.
+     * @param keywordId GUID of the keyword address
+     * @param ips New IP addresses
+     * @param cancel Token that abandons the wait when cancelled, or nullptr
+     * @return true if the firewall accepted the write; false if it failed
+     *         or was cancelled before it started
+     */
+    static bool Update(const std::string& keywordId, const std::vector<std::string>& ips,
+                       const CancellationToken* cancel = nullptr);
+
+    /**
+     * @brief Wait until the rate allows more operations
+     * @param operations Number of operations about to be issued
+     */
+    static void Throttle(size_t operations = 1);
+
+    /**
+     * @brief Account for operations issued without waiting (user-initiated)
+     * @param operations Number of operations issued
+     */
+    static void ChargeUrgent(size_t operations = 1);
+
+    /**
+     * @brief Current operation counts
+     */
+    static Stats GetStats();
+
+    /**
+     * @brief Check whether a write rate is configured
+     */
+    static bool IsLimited();
+
+private:
+    /**
+     * @brief Shared by every caller whose update was merged into one queued write
+     */
+    struct Outcome {
+        bool done;
+        bool applied;
+
+        Outcome() : done(false), applied(false) {}
+    };
+
+    struct Entry {
+        std::vector<std::string> ips;
+        std::shared_ptr<Outcome> outcome;
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    static void Refill(Clock::time_point now);
+    static bool WaitForToken(std::unique_lock<std::mutex>& lock, const std::function<bool()>& myTurn,
+                             const CancellationToken* cancel = nullptr);
+    static bool Apply(const std::string& keywordId, const std::vector<std::string>& ips);
+    static bool IsNext(const std::string& keywordId);
+
+    static std::mutex queueMutex;
+    static std::condition_variable queueChanged;
+    static std::unordered_map<std::string, Entry> entries;   // Keyword -> queued update
+    static std::deque<std::string> order;                    // Queued keywords, oldest first
+    static std::unordered_set<std::string> inFlight;         // Keywords being written now
+    static double ratePerSecond;
+    static double burstSize;
+    static double tokens;
+    static Clock::time_point lastRefill;
+    static Stats stats;
+};
+
+#endif // FIREWALLWRITEQUEUE_H
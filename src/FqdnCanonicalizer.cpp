@@ -0,0 +1,245 @@
+#include "FqdnCanonicalizer.h"
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FQDN_CANONICALIZER_SSE2 1
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define FQDN_CANONICALIZER_NEON 1
+#include <arm_neon.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+
+// Dots are recorded before labels are checked, so every character may be one
+const size_t kMaxDots = FqdnCanonicalizer::MaxLength;
+
+#ifdef FQDN_CANONICALIZER_SSE2
+unsigned LowestBit(uint32_t bits) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, bits);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctz(bits));
+#endif
+}
+#endif
+
+bool IsNameCharacter(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '-' || c == '_';
+}
+
+/**
+ * @brief Lowercase and classify input[from, to) one byte at a time
+ * @return false at the first character that is never allowed
+ */
+bool ScalarRange(std::string_view input, char* out, size_t from, size_t to,
+                 size_t* dots, size_t& dotCount, bool& nonAscii) {
+    for (size_t i = from; i < to; i++) {
+        unsigned char c = static_cast<unsigned char>(input[i]);
+        if (c >= 'A' && c <= 'Z') {
+            c = static_cast<unsigned char>(c | 0x20);
+        }
+        out[i] = static_cast<char>(c);
+
+        if (c >= 0x80) {
+            nonAscii = true;
+        }
+        else if (c == '.') {
+            dots[dotCount++] = i;
+        }
+        else if (!IsNameCharacter(c)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+FqdnCanonicalizer::Status FqdnCanonicalizer::Canonicalize(std::string_view input, char* out, size_t& length) {
+    length = 0;
+    if (!input.empty() && input.back() == '.') {
+        input.remove_suffix(1);
+    }
+    if (input.empty()) {
+        return Status::Empty;
+    }
+    if (input.size() > MaxLength) {
+        return Status::TooLong;
+    }
+
+    const size_t size = input.size();
+    size_t dots[kMaxDots];
+    size_t dotCount = 0;
+    bool nonAscii = false;
+    size_t i = 0;
+
+#if defined(FQDN_CANONICALIZER_SSE2)
+    const __m128i beforeUpper = _mm_set1_epi8('A' - 1);
+    const __m128i afterUpper = _mm_set1_epi8('Z' + 1);
+    const __m128i beforeLower = _mm_set1_epi8('a' - 1);
+    const __m128i afterLower = _mm_set1_epi8('z' + 1);
+    const __m128i beforeDigit = _mm_set1_epi8('0' - 1);
+    const __m128i afterDigit = _mm_set1_epi8('9' + 1);
+    const __m128i caseBit = _mm_set1_epi8(0x20);
+    const __m128i hyphen = _mm_set1_epi8('-');
+    const __m128i underscore = _mm_set1_epi8('_');
+    const __m128i dot = _mm_set1_epi8('.');
+
+    for (; i + 16 <= size; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input.data() + i));
+
+        // Signed compares: bytes >= 0x80 are negative and fall in no range
+        __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(bytes, beforeUpper), _mm_cmplt_epi8(bytes, afterUpper));
+        bytes = _mm_or_si128(bytes, _mm_and_si128(upper, caseBit));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), bytes);
+
+        __m128i dots16 = _mm_cmpeq_epi8(bytes, dot);
+        __m128i legal = _mm_or_si128(
+            _mm_and_si128(_mm_cmpgt_epi8(bytes, beforeLower), _mm_cmplt_epi8(bytes, afterLower)),
+            _mm_and_si128(_mm_cmpgt_epi8(bytes, beforeDigit), _mm_cmplt_epi8(bytes, afterDigit)));
+        legal = _mm_or_si128(legal, _mm_or_si128(_mm_cmpeq_epi8(bytes, hyphen), _mm_cmpeq_epi8(bytes, underscore)));
+        legal = _mm_or_si128(legal, dots16);
+
+        uint32_t high = static_cast<uint32_t>(_mm_movemask_epi8(bytes));
+        uint32_t illegal = ~static_cast<uint32_t>(_mm_movemask_epi8(legal)) & 0xFFFFu & ~high;
+        if (illegal != 0) {
+            return Status::InvalidCharacter;
+        }
+        nonAscii = nonAscii || high != 0;
+
+        for (uint32_t bits = static_cast<uint32_t>(_mm_movemask_epi8(dots16)); bits != 0; bits &= bits - 1) {
+            dots[dotCount++] = i + LowestBit(bits);
+        }
+    }
+#elif defined(FQDN_CANONICALIZER_NEON)
+    const uint8x16_t beforeUpper = vdupq_n_u8('A' - 1);
+    const uint8x16_t afterUpper = vdupq_n_u8('Z' + 1);
+    const uint8x16_t beforeLower = vdupq_n_u8('a' - 1);
+    const uint8x16_t afterLower = vdupq_n_u8('z' + 1);
+    const uint8x16_t beforeDigit = vdupq_n_u8('0' - 1);
+    const uint8x16_t afterDigit = vdupq_n_u8('9' + 1);
+    const uint8x16_t caseBit = vdupq_n_u8(0x20);
+    const uint8x16_t highBit = vdupq_n_u8(0x80);
+
+    for (; i + 16 <= size; i += 16) {
+        uint8x16_t bytes = vld1q_u8(reinterpret_cast<const uint8_t*>(input.data() + i));
+
+        // Unsigned compares: bytes >= 0x80 lie above every range
+        uint8x16_t upper = vandq_u8(vcgtq_u8(bytes, beforeUpper), vcltq_u8(bytes, afterUpper));
+        bytes = vorrq_u8(bytes, vandq_u8(upper, caseBit));
+        vst1q_u8(reinterpret_cast<uint8_t*>(out + i), bytes);
+
+        uint8x16_t dots16 = vceqq_u8(bytes, vdupq_n_u8('.'));
+        uint8x16_t high = vcgeq_u8(bytes, highBit);
+        uint8x16_t legal = vorrq_u8(
+            vandq_u8(vcgtq_u8(bytes, beforeLower), vcltq_u8(bytes, afterLower)),
+            vandq_u8(vcgtq_u8(bytes, beforeDigit), vcltq_u8(bytes, afterDigit)));
+        legal = vorrq_u8(legal, vorrq_u8(vceqq_u8(bytes, vdupq_n_u8('-')), vceqq_u8(bytes, vdupq_n_u8('_'))));
+        legal = vorrq_u8(legal, vorrq_u8(dots16, high));
+        if (vminvq_u8(legal) == 0) {
+            return Status::InvalidCharacter;
+        }
+        nonAscii = nonAscii || vmaxvq_u8(high) != 0;
+
+        // Four bits per byte, then walk the set nibbles
+        uint64_t bits = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(dots16), 4)), 0);
+        for (size_t b = 0; bits != 0; b++, bits >>= 4) {
+            if (bits & 0xF) {
+                dots[dotCount++] = i + b;
+            }
+        }
+    }
+#endif
+
+    if (!ScalarRange(input, out, i, size, dots, dotCount, nonAscii)) {
+        return Status::InvalidCharacter;
+    }
+    length = size;
+
+    Status status = ValidateLabels(out, size, dots, dotCount);
+    if (status != Status::Ok) {
+        return status;
+    }
+    return nonAscii ? Status::NeedsPunycode : Status::Ok;
+}
+
+FqdnCanonicalizer::Status FqdnCanonicalizer::CanonicalizeScalar(std::string_view input, char* out, size_t& length) {
+    length = 0;
+    if (!input.empty() && input.back() == '.') {
+        input.remove_suffix(1);
+    }
+    if (input.empty()) {
+        return Status::Empty;
+    }
+    if (input.size() > MaxLength) {
+        return Status::TooLong;
+    }
+
+    size_t dots[kMaxDots];
+    size_t dotCount = 0;
+    bool nonAscii = false;
+    if (!ScalarRange(input, out, 0, input.size(), dots, dotCount, nonAscii)) {
+        return Status::InvalidCharacter;
+    }
+    length = input.size();
+
+    Status status = ValidateLabels(out, input.size(), dots, dotCount);
+    if (status != Status::Ok) {
+        return status;
+    }
+    return nonAscii ? Status::NeedsPunycode : Status::Ok;
+}
+
+FqdnCanonicalizer::Status FqdnCanonicalizer::Canonicalize(std::string_view input, std::string& canonical) {
+    char buffer[MaxLength];
+    size_t length = 0;
+    Status status = Canonicalize(input, buffer, length);
+    if (status == Status::Ok) {
+        canonical.assign(buffer, length);
+    }
+    else {
+        canonical.clear();
+    }
+    return status;
+}
+
+FqdnCanonicalizer::Status FqdnCanonicalizer::ValidateLabels(const char* name, size_t length,
+                                                            const size_t* dots, size_t dotCount) {
+    size_t start = 0;
+    for (size_t d = 0; d <= dotCount; d++) {
+        size_t end = d < dotCount ? dots[d] : length;
+        size_t labelLength = end - start;
+        if (labelLength == 0) {
+            return Status::EmptyLabel;
+        }
+        if (labelLength > MaxLabelLength) {
+            return Status::LabelTooLong;
+        }
+        if (name[start] == '-' || name[end - 1] == '-') {
+            return Status::HyphenAtLabelEdge;
+        }
+        start = end + 1;
+    }
+    return Status::Ok;
+}
+
+const char* FqdnCanonicalizer::Describe(Status status) {
+    switch (status) {
+    case Status::Ok: return "valid";
+    case Status::Empty: return "empty name";
+    case Status::TooLong: return "name longer than 253 characters";
+    case Status::EmptyLabel: return "empty label (leading or repeated dot)";
+    case Status::LabelTooLong: return "label longer than 63 characters";
+    case Status::HyphenAtLabelEdge: return "label starts or ends with '-'";
+    case Status::InvalidCharacter: return "invalid character (allowed: letters, digits, '-', '_', '.')";
+    case Status::NeedsPunycode: return "internationalized name; give it in punycode (xn--...)";
+    }
+    return "unknown";
+}
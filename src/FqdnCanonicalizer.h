@@ -0,0 +1,79 @@
+#ifndef FQDNCANONICALIZER_H
+#define FQDNCANONICALIZER_H
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+
+/**
+ * @brief Canonical form and validation of FQDNs entering the tool
+ *
+ * Every name a user or a list supplies goes through Canonicalize() before
+ * it reaches the resolver, the firewall or the audit store, so
+ * "Example.COM." and "example.com" are the same record. The canonical form
+ * is lowercase ASCII without a trailing dot. A valid name:
+ *
+ * - is 1 to 253 characters long (one trailing dot is not counted),
+ * - consists of labels of 1 to 63 characters separated by single dots,
+ * - uses only letters, digits, '-' and '_' (service labels such as
+ *   _dmarc), with no label starting or ending in '-'.
+ *
+ * Bytes outside ASCII mark an internationalized (IDN) name. Those are not
+ * converted here; Canonicalize() reports NeedsPunycode so the caller can
+ * ask for the xn-- form.
+ *
+ * Sixteen bytes are lowercased and classified at a time with SSE2 (x86) or
+ * NEON (ARM); other targets use the scalar reference implementation, which
+ * also handles the tail of each name.
+ */
+class FqdnCanonicalizer {
+public:
+    enum class Status {
+        Ok,
+        Empty,              // Nothing but an optional trailing dot
+        TooLong,            // More than MaxLength characters
+        EmptyLabel,         // Leading dot or two dots in a row
+        LabelTooLong,       // A label longer than MaxLabelLength
+        HyphenAtLabelEdge,  // A label starting or ending with '-'
+        InvalidCharacter,   // A character other than letter, digit, '-', '_' or '.'
+        NeedsPunycode       // Otherwise valid, with non-ASCII (IDN) labels
+    };
+
+    static const size_t MaxLength = 253;
+    static const size_t MaxLabelLength = 63;
+
+    /**
+     * @brief Canonicalize a name into a caller-supplied buffer
+     * @param input Name as given
+     * @param out Buffer of at least MaxLength bytes
+     * @param length Length of the lowercased name in out (not NUL-terminated);
+     *               0 if the name was rejected before it was fully read
+     * @return Ok if the name is valid
+     */
+    static Status Canonicalize(std::string_view input, char* out, size_t& length);
+
+    /**
+     * @brief Canonicalize a name into a string
+     * @param input Name as given
+     * @param canonical Canonical form; left empty unless the status is Ok
+     * @return Ok if the name is valid
+     */
+    static Status Canonicalize(std::string_view input, std::string& canonical);
+
+    /**
+     * @brief Same result as Canonicalize(), one byte at a time
+     *
+     * The reference the vector path must agree with; exposed for the benchmark.
+     */
+    static Status CanonicalizeScalar(std::string_view input, char* out, size_t& length);
+
+    /**
+     * @brief Human-readable reason for a status
+     */
+    static const char* Describe(Status status);
+
+private:
+    static Status ValidateLabels(const char* name, size_t length, const size_t* dots, size_t dotCount);
+};
+
+#endif // FQDNCANONICALIZER_H
@@ -0,0 +1,37 @@
+#include "Log.h"
+#include <iostream>
+#include <mutex>
+
+namespace {
+
+std::mutex writeMutex;
+
+} // namespace
+
+// Initialize static members
+std::atomic<int> Log::threshold(static_cast<int>(LogLevel::Info));
+
+void Log::SetLevel(LogLevel level) {
+    threshold.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+LogLevel Log::GetLevel() {
+    return static_cast<LogLevel>(threshold.load(std::memory_order_relaxed));
+}
+
+void Log::Write(LogLevel level, const std::string& message) {
+    std::lock_guard<std::mutex> lock(writeMutex);
+
+    if (level >= LogLevel::Warning) {
+        // std::cerr is tied to std::cout, so pending stdout lines come out first
+        std::cerr << message << '\n';
+    }
+    else {
+        std::cout << message << '\n';
+    }
+}
+
+void Log::Flush() {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    std::cout.flush();
+}
@@ -0,0 +1,107 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <string>
+#include <sstream>
+#include <atomic>
+
+/**
+ * @brief Compile-time log threshold
+ *
+ * Levels below this value are removed by the preprocessor, including the
+ * evaluation of their arguments: 0 = debug (default), 1 = info,
+ * 2 = warning, 3 = error. Set with -DFQDN_LOG_MIN_LEVEL=<n> in CMake.
+ */
+#ifndef FQDN_LOG_MIN_LEVEL
+#define FQDN_LOG_MIN_LEVEL 0
+#endif
+
+enum class LogLevel {
+    Debug = 0,     // Per-FQDN and per-address detail (--verbose)
+    Info = 1,      // Lifecycle and batch summaries (default)
+    Warning = 2,   // Recoverable problems (--quiet shows warnings and errors)
+    Error = 3
+};
+
+/**
+ * @brief Leveled console logging for components
+ *
+ * Debug and info lines go to stdout without flushing, so a large refresh
+ * does not pay for one console write per line; warnings and errors go to
+ * stderr, which flushes pending stdout first so ordering is preserved.
+ * Lines from concurrent workers are never interleaved.
+ *
+ * Use the LOG_* macros rather than Write(): a disabled level costs one
+ * relaxed load, and a level below FQDN_LOG_MIN_LEVEL costs nothing.
+ */
+class Log {
+public:
+    /**
+     * @brief Set the lowest level that is printed
+     * @param level Runtime threshold
+     */
+    static void SetLevel(LogLevel level);
+
+    /**
+     * @brief Get the runtime threshold
+     * @return Lowest level that is printed
+     */
+    static LogLevel GetLevel();
+
+    /**
+     * @brief Check whether a level is printed
+     * @param level Level to check
+     * @return true if messages at this level are printed
+     */
+    static bool IsEnabled(LogLevel level) {
+        return static_cast<int>(level) >= threshold.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Print one line
+     * @param level Level of the message
+     * @param message Message text without trailing newline
+     */
+    static void Write(LogLevel level, const std::string& message);
+
+    /**
+     * @brief Push buffered output to the console
+     */
+    static void Flush();
+
+private:
+    static std::atomic<int> threshold;
+};
+
+#define FQDN_LOG_AT(level, expr)                         \
+    do {                                                 \
+        if (Log::IsEnabled(level)) {                     \
+            std::ostringstream fqdnLogLine;              \
+            fqdnLogLine << expr;                         \
+            Log::Write(level, fqdnLogLine.str());        \
+        }                                                \
+    } while (0)
+
+#define FQDN_LOG_DISABLED() do {} while (0)
+
+#if FQDN_LOG_MIN_LEVEL <= 0
+#define LOG_DEBUG(expr) FQDN_LOG_AT(LogLevel::Debug, expr)
+#else
+#define LOG_DEBUG(expr) FQDN_LOG_DISABLED()
+#endif
+
+#if FQDN_LOG_MIN_LEVEL <= 1
+#define LOG_INFO(expr) FQDN_LOG_AT(LogLevel::Info, expr)
+#else
+#define LOG_INFO(expr) FQDN_LOG_DISABLED()
+#endif
+
+#if FQDN_LOG_MIN_LEVEL <= 2
+#define LOG_WARNING(expr) FQDN_LOG_AT(LogLevel::Warning, expr)
+#else
+#define LOG_WARNING(expr) FQDN_LOG_DISABLED()
+#endif
+
+#define LOG_ERROR(expr) FQDN_LOG_AT(LogLevel::Error, expr)
+
+#endif // LOG_H
@@ -0,0 +1,200 @@
+#include "Metrics.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+// Initialize static members
+std::map<std::string, Metrics::Family> Metrics::families;
+std::mutex Metrics::registryMutex;
+std::thread Metrics::exporterThread;
+std::atomic<bool> Metrics::exporterRunning(false);
+std::mutex Metrics::exporterMutex;
+std::condition_variable Metrics::exporterCv;
+
+// Histogram implementation
+Histogram::Histogram(const std::vector<double>& bounds)
+    : bounds(bounds), buckets(new std::atomic<uint64_t>[bounds.size() + 1]), count(0), sumNs(0) {
+    for (size_t i = 0; i <= bounds.size(); i++) {
+        buckets[i].store(0, std::memory_order_relaxed);
+    }
+    for (double bound : bounds) {
+        boundsNs.push_back(static_cast<uint64_t>(bound * 1e9));
+    }
+}
+
+void Histogram::ObserveNanoseconds(uint64_t nanoseconds) {
+    size_t index = 0;
+    while (index < boundsNs.size() && nanoseconds > boundsNs[index]) {
+        index++;
+    }
+
+    buckets[index].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    sumNs.fetch_add(nanoseconds, std::memory_order_relaxed);
+}
+
+void Histogram::ObserveSeconds(double seconds) {
+    ObserveNanoseconds(seconds > 0 ? static_cast<uint64_t>(seconds * 1e9) : 0);
+}
+
+void Histogram::ObserveSince(std::chrono::steady_clock::time_point start) {
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    ObserveNanoseconds(static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+}
+
+uint64_t Histogram::BucketCount(size_t index) const {
+    return buckets[index].load(std::memory_order_relaxed);
+}
+
+uint64_t Histogram::Count() const {
+    return count.load(std::memory_order_relaxed);
+}
+
+double Histogram::SumSeconds() const {
+    return sumNs.load(std::memory_order_relaxed) / 1e9;
+}
+
+// Metrics implementation
+const std::vector<double>& Metrics::LatencyBuckets() {
+    static const std::vector<double> bounds = {
+        0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05,
+        0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60
+    };
+    return bounds;
+}
+
+Metrics::Family& Metrics::GetFamily(const std::string& name, const std::string& help, const std::string& type) {
+    Family& family = families[name];
+    if (family.type.empty()) {
+        family.help = help;
+        family.type = type;
+    }
+    return family;
+}
+
+Counter& Metrics::GetCounter(const std::string& name, const std::string& help, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    auto& slot = GetFamily(name, help, "counter").counters[labels];
+    if (!slot) {
+        slot.reset(new Counter());
+    }
+    return *slot;
+}
+
+Gauge& Metrics::GetGauge(const std::string& name, const std::string& help, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    auto& slot = GetFamily(name, help, "gauge").gauges[labels];
+    if (!slot) {
+        slot.reset(new Gauge());
+    }
+    return *slot;
+}
+
+Histogram& Metrics::GetHistogram(const std::string& name, const std::string& help,
+                                 const std::string& labels, const std::vector<double>& bounds) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    auto& slot = GetFamily(name, help, "histogram").histograms[labels];
+    if (!slot) {
+        slot.reset(new Histogram(bounds));
+    }
+    return *slot;
+}
+
+std::string Metrics::Expose() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    std::ostringstream out;
+
+    for (const auto& entry : families) {
+        const std::string& name = entry.first;
+        const Family& family = entry.second;
+
+        out << "# HELP " << name << " " << family.help << "\n";
+        out << "# TYPE " << name << " " << family.type << "\n";
+
+        for (const auto& counter : family.counters) {
+            out << name << (counter.first.empty() ? "" : "{" + counter.first + "}")
+                << " " << counter.second->Value() << "\n";
+        }
+
+        for (const auto& gauge : family.gauges) {
+            out << name << (gauge.first.empty() ? "" : "{" + gauge.first + "}")
+                << " " << gauge.second->Value() << "\n";
+        }
+
+        for (const auto& histogram : family.histograms) {
+            const std::string prefix = histogram.first.empty() ? "" : histogram.first + ",";
+            const Histogram& h = *histogram.second;
+
+            uint64_t cumulative = 0;
+            for (size_t i = 0; i < h.Bounds().size(); i++) {
+                cumulative += h.BucketCount(i);
+                out << name << "_bucket{" << prefix << "le=\"" << h.Bounds()[i] << "\"} " << cumulative << "\n";
+            }
+            cumulative += h.BucketCount(h.Bounds().size());
+            out << name << "_bucket{" << prefix << "le=\"+Inf\"} " << cumulative << "\n";
+
+            const std::string labelSet = histogram.first.empty() ? "" : "{" + histogram.first + "}";
+            out << name << "_sum" << labelSet << " " << h.SumSeconds() << "\n";
+            out << name << "_count" << labelSet << " " << h.Count() << "\n";
+        }
+    }
+
+    return out.str();
+}
+
+bool Metrics::WriteFile(const std::string& path) {
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::trunc);
+        if (!file.is_open()) {
+            std::cerr << "Failed to open metrics file for writing: " << tempPath << std::endl;
+            return false;
+        }
+        file << Expose();
+    }
+
+    // Readers never observe a partially written file
+    std::remove(path.c_str());
+    return std::rename(tempPath.c_str(), path.c_str()) == 0;
+}
+
+void Metrics::StartExporter(const std::string& path, int intervalSeconds) {
+    if (path.empty() || exporterRunning) {
+        return;
+    }
+
+    exporterRunning = true;
+    exporterThread = std::thread(ExporterLoop, path, intervalSeconds > 0 ? intervalSeconds : 15);
+    std::cout << "Metrics exported to " << path << " every " << intervalSeconds << " second(s)" << std::endl;
+}
+
+void Metrics::StopExporter() {
+    if (!exporterRunning) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(exporterMutex);
+        exporterRunning = false;
+    }
+    exporterCv.notify_all();
+
+    if (exporterThread.joinable()) {
+        exporterThread.join();
+    }
+}
+
+void Metrics::ExporterLoop(std::string path, int intervalSeconds) {
+    std::unique_lock<std::mutex> lock(exporterMutex);
+
+    while (exporterRunning) {
+        exporterCv.wait_for(lock, std::chrono::seconds(intervalSeconds),
+                            []() { return !exporterRunning.load(); });
+
+        lock.unlock();
+        WriteFile(path);
+        lock.lock();
+    }
+}
@@ -0,0 +1,209 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+
+/**
+ * @brief Monotonically increasing counter
+ */
+class Counter {
+public:
+    Counter() : value(0) {}
+
+    void Increment(uint64_t amount = 1) {
+        value.fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    uint64_t Value() const {
+        return value.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint64_t> value;
+};
+
+/**
+ * @brief Value that can go up and down
+ */
+class Gauge {
+public:
+    Gauge() : value(0) {}
+
+    void Set(int64_t newValue) {
+        value.store(newValue, std::memory_order_relaxed);
+    }
+
+    void Add(int64_t amount) {
+        value.fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    int64_t Value() const {
+        return value.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<int64_t> value;
+};
+
+/**
+ * @brief Fixed-bucket histogram of durations
+ *
+ * Recording a sample is a short scan over the bucket bounds plus three
+ * relaxed atomic increments; there is no locking on the hot path.
+ */
+class Histogram {
+public:
+    /**
+     * @brief Construct a histogram
+     * @param bounds Ascending upper bounds of the buckets, in seconds
+     */
+    explicit Histogram(const std::vector<double>& bounds);
+
+    /**
+     * @brief Record a duration
+     * @param nanoseconds Duration in nanoseconds
+     */
+    void ObserveNanoseconds(uint64_t nanoseconds);
+
+    /**
+     * @brief Record a value in seconds
+     * @param seconds Value in seconds
+     */
+    void ObserveSeconds(double seconds);
+
+    /**
+     * @brief Record the time elapsed since a start point
+     * @param start Start of the measured operation
+     */
+    void ObserveSince(std::chrono::steady_clock::time_point start);
+
+    const std::vector<double>& Bounds() const { return bounds; }
+    uint64_t BucketCount(size_t index) const;   // Non-cumulative; index == Bounds().size() is +Inf
+    uint64_t Count() const;
+    double SumSeconds() const;
+
+private:
+    std::vector<double> bounds;
+    std::vector<uint64_t> boundsNs;
+    std::unique_ptr<std::atomic<uint64_t>[]> buckets;
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sumNs;
+};
+
+/**
+ * @brief RAII helper that records the lifetime of a scope into a histogram
+ */
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Histogram& histogram)
+        : histogram(histogram), start(std::chrono::steady_clock::now()) {}
+
+    ~ScopedTimer() {
+        histogram.ObserveSince(start);
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    Histogram& histogram;
+    std::chrono::steady_clock::time_point start;
+};
+
+/**
+ * @brief Process-wide metrics registry with text exposition
+ *
+ * Metrics are registered once (typically into a function-local static
+ * reference at the instrumentation site) and then updated lock-free.
+ * The registry renders all metrics in the Prometheus text exposition
+ * format, either on demand (`metrics` command) or periodically to a file
+ * suitable for a node_exporter textfile collector.
+ */
+class Metrics {
+public:
+    /**
+     * @brief Get or create a counter
+     * @param name Metric name
+     * @param help Help text
+     * @param labels Optional label set, e.g. `op="update"`
+     * @return Counter that lives for the rest of the process
+     */
+    static Counter& GetCounter(const std::string& name, const std::string& help,
+                               const std::string& labels = "");
+
+    /**
+     * @brief Get or create a gauge
+     * @param name Metric name
+     * @param help Help text
+     * @param labels Optional label set
+     * @return Gauge that lives for the rest of the process
+     */
+    static Gauge& GetGauge(const std::string& name, const std::string& help,
+                           const std::string& labels = "");
+
+    /**
+     * @brief Get or create a histogram
+     * @param name Metric name
+     * @param help Help text
+     * @param labels Optional label set
+     * @param bounds Bucket upper bounds in seconds (defaults to LatencyBuckets())
+     * @return Histogram that lives for the rest of the process
+     */
+    static Histogram& GetHistogram(const std::string& name, const std::string& help,
+                                   const std::string& labels = "",
+                                   const std::vector<double>& bounds = LatencyBuckets());
+
+    /**
+     * @brief Default buckets for operation latencies (100us .. 60s)
+     */
+    static const std::vector<double>& LatencyBuckets();
+
+    /**
+     * @brief Render all metrics in text exposition format
+     * @return Exposition text
+     */
+    static std::string Expose();
+
+    /**
+     * @brief Periodically write the exposition text to a file
+     * @param path Output file (written atomically via a temporary file)
+     * @param intervalSeconds Seconds between writes
+     */
+    static void StartExporter(const std::string& path, int intervalSeconds);
+
+    /**
+     * @brief Stop the periodic exporter after a final write
+     */
+    static void StopExporter();
+
+private:
+    struct Family {
+        std::string help;
+        std::string type;
+        std::map<std::string, std::unique_ptr<Counter>> counters;
+        std::map<std::string, std::unique_ptr<Gauge>> gauges;
+        std::map<std::string, std::unique_ptr<Histogram>> histograms;
+    };
+
+    static Family& GetFamily(const std::string& name, const std::string& help, const std::string& type);
+    static bool WriteFile(const std::string& path);
+    static void ExporterLoop(std::string path, int intervalSeconds);
+
+    static std::map<std::string, Family> families;
+    static std::mutex registryMutex;
+    static std::thread exporterThread;
+    static std::atomic<bool> exporterRunning;
+    static std::mutex exporterMutex;
+    static std::condition_variable exporterCv;
+};
+
+#endif // METRICS_H
@@ -0,0 +1,774 @@
+#include "PassiveDnsIngest.h"
+#include "AuditLogger.h"
+#include "DnsMessage.h"
+#include "FirewallWriteQueue.h"
+#include "FqdnCanonicalizer.h"
+#include "Log.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+const size_t kReadChunkBytes = 1024 * 1024;
+const size_t kMaxPendingObservations = 256 * 1024;
+const size_t kMaxNameLength = 255;
+const int kMaxCnameChain = 8;
+const int kMaxCompressionJumps = 16;
+const size_t kMaxLogTokens = 16;
+
+const uint16_t kDnsPort = 53;
+const uint16_t kTypeCname = 5;
+
+// pcap link-layer types
+const uint32_t kLinkNull = 0;
+const uint32_t kLinkEthernet = 1;
+const uint32_t kLinkRaw = 101;
+const uint32_t kLinkRawAlt = 12;
+const uint32_t kLinkRawAltOpenBsd = 14;
+const uint32_t kLinkLoop = 108;
+const uint32_t kLinkLinuxSll = 113;
+const uint32_t kLinkIpv4 = 228;
+const uint32_t kLinkIpv6 = 229;
+const uint32_t kLinkLinuxSll2 = 276;
+
+Counter& EventCounter(const char* event) {
+    return Metrics::GetCounter("fqdn_passive_dns_total",
+        "Passive DNS answers and merged addresses by outcome", std::string("event=\"") + event + "\"");
+}
+
+uint16_t Read16(const uint8_t* data) {
+    return static_cast<uint16_t>((data[0] << 8) | data[1]);
+}
+
+uint32_t ReadPcap32(const uint8_t* data, bool swapped) {
+    uint32_t value;
+    std::memcpy(&value, data, 4);
+    if (swapped) {
+        value = ((value & 0xFF) << 24) | ((value & 0xFF00) << 8) | ((value >> 8) & 0xFF00) | (value >> 24);
+    }
+    return value;
+}
+
+bool SameName(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        char x = a[i];
+        char y = b[i];
+        if (x != y && ((x | 0x20) != (y | 0x20) || (x | 0x20) < 'a' || (x | 0x20) > 'z')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief A name held in canonical form without allocating
+ */
+struct NameBuffer {
+    char text[FqdnCanonicalizer::MaxLength];
+    size_t length;
+
+    NameBuffer() : length(0) {}
+
+    void Set(std::string_view name) {
+        FqdnCanonicalizer::Status status = FqdnCanonicalizer::Canonicalize(name, text, length);
+        if (status != FqdnCanonicalizer::Status::Ok && status != FqdnCanonicalizer::Status::NeedsPunycode) {
+            length = 0;
+        }
+    }
+
+    std::string_view View() const { return std::string_view(text, length); }
+};
+
+/**
+ * @brief Collects observations for blocked names and merges them in batches
+ */
+class Ingestor {
+public:
+    Ingestor(const PassiveDnsIngest::Options& options, PassiveDnsIngest::Stats& stats)
+        : options(options), stats(stats), snapshot(AuditLogger::Snapshot()),
+          now(std::time(nullptr)), pendingObservations(0) {}
+
+    /**
+     * @brief Record that a resolver answered a name with an address
+     */
+    void Observe(std::string_view name, const uint8_t* address, size_t size, std::time_t seenAt) {
+        static Counter& matchedTotal = EventCounter("matched");
+        static Counter& staleTotal = EventCounter("stale");
+
+        char canonical[FqdnCanonicalizer::MaxLength];
+        size_t length = 0;
+        if (FqdnCanonicalizer::Canonicalize(name, canonical, length) != FqdnCanonicalizer::Status::Ok) {
+            return;
+        }
+        RecordStore::Slot slot = snapshot->store.Find(std::string_view(canonical, length));
+        if (slot == RecordStore::InvalidSlot) {
+            return;
+        }
+
+        stats.matched++;
+        matchedTotal.Increment();
+        seenAt = std::min(seenAt, now);
+        if (options.graceSeconds > 0 && now - seenAt >= options.graceSeconds) {
+            // Would expire at the next refresh anyway
+            stats.stale++;
+            staleTotal.Increment();
+            return;
+        }
+
+        Pending& entry = pending[slot];
+        if (entry.fqdn.empty()) {
+            entry.fqdn.assign(canonical, length);
+        }
+        for (auto& observation : entry.observations) {
+            if (observation.size == size && std::memcmp(observation.bytes, address, size) == 0) {
+                observation.seenAt = std::max(observation.seenAt, seenAt);
+                return;
+            }
+        }
+
+        Observation observation;
+        std::memcpy(observation.bytes, address, size);
+        observation.size = static_cast<uint8_t>(size);
+        observation.seenAt = seenAt;
+        entry.observations.push_back(observation);
+        pendingObservations++;
+
+        if (pending.size() >= options.batchRecords || pendingObservations >= kMaxPendingObservations) {
+            Flush();
+        }
+    }
+
+    /**
+     * @brief Merge everything observed so far into the firewall and the audit store
+     */
+    void Flush() {
+        static Counter& addedTotal = EventCounter("added");
+        static Counter& refreshedTotal = EventCounter("refreshed");
+        static Counter& failedTotal = EventCounter("failed");
+
+        if (pending.empty()) {
+            return;
+        }
+        TraceSpan span("passive_dns_merge", "ingest", std::to_string(pending.size()) + " record(s)");
+
+        // Merge against the latest records; a slot may have been removed or reused meanwhile
+        AuditSnapshotPtr current = AuditLogger::Snapshot();
+        const RecordStore& store = current->store;
+        std::vector<std::pair<std::string, std::vector<std::string>>> updates;
+        std::vector<std::vector<std::time_t>> lastSeen;
+
+        for (auto& item : pending) {
+            Pending& entry = item.second;
+            RecordStore::Slot slot = store.Find(entry.fqdn);
+            if (slot == RecordStore::InvalidSlot) {
+                continue;
+            }
+
+            std::vector<std::string> ips = store.Addresses(slot);
+            std::vector<std::time_t> seen = store.LastSeen(slot);
+            seen.resize(ips.size(), 0);
+            bool changed = false;
+            bool touched = false;
+
+            for (const auto& observation : entry.observations) {
+                std::string ip = DnsMessage::AddressToString(observation.bytes, observation.size);
+                auto it = std::find(ips.begin(), ips.end(), ip);
+                if (it == ips.end()) {
+                    ips.push_back(ip);
+                    seen.push_back(observation.seenAt);
+                    changed = true;
+                    stats.added++;
+                    addedTotal.Increment();
+                    continue;
+                }
+
+                // Addresses in the latest DNS answer (0) need no bookkeeping
+                std::time_t& since = seen[static_cast<size_t>(it - ips.begin())];
+                if (since != 0 && observation.seenAt > since) {
+                    since = observation.seenAt;
+                    touched = true;
+                    stats.refreshed++;
+                    refreshedTotal.Increment();
+                }
+            }
+
+            if (changed && !FirewallWriteQueue::Update(store.KeywordId(slot), ips)) {
+                stats.failed++;
+                failedTotal.Increment();
+                continue;
+            }
+            if (changed || touched) {
+                updates.emplace_back(entry.fqdn, std::move(ips));
+                lastSeen.push_back(std::move(seen));
+            }
+        }
+
+        if (!updates.empty()) {
+            std::vector<bool> written = AuditLogger::UpdateRecords(updates, lastSeen);
+            for (size_t i = 0; i < written.size(); i++) {
+                if (written[i]) {
+                    stats.recordsUpdated++;
+                }
+                else {
+                    LOG_ERROR("Failed to record passive DNS addresses for " << updates[i].first);
+                }
+            }
+            LOG_DEBUG("Passive DNS: merged observations into " << updates.size() << " record(s)");
+        }
+
+        pending.clear();
+        pendingObservations = 0;
+        snapshot = AuditLogger::Snapshot();
+        now = std::time(nullptr);
+    }
+
+    std::time_t Now() const { return now; }
+
+private:
+    struct Observation {
+        uint8_t bytes[16];
+        uint8_t size;
+        std::time_t seenAt;
+    };
+
+    struct Pending {
+        std::string fqdn;
+        std::vector<Observation> observations;
+    };
+
+    const PassiveDnsIngest::Options& options;
+    PassiveDnsIngest::Stats& stats;
+    AuditSnapshotPtr snapshot;
+    std::time_t now;
+    std::unordered_map<RecordStore::Slot, Pending> pending;
+    size_t pendingObservations;
+};
+
+/**
+ * @brief Decode a possibly compressed name into a buffer
+ * @param offset Position of the name; moved past it
+ */
+bool ReadName(const uint8_t* message, size_t size, size_t& offset, char* out, size_t& length) {
+    size_t position = offset;
+    bool jumped = false;
+    int jumps = 0;
+    length = 0;
+
+    for (;;) {
+        if (position >= size) {
+            return false;
+        }
+        uint8_t labelLength = message[position];
+        if ((labelLength & 0xC0) == 0xC0) {
+            if (position + 1 >= size || ++jumps > kMaxCompressionJumps) {
+                return false;
+            }
+            if (!jumped) {
+                offset = position + 2;
+            }
+            position = (static_cast<size_t>(labelLength & 0x3F) << 8) | message[position + 1];
+            jumped = true;
+            continue;
+        }
+        if ((labelLength & 0xC0) != 0) {
+            return false;
+        }
+        if (labelLength == 0) {
+            if (!jumped) {
+                offset = position + 1;
+            }
+            return true;
+        }
+        if (position + 1 + labelLength > size || length + labelLength + 1 > kMaxNameLength) {
+            return false;
+        }
+        if (length > 0) {
+            out[length++] = '.';
+        }
+        std::memcpy(out + length, message + position + 1, labelLength);
+        length += labelLength;
+        position += 1 + labelLength;
+    }
+}
+
+/**
+ * @brief Walk the answers of one DNS response in place
+ * @return false if the message is malformed
+ */
+bool ParseResponse(const uint8_t* message, size_t size, std::time_t seenAt,
+                   Ingestor& ingestor, PassiveDnsIngest::Stats& stats) {
+    if (size < 12) {
+        return false;
+    }
+    const uint16_t flags = Read16(message + 2);
+    if ((flags & DnsMessage::FlagResponse) == 0 || (flags & 0x000F) != DnsMessage::RcodeNoError) {
+        return true;   // Queries and failed lookups carry no addresses
+    }
+    stats.messages++;
+
+    const uint16_t questions = Read16(message + 4);
+    const uint16_t answers = Read16(message + 6);
+    size_t offset = 12;
+
+    // The question name, then every CNAME target reached from it
+    char chain[kMaxCnameChain][kMaxNameLength];
+    size_t chainLength[kMaxCnameChain];
+    int chainCount = 0;
+    char scratch[kMaxNameLength];
+    size_t scratchLength = 0;
+
+    for (uint16_t q = 0; q < questions; q++) {
+        bool first = q == 0;
+        if (!ReadName(message, size, offset, first ? chain[0] : scratch, first ? chainLength[0] : scratchLength) ||
+            offset + 4 > size) {
+            return false;
+        }
+        offset += 4;
+        chainCount = 1;
+    }
+
+    for (uint16_t a = 0; a < answers; a++) {
+        char owner[kMaxNameLength];
+        size_t ownerLength = 0;
+        if (!ReadName(message, size, offset, owner, ownerLength) || offset + 10 > size) {
+            return false;
+        }
+        const uint16_t type = Read16(message + offset);
+        const uint16_t rrClass = Read16(message + offset + 2);
+        const uint16_t dataLength = Read16(message + offset + 8);
+        offset += 10;
+        if (offset + dataLength > size) {
+            return false;
+        }
+        const uint8_t* data = message + offset;
+        const std::string_view ownerName(owner, ownerLength);
+
+        bool inChain = false;
+        for (int c = 0; c < chainCount && !inChain; c++) {
+            inChain = SameName(ownerName, std::string_view(chain[c], chainLength[c]));
+        }
+
+        if (type == kTypeCname && inChain && chainCount < kMaxCnameChain) {
+            size_t targetOffset = offset;
+            if (ReadName(message, size, targetOffset, chain[chainCount], chainLength[chainCount])) {
+                chainCount++;
+            }
+        }
+        else if (rrClass == DnsMessage::ClassIN &&
+                 ((type == DnsMessage::TypeA && dataLength == 4) || (type == DnsMessage::TypeAAAA && dataLength == 16))) {
+            stats.answers++;
+            ingestor.Observe(ownerName, data, dataLength, seenAt);
+
+            // inChain implies a question was read (chainCount > 0)
+            if (inChain) {
+                const std::string_view question(chain[0], chainLength[0]);
+                if (!SameName(ownerName, question)) {
+                    ingestor.Observe(question, data, dataLength, seenAt);
+                }
+            }
+        }
+        offset += dataLength;
+    }
+    return true;
+}
+
+/**
+ * @brief Find the UDP payload from port 53 in an IP packet
+ */
+void HandleIpPacket(const uint8_t* packet, size_t size, std::time_t seenAt,
+                    Ingestor& ingestor, PassiveDnsIngest::Stats& stats) {
+    if (size < 1) {
+        return;
+    }
+
+    const uint8_t* udp = nullptr;
+    size_t udpSize = 0;
+    const int version = packet[0] >> 4;
+    if (version == 4) {
+        if (size < 20) {
+            return;
+        }
+        size_t headerLength = static_cast<size_t>(packet[0] & 0x0F) * 4;
+        size_t totalLength = std::min<size_t>(Read16(packet + 2), size);
+        if (packet[9] != 17 || (Read16(packet + 6) & 0x3FFF) != 0 ||
+            headerLength < 20 || headerLength > totalLength) {
+            return;   // Not UDP, or a fragment
+        }
+        udp = packet + headerLength;
+        udpSize = totalLength - headerLength;
+    }
+    else if (version == 6) {
+        if (size < 40 || packet[6] != 17) {
+            return;   // Not UDP, or behind extension headers
+        }
+        udp = packet + 40;
+        udpSize = std::min<size_t>(Read16(packet + 4), size - 40);
+    }
+    else {
+        return;
+    }
+
+    if (udpSize < 8 || Read16(udp) != kDnsPort) {
+        return;
+    }
+    size_t datagramLength = std::min<size_t>(Read16(udp + 4), udpSize);
+    if (datagramLength < 8) {
+        return;
+    }
+    if (!ParseResponse(udp + 8, datagramLength - 8, seenAt, ingestor, stats)) {
+        stats.malformed++;
+    }
+}
+
+bool SupportedLinkType(uint32_t linkType) {
+    switch (linkType) {
+    case kLinkNull: case kLinkEthernet: case kLinkRaw: case kLinkRawAlt: case kLinkRawAltOpenBsd:
+    case kLinkLoop: case kLinkLinuxSll: case kLinkIpv4: case kLinkIpv6: case kLinkLinuxSll2:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief Strip the link-layer header of a captured frame
+ */
+void HandleFrame(uint32_t linkType, const uint8_t* frame, size_t size, std::time_t seenAt,
+                 Ingestor& ingestor, PassiveDnsIngest::Stats& stats) {
+    size_t offset = 0;
+    uint16_t etherType = 0;
+
+    switch (linkType) {
+    case kLinkEthernet:
+        if (size < 14) {
+            return;
+        }
+        etherType = Read16(frame + 12);
+        offset = 14;
+        while ((etherType == 0x8100 || etherType == 0x88A8) && size >= offset + 4) {
+            etherType = Read16(frame + offset + 2);   // VLAN tag
+            offset += 4;
+        }
+        if (etherType != 0x0800 && etherType != 0x86DD) {
+            return;
+        }
+        break;
+    case kLinkLinuxSll:
+        if (size < 16) {
+            return;
+        }
+        etherType = Read16(frame + 14);
+        offset = 16;
+        if (etherType != 0x0800 && etherType != 0x86DD) {
+            return;
+        }
+        break;
+    case kLinkLinuxSll2:
+        if (size < 20) {
+            return;
+        }
+        etherType = Read16(frame);
+        offset = 20;
+        if (etherType != 0x0800 && etherType != 0x86DD) {
+            return;
+        }
+        break;
+    case kLinkNull:
+    case kLinkLoop:
+        offset = 4;   // Address family; the IP version nibble tells the rest
+        break;
+    default:
+        break;        // Raw IP
+    }
+
+    if (size > offset) {
+        HandleIpPacket(frame + offset, size - offset, seenAt, ingestor, stats);
+    }
+}
+
+/**
+ * @brief Extracts answers from dnsmasq and resource-record log lines
+ *
+ * dnsmasq logs a CNAME chain as consecutive replies ("reply www.example.com
+ * is <CNAME>", then "reply edge.cdn.net is 192.0.2.1"), so the owner of the
+ * first CNAME reply is credited with the addresses of the next name that
+ * answers. Resource-record lines name the CNAME target explicitly.
+ */
+class LogParser {
+public:
+    LogParser(Ingestor& ingestor, PassiveDnsIngest::Stats& stats)
+        : ingestor(ingestor), stats(stats), chainActive(false), targetKnown(false) {}
+
+    void ParseLine(std::string_view line) {
+        std::string_view tokens[kMaxLogTokens];
+        size_t count = 0;
+        size_t position = 0;
+        while (count < kMaxLogTokens) {
+            while (position < line.size() && (line[position] == ' ' || line[position] == '\t' || line[position] == '\r')) {
+                position++;
+            }
+            if (position >= line.size()) {
+                break;
+            }
+            size_t start = position;
+            while (position < line.size() && line[position] != ' ' && line[position] != '\t' && line[position] != '\r') {
+                position++;
+            }
+            tokens[count++] = line.substr(start, position - start);
+        }
+
+        if (count == 0) {
+            chainActive = false;   // Blank line ends a dig answer section
+            return;
+        }
+        if (tokens[0][0] == ';') {
+            return;
+        }
+        stats.messages++;
+
+        // dnsmasq: "... reply <name> is <address|<CNAME>>", also "cached"
+        for (size_t k = 0; k + 3 < count; k++) {
+            if ((tokens[k] == "reply" || tokens[k] == "cached") && tokens[k + 2] == "is") {
+                DnsmasqReply(tokens[k + 1], tokens[k + 3]);
+                return;
+            }
+        }
+
+        // BIND-style: "<name> [ttl] [class] A|AAAA|CNAME <data>"
+        for (size_t t = 1; t + 1 < count && t <= 3; t++) {
+            bool isCname = SameName(tokens[t], "CNAME");
+            bool isAddress = SameName(tokens[t], "A") || SameName(tokens[t], "AAAA");
+            if (isCname || isAddress) {
+                ResourceRecord(tokens[0], isCname, tokens[t + 1]);
+                return;
+            }
+            if (!SameName(tokens[t], "IN") &&
+                !std::all_of(tokens[t].begin(), tokens[t].end(), [](char c) { return c >= '0' && c <= '9'; })) {
+                break;
+            }
+        }
+
+        chainActive = false;   // Any other line (a new query) ends the chain
+    }
+
+private:
+    void DnsmasqReply(std::string_view name, std::string_view value) {
+        if (value == "<CNAME>") {
+            if (!chainActive || (targetKnown && !SameName(name, target.View()))) {
+                owner.Set(name);
+                chainActive = owner.length > 0;
+                targetKnown = false;
+            }
+            return;
+        }
+
+        uint8_t bytes[16];
+        size_t size = 0;
+        if (!DnsMessage::ParseAddress(std::string(value), bytes, size)) {
+            return;   // NXDOMAIN, NODATA and other non-address replies
+        }
+        stats.answers++;
+        ingestor.Observe(name, bytes, size, ingestor.Now());
+
+        if (!chainActive) {
+            return;
+        }
+        if (!targetKnown) {
+            target.Set(name);
+            targetKnown = true;
+        }
+        if (SameName(name, target.View())) {
+            ingestor.Observe(owner.View(), bytes, size, ingestor.Now());
+        }
+        else {
+            chainActive = false;
+        }
+    }
+
+    void ResourceRecord(std::string_view name, bool isCname, std::string_view data) {
+        if (isCname) {
+            if (!(chainActive && targetKnown && SameName(TrimDot(name), target.View()))) {
+                owner.Set(name);
+            }
+            target.Set(data);
+            chainActive = owner.length > 0 && target.length > 0;
+            targetKnown = true;
+            return;
+        }
+
+        uint8_t bytes[16];
+        size_t size = 0;
+        if (!DnsMessage::ParseAddress(std::string(data), bytes, size)) {
+            return;
+        }
+        stats.answers++;
+        ingestor.Observe(name, bytes, size, ingestor.Now());
+        if (chainActive && SameName(TrimDot(name), target.View())) {
+            ingestor.Observe(owner.View(), bytes, size, ingestor.Now());
+        }
+    }
+
+    static std::string_view TrimDot(std::string_view name) {
+        if (!name.empty() && name.back() == '.') {
+            name.remove_suffix(1);
+        }
+        return name;
+    }
+
+    Ingestor& ingestor;
+    PassiveDnsIngest::Stats& stats;
+    NameBuffer owner;     // Blocked-name candidate at the head of the chain
+    NameBuffer target;    // Name whose addresses are credited to owner
+    bool chainActive;
+    bool targetKnown;
+};
+
+} // namespace
+
+bool PassiveDnsIngest::IngestPcap(const std::string& path, const Options& options, Stats& stats) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        LOG_ERROR("Cannot open capture file: " << path);
+        return false;
+    }
+    TraceSpan span("ingest_pcap", "ingest", path);
+
+    uint8_t header[24];
+    if (std::fread(header, 1, sizeof(header), file) != sizeof(header)) {
+        LOG_ERROR("Capture file too short: " << path);
+        std::fclose(file);
+        return false;
+    }
+    stats.bytes += sizeof(header);
+
+    uint32_t magic;
+    std::memcpy(&magic, header, 4);
+    bool swapped = false;
+    if (magic == 0xA1B2C3D4u || magic == 0xA1B23C4Du) {
+        swapped = false;
+    }
+    else if (magic == 0xD4C3B2A1u || magic == 0x4D3CB2A1u) {
+        swapped = true;
+    }
+    else {
+        LOG_ERROR("Not a classic pcap file" << (magic == 0x0A0D0D0Au ? " (pcapng; convert with editcap -F pcap)" : "")
+                  << ": " << path);
+        std::fclose(file);
+        return false;
+    }
+    const uint32_t linkType = ReadPcap32(header + 20, swapped) & 0x0FFFFFFFu;
+    if (!SupportedLinkType(linkType)) {
+        LOG_ERROR("Unsupported pcap link type " << linkType << ": " << path);
+        std::fclose(file);
+        return false;
+    }
+
+    Ingestor ingestor(options, stats);
+    std::vector<uint8_t> buffer(kReadChunkBytes);
+    size_t begin = 0;
+    size_t end = 0;
+    bool eof = false;
+    bool ok = true;
+
+    auto ensure = [&](size_t needed) {
+        while (end - begin < needed && !eof) {
+            if (begin > 0) {
+                std::memmove(buffer.data(), buffer.data() + begin, end - begin);
+                end -= begin;
+                begin = 0;
+            }
+            size_t read = std::fread(buffer.data() + end, 1, buffer.size() - end, file);
+            stats.bytes += read;
+            end += read;
+            eof = read == 0;
+        }
+        return end - begin >= needed;
+    };
+
+    while (ensure(16)) {
+        const uint8_t* record = buffer.data() + begin;
+        const std::time_t seenAt = static_cast<std::time_t>(ReadPcap32(record, swapped));
+        const uint32_t capturedLength = ReadPcap32(record + 8, swapped);
+        if (capturedLength > buffer.size() - 16) {
+            LOG_ERROR("Corrupt capture record (" << capturedLength << " bytes): " << path);
+            ok = false;
+            break;
+        }
+        if (!ensure(16 + static_cast<size_t>(capturedLength))) {
+            LOG_WARNING("Capture file ends inside a packet: " << path);
+            break;
+        }
+        HandleFrame(linkType, buffer.data() + begin + 16, capturedLength, seenAt, ingestor, stats);
+        begin += 16 + capturedLength;
+    }
+
+    ingestor.Flush();
+    std::fclose(file);
+    return ok;
+}
+
+bool PassiveDnsIngest::IngestLog(const std::string& path, const Options& options, Stats& stats) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        LOG_ERROR("Cannot open log file: " << path);
+        return false;
+    }
+    TraceSpan span("ingest_log", "ingest", path);
+
+    Ingestor ingestor(options, stats);
+    LogParser parser(ingestor, stats);
+    std::vector<char> buffer(kReadChunkBytes);
+    size_t carried = 0;
+    bool skipping = false;   // Inside a line longer than the buffer
+
+    for (;;) {
+        size_t read = std::fread(buffer.data() + carried, 1, buffer.size() - carried, file);
+        stats.bytes += read;
+        size_t available = carried + read;
+        if (available == 0) {
+            break;
+        }
+
+        size_t start = 0;
+        for (size_t i = carried; i < available; i++) {
+            if (buffer[i] != '\n') {
+                continue;
+            }
+            if (!skipping) {
+                parser.ParseLine(std::string_view(buffer.data() + start, i - start));
+            }
+            skipping = false;
+            start = i + 1;
+        }
+
+        if (read == 0) {
+            if (start < available && !skipping) {
+                parser.ParseLine(std::string_view(buffer.data() + start, available - start));
+            }
+            break;
+        }
+
+        carried = available - start;
+        if (carried == buffer.size()) {
+            skipping = true;   // No resolver writes lines this long; drop it
+            carried = 0;
+        }
+        else {
+            std::memmove(buffer.data(), buffer.data() + start, carried);
+        }
+    }
+
+    ingestor.Flush();
+    std::fclose(file);
+    return true;
+}
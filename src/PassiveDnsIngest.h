@@ -0,0 +1,80 @@
+#ifndef PASSIVEDNSINGEST_H
+#define PASSIVEDNSINGEST_H
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief Passive DNS: merge addresses observed by other resolvers into blocks
+ *
+ * Clients behind geo-steered CDNs are often answered with addresses that
+ * our own resolver never sees at refresh time. Ingestion reads what other
+ * resolvers actually answered and adds those addresses to the matching
+ * blocked records:
+ *
+ * - Packet captures (classic pcap; Ethernet, VLAN, Linux cooked, raw IP or
+ *   loopback link types) of DNS responses over UDP port 53. Each response
+ *   is parsed in place in the read buffer; names are decoded into stack
+ *   buffers and only answers for blocked names are copied.
+ * - Resolver logs: dnsmasq `log-queries` lines ("reply example.com is
+ *   192.0.2.1", including CNAME chains) and BIND-style resource record
+ *   lines ("example.com. 300 IN A 192.0.2.1", as in dig output or cache
+ *   dumps).
+ *
+ * Input is read in fixed-size chunks and observations are merged in
+ * batches of records, so memory stays bounded however large the input.
+ * An address seen for a CNAME target counts for the blocked name that
+ * led to it. Observed addresses join the record as lingering addresses
+ * (Record::lastSeen set to the time of the observation), so refreshes keep
+ * them for the address grace period and then let them expire unless they
+ * are seen again.
+ */
+class PassiveDnsIngest {
+public:
+    /**
+     * @brief Counts for one ingestion run
+     */
+    struct Stats {
+        uint64_t bytes;          // Input bytes read
+        uint64_t messages;       // DNS responses or log lines examined
+        uint64_t malformed;      // Packets or responses that could not be parsed
+        uint64_t answers;        // A/AAAA answers seen
+        uint64_t matched;        // Answers for blocked FQDNs
+        uint64_t stale;          // Matched answers older than the grace period
+        uint64_t added;          // Addresses new to their record
+        uint64_t refreshed;      // Lingering addresses seen again
+        uint64_t recordsUpdated; // Records written to the audit store
+        uint64_t failed;         // Records whose firewall update failed
+    };
+
+    /**
+     * @brief How observations are merged
+     */
+    struct Options {
+        int graceSeconds;        // Address grace period; older observations are ignored (0: keep all)
+        size_t batchRecords;     // Records merged per audit store write (each write saves the whole store)
+
+        Options() : graceSeconds(0), batchRecords(16384) {}
+    };
+
+    /**
+     * @brief Ingest a pcap file of DNS traffic
+     * @param path Capture file
+     * @param options Merge options
+     * @param stats Counts, added to
+     * @return false if the file could not be read or is not a classic pcap
+     */
+    static bool IngestPcap(const std::string& path, const Options& options, Stats& stats);
+
+    /**
+     * @brief Ingest a dnsmasq or BIND-style log file
+     * @param path Log file
+     * @param options Merge options
+     * @param stats Counts, added to
+     * @return false if the file could not be read
+     */
+    static bool IngestLog(const std::string& path, const Options& options, Stats& stats);
+};
+
+#endif // PASSIVEDNSINGEST_H
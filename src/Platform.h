@@ -0,0 +1,30 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <ctime>
+
+/**
+ * @brief Small portability helpers shared by the Windows and Linux builds
+ *
+ * The Windows build talks to the real Windows Filtering Platform. The Linux
+ * build runs against a simulated firewall backend and exists so the service,
+ * tooling and benchmarks can be developed and exercised off Windows.
+ */
+namespace Platform {
+
+    /**
+     * @brief Thread-safe conversion of a timestamp to local time
+     * @param time Timestamp to convert
+     * @param out Output broken-down local time
+     */
+    inline void LocalTime(std::time_t time, std::tm& out) {
+#ifdef _WIN32
+        localtime_s(&out, &time);
+#else
+        localtime_r(&time, &out);
+#endif
+    }
+
+} // namespace Platform
+
+#endif // PLATFORM_H
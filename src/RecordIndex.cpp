@@ -0,0 +1,174 @@
+#include "RecordIndex.h"
+#include "DnsMessage.h"
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+const uint8_t kMappedPrefix[12] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF };
+
+/**
+ * @brief Key of an address as 16 bytes, IPv4 mapped into IPv6
+ */
+bool ToKey(const std::string& text, RecordIndex::AddressKey& key) {
+    uint8_t bytes[16];
+    size_t size = 0;
+    if (!DnsMessage::ParseAddress(text, bytes, size)) {
+        return false;
+    }
+    if (size == 4) {
+        std::copy(kMappedPrefix, kMappedPrefix + 12, key.begin());
+        std::copy(bytes, bytes + 4, key.begin() + 12);
+    }
+    else {
+        std::copy(bytes, bytes + 16, key.begin());
+    }
+    return true;
+}
+
+} // namespace
+
+RecordIndex::Filter::Filter()
+    : blockedFrom(std::numeric_limits<std::time_t>::min()), blockedTo(std::numeric_limits<std::time_t>::max()),
+      changedFrom(std::numeric_limits<std::time_t>::min()), changedTo(std::numeric_limits<std::time_t>::max()),
+      interval(-1), hasNetwork(false), network() {}
+
+bool RecordIndex::Filter::IsEmpty() const {
+    return blockedFrom == std::numeric_limits<std::time_t>::min() &&
+           blockedTo == std::numeric_limits<std::time_t>::max() &&
+           changedFrom == std::numeric_limits<std::time_t>::min() &&
+           changedTo == std::numeric_limits<std::time_t>::max() &&
+           interval < 0 && !hasNetwork;
+}
+
+RecordIndex::RecordIndex(const RecordStore& store) {
+    live = store.LiveSlots();
+    byBlockedAt.reserve(live.size());
+    byChangedAt.reserve(live.size());
+    byInterval.reserve(live.size());
+    byAddress.reserve(live.size() * 2);
+
+    AddressKey key;
+    for (Slot slot : live) {
+        byBlockedAt.emplace_back(ClampTime(store.BlockedAt(slot)), slot);
+        byChangedAt.emplace_back(ClampTime(store.ChangedAt(slot)), slot);
+        byInterval.emplace_back(store.Interval(slot), slot);
+        for (const auto& ip : store.Addresses(slot)) {
+            if (ToKey(ip, key)) {
+                byAddress.emplace_back(key, slot);
+            }
+        }
+    }
+
+    std::sort(byBlockedAt.begin(), byBlockedAt.end());
+    std::sort(byChangedAt.begin(), byChangedAt.end());
+    std::sort(byInterval.begin(), byInterval.end());
+    std::sort(byAddress.begin(), byAddress.end());
+}
+
+std::vector<RecordIndex::Slot> RecordIndex::Select(const Filter& filter) const {
+    if (filter.IsEmpty()) {
+        return live;
+    }
+
+    // Each condition yields a sorted slot list; intersect them smallest first
+    std::vector<std::vector<Slot>> matches;
+    if (filter.blockedFrom != std::numeric_limits<std::time_t>::min() ||
+        filter.blockedTo != std::numeric_limits<std::time_t>::max()) {
+        if (filter.blockedTo <= filter.blockedFrom || filter.blockedTo <= 0) {
+            return std::vector<Slot>();
+        }
+        matches.push_back(Range(byBlockedAt, ClampTime(filter.blockedFrom), ClampTime(filter.blockedTo - 1)));
+    }
+    if (filter.changedFrom != std::numeric_limits<std::time_t>::min() ||
+        filter.changedTo != std::numeric_limits<std::time_t>::max()) {
+        if (filter.changedTo <= filter.changedFrom || filter.changedTo <= 0) {
+            return std::vector<Slot>();
+        }
+        matches.push_back(Range(byChangedAt, ClampTime(filter.changedFrom), ClampTime(filter.changedTo - 1)));
+    }
+    if (filter.interval >= 0) {
+        matches.push_back(Range(byInterval, static_cast<int32_t>(filter.interval),
+                                static_cast<int32_t>(filter.interval)));
+    }
+    if (filter.hasNetwork) {
+        matches.push_back(Range(byAddress, filter.network.first, filter.network.last));
+    }
+
+    std::sort(matches.begin(), matches.end(),
+        [](const std::vector<Slot>& a, const std::vector<Slot>& b) { return a.size() < b.size(); });
+    std::vector<Slot> result = std::move(matches[0]);
+    for (size_t i = 1; i < matches.size() && !result.empty(); i++) {
+        result = Intersect(result, matches[i]);
+    }
+    return result;
+}
+
+bool RecordIndex::ParseNetwork(const std::string& text, Network& network) {
+    size_t slash = text.find('/');
+    AddressKey key;
+    if (!ToKey(text.substr(0, slash), key)) {
+        return false;
+    }
+
+    const bool ipv4 = text.find(':') == std::string::npos;
+    int prefix = ipv4 ? 32 : 128;
+    if (slash != std::string::npos) {
+        const std::string digits = text.substr(slash + 1);
+        if (digits.empty() || digits.size() > 3 ||
+            !std::all_of(digits.begin(), digits.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+            return false;
+        }
+        prefix = std::stoi(digits);
+        if (prefix > (ipv4 ? 32 : 128)) {
+            return false;
+        }
+    }
+    if (ipv4) {
+        prefix += 96;
+    }
+
+    network.first = key;
+    network.last = key;
+    for (int bit = prefix; bit < 128; bit++) {
+        uint8_t mask = static_cast<uint8_t>(0x80 >> (bit % 8));
+        network.first[bit / 8] &= static_cast<uint8_t>(~mask);
+        network.last[bit / 8] |= mask;
+    }
+    return true;
+}
+
+size_t RecordIndex::MemoryBytes() const {
+    return live.capacity() * sizeof(Slot) +
+           byBlockedAt.capacity() * sizeof(byBlockedAt[0]) +
+           byChangedAt.capacity() * sizeof(byChangedAt[0]) +
+           byInterval.capacity() * sizeof(byInterval[0]) +
+           byAddress.capacity() * sizeof(byAddress[0]);
+}
+
+template <typename Key>
+std::vector<RecordIndex::Slot> RecordIndex::Range(const std::vector<std::pair<Key, Slot>>& index,
+                                                  const Key& first, const Key& last) {
+    auto begin = std::lower_bound(index.begin(), index.end(), std::make_pair(first, Slot(0)));
+    auto end = std::upper_bound(index.begin(), index.end(), std::make_pair(last, RecordStore::InvalidSlot));
+
+    std::vector<Slot> slots;
+    slots.reserve(static_cast<size_t>(end - begin));
+    for (auto it = begin; it != end; ++it) {
+        slots.push_back(it->second);
+    }
+    std::sort(slots.begin(), slots.end());
+    slots.erase(std::unique(slots.begin(), slots.end()), slots.end());   // A record with several matching addresses
+    return slots;
+}
+
+std::vector<RecordIndex::Slot> RecordIndex::Intersect(const std::vector<Slot>& a, const std::vector<Slot>& b) {
+    std::vector<Slot> both;
+    std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(both));
+    return both;
+}
+
+uint32_t RecordIndex::ClampTime(std::time_t time) {
+    return static_cast<uint32_t>(std::min<int64_t>(
+        std::max<int64_t>(time, 0), std::numeric_limits<uint32_t>::max()));
+}
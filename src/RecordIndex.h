@@ -0,0 +1,99 @@
+#ifndef RECORDINDEX_H
+#define RECORDINDEX_H
+
+#include <string>
+#include <vector>
+#include <array>
+#include <utility>
+#include <ctime>
+#include <cstdint>
+#include <cstddef>
+
+#include "RecordStore.h"
+
+/**
+ * @brief Secondary indexes over one version of a RecordStore
+ *
+ * Sorted arrays of (key, slot) pairs for the block time, the time of the
+ * last address change, the refresh interval and every stored address, so
+ * range and prefix queries touch only the matching records. Built in one
+ * pass over the store and never updated; AuditSnapshot builds one per
+ * snapshot on first use.
+ *
+ * Addresses are keyed as 16 bytes, IPv4 as IPv4-mapped IPv6
+ * (::ffff:a.b.c.d), so a network is a contiguous key range.
+ */
+class RecordIndex {
+public:
+    typedef RecordStore::Slot Slot;
+    typedef std::array<uint8_t, 16> AddressKey;
+
+    /**
+     * @brief Inclusive range of address keys
+     */
+    struct Network {
+        AddressKey first;
+        AddressKey last;
+    };
+
+    /**
+     * @brief Conditions a record must meet; unset conditions match everything
+     */
+    struct Filter {
+        std::time_t blockedFrom;    // blockedAt >= blockedFrom
+        std::time_t blockedTo;      // blockedAt < blockedTo
+        std::time_t changedFrom;    // changedAt >= changedFrom
+        std::time_t changedTo;      // changedAt < changedTo
+        int interval;               // Exact refresh interval, -1 for any
+        bool hasNetwork;
+        Network network;            // Some address inside this network
+
+        Filter();
+
+        /**
+         * @brief Check whether no condition is set
+         */
+        bool IsEmpty() const;
+    };
+
+    /**
+     * @brief Index every record of a store
+     * @param store Store to index; must not change while the index is used
+     */
+    explicit RecordIndex(const RecordStore& store);
+
+    /**
+     * @brief Find the records that meet every condition of a filter
+     * @param filter Conditions to apply
+     * @return Matching slots in ascending order
+     */
+    std::vector<Slot> Select(const Filter& filter) const;
+
+    /**
+     * @brief Parse an address or a network in CIDR notation
+     * @param text "192.0.2.1", "192.0.2.0/24", "2001:db8::/32", ...
+     * @param network Range of address keys covered
+     * @return true if the text is valid
+     */
+    static bool ParseNetwork(const std::string& text, Network& network);
+
+    /**
+     * @brief Bytes held by the index arrays
+     */
+    size_t MemoryBytes() const;
+
+private:
+    template <typename Key>
+    static std::vector<Slot> Range(const std::vector<std::pair<Key, Slot>>& index, const Key& first, const Key& last);
+
+    static std::vector<Slot> Intersect(const std::vector<Slot>& a, const std::vector<Slot>& b);
+    static uint32_t ClampTime(std::time_t time);
+
+    std::vector<Slot> live;                                   // All slots, for an empty filter
+    std::vector<std::pair<uint32_t, Slot>> byBlockedAt;
+    std::vector<std::pair<uint32_t, Slot>> byChangedAt;
+    std::vector<std::pair<int32_t, Slot>> byInterval;
+    std::vector<std::pair<AddressKey, Slot>> byAddress;
+};
+
+#endif // RECORDINDEX_H
@@ -0,0 +1,728 @@
+#include "RecordStore.h"
+#include "DnsMessage.h"
+#include "Log.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+namespace {
+
+// Address lists in the pool start with a header byte. Below 0xFF it holds
+// the IPv4 count in the low nibble and the IPv6 count in the high nibble,
+// followed by the raw addresses, IPv4 first. Lists that do not fit that
+// form use 0xFF, a two-byte length and tagged entries in the given order.
+const uint8_t kGeneralForm = 0xFF;
+const size_t kMaxCompactCount = 14;
+
+// Entry tags of the general form
+const uint8_t kTagText = 0;     // Followed by a length byte and the text
+const uint8_t kTagIPv4 = 4;     // Followed by 4 bytes
+const uint8_t kTagIPv6 = 6;     // Followed by 16 bytes
+
+// Dead space is reclaimed once it is both this large and half of its buffer
+const size_t kMinCompactBytes = 4096;
+
+// Interval column value for intervals kept in largeIntervals (negative or 65535+ minutes)
+const uint16_t kLargeInterval = 0xFFFF;
+
+// The FQDN index is kept at most kIndexLoadNum / kIndexLoadDen full
+const size_t kIndexLoadNum = 4;
+const size_t kIndexLoadDen = 5;
+
+const char kDefaultRulePrefix[] = "Block ";
+
+/**
+ * @brief Fit a timestamp into the 32-bit columns (1970 to 2106)
+ */
+uint32_t ClampTime(std::time_t time) {
+    return static_cast<uint32_t>(std::min<int64_t>(
+        std::max<int64_t>(time, 0), std::numeric_limits<uint32_t>::max()));
+}
+
+size_t HashOf(std::string_view text) {
+    return std::hash<std::string_view>()(text);
+}
+
+int HexValue(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+/**
+ * @brief Parse a canonical lowercase GUID (8-4-4-4-12) into 16 bytes
+ */
+bool ParseGuid(const std::string& text, std::array<uint8_t, 16>& bytes) {
+    if (text.size() != 36) {
+        return false;
+    }
+
+    size_t out = 0;
+    for (size_t i = 0; i < text.size(); ) {
+        if (i == 8 || i == 13 || i == 18 || i == 23) {
+            if (text[i] != '-') {
+                return false;
+            }
+            i++;
+            continue;
+        }
+        int high = HexValue(text[i]);
+        int low = HexValue(text[i + 1]);
+        if (high < 0 || low < 0) {
+            return false;
+        }
+        bytes[out++] = static_cast<uint8_t>((high << 4) | low);
+        i += 2;
+    }
+    return out == 16;
+}
+
+std::string FormatGuid(const std::array<uint8_t, 16>& bytes) {
+    static const char digits[] = "0123456789abcdef";
+    std::string text;
+    text.reserve(36);
+    for (size_t i = 0; i < 16; i++) {
+        if (i == 4 || i == 6 || i == 8 || i == 10) {
+            text += '-';
+        }
+        text += digits[bytes[i] >> 4];
+        text += digits[bytes[i] & 0x0F];
+    }
+    return text;
+}
+
+size_t TaggedEntrySize(const uint8_t* entry) {
+    return entry[0] == kTagIPv4 ? 5 : entry[0] == kTagIPv6 ? 17 : 2 + entry[1];
+}
+
+/**
+ * @brief Bytes taken by an encoded address list, including its header
+ */
+size_t EncodedSize(const uint8_t* list) {
+    if (list[0] != kGeneralForm) {
+        return 1 + 4 * (list[0] & 0x0F) + 16 * (list[0] >> 4);
+    }
+    return 3 + ((static_cast<size_t>(list[1]) << 8) | list[2]);
+}
+
+/**
+ * @brief Split an encoded address list into one view per address
+ */
+void SplitEntries(const uint8_t* list, std::vector<std::string_view>& entries) {
+    const char* data = reinterpret_cast<const char*>(list);
+    if (list[0] != kGeneralForm) {
+        size_t pos = 1;
+        for (int i = 0; i < (list[0] & 0x0F); i++, pos += 4) {
+            entries.emplace_back(data + pos, 4);
+        }
+        for (int i = 0; i < (list[0] >> 4); i++, pos += 16) {
+            entries.emplace_back(data + pos, 16);
+        }
+        return;
+    }
+
+    size_t end = EncodedSize(list);
+    for (size_t pos = 3; pos < end; pos += TaggedEntrySize(list + pos)) {
+        entries.emplace_back(data + pos, TaggedEntrySize(list + pos));
+    }
+}
+
+/**
+ * @brief Encode an address list for the pool
+ *
+ * The general form holds at most 0xFFFF bytes of entries and text entries
+ * at most 0xFF bytes, so longer lists are cut at that limit.
+ * @return Number of addresses dropped or cut short to fit
+ */
+size_t EncodeAddresses(const std::vector<std::string>& ips, std::vector<uint8_t>& out) {
+    std::vector<uint8_t> v4;
+    std::vector<uint8_t> v6;
+    std::vector<uint8_t> tagged;
+    bool binary = true;
+    uint8_t bytes[16];
+    size_t size = 0;
+    size_t truncated = 0;
+    size_t encoded = 0;
+
+    for (const auto& ip : ips) {
+        // Only binary-encode text that renders back identically
+        if (DnsMessage::ParseAddress(ip, bytes, size) && DnsMessage::AddressToString(bytes, size) == ip) {
+            if (tagged.size() + 1 + size > 0xFFFF) {
+                break;
+            }
+            (size == 4 ? v4 : v6).insert((size == 4 ? v4 : v6).end(), bytes, bytes + size);
+            tagged.push_back(size == 4 ? kTagIPv4 : kTagIPv6);
+            tagged.insert(tagged.end(), bytes, bytes + size);
+        }
+        else {
+            size_t length = std::min<size_t>(ip.size(), 0xFF);
+            if (tagged.size() + 2 + length > 0xFFFF) {
+                break;
+            }
+            if (length < ip.size()) {
+                truncated++;
+            }
+            binary = false;
+            tagged.push_back(kTagText);
+            tagged.push_back(static_cast<uint8_t>(length));
+            tagged.insert(tagged.end(), ip.begin(), ip.begin() + length);
+        }
+        encoded++;
+    }
+    truncated += ips.size() - encoded;
+
+    out.clear();
+    if (binary && v4.size() / 4 <= kMaxCompactCount && v6.size() / 16 <= kMaxCompactCount) {
+        out.push_back(static_cast<uint8_t>((v6.size() / 16) << 4 | (v4.size() / 4)));
+        out.insert(out.end(), v4.begin(), v4.end());
+        out.insert(out.end(), v6.begin(), v6.end());
+        return truncated;
+    }
+
+    out.push_back(kGeneralForm);
+    out.push_back(static_cast<uint8_t>(tagged.size() >> 8));
+    out.push_back(static_cast<uint8_t>(tagged.size() & 0xFF));
+    out.insert(out.end(), tagged.begin(), tagged.end());
+    return truncated;
+}
+
+/**
+ * @brief Log and count addresses that did not fit the pool encoding
+ */
+void ReportTruncated(std::string_view fqdn, size_t truncated) {
+    static Counter& truncatedTotal = Metrics::GetCounter("fqdn_record_addresses_truncated_total",
+        "Addresses dropped or cut short because a record's address list exceeded the storage limit");
+    if (truncated > 0) {
+        LOG_WARNING("Dropped or cut short " << truncated << " address(es) of " << fqdn
+                    << " to fit the per-record address list limit");
+        truncatedTotal.Increment(truncated);
+    }
+}
+
+void DecodeAddresses(const uint8_t* list, std::vector<std::string>& out) {
+    std::vector<std::string_view> entries;
+    SplitEntries(list, entries);
+
+    for (const auto& entry : entries) {
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(entry.data());
+        if (list[0] != kGeneralForm) {
+            out.push_back(DnsMessage::AddressToString(data, entry.size()));
+        }
+        else if (data[0] == kTagText) {
+            out.emplace_back(entry.data() + 2, data[1]);
+        }
+        else {
+            out.push_back(DnsMessage::AddressToString(data + 1, entry.size() - 1));
+        }
+    }
+}
+
+} // namespace
+
+// Record implementation
+Record::Record() : blockedAt(0), changedAt(0), interval(0) {}
+
+Record::Record(const std::string& fqdn, const std::string& keywordId,
+               const std::string& ruleName, const std::vector<std::string>& ips, int interval)
+    : fqdn(fqdn), keywordId(keywordId), ruleName(ruleName),
+      blockedAt(std::time(nullptr)), changedAt(blockedAt), lastResolvedIPs(ips), interval(interval) {}
+
+// RecordStore implementation
+const RecordStore::Slot RecordStore::InvalidSlot;
+const uint32_t RecordStore::InvalidRef;
+
+RecordStore::RecordStore()
+    : liveCount(0), internedCount(0), deadStringBytes(0), deadAddressBytes(0) {}
+
+void RecordStore::Reserve(size_t records) {
+    fqdnRefs.reserve(records);
+    keywordIds.reserve(records);
+    blockedAts.reserve(records);
+    changedAts.reserve(records);
+    intervals.reserve(records);
+    addressOffsets.reserve(records);
+    flags.reserve(records);
+
+    if (index.size() * kIndexLoadNum < records * kIndexLoadDen) {
+        RehashIndex(records * kIndexLoadDen / kIndexLoadNum + 1);
+    }
+}
+
+void RecordStore::ShrinkToFit() {
+    fqdnRefs.shrink_to_fit();
+    keywordIds.shrink_to_fit();
+    blockedAts.shrink_to_fit();
+    changedAts.shrink_to_fit();
+    intervals.shrink_to_fit();
+    addressOffsets.shrink_to_fit();
+    flags.shrink_to_fit();
+    strings.shrink_to_fit();
+    addressPool.shrink_to_fit();
+    freeSlots.shrink_to_fit();
+}
+
+RecordStore::Slot RecordStore::Insert(const Record& record) {
+    if (Find(record.fqdn) != InvalidSlot) {
+        return InvalidSlot;
+    }
+
+    Slot slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    else {
+        slot = static_cast<Slot>(fqdnRefs.size());
+        fqdnRefs.push_back(InvalidRef);
+        keywordIds.emplace_back();
+        blockedAts.push_back(0);
+        changedAts.push_back(0);
+        intervals.push_back(0);
+        addressOffsets.push_back(0);
+        flags.push_back(0);
+    }
+
+    fqdnRefs[slot] = AppendString(record.fqdn);
+    blockedAts[slot] = ClampTime(record.blockedAt);
+    changedAts[slot] = record.changedAt > 0 ? ClampTime(record.changedAt) : blockedAts[slot];
+    if (record.interval >= 0 && record.interval < kLargeInterval) {
+        intervals[slot] = static_cast<uint16_t>(record.interval);
+    }
+    else {
+        intervals[slot] = kLargeInterval;
+        largeIntervals[slot] = record.interval;
+    }
+    flags[slot] = 0;
+
+    if (!ParseGuid(record.keywordId, keywordIds[slot])) {
+        uint32_t ref = AppendString(record.keywordId);
+        keywordIds[slot].fill(0);
+        std::copy(reinterpret_cast<const uint8_t*>(&ref),
+                  reinterpret_cast<const uint8_t*>(&ref) + sizeof(ref), keywordIds[slot].begin());
+        flags[slot] |= FlagKeywordText;
+    }
+
+    if (record.ruleName != kDefaultRulePrefix + record.fqdn) {
+        customRules[slot] = Intern(record.ruleName);
+        flags[slot] |= FlagCustomRule;
+    }
+
+    std::vector<uint8_t> encoded;
+    ReportTruncated(record.fqdn, EncodeAddresses(record.lastResolvedIPs, encoded));
+    addressOffsets[slot] = static_cast<uint32_t>(addressPool.size());
+    addressPool.insert(addressPool.end(), encoded.begin(), encoded.end());
+    StoreLastSeen(slot, record.lastResolvedIPs, record.lastSeen);
+
+    IndexInsert(slot);
+    liveCount++;
+    return slot;
+}
+
+bool RecordStore::Erase(Slot slot) {
+    if (!IsLive(slot)) {
+        return false;
+    }
+
+    IndexErase(slot);
+
+    deadStringBytes += StringFootprint(fqdnRefs[slot]);
+    if (flags[slot] & FlagKeywordText) {
+        uint32_t ref;
+        std::copy(keywordIds[slot].begin(), keywordIds[slot].begin() + sizeof(ref),
+                  reinterpret_cast<uint8_t*>(&ref));
+        deadStringBytes += StringFootprint(ref);
+    }
+    if (flags[slot] & FlagCustomRule) {
+        customRules.erase(slot);
+    }
+    if (intervals[slot] == kLargeInterval) {
+        largeIntervals.erase(slot);
+    }
+    lastSeen.erase(slot);
+    deadAddressBytes += EncodedSize(addressPool.data() + addressOffsets[slot]);
+
+    fqdnRefs[slot] = InvalidRef;
+    flags[slot] = 0;
+    freeSlots.push_back(slot);
+    liveCount--;
+
+    if (deadStringBytes >= kMinCompactBytes && deadStringBytes * 2 > strings.size()) {
+        CompactStrings();
+    }
+    if (deadAddressBytes >= kMinCompactBytes && deadAddressBytes * 2 > addressPool.size()) {
+        CompactAddresses();
+    }
+    return true;
+}
+
+bool RecordStore::SetAddresses(Slot slot, const std::vector<std::string>& ips) {
+    return SetAddresses(slot, ips, std::vector<std::time_t>());
+}
+
+bool RecordStore::SetAddresses(Slot slot, const std::vector<std::string>& ips,
+                               const std::vector<std::time_t>& times) {
+    if (!IsLive(slot)) {
+        return false;
+    }
+
+    if (!SameAddresses(slot, ips)) {
+        changedAts[slot] = ClampTime(std::time(nullptr));
+    }
+
+    std::vector<uint8_t> encoded;
+    ReportTruncated(Fqdn(slot), EncodeAddresses(ips, encoded));
+
+    // Reuse the old space when the new list fits, otherwise append
+    size_t previous = EncodedSize(addressPool.data() + addressOffsets[slot]);
+    if (encoded.size() <= previous) {
+        std::copy(encoded.begin(), encoded.end(), addressPool.begin() + addressOffsets[slot]);
+        deadAddressBytes += previous - encoded.size();
+    }
+    else {
+        deadAddressBytes += previous;
+        addressOffsets[slot] = static_cast<uint32_t>(addressPool.size());
+        addressPool.insert(addressPool.end(), encoded.begin(), encoded.end());
+    }
+    StoreLastSeen(slot, ips, times);
+
+    if (deadAddressBytes >= kMinCompactBytes && deadAddressBytes * 2 > addressPool.size()) {
+        CompactAddresses();
+    }
+    return true;
+}
+
+void RecordStore::StoreLastSeen(Slot slot, const std::vector<std::string>& ips,
+                                const std::vector<std::time_t>& times) {
+    if (times.size() != ips.size() ||
+        std::all_of(times.begin(), times.end(), [](std::time_t t) { return t <= 0; })) {
+        lastSeen.erase(slot);
+        return;
+    }
+
+    // The pool reorders addresses (IPv4 first), so match them back by text
+    std::vector<std::string> stored = Addresses(slot);
+    std::vector<uint32_t>& seen = lastSeen[slot];
+    seen.assign(stored.size(), 0);
+    std::vector<bool> used(ips.size(), false);
+    for (size_t i = 0; i < stored.size(); i++) {
+        for (size_t j = 0; j < ips.size(); j++) {
+            if (!used[j] && ips[j] == stored[i]) {
+                used[j] = true;
+                seen[i] = ClampTime(times[j]);
+                break;
+            }
+        }
+    }
+    if (std::all_of(seen.begin(), seen.end(), [](uint32_t t) { return t == 0; })) {
+        lastSeen.erase(slot);
+    }
+}
+
+RecordStore::Slot RecordStore::Find(std::string_view fqdn) const {
+    if (index.empty()) {
+        return InvalidSlot;
+    }
+
+    for (size_t pos = IndexHome(fqdn); index[pos] != InvalidSlot; pos = IndexNext(pos)) {
+        if (StringAt(fqdnRefs[index[pos]]) == fqdn) {
+            return index[pos];
+        }
+    }
+    return InvalidSlot;
+}
+
+bool RecordStore::IsLive(Slot slot) const {
+    return slot < fqdnRefs.size() && fqdnRefs[slot] != InvalidRef;
+}
+
+std::vector<RecordStore::Slot> RecordStore::LiveSlots() const {
+    std::vector<Slot> slots;
+    slots.reserve(liveCount);
+    for (Slot slot = 0; slot < SlotCount(); slot++) {
+        if (fqdnRefs[slot] != InvalidRef) {
+            slots.push_back(slot);
+        }
+    }
+    return slots;
+}
+
+std::string_view RecordStore::Fqdn(Slot slot) const {
+    return StringAt(fqdnRefs[slot]);
+}
+
+std::string RecordStore::RuleName(Slot slot) const {
+    if (flags[slot] & FlagCustomRule) {
+        return std::string(StringAt(customRules.at(slot)));
+    }
+    std::string name = kDefaultRulePrefix;
+    name += Fqdn(slot);
+    return name;
+}
+
+std::string RecordStore::KeywordId(Slot slot) const {
+    if (flags[slot] & FlagKeywordText) {
+        uint32_t ref;
+        std::copy(keywordIds[slot].begin(), keywordIds[slot].begin() + sizeof(ref),
+                  reinterpret_cast<uint8_t*>(&ref));
+        return std::string(StringAt(ref));
+    }
+    return FormatGuid(keywordIds[slot]);
+}
+
+std::vector<std::string> RecordStore::Addresses(Slot slot) const {
+    std::vector<std::string> ips;
+    DecodeAddresses(addressPool.data() + addressOffsets[slot], ips);
+    return ips;
+}
+
+std::vector<std::time_t> RecordStore::LastSeen(Slot slot) const {
+    auto it = lastSeen.find(slot);
+    if (it == lastSeen.end()) {
+        return std::vector<std::time_t>();
+    }
+    return std::vector<std::time_t>(it->second.begin(), it->second.end());
+}
+
+int RecordStore::Interval(Slot slot) const {
+    if (intervals[slot] == kLargeInterval) {
+        return largeIntervals.at(slot);
+    }
+    return intervals[slot];
+}
+
+size_t RecordStore::AddressCount(Slot slot) const {
+    const uint8_t* list = addressPool.data() + addressOffsets[slot];
+    if (list[0] != kGeneralForm) {
+        return (list[0] & 0x0F) + (list[0] >> 4);
+    }
+    std::vector<std::string_view> entries;
+    SplitEntries(list, entries);
+    return entries.size();
+}
+
+bool RecordStore::SameAddresses(Slot slot, const std::vector<std::string>& ips) const {
+    std::vector<uint8_t> encoded;
+    EncodeAddresses(ips, encoded);
+    const uint8_t* stored = addressPool.data() + addressOffsets[slot];
+    if (encoded.size() != EncodedSize(stored) || encoded[0] != stored[0]) {
+        return false;
+    }
+
+    // Same multiset of addresses, in any order
+    std::vector<std::string_view> a;
+    std::vector<std::string_view> b;
+    SplitEntries(encoded.data(), a);
+    SplitEntries(stored, b);
+    std::sort(a.begin(), a.end());
+    std::sort(b.begin(), b.end());
+    return a == b;
+}
+
+Record RecordStore::Get(Slot slot) const {
+    Record record;
+    record.fqdn = std::string(Fqdn(slot));
+    record.keywordId = KeywordId(slot);
+    record.ruleName = RuleName(slot);
+    record.blockedAt = BlockedAt(slot);
+    record.changedAt = ChangedAt(slot);
+    record.interval = Interval(slot);
+    DecodeAddresses(addressPool.data() + addressOffsets[slot], record.lastResolvedIPs);
+    record.lastSeen = LastSeen(slot);
+    return record;
+}
+
+RecordStore::MemoryUsage RecordStore::Memory() const {
+    MemoryUsage usage;
+    usage.columns = fqdnRefs.capacity() * sizeof(uint32_t) +
+                    keywordIds.capacity() * sizeof(std::array<uint8_t, 16>) +
+                    blockedAts.capacity() * sizeof(uint32_t) +
+                    changedAts.capacity() * sizeof(uint32_t) +
+                    intervals.capacity() * sizeof(uint16_t) +
+                    addressOffsets.capacity() * sizeof(uint32_t) +
+                    flags.capacity() * sizeof(uint8_t);
+    usage.strings = strings.capacity();
+    usage.addresses = addressPool.capacity();
+
+    // Node-based map: key/value plus roughly two pointers of node and bucket overhead
+    usage.index = index.capacity() * sizeof(Slot) +
+                  interned.capacity() * sizeof(uint32_t) +
+                  freeSlots.capacity() * sizeof(Slot) +
+                  customRules.size() * (sizeof(std::pair<const Slot, uint32_t>) + 2 * sizeof(void*)) +
+                  customRules.bucket_count() * sizeof(void*) +
+                  largeIntervals.size() * (sizeof(std::pair<const Slot, int32_t>) + 2 * sizeof(void*)) +
+                  largeIntervals.bucket_count() * sizeof(void*) +
+                  lastSeen.size() * (sizeof(std::pair<const Slot, std::vector<uint32_t>>) + 2 * sizeof(void*)) +
+                  lastSeen.bucket_count() * sizeof(void*);
+    for (const auto& entry : lastSeen) {
+        usage.index += entry.second.capacity() * sizeof(uint32_t);
+    }
+    return usage;
+}
+
+uint32_t RecordStore::AppendString(std::string_view text) {
+    // One length byte below 128, two up to 32767; longer strings are cut
+    size_t length = std::min<size_t>(text.size(), 0x7FFF);
+    uint32_t ref = static_cast<uint32_t>(strings.size());
+
+    if (length < 0x80) {
+        strings.push_back(static_cast<char>(length));
+    }
+    else {
+        strings.push_back(static_cast<char>(0x80 | (length >> 8)));
+        strings.push_back(static_cast<char>(length & 0xFF));
+    }
+    strings.insert(strings.end(), text.begin(), text.begin() + length);
+    return ref;
+}
+
+std::string_view RecordStore::StringAt(uint32_t ref) const {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(strings.data() + ref);
+    if (p[0] < 0x80) {
+        return std::string_view(reinterpret_cast<const char*>(p + 1), p[0]);
+    }
+    size_t length = (static_cast<size_t>(p[0] & 0x7F) << 8) | p[1];
+    return std::string_view(reinterpret_cast<const char*>(p + 2), length);
+}
+
+size_t RecordStore::StringFootprint(uint32_t ref) const {
+    size_t length = StringAt(ref).size();
+    return length + (length < 0x80 ? 1 : 2);
+}
+
+uint32_t RecordStore::Intern(std::string_view text) {
+    if ((internedCount + 1) * 4 > interned.size() * 3) {
+        std::vector<uint32_t> old;
+        old.swap(interned);
+        interned.assign(std::max<size_t>(16, old.size() * 2), InvalidRef);
+        size_t mask = interned.size() - 1;
+        for (uint32_t ref : old) {
+            if (ref != InvalidRef) {
+                size_t pos = HashOf(StringAt(ref)) & mask;
+                while (interned[pos] != InvalidRef) {
+                    pos = (pos + 1) & mask;
+                }
+                interned[pos] = ref;
+            }
+        }
+    }
+
+    size_t mask = interned.size() - 1;
+    size_t pos = HashOf(text) & mask;
+    for (; interned[pos] != InvalidRef; pos = (pos + 1) & mask) {
+        if (StringAt(interned[pos]) == text) {
+            return interned[pos];
+        }
+    }
+
+    uint32_t ref = AppendString(text);
+    interned[pos] = ref;
+    internedCount++;
+    return ref;
+}
+
+size_t RecordStore::IndexHome(std::string_view fqdn) const {
+    // Scale the hash onto the table, which need not be a power of two
+    uint64_t hash = HashOf(fqdn);
+    uint64_t folded = (hash ^ (hash >> 32)) & 0xFFFFFFFFu;
+    return static_cast<size_t>((folded * index.size()) >> 32);
+}
+
+void RecordStore::IndexInsert(Slot slot) {
+    if ((liveCount + 1) * kIndexLoadDen > index.size() * kIndexLoadNum) {
+        RehashIndex(std::max<size_t>(16, index.size() * 2));
+    }
+
+    size_t pos = IndexHome(Fqdn(slot));
+    while (index[pos] != InvalidSlot) {
+        pos = IndexNext(pos);
+    }
+    index[pos] = slot;
+}
+
+void RecordStore::IndexErase(Slot slot) {
+    size_t hole = IndexHome(Fqdn(slot));
+    while (index[hole] != slot) {
+        hole = IndexNext(hole);
+    }
+
+    // Backward-shift deletion keeps probe chains intact without tombstones
+    const size_t size = index.size();
+    for (size_t next = IndexNext(hole); index[next] != InvalidSlot; next = IndexNext(next)) {
+        size_t home = IndexHome(Fqdn(index[next]));
+        if ((next + size - home) % size >= (next + size - hole) % size) {
+            index[hole] = index[next];
+            hole = next;
+        }
+    }
+    index[hole] = InvalidSlot;
+}
+
+void RecordStore::RehashIndex(size_t size) {
+    std::vector<Slot> old;
+    old.swap(index);
+    index.assign(size, InvalidSlot);
+
+    for (Slot slot : old) {
+        if (slot != InvalidSlot) {
+            size_t pos = IndexHome(Fqdn(slot));
+            while (index[pos] != InvalidSlot) {
+                pos = IndexNext(pos);
+            }
+            index[pos] = slot;
+        }
+    }
+}
+
+void RecordStore::CompactStrings() {
+    RecordStore compacted;
+    compacted.strings.reserve(strings.size() - deadStringBytes);
+
+    // Slots and the FQDN index stay valid: only arena references move
+    for (Slot slot = 0; slot < SlotCount(); slot++) {
+        if (fqdnRefs[slot] == InvalidRef) {
+            continue;
+        }
+        fqdnRefs[slot] = compacted.AppendString(Fqdn(slot));
+
+        if (flags[slot] & FlagKeywordText) {
+            uint32_t ref;
+            std::copy(keywordIds[slot].begin(), keywordIds[slot].begin() + sizeof(ref),
+                      reinterpret_cast<uint8_t*>(&ref));
+            ref = compacted.AppendString(StringAt(ref));
+            std::copy(reinterpret_cast<const uint8_t*>(&ref),
+                      reinterpret_cast<const uint8_t*>(&ref) + sizeof(ref), keywordIds[slot].begin());
+        }
+    }
+
+    for (auto& rule : customRules) {
+        rule.second = compacted.Intern(StringAt(rule.second));
+    }
+
+    strings.swap(compacted.strings);
+    interned.swap(compacted.interned);
+    internedCount = compacted.internedCount;
+    deadStringBytes = 0;
+}
+
+void RecordStore::CompactAddresses() {
+    std::vector<uint8_t> pool;
+    pool.reserve(addressPool.size() - deadAddressBytes);
+
+    for (Slot slot = 0; slot < SlotCount(); slot++) {
+        if (fqdnRefs[slot] == InvalidRef) {
+            continue;
+        }
+        uint32_t offset = static_cast<uint32_t>(pool.size());
+        const uint8_t* list = addressPool.data() + addressOffsets[slot];
+        pool.insert(pool.end(), list, list + EncodedSize(list));
+        addressOffsets[slot] = offset;
+    }
+
+    addressPool.swap(pool);
+    deadAddressBytes = 0;
+}
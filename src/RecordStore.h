@@ -0,0 +1,248 @@
+#ifndef RECORDSTORE_H
+#define RECORDSTORE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <array>
+#include <unordered_map>
+#include <ctime>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief Record structure for tracking blocked FQDNs
+ */
+struct Record {
+    std::string fqdn;                      // Fully Qualified Domain Name
+    std::string keywordId;                 // GUID for dynamic keyword address
+    std::string ruleName;                  // Firewall rule name
+    std::time_t blockedAt;                 // Timestamp when blocked
+    std::time_t changedAt;                 // Timestamp of the last address change, 0 if never
+    std::vector<std::string> lastResolvedIPs;  // Last resolved IP addresses
+    int interval;                          // Refresh interval in minutes
+    std::vector<std::time_t> lastSeen;     // Per address: when DNS last returned it, 0 if in the
+                                           // latest answer; empty if all were
+
+    /**
+     * @brief Default constructor
+     */
+    Record();
+
+    /**
+     * @brief Parameterized constructor
+     */
+    Record(const std::string& fqdn, const std::string& keywordId,
+           const std::string& ruleName, const std::vector<std::string>& ips, int interval);
+};
+
+/**
+ * @brief Compact in-memory layout for the blocked FQDN records
+ *
+ * Structure of arrays indexed by a dense slot number. Slots are stable for
+ * the lifetime of a record and reused after it is erased, so other
+ * components (the scheduler) can refer to a record by slot instead of by
+ * FQDN string.
+ *
+ * - FQDNs are stored once in a bump-allocated string arena and found
+ *   through an open-addressing hash table of slots.
+ * - Rule names of the default form "Block <fqdn>" cost nothing; any other
+ *   rule name is interned in the arena and shared between records.
+ * - Keyword GUIDs are kept as 16 raw bytes. Identifiers that are not in
+ *   the canonical lowercase form are kept as text so they round-trip.
+ * - Addresses live in one packed pool: a header byte with the IPv4 and
+ *   IPv6 counts, then 4 or 16 bytes per address (IPv4 first). Lists with
+ *   text that is not a plain address fall back to tagged entries.
+ * - Refresh intervals take 2 bytes; the rare interval outside 0..65534
+ *   minutes is kept in a side table.
+ * - Last-seen times are kept only for records that still hold addresses
+ *   DNS no longer returns (sticky aging), as 4 bytes per address.
+ *
+ * Space left behind by erased records and shrinking address lists is
+ * reclaimed once it exceeds half of the arena or pool. Not thread-safe;
+ * AuditLogger publishes stores as immutable snapshots.
+ */
+class RecordStore {
+public:
+    typedef uint32_t Slot;
+    static const Slot InvalidSlot = 0xFFFFFFFFu;
+
+    /**
+     * @brief Bytes held by each part of the store (allocated capacity)
+     */
+    struct MemoryUsage {
+        size_t columns;      // Per-slot fixed-size arrays
+        size_t strings;      // FQDN / rule name / keyword text arena
+        size_t addresses;    // Packed address pool
+        size_t index;        // FQDN hash table, intern table, free list, custom rule names, last-seen times
+
+        size_t Total() const { return columns + strings + addresses + index; }
+    };
+
+    RecordStore();
+
+    /**
+     * @brief Reserve room for a number of records
+     * @param records Expected record count
+     */
+    void Reserve(size_t records);
+
+    /**
+     * @brief Release unused capacity (after a bulk load)
+     */
+    void ShrinkToFit();
+
+    /**
+     * @brief Add a record
+     *
+     * Addresses that do not fit the list limit are handled as in SetAddresses().
+     * @param record Record to add
+     * @return Slot of the new record, InvalidSlot if the FQDN is already present
+     */
+    Slot Insert(const Record& record);
+
+    /**
+     * @brief Remove a record; its slot may be reused by a later Insert
+     * @param slot Slot to remove
+     * @return true if the slot held a record
+     */
+    bool Erase(Slot slot);
+
+    /**
+     * @brief Replace the addresses of a record
+     *
+     * ChangedAt() moves to the current time if the set of addresses differs.
+     * Addresses past the 64 KiB list limit are dropped, and text entries
+     * are cut to 255 bytes; both are logged and counted.
+     * @param slot Slot to update
+     * @param ips New addresses
+     * @return true if the slot holds a record
+     */
+    bool SetAddresses(Slot slot, const std::vector<std::string>& ips);
+
+    /**
+     * @brief Replace the addresses of a record along with when each was last seen
+     * @param slot Slot to update
+     * @param ips New addresses
+     * @param lastSeen Per address in ips: when DNS last returned it, 0 if in
+     *        the latest answer; empty if all were
+     * @return true if the slot holds a record
+     */
+    bool SetAddresses(Slot slot, const std::vector<std::string>& ips, const std::vector<std::time_t>& lastSeen);
+
+    /**
+     * @brief Look up a record by FQDN
+     * @param fqdn FQDN to search for
+     * @return Slot of the record, InvalidSlot if not present
+     */
+    Slot Find(std::string_view fqdn) const;
+
+    /**
+     * @brief Check whether a slot holds a record
+     */
+    bool IsLive(Slot slot) const;
+
+    /**
+     * @brief Number of records
+     */
+    size_t Size() const { return liveCount; }
+
+    /**
+     * @brief One past the highest slot ever used
+     */
+    Slot SlotCount() const { return static_cast<Slot>(fqdnRefs.size()); }
+
+    /**
+     * @brief Slots of all records, in slot order
+     */
+    std::vector<Slot> LiveSlots() const;
+
+    // Field accessors; the slot must hold a record. Fqdn() points into the
+    // store and is valid until the store is modified.
+    std::string_view Fqdn(Slot slot) const;
+    std::string RuleName(Slot slot) const;
+    std::string KeywordId(Slot slot) const;
+    std::time_t BlockedAt(Slot slot) const { return static_cast<std::time_t>(blockedAts[slot]); }
+    std::time_t ChangedAt(Slot slot) const { return static_cast<std::time_t>(changedAts[slot]); }
+    int Interval(Slot slot) const;
+    std::vector<std::string> Addresses(Slot slot) const;
+    size_t AddressCount(Slot slot) const;
+
+    /**
+     * @brief When DNS last returned each address of a record
+     * @param slot Slot to read
+     * @return Per address in Addresses() order, 0 if in the latest answer;
+     *         empty if all were
+     */
+    std::vector<std::time_t> LastSeen(Slot slot) const;
+
+    /**
+     * @brief Compare the stored addresses of a record with a new list, ignoring order
+     * @param slot Slot to compare
+     * @param ips Candidate addresses
+     * @return true if both hold the same addresses
+     */
+    bool SameAddresses(Slot slot, const std::vector<std::string>& ips) const;
+
+    /**
+     * @brief Expand a record into the owning Record form
+     * @param slot Slot to read
+     * @return Copy of the record
+     */
+    Record Get(Slot slot) const;
+
+    /**
+     * @brief Measure the memory held by the store
+     * @return Allocated bytes by component
+     */
+    MemoryUsage Memory() const;
+
+private:
+    static const uint32_t InvalidRef = 0xFFFFFFFFu;
+
+    enum Flags : uint8_t {
+        FlagCustomRule = 0x01,    // Rule name is in customRules rather than derived from the FQDN
+        FlagKeywordText = 0x02    // keywordIds holds an arena reference instead of GUID bytes
+    };
+
+    uint32_t AppendString(std::string_view text);
+    std::string_view StringAt(uint32_t ref) const;
+    uint32_t Intern(std::string_view text);
+    size_t StringFootprint(uint32_t ref) const;
+
+    size_t IndexHome(std::string_view fqdn) const;
+    size_t IndexNext(size_t pos) const { return pos + 1 == index.size() ? 0 : pos + 1; }
+    void IndexInsert(Slot slot);
+    void IndexErase(Slot slot);
+    void RehashIndex(size_t size);
+
+    void StoreLastSeen(Slot slot, const std::vector<std::string>& ips, const std::vector<std::time_t>& times);
+
+    void CompactStrings();
+    void CompactAddresses();
+
+    // Per-slot columns
+    std::vector<uint32_t> fqdnRefs;                       // Arena reference, InvalidRef for a free slot
+    std::vector<std::array<uint8_t, 16>> keywordIds;
+    std::vector<uint32_t> blockedAts;                     // Seconds since 1970, valid to 2106
+    std::vector<uint32_t> changedAts;                     // Last change of the address set, same clock
+    std::vector<uint16_t> intervals;                      // Minutes; kLargeInterval means see largeIntervals
+    std::vector<uint32_t> addressOffsets;                 // Into addressPool; lists carry their own length
+    std::vector<uint8_t> flags;
+
+    std::vector<char> strings;                            // Length-prefixed strings
+    std::vector<uint8_t> addressPool;
+    std::vector<Slot> index;                              // Open addressing, linear probing, at most 80% full
+    std::vector<uint32_t> interned;                       // Open addressing set of arena references
+    std::unordered_map<Slot, uint32_t> customRules;       // Slot -> interned rule name
+    std::unordered_map<Slot, int32_t> largeIntervals;     // Slot -> interval that does not fit 16 bits
+    std::unordered_map<Slot, std::vector<uint32_t>> lastSeen;  // Slot -> seconds since 1970 per address, 0 if current
+    std::vector<Slot> freeSlots;
+
+    size_t liveCount;
+    size_t internedCount;
+    size_t deadStringBytes;
+    size_t deadAddressBytes;
+};
+
+#endif // RECORDSTORE_H
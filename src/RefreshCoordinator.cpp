@@ -0,0 +1,202 @@
+#include "RefreshCoordinator.h"
+#include "Log.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <functional>
+#include <numeric>
+
+// Initialize static members
+std::mutex RefreshCoordinator::coordinatorMutex;
+std::condition_variable RefreshCoordinator::flightDone;
+std::unordered_map<std::string, std::shared_ptr<RefreshCoordinator::Flight>> RefreshCoordinator::inFlight;
+std::vector<RefreshCoordinator::Freshness> RefreshCoordinator::freshness;
+const std::chrono::steady_clock::time_point RefreshCoordinator::epoch = std::chrono::steady_clock::now();
+
+RefreshPipeline::Result RefreshCoordinator::Refresh(const AuditSnapshotPtr& snapshot,
+                                                    const std::vector<RecordStore::Slot>& slots,
+                                                    const RefreshPipeline::Options& options) {
+    static Counter& joinedTotal = Metrics::GetCounter("fqdn_refresh_coalesced_total",
+        "FQDN refreshes served by another run instead of a pipeline pass of their own", "reason=\"joined\"");
+    static Counter& freshTotal = Metrics::GetCounter("fqdn_refresh_coalesced_total",
+        "FQDN refreshes served by another run instead of a pipeline pass of their own", "reason=\"fresh\"");
+
+    auto startTime = std::chrono::steady_clock::now();
+    const RecordStore& store = snapshot->store;
+    const bool forced = options.forceApply;
+
+    RefreshPipeline::Result result;
+    result.updated = 0;
+    result.unchanged = 0;
+    result.skipped = 0;
+    result.joined = 0;
+    result.cancelled = 0;
+    result.failed = 0;
+    result.items.resize(slots.size());
+    for (size_t i = 0; i < slots.size(); i++) {
+        result.items[i].fqdn = std::string(store.Fqdn(slots[i]));
+        result.items[i].outcome = RefreshPipeline::ItemResult::Unchanged;
+        result.items[i].ipCount = store.AddressCount(slots[i]);
+    }
+
+    // Claim every FQDN nobody else is refreshing; join or skip the rest
+    std::vector<size_t> own;
+    std::vector<std::shared_ptr<Flight>> ownFlights;
+    std::vector<std::pair<size_t, std::shared_ptr<Flight>>> joined;
+    {
+        std::unique_lock<std::mutex> lock(coordinatorMutex);
+        const uint32_t now = Now();
+
+        std::vector<size_t> pending(slots.size());
+        std::iota(pending.begin(), pending.end(), 0);
+        while (!pending.empty()) {
+            std::vector<size_t> blocked;
+            std::shared_ptr<Flight> blocker;
+
+            for (size_t index : pending) {
+                const std::string& fqdn = result.items[index].fqdn;
+                auto it = inFlight.find(fqdn);
+                if (it != inFlight.end()) {
+                    if (!forced || it->second->forced) {
+                        joined.emplace_back(index, it->second);
+                    }
+                    else {
+                        blocked.push_back(index);
+                        blocker = it->second;
+                    }
+                    continue;
+                }
+
+                if (!forced && IsFresh(slots[index], fqdn, options.freshnessSeconds, now)) {
+                    result.items[index].outcome = RefreshPipeline::ItemResult::Skipped;
+                    continue;
+                }
+
+                auto flight = std::make_shared<Flight>(forced);
+                inFlight.emplace(fqdn, flight);
+                own.push_back(index);
+                ownFlights.push_back(flight);
+            }
+
+            pending.swap(blocked);
+            if (!pending.empty()) {
+                flightDone.wait(lock, [&blocker]() { return blocker->done; });
+            }
+        }
+    }
+
+    // Refresh the claimed FQDNs
+    bool passFailed = false;
+    if (!own.empty()) {
+        std::vector<RecordStore::Slot> ownSlots;
+        ownSlots.reserve(own.size());
+        for (size_t index : own) {
+            ownSlots.push_back(slots[index]);
+        }
+
+        try {
+            RefreshPipeline::Result pass = RefreshPipeline::Run(snapshot, ownSlots, options);
+            for (size_t k = 0; k < own.size(); k++) {
+                result.items[own[k]] = std::move(pass.items[k]);
+            }
+            result.stages = std::move(pass.stages);
+        }
+        catch (const std::exception& e) {
+            LOG_ERROR("Refresh pass failed: " << e.what());
+            passFailed = true;
+        }
+    }
+
+    // Hand the outcomes to joined requests before waiting on other runs, so
+    // two runs that joined each other cannot wait forever
+    {
+        std::unique_lock<std::mutex> lock(coordinatorMutex);
+        const uint32_t now = Now();
+
+        for (size_t k = 0; k < own.size(); k++) {
+            RefreshPipeline::ItemResult& item = result.items[own[k]];
+            if (passFailed) {
+                item.outcome = RefreshPipeline::ItemResult::ResolveFailed;
+            }
+
+            ownFlights[k]->result = item;
+            ownFlights[k]->done = true;
+            inFlight.erase(item.fqdn);
+
+            if (item.outcome == RefreshPipeline::ItemResult::Updated ||
+                item.outcome == RefreshPipeline::ItemResult::Unchanged) {
+                RecordStore::Slot slot = slots[own[k]];
+                if (freshness.size() <= slot) {
+                    freshness.resize(static_cast<size_t>(slot) + 1, Freshness{ 0, 0 });
+                }
+                freshness[slot] = Freshness{ HashOf(item.fqdn), now + 1 };
+            }
+        }
+        flightDone.notify_all();
+
+        flightDone.wait(lock, [&joined]() {
+            return std::all_of(joined.begin(), joined.end(),
+                [](const std::pair<size_t, std::shared_ptr<Flight>>& entry) { return entry.second->done; });
+        });
+        for (const auto& entry : joined) {
+            result.items[entry.first].outcome = entry.second->result.outcome;
+            result.items[entry.first].ipCount = entry.second->result.ipCount;
+        }
+    }
+
+    for (const auto& item : result.items) {
+        switch (item.outcome) {
+        case RefreshPipeline::ItemResult::Updated:
+            result.updated++;
+            break;
+        case RefreshPipeline::ItemResult::Unchanged:
+            result.unchanged++;
+            break;
+        case RefreshPipeline::ItemResult::Skipped:
+            result.skipped++;
+            break;
+        case RefreshPipeline::ItemResult::Cancelled:
+            result.cancelled++;
+            break;
+        default:
+            result.failed++;
+            break;
+        }
+    }
+    result.joined = joined.size();
+
+    joinedTotal.Increment(result.joined);
+    freshTotal.Increment(result.skipped);
+    if (result.joined > 0 || result.skipped > 0) {
+        LOG_DEBUG("Refresh coalesced: " << result.joined << " joined an in-flight refresh, "
+                  << result.skipped << " refreshed recently");
+    }
+
+    result.elapsedMs = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - startTime).count() / 1000.0;
+    return result;
+}
+
+void RefreshCoordinator::Reset() {
+    std::lock_guard<std::mutex> lock(coordinatorMutex);
+    freshness.clear();
+    freshness.shrink_to_fit();
+}
+
+uint32_t RefreshCoordinator::Now() {
+    return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::steady_clock::now() - epoch).count());
+}
+
+uint32_t RefreshCoordinator::HashOf(const std::string& fqdn) {
+    return static_cast<uint32_t>(std::hash<std::string>()(fqdn));
+}
+
+bool RefreshCoordinator::IsFresh(RecordStore::Slot slot, const std::string& fqdn, int windowSeconds, uint32_t now) {
+    if (windowSeconds <= 0 || slot >= freshness.size()) {
+        return false;
+    }
+
+    const Freshness& entry = freshness[slot];
+    return entry.refreshedAt != 0 && entry.fqdnHash == HashOf(fqdn) &&
+           now - (entry.refreshedAt - 1) < static_cast<uint32_t>(windowSeconds);
+}
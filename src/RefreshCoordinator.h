@@ -0,0 +1,81 @@
+#ifndef REFRESHCOORDINATOR_H
+#define REFRESHCOORDINATOR_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <memory>
+#include <chrono>
+#include <cstdint>
+
+#include "RefreshPipeline.h"
+
+/**
+ * @brief Single-flight front end of the refresh pipeline
+ *
+ * The scheduler, the refresh command and boot pre-hydration all refresh
+ * through here, so an FQDN is never resolved and pushed to the firewall by
+ * two runs at once:
+ *
+ * - An FQDN that another run is already refreshing is not refreshed again;
+ *   the request joins that run and reports its outcome.
+ * - An FQDN refreshed successfully within Options::freshnessSeconds is
+ *   skipped (ItemResult::Skipped).
+ *
+ * Forced runs (Options::forceApply) never skip, and wait for an unforced
+ * run of the same FQDN to finish rather than joining it, since that run
+ * may leave the firewall untouched.
+ */
+class RefreshCoordinator {
+public:
+    /**
+     * @brief Refresh a set of records, coalescing with concurrent refreshes
+     * @param snapshot Audit snapshot the records are read from
+     * @param slots Slots of the records to refresh
+     * @param options Pipeline options
+     * @return Outcome for every requested record; stage statistics cover
+     *         only the records this call refreshed itself
+     */
+    static RefreshPipeline::Result Refresh(const AuditSnapshotPtr& snapshot,
+                                           const std::vector<RecordStore::Slot>& slots,
+                                           const RefreshPipeline::Options& options);
+
+    /**
+     * @brief Forget when records were last refreshed
+     */
+    static void Reset();
+
+private:
+    /**
+     * @brief One in-progress refresh of an FQDN
+     */
+    struct Flight {
+        bool forced;
+        bool done;
+        RefreshPipeline::ItemResult result;
+
+        explicit Flight(bool forced) : forced(forced), done(false) {}
+    };
+
+    /**
+     * @brief Last successful refresh of a slot
+     */
+    struct Freshness {
+        uint32_t fqdnHash;       // Tells a reused slot apart from its previous record
+        uint32_t refreshedAt;    // Seconds since epoch plus one, 0 if never
+    };
+
+    static uint32_t Now();
+    static uint32_t HashOf(const std::string& fqdn);
+    static bool IsFresh(RecordStore::Slot slot, const std::string& fqdn, int windowSeconds, uint32_t now);
+
+    static std::mutex coordinatorMutex;
+    static std::condition_variable flightDone;
+    static std::unordered_map<std::string, std::shared_ptr<Flight>> inFlight;
+    static std::vector<Freshness> freshness;                 // Indexed by slot
+    static const std::chrono::steady_clock::time_point epoch;
+};
+
+#endif // REFRESHCOORDINATOR_H
@@ -0,0 +1,426 @@
+#include "RefreshPipeline.h"
+#include "BoundedQueue.h"
+#include "CancellationToken.h"
+#include "Config.h"
+#include "Log.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "FirewallWriteQueue.h"
+#include "Resolver.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <functional>
+#include <iomanip>
+#include <memory>
+#include <thread>
+
+namespace {
+
+// Upper bound on records written by one audit store save in the commit stage
+const size_t kCommitBatchSize = 512;
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @brief Lock-free per-stage latency accumulator
+ */
+struct StageCounter {
+    std::atomic<size_t> processed{0};
+    std::atomic<uint64_t> totalNs{0};
+    std::atomic<uint64_t> maxNs{0};
+    Histogram& latency;
+
+    explicit StageCounter(Histogram& latency) : latency(latency) {}
+
+    void Record(Clock::time_point start, size_t items = 1) {
+        uint64_t ns = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+        processed += items;
+        totalNs += ns;
+        latency.ObserveNanoseconds(ns);
+
+        uint64_t seen = maxNs.load();
+        while (ns > seen && !maxNs.compare_exchange_weak(seen, ns)) {
+        }
+    }
+};
+
+struct WorkItem {
+    size_t index;
+    RecordStore::Slot slot;
+    std::vector<std::string> ips;
+    uint32_t ttl;                       // Lowest answer TTL, 0 if unknown
+    std::vector<std::time_t> lastSeen;  // Per address in ips, 0 if in this answer
+    bool apply;                         // Needs a firewall write; otherwise audit only
+};
+
+/**
+ * @brief Add the stored addresses that are still within their grace period to a fresh answer
+ * @param store Store holding the record
+ * @param item Work item with the fresh answer; gains the lingering addresses and their times
+ * @param now Current time
+ * @param grace Seconds an address stays after the first refresh that misses it
+ * @param aging Set if an address started or stopped aging (audit record needs an update)
+ * @param expired Set to the number of addresses dropped after their grace period
+ * @return true if an address was added or expired (firewall needs an update)
+ */
+bool MergeLingering(const RecordStore& store, WorkItem& item, std::time_t now, std::time_t grace,
+                    bool& aging, size_t& expired) {
+    std::vector<std::string> stored = store.Addresses(item.slot);
+    std::vector<std::time_t> seen = store.LastSeen(item.slot);
+    std::vector<std::string> fresh = item.ips;
+    std::vector<std::string> sortedStored = stored;
+    std::sort(fresh.begin(), fresh.end());
+    std::sort(sortedStored.begin(), sortedStored.end());
+
+    bool changed = false;
+    for (const auto& ip : fresh) {
+        changed = changed || !std::binary_search(sortedStored.begin(), sortedStored.end(), ip);
+    }
+
+    item.lastSeen.assign(item.ips.size(), 0);
+    aging = false;
+    expired = 0;
+    for (size_t i = 0; i < stored.size(); i++) {
+        const std::time_t since = seen.empty() ? 0 : seen[i];
+        if (std::binary_search(fresh.begin(), fresh.end(), stored[i])) {
+            aging = aging || since != 0;
+            continue;
+        }
+
+        if (since != 0 && now - since >= grace) {
+            changed = true;
+            expired++;
+            continue;
+        }
+        aging = aging || since == 0;
+        item.ips.push_back(stored[i]);
+        item.lastSeen.push_back(since != 0 ? since : now);
+    }
+    return changed;
+}
+
+/**
+ * @brief Start a group of workers; the last one to finish runs onLastExit
+ */
+void LaunchWorkers(std::vector<std::thread>& threads, int count, const char* name,
+                   const std::function<void()>& body, const std::function<void()>& onLastExit) {
+    auto remaining = std::make_shared<std::atomic<int>>(count);
+    for (int i = 0; i < count; i++) {
+        threads.emplace_back([remaining, name, body, onLastExit]() {
+            Trace::SetThreadName(name);
+            body();
+            if (--*remaining == 0) {
+                onLastExit();
+            }
+        });
+    }
+}
+
+RefreshPipeline::StageStats MakeStats(const std::string& name, int workers,
+                                      const StageCounter& counter, size_t maxQueueDepth) {
+    RefreshPipeline::StageStats stats;
+    stats.name = name;
+    stats.workers = workers;
+    stats.processed = counter.processed.load();
+    stats.totalLatencyMs = counter.totalNs.load() / 1e6;
+    stats.maxLatencyMs = counter.maxNs.load() / 1e6;
+    stats.maxQueueDepth = maxQueueDepth;
+    return stats;
+}
+
+} // namespace
+
+RefreshPipeline::Options RefreshPipeline::OptionsFromConfig() {
+    Options options;
+    options.resolveWorkers = std::max(1, Config::GetPipelineResolveWorkers());
+    options.applyWorkers = std::max(1, Config::GetPipelineApplyWorkers());
+    options.queueCapacity = static_cast<size_t>(std::max(1, Config::GetPipelineQueueCapacity()));
+    options.freshnessSeconds = std::max(0, Config::GetRefreshFreshnessSeconds());
+    options.graceSeconds = std::max(0, Config::GetAddressGraceMinutes()) * 60;
+    options.graceTtlMultiple = std::max(0, Config::GetAddressGraceTtlMultiple());
+    return options;
+}
+
+const char* RefreshPipeline::DescribeOutcome(ItemResult::Outcome outcome) {
+    switch (outcome) {
+    case ItemResult::Unchanged:
+        return "no changes detected";
+    case ItemResult::Updated:
+        return "IP addresses updated";
+    case ItemResult::ResolveFailed:
+        return "failed to resolve";
+    case ItemResult::ApplyFailed:
+        return "failed to update firewall";
+    case ItemResult::CommitFailed:
+        return "failed to update audit record";
+    case ItemResult::Skipped:
+        return "refreshed recently, skipped";
+    case ItemResult::Cancelled:
+        return "cancelled";
+    }
+    return "unknown";
+}
+
+bool RefreshPipeline::SameAddresses(const std::vector<std::string>& a, const std::vector<std::string>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+
+    std::vector<std::string> sortedA = a;
+    std::vector<std::string> sortedB = b;
+    std::sort(sortedA.begin(), sortedA.end());
+    std::sort(sortedB.begin(), sortedB.end());
+    return sortedA == sortedB;
+}
+
+RefreshPipeline::Result RefreshPipeline::Run(const AuditSnapshotPtr& snapshot,
+                                             const std::vector<RecordStore::Slot>& slots,
+                                             const Options& options) {
+    auto startTime = Clock::now();
+    TraceSpan span("refresh_pipeline", "pipeline", std::to_string(slots.size()) + " record(s)");
+    const RecordStore& store = snapshot->store;
+
+    Result result;
+    result.updated = 0;
+    result.unchanged = 0;
+    result.skipped = 0;
+    result.joined = 0;
+    result.cancelled = 0;
+    result.failed = 0;
+    result.items.resize(slots.size());
+    for (size_t i = 0; i < slots.size(); i++) {
+        result.items[i].fqdn = std::string(store.Fqdn(slots[i]));
+        result.items[i].outcome = ItemResult::Unchanged;
+        result.items[i].ipCount = store.AddressCount(slots[i]);
+    }
+
+    const int resolveWorkers = std::max(1, options.resolveWorkers);
+    const int applyWorkers = std::max(1, options.applyWorkers);
+
+    BoundedQueue<size_t> resolveQueue(options.queueCapacity);
+    BoundedQueue<WorkItem> diffQueue(options.queueCapacity);
+    BoundedQueue<WorkItem> applyQueue(options.queueCapacity);
+    BoundedQueue<WorkItem> commitQueue(options.queueCapacity);
+
+    static Histogram& resolveLatency = Metrics::GetHistogram("fqdn_pipeline_stage_seconds",
+        "Per-item (per-batch for commit) processing time of refresh pipeline stages", "stage=\"resolve\"");
+    static Histogram& diffLatency = Metrics::GetHistogram("fqdn_pipeline_stage_seconds",
+        "Per-item (per-batch for commit) processing time of refresh pipeline stages", "stage=\"diff\"");
+    static Histogram& applyLatency = Metrics::GetHistogram("fqdn_pipeline_stage_seconds",
+        "Per-item (per-batch for commit) processing time of refresh pipeline stages", "stage=\"apply\"");
+    static Histogram& commitLatency = Metrics::GetHistogram("fqdn_pipeline_stage_seconds",
+        "Per-item (per-batch for commit) processing time of refresh pipeline stages", "stage=\"commit\"");
+
+    StageCounter resolveCounter(resolveLatency);
+    StageCounter diffCounter(diffLatency);
+    StageCounter applyCounter(applyLatency);
+    StageCounter commitCounter(commitLatency);
+    std::vector<std::thread> threads;
+
+    // Stage 1: DNS resolution
+    LaunchWorkers(threads, resolveWorkers, "pipeline-resolve", [&]() {
+        size_t index;
+        while (resolveQueue.Pop(index)) {
+            if (CancellationToken::IsCancelled(options.cancel)) {
+                result.items[index].outcome = ItemResult::Cancelled;
+                continue;
+            }
+
+            auto t0 = Clock::now();
+            Resolver::Resolution resolution;
+            try {
+                resolution = Resolver::Resolve(result.items[index].fqdn, options.cancel);
+            }
+            catch (const std::exception& e) {
+                LOG_ERROR("Error resolving " << result.items[index].fqdn << ": " << e.what());
+            }
+            resolveCounter.Record(t0);
+
+            std::vector<std::string> ips = std::move(resolution.addresses);
+            const uint32_t ttl = resolution.ttlSeconds;
+            if (resolution.cancelled) {
+                result.items[index].outcome = ItemResult::Cancelled;
+                continue;
+            }
+            if (ips.empty()) {
+                result.items[index].outcome = ItemResult::ResolveFailed;
+                continue;
+            }
+            diffQueue.Push(WorkItem{ index, slots[index], std::move(ips), ttl, {}, true });
+        }
+    }, [&]() { diffQueue.Close(); });
+
+    // Stage 2: change detection, with sticky aging of addresses DNS stopped returning
+    static Counter& expiredTotal = Metrics::GetCounter("fqdn_refresh_addresses_expired_total",
+        "Addresses removed from a blocked set after their grace period");
+    LaunchWorkers(threads, 1, "pipeline-diff", [&]() {
+        WorkItem item;
+        while (diffQueue.Pop(item)) {
+            auto t0 = Clock::now();
+            const std::time_t grace = std::max<std::time_t>(options.graceSeconds,
+                static_cast<std::time_t>(options.graceTtlMultiple) * item.ttl);
+            bool changed;
+            bool aging = false;
+            if (grace > 0) {
+                size_t expired = 0;
+                changed = MergeLingering(store, item, std::time(nullptr), grace, aging, expired);
+                expiredTotal.Increment(expired);
+            }
+            else {
+                changed = !store.SameAddresses(item.slot, item.ips);
+            }
+            diffCounter.Record(t0);
+
+            result.items[item.index].ipCount = item.ips.size();
+            item.apply = changed || options.forceApply;
+            if (item.apply) {
+                applyQueue.Push(std::move(item));
+            }
+            else if (aging) {
+                commitQueue.Push(std::move(item));
+            }
+        }
+    }, [&]() { applyQueue.Close(); });
+
+    // Stage 3: firewall apply
+    LaunchWorkers(threads, applyWorkers, "pipeline-apply", [&]() {
+        WorkItem item;
+        while (applyQueue.Pop(item)) {
+            if (CancellationToken::IsCancelled(options.cancel)) {
+                result.items[item.index].outcome = ItemResult::Cancelled;
+                continue;
+            }
+
+            auto t0 = Clock::now();
+            bool applied = false;
+            try {
+                applied = FirewallWriteQueue::Update(store.KeywordId(item.slot), item.ips, options.cancel);
+            }
+            catch (const std::exception& e) {
+                LOG_ERROR("Error updating firewall for " << result.items[item.index].fqdn << ": " << e.what());
+            }
+            applyCounter.Record(t0);
+
+            if (!applied && CancellationToken::IsCancelled(options.cancel)) {
+                result.items[item.index].outcome = ItemResult::Cancelled;
+                continue;
+            }
+            if (!applied) {
+                result.items[item.index].outcome = ItemResult::ApplyFailed;
+                continue;
+            }
+            commitQueue.Push(std::move(item));
+        }
+    }, [&]() { commitQueue.Close(); });
+
+    // Stage 4: audit commit, batching whatever has accumulated into one snapshot update
+    LaunchWorkers(threads, 1, "pipeline-commit", [&]() {
+        WorkItem item;
+        while (commitQueue.Pop(item)) {
+            std::vector<WorkItem> batch;
+            batch.push_back(std::move(item));
+            while (batch.size() < kCommitBatchSize && commitQueue.TryPop(item)) {
+                batch.push_back(std::move(item));
+            }
+
+            auto t0 = Clock::now();
+            TraceSpan commitSpan("commit_batch", "pipeline", std::to_string(batch.size()) + " record(s)");
+            std::vector<std::pair<std::string, std::vector<std::string>>> updates;
+            std::vector<std::vector<std::time_t>> lastSeen;
+            updates.reserve(batch.size());
+            lastSeen.reserve(batch.size());
+            for (auto& pending : batch) {
+                updates.emplace_back(result.items[pending.index].fqdn, pending.ips);
+                lastSeen.push_back(std::move(pending.lastSeen));
+            }
+            // Only publish here; the audit store file is written once, after the last
+            // batch (other writers save at once, covering these versions too)
+            std::vector<bool> committed = AuditLogger::UpdateRecords(updates, lastSeen, true);
+            commitCounter.Record(t0, batch.size());
+
+            for (size_t i = 0; i < batch.size(); i++) {
+                if (!committed[i]) {
+                    result.items[batch[i].index].outcome = ItemResult::CommitFailed;
+                }
+                else if (batch[i].apply) {
+                    result.items[batch[i].index].outcome = ItemResult::Updated;
+                }
+            }
+        }
+    }, []() {});
+
+    // Feed the first stage; blocks whenever the resolvers fall behind
+    {
+        TraceSpan feedSpan("pipeline_feed", "pipeline");
+        for (size_t i = 0; i < slots.size(); i++) {
+            if (CancellationToken::IsCancelled(options.cancel)) {
+                result.items[i].outcome = ItemResult::Cancelled;
+                continue;
+            }
+            resolveQueue.Push(i);
+        }
+        resolveQueue.Close();
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    if (!AuditLogger::Flush()) {
+        LOG_ERROR("Failed to write the audit store after refresh; retrying with the next write");
+    }
+
+    for (const auto& item : result.items) {
+        switch (item.outcome) {
+        case ItemResult::Updated:
+            result.updated++;
+            break;
+        case ItemResult::Unchanged:
+            result.unchanged++;
+            break;
+        case ItemResult::Cancelled:
+            result.cancelled++;
+            break;
+        default:
+            result.failed++;
+            break;
+        }
+    }
+
+    result.stages.push_back(MakeStats("resolve", resolveWorkers, resolveCounter, resolveQueue.MaxDepth()));
+    result.stages.push_back(MakeStats("diff", 1, diffCounter, diffQueue.MaxDepth()));
+    result.stages.push_back(MakeStats("apply", applyWorkers, applyCounter, applyQueue.MaxDepth()));
+    result.stages.push_back(MakeStats("commit", 1, commitCounter, commitQueue.MaxDepth()));
+
+    result.elapsedMs = std::chrono::duration_cast<std::chrono::microseconds>(
+        Clock::now() - startTime).count() / 1000.0;
+
+    return result;
+}
+
+void RefreshPipeline::PrintStats(const Result& result, std::ostream& out) {
+    out << std::left << std::setw(10) << "Stage"
+        << std::right << std::setw(9) << "Workers"
+        << std::setw(10) << "Items"
+        << std::setw(11) << "Avg ms"
+        << std::setw(11) << "Max ms"
+        << std::setw(11) << "Max queue" << "\n";
+
+    out << std::fixed << std::setprecision(2);
+    for (const auto& stage : result.stages) {
+        double avg = stage.processed > 0 ? stage.totalLatencyMs / stage.processed : 0.0;
+        out << std::left << std::setw(10) << stage.name
+            << std::right << std::setw(9) << stage.workers
+            << std::setw(10) << stage.processed
+            << std::setw(11) << avg
+            << std::setw(11) << stage.maxLatencyMs
+            << std::setw(11) << stage.maxQueueDepth << "\n";
+    }
+    out << std::defaultfloat;
+
+    out << "Total: " << result.updated << " updated, " << result.unchanged << " unchanged, "
+        << result.failed << " failed in " << result.elapsedMs << " ms" << std::endl;
+}
@@ -0,0 +1,143 @@
+#ifndef REFRESHPIPELINE_H
+#define REFRESHPIPELINE_H
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cstddef>
+
+#include "AuditLogger.h"
+
+class CancellationToken;
+
+/**
+ * @brief Staged refresh of blocked FQDNs
+ *
+ * Shared by the scheduler, the refresh command and boot pre-hydration.
+ * Records flow through four stages connected by bounded queues:
+ *
+ *   resolve -> change detection -> firewall apply -> audit commit
+ *
+ * Each stage runs its own workers, so slow DNS overlaps with firewall
+ * writes instead of adding to them, and a full queue throttles the stage
+ * feeding it. The audit commit stage batches record updates into new
+ * snapshots, and the audit store file is written once per run.
+ *
+ * Change detection applies sticky aging: an address DNS no longer returns
+ * stays in the set until its grace period has passed since the first
+ * refresh that missed it. The firewall is written only when an address is
+ * added or expires; records whose addresses only start or stop aging are
+ * committed to the audit store alone.
+ *
+ * A run given a cancellation token stops resolving and writing to the
+ * firewall once it is cancelled; in-flight resolutions are abandoned and
+ * the records not yet written are reported as ItemResult::Cancelled.
+ * Firewall writes that did happen are still committed to the audit store.
+ */
+class RefreshPipeline {
+public:
+    /**
+     * @brief Tuning knobs for one pipeline run
+     */
+    struct Options {
+        int resolveWorkers;      // Concurrent DNS resolutions
+        int applyWorkers;        // Concurrent firewall writers
+        size_t queueCapacity;    // Capacity of each inter-stage queue
+        bool forceApply;         // Push to the firewall even if IPs are unchanged (hydration)
+        int freshnessSeconds;    // RefreshCoordinator skips records refreshed this recently (0 = never)
+        int graceSeconds;        // Keep addresses DNS stopped returning this long (0 = drop at once)
+        int graceTtlMultiple;    // ...or this multiple of the answer TTL, if longer
+        const CancellationToken* cancel;   // Abandons the run when cancelled (nullptr = never)
+
+        Options() : resolveWorkers(8), applyWorkers(1), queueCapacity(256), forceApply(false),
+                    freshnessSeconds(0), graceSeconds(0), graceTtlMultiple(0), cancel(nullptr) {}
+    };
+
+    /**
+     * @brief Outcome for a single record
+     */
+    struct ItemResult {
+        enum Outcome {
+            Unchanged,
+            Updated,
+            ResolveFailed,
+            ApplyFailed,
+            CommitFailed,
+            Skipped,         // Refreshed recently (RefreshCoordinator)
+            Cancelled        // Not finished when the run was cancelled
+        };
+
+        std::string fqdn;
+        Outcome outcome;
+        size_t ipCount;
+    };
+
+    /**
+     * @brief Per-stage counters for bottleneck analysis
+     */
+    struct StageStats {
+        std::string name;
+        int workers;
+        size_t processed;
+        double totalLatencyMs;   // Sum of per-item processing time
+        double maxLatencyMs;
+        size_t maxQueueDepth;    // Deepest backlog seen in the stage's input queue
+    };
+
+    /**
+     * @brief Result of a pipeline run
+     */
+    struct Result {
+        std::vector<ItemResult> items;
+        std::vector<StageStats> stages;
+        size_t updated;
+        size_t unchanged;
+        size_t skipped;          // Refreshed recently, not refreshed again
+        size_t joined;           // Served by a concurrent run (RefreshCoordinator)
+        size_t cancelled;        // Abandoned because the run was cancelled
+        size_t failed;
+        double elapsedMs;
+    };
+
+    /**
+     * @brief Build options from the configured pipeline settings
+     * @return Options populated from Config
+     */
+    static Options OptionsFromConfig();
+
+    /**
+     * @brief Refresh a set of records
+     * @note Components refresh through RefreshCoordinator, which keeps two
+     *       runs from refreshing the same FQDN at once
+     * @param snapshot Audit snapshot the records are read from
+     * @param slots Slots of the records to refresh
+     * @param options Pipeline options
+     * @return Per-item outcomes and per-stage statistics
+     */
+    static Result Run(const AuditSnapshotPtr& snapshot, const std::vector<RecordStore::Slot>& slots,
+                      const Options& options);
+
+    /**
+     * @brief Print per-stage statistics as a table
+     * @param result Result of a pipeline run
+     * @param out Stream to print to
+     */
+    static void PrintStats(const Result& result, std::ostream& out);
+
+    /**
+     * @brief Human-readable description of an item outcome
+     * @param outcome Outcome to describe
+     * @return Short description
+     */
+    static const char* DescribeOutcome(ItemResult::Outcome outcome);
+
+    /**
+     * @brief Check whether two IP lists contain the same addresses
+     * @param a First list
+     * @param b Second list
+     * @return true if both contain the same set of addresses
+     */
+    static bool SameAddresses(const std::vector<std::string>& a, const std::vector<std::string>& b);
+};
+
+#endif // REFRESHPIPELINE_H
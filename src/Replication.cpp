@@ -0,0 +1,1459 @@
+#include "Replication.h"
+#include "FirewallManager.h"
+#include "FirewallWriteQueue.h"
+#include "Log.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+
+#ifdef _WIN32
+#include <WinSock2.h>
+#include <WS2tcpip.h>
+
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#ifdef _WIN32
+using SocketHandle = SOCKET;
+const SocketHandle kInvalidSocket = INVALID_SOCKET;
+
+int PollSockets(pollfd* fds, unsigned long count, int timeoutMs) {
+    return WSAPoll(fds, count, timeoutMs);
+}
+
+void CloseSocket(SocketHandle s) {
+    closesocket(s);
+}
+
+void SetBlocking(SocketHandle s, bool blocking) {
+    u_long mode = blocking ? 0 : 1;
+    ioctlsocket(s, FIONBIO, &mode);
+}
+
+void SetSendTimeout(SocketHandle s, int timeoutMs) {
+    DWORD value = static_cast<DWORD>(timeoutMs);
+    setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+const int kShutdownBoth = SD_BOTH;
+const int kSendFlags = 0;
+#else
+using SocketHandle = int;
+const SocketHandle kInvalidSocket = -1;
+
+int PollSockets(pollfd* fds, unsigned long count, int timeoutMs) {
+    return poll(fds, static_cast<nfds_t>(count), timeoutMs);
+}
+
+void CloseSocket(SocketHandle s) {
+    close(s);
+}
+
+void SetBlocking(SocketHandle s, bool blocking) {
+    int flags = fcntl(s, F_GETFL, 0);
+    fcntl(s, F_SETFL, blocking ? (flags & ~O_NONBLOCK) : (flags | O_NONBLOCK));
+}
+
+void SetSendTimeout(SocketHandle s, int timeoutMs) {
+    timeval value;
+    value.tv_sec = timeoutMs / 1000;
+    value.tv_usec = (timeoutMs % 1000) * 1000;
+    setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, &value, sizeof(value));
+}
+
+const int kShutdownBoth = SHUT_RDWR;
+const int kSendFlags = MSG_NOSIGNAL;
+#endif
+
+// Frames are a little-endian u32 length, a u8 type and the payload
+enum class Frame : uint8_t {
+    Hello = 1,              // Follower: magic, protocol, secret, epoch, version
+    Refused = 2,            // Leader: reason
+    SnapshotBegin = 3,      // Leader: epoch, version, record count
+    SnapshotRecords = 4,    // Leader: count, records
+    SnapshotEnd = 5,        // Leader: version
+    Entry = 6,              // Leader: version, count, changes
+    Heartbeat = 7,          // Leader: epoch, last version
+    Ack = 8                 // Follower: last version applied
+};
+
+// Change types in Entry frames: AuditChange::Type, or an address delta of an Update
+const uint8_t kAddressDelta = 3;                // fqdn, changedAt, removed, added at positions, stale addresses
+
+const uint32_t kMagic = 0x50525146;             // "FQRP"
+const uint32_t kProtocol = 2;
+const uint32_t kMaxFrameBytes = 64u << 20;
+const uint32_t kMaxFollowerFrameBytes = 4096;   // Followers only send Hello and Ack frames
+const size_t kMaxJournalBytes = 64u << 20;      // Older versions are dropped beyond this
+const size_t kSnapshotChunk = 1024;             // Records per SnapshotRecords frame
+const int kHeartbeatMs = 1000;
+const int kSilenceTimeoutMs = 5000;             // Follower reconnects after this long without a frame
+const int kSendTimeoutMs = 10000;               // Leader drops a follower that stops reading
+const int kConnectTimeoutMs = 3000;
+const int kMaxBackoffMs = 10000;
+
+/**
+ * @brief Builds a frame payload
+ */
+class FrameWriter {
+public:
+    explicit FrameWriter(Frame type) : buffer(4, '\0') {
+        buffer.push_back(static_cast<char>(type));
+    }
+
+    void U8(uint8_t value) { buffer.push_back(static_cast<char>(value)); }
+
+    void U32(uint32_t value) {
+        for (int i = 0; i < 4; i++) {
+            buffer.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+        }
+    }
+
+    void U64(uint64_t value) {
+        for (int i = 0; i < 8; i++) {
+            buffer.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+        }
+    }
+
+    void Str(const std::string& value) {
+        U32(static_cast<uint32_t>(value.size()));
+        buffer.append(value);
+    }
+
+    void Put(const Record& record) {
+        Str(record.fqdn);
+        Str(record.keywordId);
+        Str(record.ruleName);
+        U64(static_cast<uint64_t>(record.blockedAt));
+        U64(static_cast<uint64_t>(record.changedAt));
+        U32(static_cast<uint32_t>(record.interval));
+        U32(static_cast<uint32_t>(record.lastResolvedIPs.size()));
+        for (const auto& ip : record.lastResolvedIPs) {
+            Str(ip);
+        }
+        U32(static_cast<uint32_t>(record.lastSeen.size()));
+        for (std::time_t seen : record.lastSeen) {
+            U64(static_cast<uint64_t>(seen));
+        }
+    }
+
+    /**
+     * @brief Finish the frame and take its bytes
+     */
+    std::string Take() {
+        uint32_t length = static_cast<uint32_t>(buffer.size() - 4);
+        for (int i = 0; i < 4; i++) {
+            buffer[i] = static_cast<char>((length >> (8 * i)) & 0xFF);
+        }
+        return std::move(buffer);
+    }
+
+private:
+    std::string buffer;
+};
+
+/**
+ * @brief Reads a frame payload; every read fails once the payload is exhausted
+ */
+class FrameReader {
+public:
+    explicit FrameReader(const std::string& payload) : data(payload), offset(0), ok(true) {}
+
+    bool Ok() const { return ok; }
+
+    uint8_t U8() {
+        if (!Need(1)) return 0;
+        return static_cast<uint8_t>(data[offset++]);
+    }
+
+    uint32_t U32() {
+        if (!Need(4)) return 0;
+        uint32_t value = 0;
+        for (int i = 0; i < 4; i++) {
+            value |= static_cast<uint32_t>(static_cast<uint8_t>(data[offset++])) << (8 * i);
+        }
+        return value;
+    }
+
+    uint64_t U64() {
+        if (!Need(8)) return 0;
+        uint64_t value = 0;
+        for (int i = 0; i < 8; i++) {
+            value |= static_cast<uint64_t>(static_cast<uint8_t>(data[offset++])) << (8 * i);
+        }
+        return value;
+    }
+
+    std::string Str() {
+        uint32_t length = U32();
+        if (!Need(length)) return std::string();
+        std::string value = data.substr(offset, length);
+        offset += length;
+        return value;
+    }
+
+    bool Get(Record& record) {
+        record.fqdn = Str();
+        record.keywordId = Str();
+        record.ruleName = Str();
+        record.blockedAt = static_cast<std::time_t>(U64());
+        record.changedAt = static_cast<std::time_t>(U64());
+        record.interval = static_cast<int>(U32());
+        uint32_t ips = U32();
+        record.lastResolvedIPs.clear();
+        for (uint32_t i = 0; i < ips && ok; i++) {
+            record.lastResolvedIPs.push_back(Str());
+        }
+        uint32_t seen = U32();
+        record.lastSeen.clear();
+        for (uint32_t i = 0; i < seen && ok; i++) {
+            record.lastSeen.push_back(static_cast<std::time_t>(U64()));
+        }
+        return ok;
+    }
+
+private:
+    bool Need(size_t bytes) {
+        if (!ok || data.size() - offset < bytes) {
+            ok = false;
+        }
+        return ok;
+    }
+
+    const std::string& data;
+    size_t offset;
+    bool ok;
+};
+
+bool SendAll(SocketHandle sock, const std::string& bytes) {
+    static Counter& bytesSent = Metrics::GetCounter("fqdn_replication_bytes_sent_total",
+        "Bytes sent on replication connections");
+
+    const char* ptr = bytes.data();
+    size_t length = bytes.size();
+    while (length > 0) {
+        int sent = static_cast<int>(send(sock, ptr, static_cast<int>(std::min<size_t>(length, 1u << 20)), kSendFlags));
+        if (sent <= 0) {
+            return false;
+        }
+        ptr += sent;
+        length -= static_cast<size_t>(sent);
+    }
+    bytesSent.Increment(bytes.size());
+    return true;
+}
+
+/**
+ * @brief Receive exactly length bytes of a frame that has started
+ * @param cancel Token to give up on, or nullptr
+ * @return false if the connection failed, was cancelled or stalled for kSilenceTimeoutMs
+ */
+bool RecvAll(SocketHandle sock, char* data, size_t length, const CancellationToken* cancel) {
+    const int sliceMs = static_cast<int>(CancellationToken::CheckInterval().count());
+    int silentMs = 0;
+    while (length > 0) {
+        pollfd fd = {};
+        fd.fd = sock;
+        fd.events = POLLIN;
+        int ready = PollSockets(&fd, 1, sliceMs);
+        if (ready < 0 || CancellationToken::IsCancelled(cancel)) {
+            return false;
+        }
+        if (ready == 0) {
+            silentMs += sliceMs;
+            if (silentMs >= kSilenceTimeoutMs) {
+                LOG_WARNING("Replication peer stalled in the middle of a frame");
+                return false;
+            }
+            continue;
+        }
+
+        int received = static_cast<int>(recv(sock, data, static_cast<int>(length), 0));
+        if (received <= 0) {
+            return false;
+        }
+        silentMs = 0;
+        data += received;
+        length -= static_cast<size_t>(received);
+    }
+    return true;
+}
+
+/**
+ * @brief Read one frame, waiting at most waitMs for it to start
+ * @param cancel Token to give up on, or nullptr
+ * @param maxBytes Largest frame accepted; a longer one fails the connection
+ * @return 1 if a frame was read, 0 if none arrived in time, -1 if the connection failed
+ */
+int ReadFrame(SocketHandle sock, int waitMs, Frame& type, std::string& payload,
+              const CancellationToken* cancel, uint32_t maxBytes) {
+    pollfd fd = {};
+    fd.fd = sock;
+    fd.events = POLLIN;
+    int ready = PollSockets(&fd, 1, waitMs);
+    if (ready == 0) {
+        return 0;
+    }
+    if (ready < 0) {
+        return -1;
+    }
+
+    unsigned char header[5];
+    if (!RecvAll(sock, reinterpret_cast<char*>(header), sizeof(header), cancel)) {
+        return -1;
+    }
+    uint32_t length = static_cast<uint32_t>(header[0]) | (static_cast<uint32_t>(header[1]) << 8) |
+                      (static_cast<uint32_t>(header[2]) << 16) | (static_cast<uint32_t>(header[3]) << 24);
+    if (length == 0 || length > maxBytes) {
+        return -1;
+    }
+    type = static_cast<Frame>(header[4]);
+    payload.resize(length - 1);
+    if (!payload.empty() && !RecvAll(sock, &payload[0], payload.size(), cancel)) {
+        return -1;
+    }
+    return 1;
+}
+
+/**
+ * @brief Resolve "host:port" ("[v6]:port" for IPv6) to a TCP address
+ */
+bool ResolveEndpoint(const std::string& endpoint, bool passive, sockaddr_storage& address, socklen_t& length) {
+    size_t colon = endpoint.rfind(':');
+    if (colon == std::string::npos || colon + 1 == endpoint.size()) {
+        LOG_ERROR("Replication endpoint must be host:port: " << endpoint);
+        return false;
+    }
+    std::string host = endpoint.substr(0, colon);
+    std::string port = endpoint.substr(colon + 1);
+    if (host.size() >= 2 && host.front() == '[' && host.back() == ']') {
+        host = host.substr(1, host.size() - 2);
+    }
+
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+
+    struct addrinfo* result = nullptr;
+    int status = getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &result);
+    if (status != 0 || result == nullptr) {
+        LOG_ERROR("Invalid replication endpoint '" << endpoint << "': " << gai_strerror(status));
+        return false;
+    }
+    std::memcpy(&address, result->ai_addr, result->ai_addrlen);
+    length = static_cast<socklen_t>(result->ai_addrlen);
+    freeaddrinfo(result);
+    return true;
+}
+
+std::string PeerName(const sockaddr_storage& address) {
+    char host[INET6_ADDRSTRLEN] = {};
+    uint16_t port = 0;
+    if (address.ss_family == AF_INET) {
+        const sockaddr_in* v4 = reinterpret_cast<const sockaddr_in*>(&address);
+        inet_ntop(AF_INET, &v4->sin_addr, host, sizeof(host));
+        port = ntohs(v4->sin_port);
+        return std::string(host) + ":" + std::to_string(port);
+    }
+    const sockaddr_in6* v6 = reinterpret_cast<const sockaddr_in6*>(&address);
+    inet_ntop(AF_INET6, &v6->sin6_addr, host, sizeof(host));
+    port = ntohs(v6->sin6_port);
+    return "[" + std::string(host) + "]:" + std::to_string(port);
+}
+
+uint64_t NewEpoch() {
+    std::mt19937_64 rng(std::random_device{}());
+    uint64_t value = 0;
+    while (value == 0) {
+        value = rng();
+    }
+    return value;
+}
+
+/**
+ * @brief Encode one version; address updates are sent as the addresses added and removed
+ *
+ * A refresh usually changes one or two addresses of a record, so the delta
+ * is a fraction of the record. Addresses still blocked in their grace
+ * period are sent with their lastSeen time; the rest are current.
+ */
+std::string EncodeEntry(uint64_t version, const std::vector<AuditChange>& changes) {
+    FrameWriter frame(Frame::Entry);
+    frame.U64(version);
+    frame.U32(static_cast<uint32_t>(changes.size()));
+    for (const auto& change : changes) {
+        if (change.type != AuditChange::Update) {
+            frame.U8(static_cast<uint8_t>(change.type));
+            frame.Put(change.record);
+            continue;
+        }
+
+        const std::vector<std::string>& before = change.previousIPs;
+        const std::vector<std::string>& after = change.record.lastResolvedIPs;
+        std::vector<const std::string*> removed;
+        std::vector<uint32_t> added;            // Positions in the new list
+        std::vector<const std::string*> kept;
+        for (const auto& ip : before) {
+            if (std::find(after.begin(), after.end(), ip) == after.end()) {
+                removed.push_back(&ip);
+            }
+            else {
+                kept.push_back(&ip);
+            }
+        }
+        size_t nextKept = 0;
+        bool inOrder = true;
+        for (size_t i = 0; i < after.size(); i++) {
+            if (std::find(before.begin(), before.end(), after[i]) == before.end()) {
+                added.push_back(static_cast<uint32_t>(i));
+            }
+            else if (nextKept < kept.size() && *kept[nextKept] == after[i]) {
+                nextKept++;
+            }
+            else {
+                inOrder = false;
+            }
+        }
+        // Addresses kept but reordered (round-robin answers): send the whole record
+        if (!inOrder) {
+            frame.U8(static_cast<uint8_t>(change.type));
+            frame.Put(change.record);
+            continue;
+        }
+
+        frame.U8(kAddressDelta);
+        frame.Str(change.record.fqdn);
+        frame.U64(static_cast<uint64_t>(change.record.changedAt));
+        frame.U32(static_cast<uint32_t>(removed.size()));
+        for (const std::string* ip : removed) {
+            frame.Str(*ip);
+        }
+        frame.U32(static_cast<uint32_t>(added.size()));
+        for (uint32_t position : added) {
+            frame.U32(position);
+            frame.Str(after[position]);
+        }
+        const std::vector<std::time_t>& seen = change.record.lastSeen;
+        uint32_t stale = 0;
+        for (size_t i = 0; i < seen.size() && i < after.size(); i++) {
+            stale += seen[i] > 0 ? 1 : 0;
+        }
+        frame.U32(stale);
+        for (size_t i = 0; i < seen.size() && i < after.size(); i++) {
+            if (seen[i] > 0) {
+                frame.Str(after[i]);
+                frame.U64(static_cast<uint64_t>(seen[i]));
+            }
+        }
+    }
+    return frame.Take();
+}
+
+/**
+ * @brief Rebuild the record an address delta was made from
+ * @param reader Reader positioned after the change type
+ * @param base Record before the change
+ * @param record Receives the record after the change
+ */
+bool DecodeAddressDelta(FrameReader& reader, const Record& base, Record& record) {
+    record = base;
+    record.changedAt = static_cast<std::time_t>(reader.U64());
+
+    std::vector<std::string>& ips = record.lastResolvedIPs;
+    uint32_t removed = reader.U32();
+    for (uint32_t i = 0; i < removed && reader.Ok(); i++) {
+        std::string ip = reader.Str();
+        ips.erase(std::remove(ips.begin(), ips.end(), ip), ips.end());
+    }
+    uint32_t added = reader.U32();
+    for (uint32_t i = 0; i < added && reader.Ok(); i++) {
+        size_t position = reader.U32();
+        std::string ip = reader.Str();
+        // Replaying a version already applied must not duplicate addresses
+        if (std::find(ips.begin(), ips.end(), ip) == ips.end()) {
+            ips.insert(ips.begin() + static_cast<std::ptrdiff_t>(std::min(position, ips.size())), std::move(ip));
+        }
+    }
+
+    record.lastSeen.clear();
+    uint32_t stale = reader.U32();
+    if (stale > 0) {
+        record.lastSeen.assign(ips.size(), 0);
+    }
+    for (uint32_t i = 0; i < stale && reader.Ok(); i++) {
+        std::string ip = reader.Str();
+        std::time_t seen = static_cast<std::time_t>(reader.U64());
+        auto it = std::find(ips.begin(), ips.end(), ip);
+        if (it != ips.end()) {
+            record.lastSeen[static_cast<size_t>(it - ips.begin())] = seen;
+        }
+    }
+    return reader.Ok();
+}
+
+/**
+ * @brief Read the leader position a follower saved, "epoch version"
+ */
+bool LoadPosition(const std::string& path, uint64_t& epoch, uint64_t& version) {
+    std::ifstream file(path);
+    return file.is_open() && (file >> epoch >> version) && epoch != 0;
+}
+
+bool SavePosition(const std::string& path, uint64_t epoch, uint64_t version) {
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::trunc);
+        if (!file.is_open()) {
+            return false;
+        }
+        file << epoch << " " << version << "\n";
+    }
+#ifdef _WIN32
+    return MoveFileExA(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return std::rename(tempPath.c_str(), path.c_str()) == 0;
+#endif
+}
+
+std::string EncodeHeartbeat(uint64_t epoch, uint64_t version) {
+    FrameWriter frame(Frame::Heartbeat);
+    frame.U64(epoch);
+    frame.U64(version);
+    return frame.Take();
+}
+
+std::string EncodeAck(uint64_t version) {
+    FrameWriter frame(Frame::Ack);
+    frame.U64(version);
+    return frame.Take();
+}
+
+std::string EncodeRefused(const std::string& reason) {
+    FrameWriter frame(Frame::Refused);
+    frame.Str(reason);
+    return frame.Take();
+}
+
+Gauge& FollowersGauge() {
+    static Gauge& gauge = Metrics::GetGauge("fqdn_replication_followers",
+        "Followers connected to this leader");
+    return gauge;
+}
+
+Gauge& VersionGauge() {
+    static Gauge& gauge = Metrics::GetGauge("fqdn_replication_version",
+        "Last audit store version journaled (leader) or applied (follower)");
+    return gauge;
+}
+
+} // namespace
+
+struct Replication::JournalEntry {
+    uint64_t version;
+    std::string frame;      // Encoded Entry frame, shared by every follower
+};
+
+struct Replication::EncodedSnapshot {
+    uint64_t epoch;
+    uint64_t version;
+    size_t records;
+    std::vector<std::string> frames;    // SnapshotBegin, SnapshotRecords..., SnapshotEnd
+};
+
+struct Replication::FollowerLink {
+    SocketHandle sock;
+    std::string address;
+    std::thread thread;
+    std::atomic<bool> done;
+    // Guarded by journalMutex
+    uint64_t ackedVersion;
+    bool streaming;
+    uint64_t snapshots;
+
+    FollowerLink() : sock(kInvalidSocket), done(false), ackedVersion(0), streaming(false), snapshots(0) {}
+};
+
+// Initialize static members
+std::mutex Replication::journalMutex;
+std::condition_variable Replication::journalChanged;
+std::deque<std::shared_ptr<const Replication::JournalEntry>> Replication::journal;
+size_t Replication::journalBytes = 0;
+uint64_t Replication::epoch = 0;
+uint64_t Replication::lastVersion = 0;
+std::string Replication::leaderSecret;
+std::string Replication::listenEndpoint;
+intptr_t Replication::listenSocket = -1;
+std::thread Replication::acceptThread;
+std::vector<std::shared_ptr<Replication::FollowerLink>> Replication::links;
+std::atomic<bool> Replication::leading(false);
+std::mutex Replication::snapshotMutex;
+std::shared_ptr<const Replication::EncodedSnapshot> Replication::snapshotCache;
+
+std::mutex Replication::followerMutex;
+std::string Replication::leaderEndpoint;
+std::string Replication::followerSecret;
+std::string Replication::positionPath;
+std::thread Replication::followThread;
+CancellationToken Replication::followStop;
+uint64_t Replication::followedEpoch = 0;
+uint64_t Replication::appliedVersion = 0;
+bool Replication::connected = false;
+bool Replication::firstSync = true;
+std::chrono::steady_clock::time_point Replication::lastMessage;
+uint64_t Replication::snapshotsReceived = 0;
+uint64_t Replication::versionsApplied = 0;
+std::atomic<bool> Replication::following(false);
+
+// Replication implementation
+bool Replication::StartLeader(const std::string& endpoint, const std::string& secret) {
+    if (leading.load()) {
+        return true;
+    }
+
+#ifdef _WIN32
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        LOG_ERROR("WSAStartup failed");
+        return false;
+    }
+#endif
+
+    sockaddr_storage address = {};
+    socklen_t length = 0;
+    if (!ResolveEndpoint(endpoint, true, address, length)) {
+        return false;
+    }
+
+    SocketHandle sock = socket(address.ss_family, SOCK_STREAM, IPPROTO_TCP);
+    if (sock == kInvalidSocket) {
+        LOG_ERROR("Failed to create replication socket");
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+    if (bind(sock, reinterpret_cast<sockaddr*>(&address), length) != 0 || listen(sock, 16) != 0) {
+        LOG_ERROR("Failed to listen for replication followers on " << endpoint);
+        CloseSocket(sock);
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(journalMutex);
+        journal.clear();
+        journalBytes = 0;
+        epoch = NewEpoch();
+        leaderSecret = secret;
+        listenEndpoint = endpoint;
+        listenSocket = static_cast<intptr_t>(sock);
+    }
+    // Journal versions from here on; lastVersion is what a new follower's snapshot starts from
+    uint64_t current = AuditLogger::SetChangeListener(&Replication::OnChange);
+    {
+        std::lock_guard<std::mutex> lock(journalMutex);
+        if (journal.empty()) {
+            lastVersion = std::max(lastVersion, current);
+        }
+    }
+    VersionGauge().Set(static_cast<int64_t>(current));
+
+    leading = true;
+    acceptThread = std::thread(&Replication::AcceptLoop);
+    LOG_INFO("Replication leader listening on " << endpoint);
+    return true;
+}
+
+void Replication::OnChange(uint64_t version, const std::vector<AuditChange>* changes) {
+    std::lock_guard<std::mutex> lock(journalMutex);
+
+    if (changes == nullptr || version != lastVersion + 1) {
+        // Followers cannot catch up across a replaced store or a gap: start a new epoch
+        journal.clear();
+        journalBytes = 0;
+        epoch = NewEpoch();
+    }
+    else {
+        auto entry = std::make_shared<JournalEntry>();
+        entry->version = version;
+        entry->frame = EncodeEntry(version, *changes);
+        journalBytes += entry->frame.size();
+        journal.push_back(std::move(entry));
+        while (journalBytes > kMaxJournalBytes && journal.size() > 1) {
+            journalBytes -= journal.front()->frame.size();
+            journal.pop_front();
+        }
+    }
+    lastVersion = version;
+    VersionGauge().Set(static_cast<int64_t>(version));
+    journalChanged.notify_all();
+}
+
+void Replication::AcceptLoop() {
+    SocketHandle listener = static_cast<SocketHandle>(listenSocket);
+
+    while (leading.load()) {
+        pollfd fd = {};
+        fd.fd = listener;
+        fd.events = POLLIN;
+        if (PollSockets(&fd, 1, 250) <= 0) {
+            continue;
+        }
+
+        sockaddr_storage peer = {};
+        socklen_t peerLength = sizeof(peer);
+        SocketHandle sock = accept(listener, reinterpret_cast<sockaddr*>(&peer), &peerLength);
+        if (sock == kInvalidSocket) {
+            continue;
+        }
+        int noDelay = 1;
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+        SetSendTimeout(sock, kSendTimeoutMs);
+
+        auto link = std::make_shared<FollowerLink>();
+        link->sock = sock;
+        link->address = PeerName(peer);
+
+        std::vector<std::shared_ptr<FollowerLink>> finished;
+        {
+            std::lock_guard<std::mutex> lock(journalMutex);
+            for (auto it = links.begin(); it != links.end();) {
+                if ((*it)->done.load()) {
+                    finished.push_back(*it);
+                    it = links.erase(it);
+                }
+                else {
+                    ++it;
+                }
+            }
+            links.push_back(link);
+        }
+        for (auto& old : finished) {
+            old->thread.join();
+        }
+        link->thread = std::thread(&Replication::ServeFollower, link);
+    }
+}
+
+std::shared_ptr<const Replication::EncodedSnapshot> Replication::EncodeSnapshot(uint64_t snapshotEpoch) {
+    std::lock_guard<std::mutex> lock(snapshotMutex);
+
+    // Followers connecting together (a fleet after a leader restart) share one encoding
+    AuditSnapshotPtr snapshot = AuditLogger::Snapshot();
+    if (snapshotCache && snapshotCache->epoch == snapshotEpoch && snapshotCache->version == snapshot->version) {
+        return snapshotCache;
+    }
+
+    auto encoded = std::make_shared<EncodedSnapshot>();
+    encoded->epoch = snapshotEpoch;
+    encoded->version = snapshot->version;
+    encoded->records = snapshot->store.Size();
+
+    FrameWriter begin(Frame::SnapshotBegin);
+    begin.U64(snapshotEpoch);
+    begin.U64(snapshot->version);
+    begin.U64(encoded->records);
+    encoded->frames.push_back(begin.Take());
+
+    std::vector<RecordStore::Slot> slots = snapshot->store.LiveSlots();
+    for (size_t start = 0; start < slots.size(); start += kSnapshotChunk) {
+        size_t end = std::min(slots.size(), start + kSnapshotChunk);
+        FrameWriter chunk(Frame::SnapshotRecords);
+        chunk.U32(static_cast<uint32_t>(end - start));
+        for (size_t i = start; i < end; i++) {
+            chunk.Put(snapshot->store.Get(slots[i]));
+        }
+        encoded->frames.push_back(chunk.Take());
+    }
+
+    FrameWriter finish(Frame::SnapshotEnd);
+    finish.U64(snapshot->version);
+    encoded->frames.push_back(finish.Take());
+
+    snapshotCache = encoded;
+    return encoded;
+}
+
+bool Replication::SendSnapshot(FollowerLink& link, uint64_t& version) {
+    static Counter& snapshotsSent = Metrics::GetCounter("fqdn_replication_snapshots_sent_total",
+        "Full snapshots sent to followers");
+
+    uint64_t snapshotEpoch;
+    {
+        std::lock_guard<std::mutex> lock(journalMutex);
+        snapshotEpoch = epoch;
+    }
+
+    // Repeat until the journal is still on the epoch the snapshot was labelled with
+    for (;;) {
+        {
+            std::lock_guard<std::mutex> lock(journalMutex);
+            link.streaming = false;
+            link.snapshots++;
+        }
+        std::shared_ptr<const EncodedSnapshot> encoded = EncodeSnapshot(snapshotEpoch);
+
+        for (const auto& frame : encoded->frames) {
+            if (!leading.load() || !SendAll(link.sock, frame)) {
+                return false;
+            }
+        }
+
+        snapshotsSent.Increment();
+        LOG_INFO("Sent snapshot of " << encoded->records << " record(s) at version " << encoded->version
+                 << " to follower " << link.address);
+
+        std::lock_guard<std::mutex> lock(journalMutex);
+        if (epoch == snapshotEpoch) {
+            link.streaming = true;
+            version = encoded->version;
+            return true;
+        }
+        // The journal moved to a new epoch while the snapshot was taken: send another
+        snapshotEpoch = epoch;
+    }
+}
+
+void Replication::ServeFollower(const std::shared_ptr<FollowerLink>& link) {
+    static Counter& entriesSent = Metrics::GetCounter("fqdn_replication_entries_sent_total",
+        "Audit store versions streamed to followers");
+
+    FollowersGauge().Add(1);
+    Frame type;
+    std::string payload;
+
+    // Handshake
+    bool accepted = false;
+    uint64_t sent = 0;
+    uint64_t sessionEpoch = 0;
+    if (ReadFrame(link->sock, kSilenceTimeoutMs, type, payload, nullptr, kMaxFollowerFrameBytes) == 1 &&
+        type == Frame::Hello) {
+        FrameReader hello(payload);
+        uint32_t magic = hello.U32();
+        uint32_t protocol = hello.U32();
+        std::string secret = hello.Str();
+        uint64_t followerEpoch = hello.U64();
+        uint64_t followerVersion = hello.U64();
+
+        std::string reason;
+        if (!hello.Ok() || magic != kMagic) {
+            reason = "not a replication client";
+        }
+        else if (protocol != kProtocol) {
+            reason = "unsupported protocol version " + std::to_string(protocol);
+        }
+        else if (secret != leaderSecret) {
+            reason = "wrong replication secret";
+        }
+
+        if (!reason.empty()) {
+            LOG_WARNING("Refused replication follower " << link->address << ": " << reason);
+            SendAll(link->sock, EncodeRefused(reason));
+        }
+        else {
+            accepted = true;
+            std::lock_guard<std::mutex> lock(journalMutex);
+            // Resume from the journal when it still holds every version after the follower's
+            bool resumable = followerEpoch == epoch && followerVersion <= lastVersion &&
+                (followerVersion == lastVersion ||
+                 (!journal.empty() && journal.front()->version <= followerVersion + 1));
+            if (resumable) {
+                sent = followerVersion;
+                sessionEpoch = epoch;
+                link->ackedVersion = followerVersion;
+                link->streaming = true;
+            }
+        }
+    }
+
+    bool healthy = accepted;
+    if (accepted) {
+        LOG_INFO("Replication follower connected: " << link->address);
+        if (sessionEpoch == 0) {
+            healthy = SendSnapshot(*link, sent);
+            std::lock_guard<std::mutex> lock(journalMutex);
+            sessionEpoch = epoch;
+        }
+    }
+
+    while (healthy && leading.load()) {
+        std::vector<std::shared_ptr<const JournalEntry>> pending;
+        bool resnapshot = false;
+        uint64_t currentEpoch;
+        uint64_t currentVersion;
+        {
+            std::unique_lock<std::mutex> lock(journalMutex);
+            journalChanged.wait_for(lock, std::chrono::milliseconds(kHeartbeatMs), [&]() {
+                return !leading.load() || epoch != sessionEpoch || lastVersion > sent;
+            });
+            currentEpoch = epoch;
+            currentVersion = lastVersion;
+            if (epoch != sessionEpoch ||
+                (lastVersion > sent && (journal.empty() || journal.front()->version > sent + 1))) {
+                resnapshot = true;
+            }
+            else if (lastVersion > sent) {
+                size_t first = static_cast<size_t>(sent + 1 - journal.front()->version);
+                pending.assign(journal.begin() + static_cast<std::ptrdiff_t>(first), journal.end());
+            }
+        }
+
+        if (!leading.load()) {
+            break;
+        }
+        if (resnapshot) {
+            healthy = SendSnapshot(*link, sent);
+            std::lock_guard<std::mutex> lock(journalMutex);
+            sessionEpoch = epoch;
+            continue;
+        }
+
+        if (pending.empty()) {
+            healthy = SendAll(link->sock, EncodeHeartbeat(currentEpoch, currentVersion));
+        }
+        for (const auto& entry : pending) {
+            if (!SendAll(link->sock, entry->frame)) {
+                healthy = false;
+                break;
+            }
+            sent = entry->version;
+            entriesSent.Increment();
+        }
+
+        // Drain acknowledgements without waiting
+        int status;
+        while (healthy && (status = ReadFrame(link->sock, 0, type, payload, nullptr, kMaxFollowerFrameBytes)) != 0) {
+            if (status < 0) {
+                healthy = false;
+                break;
+            }
+            if (type == Frame::Ack) {
+                FrameReader ack(payload);
+                uint64_t version = ack.U64();
+                std::lock_guard<std::mutex> lock(journalMutex);
+                link->ackedVersion = std::max(link->ackedVersion, version);
+            }
+        }
+    }
+
+    if (accepted) {
+        LOG_INFO("Replication follower disconnected: " << link->address);
+    }
+    CloseSocket(link->sock);
+    FollowersGauge().Add(-1);
+    link->done = true;
+}
+
+bool Replication::StartFollower(const std::string& leader, const std::string& secret, const std::string& statePath) {
+    if (following.load()) {
+        return true;
+    }
+
+#ifdef _WIN32
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        LOG_ERROR("WSAStartup failed");
+        return false;
+    }
+#endif
+
+    sockaddr_storage address = {};
+    socklen_t length = 0;
+    if (!ResolveEndpoint(leader, false, address, length)) {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(followerMutex);
+        leaderEndpoint = leader;
+        followerSecret = secret;
+        positionPath = statePath;
+        connected = false;
+        lastMessage = std::chrono::steady_clock::now();
+
+        // Resume where the last run stopped; the audit store already holds that version
+        uint64_t savedEpoch = 0;
+        uint64_t savedVersion = 0;
+        if (appliedVersion == 0 && !statePath.empty() && LoadPosition(statePath, savedEpoch, savedVersion)) {
+            followedEpoch = savedEpoch;
+            appliedVersion = savedVersion;
+            LOG_INFO("Resuming replication after leader version " << savedVersion);
+        }
+    }
+    followStop.Reset();
+    following = true;
+    followThread = std::thread(&Replication::FollowLoop);
+    LOG_INFO("Following replication leader " << leader);
+    return true;
+}
+
+void Replication::FollowLoop() {
+    static Counter& reconnects = Metrics::GetCounter("fqdn_replication_reconnects_total",
+        "Times a follower lost or could not reach its leader");
+
+    bool restore;
+    {
+        std::lock_guard<std::mutex> lock(followerMutex);
+        restore = firstSync && followedEpoch != 0;
+    }
+    if (restore) {
+        // Resuming skips the first snapshot, which would have pushed every record: push the stored addresses
+        AuditSnapshotPtr snapshot = AuditLogger::Snapshot();
+        for (RecordStore::Slot slot : snapshot->store.LiveSlots()) {
+            if (followStop.IsCancelled()) {
+                return;
+            }
+            FirewallWriteQueue::Update(snapshot->store.KeywordId(slot), snapshot->store.Addresses(slot), &followStop);
+        }
+        LOG_INFO("Restored firewall addresses of " << snapshot->store.Size() << " replicated record(s)");
+        std::lock_guard<std::mutex> lock(followerMutex);
+        firstSync = false;
+    }
+
+    int backoffMs = 500;
+    while (!followStop.IsCancelled()) {
+        sockaddr_storage address = {};
+        socklen_t length = 0;
+        SocketHandle sock = kInvalidSocket;
+        if (ResolveEndpoint(leaderEndpoint, false, address, length)) {
+            sock = socket(address.ss_family, SOCK_STREAM, IPPROTO_TCP);
+        }
+
+        bool established = false;
+        if (sock != kInvalidSocket) {
+            // Connect without blocking so an unreachable leader cannot hold up StopFollower
+            SetBlocking(sock, false);
+            if (connect(sock, reinterpret_cast<sockaddr*>(&address), length) == 0) {
+                established = true;
+            }
+            else {
+                pollfd fd = {};
+                fd.fd = sock;
+                fd.events = POLLOUT;
+                auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(kConnectTimeoutMs);
+                while (!followStop.IsCancelled() && std::chrono::steady_clock::now() < deadline) {
+                    fd.revents = 0;
+                    if (PollSockets(&fd, 1, static_cast<int>(CancellationToken::CheckInterval().count())) > 0) {
+                        int error = 0;
+                        socklen_t errorLength = sizeof(error);
+                        getsockopt(sock, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&error), &errorLength);
+                        established = error == 0;
+                        break;
+                    }
+                }
+            }
+            SetBlocking(sock, true);
+        }
+
+        if (established) {
+            int noDelay = 1;
+            setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+            SetSendTimeout(sock, kSendTimeoutMs);
+            {
+                std::lock_guard<std::mutex> lock(followerMutex);
+                connected = true;
+                lastMessage = std::chrono::steady_clock::now();
+            }
+            uint64_t before = snapshotsReceived + versionsApplied;
+            FollowSession(static_cast<intptr_t>(sock));
+            {
+                std::lock_guard<std::mutex> lock(followerMutex);
+                connected = false;
+                // Retry quickly after a session that made progress
+                if (snapshotsReceived + versionsApplied != before) {
+                    backoffMs = 500;
+                }
+            }
+        }
+        if (sock != kInvalidSocket) {
+            CloseSocket(sock);
+        }
+        if (followStop.IsCancelled()) {
+            break;
+        }
+
+        reconnects.Increment();
+        LOG_WARNING("Lost replication leader " << leaderEndpoint << "; reconnecting in " << backoffMs << " ms");
+        followStop.WaitFor(std::chrono::milliseconds(backoffMs));
+        backoffMs = std::min(kMaxBackoffMs, backoffMs * 2);
+    }
+}
+
+void Replication::FollowSession(intptr_t handle) {
+    static Counter& snapshotsApplied = Metrics::GetCounter("fqdn_replication_snapshots_applied_total",
+        "Full snapshots applied by this follower");
+    static Counter& entriesApplied = Metrics::GetCounter("fqdn_replication_entries_applied_total",
+        "Audit store versions applied by this follower");
+
+    SocketHandle sock = static_cast<SocketHandle>(handle);
+
+    uint64_t helloEpoch;
+    uint64_t helloVersion;
+    {
+        std::lock_guard<std::mutex> lock(followerMutex);
+        helloEpoch = followedEpoch;
+        helloVersion = appliedVersion;
+    }
+    FrameWriter hello(Frame::Hello);
+    hello.U32(kMagic);
+    hello.U32(kProtocol);
+    hello.Str(followerSecret);
+    hello.U64(helloEpoch);
+    hello.U64(helloVersion);
+    if (!SendAll(sock, hello.Take())) {
+        return;
+    }
+
+    RecordStore staging;
+    uint64_t stagingEpoch = 0;
+    uint64_t stagingVersion = 0;
+    bool inSnapshot = false;
+    int silentMs = 0;
+    Frame type;
+    std::string payload;
+
+    while (!followStop.IsCancelled()) {
+        int waitMs = static_cast<int>(CancellationToken::CheckInterval().count()) * 10;
+        int status = ReadFrame(sock, waitMs, type, payload, &followStop, kMaxFrameBytes);
+        if (status < 0) {
+            return;
+        }
+        if (status == 0) {
+            silentMs += waitMs;
+            if (silentMs >= kSilenceTimeoutMs) {
+                LOG_WARNING("Replication leader silent for " << silentMs << " ms");
+                return;
+            }
+            continue;
+        }
+        silentMs = 0;
+        {
+            std::lock_guard<std::mutex> lock(followerMutex);
+            lastMessage = std::chrono::steady_clock::now();
+        }
+
+        FrameReader reader(payload);
+        switch (type) {
+        case Frame::Refused: {
+            LOG_ERROR("Replication leader refused this follower: " << reader.Str());
+            return;
+        }
+        case Frame::SnapshotBegin: {
+            stagingEpoch = reader.U64();
+            stagingVersion = reader.U64();
+            uint64_t count = reader.U64();
+            staging = RecordStore();
+            staging.Reserve(static_cast<size_t>(std::min<uint64_t>(count, 1u << 24)));
+            inSnapshot = reader.Ok();
+            break;
+        }
+        case Frame::SnapshotRecords: {
+            uint32_t count = reader.U32();
+            Record record;
+            for (uint32_t i = 0; i < count && inSnapshot; i++) {
+                if (!reader.Get(record)) {
+                    inSnapshot = false;
+                }
+                else {
+                    staging.Insert(record);
+                }
+            }
+            break;
+        }
+        case Frame::SnapshotEnd: {
+            if (!inSnapshot || reader.U64() != stagingVersion) {
+                LOG_ERROR("Malformed replication snapshot");
+                return;
+            }
+            inSnapshot = false;
+
+            // Mirror the differences to the firewall, then swap the records in
+            AuditSnapshotPtr current = AuditLogger::Snapshot();
+            bool force;
+            {
+                std::lock_guard<std::mutex> lock(followerMutex);
+                force = firstSync;
+            }
+            for (RecordStore::Slot slot : current->store.LiveSlots()) {
+                if (staging.Find(current->store.Fqdn(slot)) == RecordStore::InvalidSlot) {
+                    Record before = current->store.Get(slot);
+                    SyncFirewall(&before, nullptr, false);
+                }
+            }
+            for (RecordStore::Slot slot : staging.LiveSlots()) {
+                Record after = staging.Get(slot);
+                RecordStore::Slot old = current->store.Find(after.fqdn);
+                if (old == RecordStore::InvalidSlot) {
+                    SyncFirewall(nullptr, &after, force);
+                }
+                else {
+                    Record before = current->store.Get(old);
+                    SyncFirewall(&before, &after, force);
+                }
+            }
+            size_t records = staging.Size();
+            if (!AuditLogger::ReplaceRecords(std::move(staging))) {
+                return;
+            }
+            staging = RecordStore();
+
+            {
+                std::lock_guard<std::mutex> lock(followerMutex);
+                followedEpoch = stagingEpoch;
+                appliedVersion = stagingVersion;
+                firstSync = false;
+                snapshotsReceived++;
+                if (!positionPath.empty()) {
+                    SavePosition(positionPath, followedEpoch, appliedVersion);
+                }
+            }
+            snapshotsApplied.Increment();
+            VersionGauge().Set(static_cast<int64_t>(stagingVersion));
+            LOG_INFO("Applied replication snapshot of " << records << " record(s) at version " << stagingVersion);
+            if (!SendAll(sock, EncodeAck(stagingVersion))) {
+                return;
+            }
+            break;
+        }
+        case Frame::Entry: {
+            uint64_t version = reader.U64();
+            uint64_t expected;
+            {
+                std::lock_guard<std::mutex> lock(followerMutex);
+                expected = appliedVersion + 1;
+            }
+            if (version != expected) {
+                LOG_WARNING("Replication gap: expected version " << expected << ", got " << version);
+                return;
+            }
+
+            AuditSnapshotPtr current = AuditLogger::Snapshot();
+            uint32_t count = reader.U32();
+            std::vector<AuditChange> changes;
+            changes.reserve(std::min<uint32_t>(count, 1u << 16));
+            for (uint32_t i = 0; i < count && reader.Ok(); i++) {
+                AuditChange change;
+                uint8_t changeType = reader.U8();
+                if (reader.Ok() && changeType != AuditChange::Add && changeType != AuditChange::Update &&
+                    changeType != AuditChange::Remove && changeType != kAddressDelta) {
+                    LOG_ERROR("Malformed replication entry for version " << version
+                              << ": unknown change type " << static_cast<int>(changeType));
+                    return;
+                }
+                if (changeType != kAddressDelta) {
+                    change.type = static_cast<AuditChange::Type>(changeType);
+                    reader.Get(change.record);
+                    changes.push_back(std::move(change));
+                    continue;
+                }
+
+                // Deltas apply to the record as of the previous change to it in this version
+                std::string fqdn = reader.Str();
+                auto earlier = std::find_if(changes.rbegin(), changes.rend(),
+                    [&](const AuditChange& c) { return c.record.fqdn == fqdn; });
+                Record base;
+                if (earlier != changes.rend() && earlier->type != AuditChange::Remove) {
+                    base = earlier->record;
+                }
+                else if (earlier == changes.rend() &&
+                         current->store.Find(fqdn) != RecordStore::InvalidSlot) {
+                    base = current->store.Get(current->store.Find(fqdn));
+                }
+                else {
+                    // Our records have diverged from the leader's: start over from a snapshot
+                    LOG_WARNING("Replicated address change for unknown FQDN '" << fqdn << "'; resynchronizing");
+                    std::lock_guard<std::mutex> lock(followerMutex);
+                    followedEpoch = 0;
+                    return;
+                }
+                change.type = AuditChange::Update;
+                DecodeAddressDelta(reader, base, change.record);
+                changes.push_back(std::move(change));
+            }
+            if (!reader.Ok()) {
+                LOG_ERROR("Malformed replication entry for version " << version);
+                return;
+            }
+
+            if (!AuditLogger::ApplyChanges(changes)) {
+                return;
+            }
+            for (const auto& change : changes) {
+                RecordStore::Slot old = current->store.Find(change.record.fqdn);
+                Record before;
+                if (old != RecordStore::InvalidSlot) {
+                    before = current->store.Get(old);
+                }
+                SyncFirewall(old != RecordStore::InvalidSlot ? &before : nullptr,
+                             change.type != AuditChange::Remove ? &change.record : nullptr, false);
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(followerMutex);
+                appliedVersion = version;
+                versionsApplied++;
+                if (!positionPath.empty()) {
+                    SavePosition(positionPath, followedEpoch, appliedVersion);
+                }
+            }
+            entriesApplied.Increment();
+            VersionGauge().Set(static_cast<int64_t>(version));
+            if (!SendAll(sock, EncodeAck(version))) {
+                return;
+            }
+            break;
+        }
+        case Frame::Heartbeat: {
+            uint64_t version;
+            {
+                std::lock_guard<std::mutex> lock(followerMutex);
+                version = appliedVersion;
+            }
+            if (!SendAll(sock, EncodeAck(version))) {
+                return;
+            }
+            break;
+        }
+        default:
+            LOG_ERROR("Unexpected replication frame type " << static_cast<int>(type));
+            return;
+        }
+    }
+}
+
+void Replication::SyncFirewall(const Record* before, const Record* after, bool force) {
+    bool sameKeyword = before != nullptr && after != nullptr && before->keywordId == after->keywordId;
+
+    if (before != nullptr && !sameKeyword) {
+        FirewallWriteQueue::Throttle(2);
+        FirewallManager::DeleteFirewallRule(before->ruleName);
+        FirewallManager::DeleteDynamicKeywordAddress(before->keywordId);
+    }
+    if (after == nullptr) {
+        return;
+    }
+
+    if (!sameKeyword) {
+        FirewallWriteQueue::Throttle(2);
+        std::string keywordId = FirewallManager::CreateDynamicKeywordAddress(after->fqdn, after->lastResolvedIPs,
+                                                                             true, after->keywordId);
+        if (keywordId.empty() ||
+            !FirewallManager::CreateFirewallRule(after->ruleName, keywordId, "Outbound", "Block")) {
+            LOG_ERROR("Failed to mirror firewall rule for replicated FQDN: " << after->fqdn);
+        }
+    }
+    else if (force || before->lastResolvedIPs != after->lastResolvedIPs) {
+        if (!FirewallWriteQueue::Update(after->keywordId, after->lastResolvedIPs)) {
+            LOG_ERROR("Failed to mirror addresses for replicated FQDN: " << after->fqdn);
+        }
+    }
+}
+
+uint64_t Replication::StopFollower() {
+    if (following.exchange(false)) {
+        followStop.Cancel();
+        if (followThread.joinable()) {
+            followThread.join();
+        }
+        LOG_INFO("Stopped following replication leader " << leaderEndpoint);
+    }
+    std::lock_guard<std::mutex> lock(followerMutex);
+    return appliedVersion;
+}
+
+void Replication::Stop() {
+    StopFollower();
+
+    if (!leading.exchange(false)) {
+        return;
+    }
+    AuditLogger::SetChangeListener(AuditLogger::ChangeListener());
+
+    // Let the accept loop finish first: a connection it accepts now still
+    // lands in links, and its thread is started, before links is taken
+    if (acceptThread.joinable()) {
+        acceptThread.join();
+    }
+
+    std::vector<std::shared_ptr<FollowerLink>> stopping;
+    {
+        std::lock_guard<std::mutex> lock(journalMutex);
+        journalChanged.notify_all();
+        stopping.swap(links);
+        // Unblock followers stuck in send()
+        for (auto& link : stopping) {
+            if (!link->done.load()) {
+                shutdown(link->sock, kShutdownBoth);
+            }
+        }
+    }
+    for (auto& link : stopping) {
+        if (link->thread.joinable()) {
+            link->thread.join();
+        }
+    }
+    CloseSocket(static_cast<SocketHandle>(listenSocket));
+    listenSocket = -1;
+    LOG_INFO("Stopped replication leader on " << listenEndpoint);
+}
+
+bool Replication::IsLeading() {
+    return leading.load();
+}
+
+bool Replication::IsFollowing() {
+    return following.load();
+}
+
+Replication::Status Replication::GetStatus() {
+    Status status = {};
+    status.leading = leading.load();
+    status.following = following.load();
+
+    if (status.leading) {
+        std::lock_guard<std::mutex> lock(journalMutex);
+        status.epoch = epoch;
+        status.version = lastVersion;
+        status.listen = listenEndpoint;
+        status.journalEntries = journal.size();
+        status.journalBytes = journalBytes;
+        status.journalFirstVersion = journal.empty() ? 0 : journal.front()->version;
+        for (const auto& link : links) {
+            if (link->done.load()) {
+                continue;
+            }
+            status.followers.push_back(FollowerStatus{ link->address, link->ackedVersion, link->streaming,
+                                                       link->snapshots });
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(followerMutex);
+    if (!status.leading) {
+        status.epoch = followedEpoch;
+        status.version = appliedVersion;
+    }
+    status.leader = leaderEndpoint;
+    status.connected = connected;
+    status.sinceLastMessageSeconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - lastMessage).count();
+    status.snapshotsReceived = snapshotsReceived;
+    status.versionsApplied = versionsApplied;
+    return status;
+}
@@ -0,0 +1,196 @@
+#ifndef REPLICATION_H
+#define REPLICATION_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+#include "AuditLogger.h"
+#include "CancellationToken.h"
+
+/**
+ * @brief Warm-standby replication of the audit store over TCP
+ *
+ * The active service (leader) keeps a journal of the record changes of
+ * every audit store version it publishes, numbered by that version, and
+ * streams it to any number of followers:
+ *
+ * - A follower connects with the leader epoch (a random number drawn when
+ *   the journal starts) and the last version it applied. If the journal
+ *   still holds every later version, streaming resumes from there;
+ *   otherwise the follower is sent a full snapshot, then the versions
+ *   after it.
+ * - Versions are applied in order as one audit store version each
+ *   (AuditLogger::ApplyChanges); a gap makes the follower reconnect and
+ *   catch up again. Address updates travel as the addresses added and
+ *   removed, which is what a fleet of followers mostly receives.
+ * - The follower mirrors every change to its own firewall (keywords
+ *   created with the leader's IDs, address sets updated, removed records
+ *   deleted), so both its audit store and its rules stay current.
+ * - The leader sends a heartbeat every second when idle, and the follower
+ *   acknowledges the versions it has applied. A follower that hears
+ *   nothing for five seconds reconnects.
+ *
+ * A standby runs neither boot hydration nor the scheduler. Takeover stops
+ * following and starts the scheduler over the replicated records, with no
+ * DNS resolution and no firewall writes.
+ */
+class Replication {
+public:
+    /**
+     * @brief A follower connected to this leader
+     */
+    struct FollowerStatus {
+        std::string address;
+        uint64_t ackedVersion;      // Last version it reported applied
+        bool streaming;             // false while it is being sent a snapshot
+        uint64_t snapshots;         // Snapshots sent on this connection
+    };
+
+    /**
+     * @brief Replication state of this service
+     */
+    struct Status {
+        bool leading;
+        bool following;
+        uint64_t epoch;
+        uint64_t version;           // Leader: last journaled; follower: last applied
+        // Leader
+        std::string listen;
+        size_t journalEntries;
+        size_t journalBytes;
+        uint64_t journalFirstVersion;
+        std::vector<FollowerStatus> followers;
+        // Follower
+        std::string leader;
+        bool connected;
+        double sinceLastMessageSeconds;
+        uint64_t snapshotsReceived;
+        uint64_t versionsApplied;
+    };
+
+    /**
+     * @brief Start journaling audit store changes and accept followers
+     * @param endpoint "host:port" to listen on ("0.0.0.0:port" for every interface)
+     * @param secret Secret followers must present, empty to accept any
+     * @return false if the endpoint cannot be bound
+     */
+    static bool StartLeader(const std::string& endpoint, const std::string& secret);
+
+    /**
+     * @brief Follow a leader on a background thread, reconnecting as needed
+     *
+     * With a state file, the leader position applied is saved after every
+     * version, and the next run resumes from it (pushing the stored
+     * addresses to the firewall first) instead of from a full snapshot.
+     * @param leader "host:port" of the leader
+     * @param secret Secret to present to the leader
+     * @param statePath File that keeps the leader position, or empty
+     * @return false if the leader address is invalid
+     */
+    static bool StartFollower(const std::string& leader, const std::string& secret,
+                              const std::string& statePath = "");
+
+    /**
+     * @brief Stop following; the audit store keeps the last applied version
+     * @return Last leader version applied
+     */
+    static uint64_t StopFollower();
+
+    /**
+     * @brief Stop leading and following
+     */
+    static void Stop();
+
+    static bool IsLeading();
+    static bool IsFollowing();
+
+    /**
+     * @brief Current replication state
+     */
+    static Status GetStatus();
+
+private:
+    struct JournalEntry;
+    struct EncodedSnapshot;
+    struct FollowerLink;
+
+    /**
+     * @brief Journal the changes of a published version (AuditLogger change listener)
+     */
+    static void OnChange(uint64_t version, const std::vector<AuditChange>* changes);
+
+    static void AcceptLoop();
+    static void ServeFollower(const std::shared_ptr<FollowerLink>& link);
+
+    /**
+     * @brief Encode the current snapshot, or reuse the last encoding if it is still current
+     * @param snapshotEpoch Epoch to label it with
+     */
+    static std::shared_ptr<const EncodedSnapshot> EncodeSnapshot(uint64_t snapshotEpoch);
+
+    /**
+     * @brief Send the current snapshot to a follower
+     * @param link Follower to send it to
+     * @param version Receives the version of the snapshot
+     * @return false if sending failed
+     */
+    static bool SendSnapshot(FollowerLink& link, uint64_t& version);
+
+    static void FollowLoop();
+
+    /**
+     * @brief One connection to the leader, until it fails or following stops
+     */
+    static void FollowSession(intptr_t sock);
+
+    /**
+     * @brief Bring the firewall in line with a change of one record
+     * @param before Record before the change, or nullptr
+     * @param after Record after the change, or nullptr
+     * @param force Write the addresses even if they did not change
+     */
+    static void SyncFirewall(const Record* before, const Record* after, bool force);
+
+    // Leader
+    static std::mutex journalMutex;
+    static std::condition_variable journalChanged;
+    static std::deque<std::shared_ptr<const JournalEntry>> journal;
+    static size_t journalBytes;
+    static uint64_t epoch;
+    static uint64_t lastVersion;         // Last version journaled
+    static std::string leaderSecret;
+    static std::string listenEndpoint;
+    static intptr_t listenSocket;
+    static std::thread acceptThread;
+    static std::vector<std::shared_ptr<FollowerLink>> links;   // Guarded by journalMutex
+    static std::atomic<bool> leading;
+    static std::mutex snapshotMutex;     // Serializes snapshot encoding
+    static std::shared_ptr<const EncodedSnapshot> snapshotCache;
+
+    // Follower
+    static std::mutex followerMutex;
+    static std::string leaderEndpoint;
+    static std::string followerSecret;
+    static std::string positionPath;
+    static std::thread followThread;
+    static CancellationToken followStop;
+    static uint64_t followedEpoch;       // Guarded by followerMutex, like the fields below
+    static uint64_t appliedVersion;
+    static bool connected;
+    static bool firstSync;               // No snapshot applied yet in this process
+    static std::chrono::steady_clock::time_point lastMessage;
+    static uint64_t snapshotsReceived;
+    static uint64_t versionsApplied;
+    static std::atomic<bool> following;
+};
+
+#endif // REPLICATION_H
@@ -1,39 +1,583 @@
 #include "Resolver.h"
+#include "CancellationToken.h"
+#include "DnsMessage.h"
+#include "Log.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include <algorithm>
 #include <iostream>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+
+#ifdef _WIN32
 #include <WinSock2.h>
 #include <WS2tcpip.h>
 
 #pragma comment(lib, "ws2_32.lib")
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#ifdef _WIN32
+using SocketHandle = SOCKET;
+const SocketHandle kInvalidSocket = INVALID_SOCKET;
+
+int PollSockets(pollfd* fds, unsigned long count, int timeoutMs) {
+    return WSAPoll(fds, count, timeoutMs);
+}
+
+void CloseSocket(SocketHandle s) {
+    closesocket(s);
+}
+#else
+using SocketHandle = int;
+const SocketHandle kInvalidSocket = -1;
+
+int PollSockets(pollfd* fds, unsigned long count, int timeoutMs) {
+    return poll(fds, static_cast<nfds_t>(count), timeoutMs);
+}
+
+void CloseSocket(SocketHandle s) {
+    close(s);
+}
+#endif
+
+uint16_t NextQueryId() {
+    thread_local std::mt19937 rng(std::random_device{}());
+    return static_cast<uint16_t>(rng() & 0xFFFF);
+}
+
+const size_t kLatencySamples = 64;      // Recent latencies kept per server for its p95
+const size_t kMinHedgeSamples = 8;      // Samples needed before a server's own p95 sets its hedge delay
+const double kEwmaWeight = 0.2;
+const int kEjectAfterFailures = 3;
+const int kEjectBaseSeconds = 5;
+const int kEjectMaxSeconds = 300;
+const double kMinHedgeDelayMs = 2.0;
+const int kMaxAbandonedLookups = 256;   // System resolver calls still running after their caller gave up
+
+double MillisecondsBetween(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+/**
+ * @brief The A and AAAA queries of one FQDN, sent alike to every server
+ */
+struct QueryPair {
+    uint16_t ids[2];
+    uint16_t types[2];
+    std::vector<uint8_t> packets[2];
+};
+
+/**
+ * @brief One server's answers to the queries of one FQDN
+ */
+struct Exchange {
+    size_t upstream;
+    SocketHandle sock;
+    bool answered[2];
+    int outstanding;
+    bool failed;       // Not sent, or answered SERVFAIL / REFUSED
+    bool nxdomain;
+    std::chrono::steady_clock::time_point sentAt;
+    std::chrono::steady_clock::time_point completedAt;
+    std::vector<std::pair<std::string, uint32_t>> answers;   // Address, TTL
+
+    explicit Exchange(size_t upstream)
+        : upstream(upstream), sock(kInvalidSocket), answered{ false, false }, outstanding(2),
+          failed(false), nxdomain(false) {}
+
+    bool Complete() const { return outstanding == 0 && !failed; }
+    bool Done() const { return outstanding == 0 || failed; }
+};
+
+bool Send(const std::vector<unsigned char>& address, const std::string& serverName,
+          const QueryPair& queries, Exchange& exchange) {
+    static Counter& queriesA = Metrics::GetCounter("fqdn_resolver_dns_queries_total",
+        "Queries sent to the upstream DNS server", "type=\"A\"");
+    static Counter& queriesAAAA = Metrics::GetCounter("fqdn_resolver_dns_queries_total",
+        "Queries sent to the upstream DNS server", "type=\"AAAA\"");
+
+    exchange.sentAt = std::chrono::steady_clock::now();
+    const sockaddr* server = reinterpret_cast<const sockaddr*>(address.data());
+    exchange.sock = socket(server->sa_family, SOCK_DGRAM, IPPROTO_UDP);
+    if (exchange.sock == kInvalidSocket) {
+        LOG_ERROR("Failed to create DNS socket for " << serverName);
+        exchange.failed = true;
+        return false;
+    }
+
+    // Connected UDP: the kernel drops datagrams that are not from the server
+    if (connect(exchange.sock, server, static_cast<int>(address.size())) != 0) {
+        LOG_ERROR("Failed to reach DNS server " << serverName);
+        exchange.failed = true;
+        return false;
+    }
+
+    for (int t = 0; t < 2; t++) {
+        send(exchange.sock, reinterpret_cast<const char*>(queries.packets[t].data()),
+             static_cast<int>(queries.packets[t].size()), 0);
+        (t == 0 ? queriesA : queriesAAAA).Increment();
+    }
+    return true;
+}
+
+/**
+ * @brief Read one datagram of an exchange and take the answer it carries
+ */
+void Receive(const QueryPair& queries, Exchange& exchange) {
+    uint8_t buffer[4096];
+    int received = static_cast<int>(recv(exchange.sock, reinterpret_cast<char*>(buffer), sizeof(buffer), 0));
+    DnsMessage::Message response;
+    if (received <= 0 || !DnsMessage::Decode(buffer, static_cast<size_t>(received), response) ||
+        !(response.flags & DnsMessage::FlagResponse) || response.questions.empty()) {
+        return;
+    }
+
+    for (int t = 0; t < 2; t++) {
+        if (exchange.answered[t] || response.id != queries.ids[t] || response.questions[0].type != queries.types[t]) {
+            continue;
+        }
+
+        exchange.answered[t] = true;
+        exchange.outstanding--;
+        if (exchange.outstanding == 0) {
+            exchange.completedAt = std::chrono::steady_clock::now();
+        }
+        if (response.Rcode() == DnsMessage::RcodeServFail || response.Rcode() == DnsMessage::RcodeRefused) {
+            exchange.failed = true;   // The server could not answer; another one may
+        }
+        exchange.nxdomain = exchange.nxdomain || response.Rcode() == DnsMessage::RcodeNxDomain;
+
+        for (const auto& answer : response.answers) {
+            if (answer.type != queries.types[t]) {
+                continue;   // CNAME chain entries
+            }
+            std::string address = DnsMessage::AddressToString(answer);
+            if (!address.empty()) {
+                exchange.answers.emplace_back(address, answer.ttl);
+            }
+        }
+    }
+}
+
+bool BuildQueries(const std::string& fqdn, QueryPair& queries) {
+    queries.types[0] = DnsMessage::TypeA;
+    queries.types[1] = DnsMessage::TypeAAAA;
+    for (int t = 0; t < 2; t++) {
+        queries.ids[t] = NextQueryId();
+        if (!DnsMessage::Encode(DnsMessage::MakeQuery(queries.ids[t], fqdn, queries.types[t]), queries.packets[t])) {
+            LOG_WARNING("Invalid FQDN for DNS query: " << fqdn);
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Wait until one of the unfinished exchanges has a datagram to read
+ * @param cancel Token checked at least every CancellationToken::CheckInterval(), or nullptr
+ * @return Indexes of the readable exchanges
+ */
+std::vector<size_t> PollExchanges(std::vector<Exchange>& exchanges, double timeoutMs, const CancellationToken* cancel) {
+    std::vector<pollfd> fds;
+    std::vector<size_t> indexes;
+    for (size_t i = 0; i < exchanges.size(); i++) {
+        if (!exchanges[i].Done() && exchanges[i].sock != kInvalidSocket) {
+            pollfd pfd = {};
+            pfd.fd = exchanges[i].sock;
+            pfd.events = POLLIN;
+            fds.push_back(pfd);
+            indexes.push_back(i);
+        }
+    }
+
+    std::vector<size_t> readable;
+    if (fds.empty()) {
+        return readable;
+    }
+    if (cancel != nullptr) {
+        timeoutMs = std::min(timeoutMs, static_cast<double>(CancellationToken::CheckInterval().count()));
+    }
+    int waitMs = static_cast<int>(std::ceil(std::max(0.0, timeoutMs)));
+    if (PollSockets(fds.data(), static_cast<unsigned long>(fds.size()), waitMs) <= 0) {
+        return readable;
+    }
+    for (size_t f = 0; f < fds.size(); f++) {
+        if (fds[f].revents & POLLIN) {
+            readable.push_back(indexes[f]);
+        }
+    }
+    return readable;
+}
+
+/**
+ * @brief One getaddrinfo call, run on its own thread so the caller can stop waiting for it
+ *
+ * getaddrinfo cannot be interrupted. The caller waits for it until its
+ * deadline or cancellation and then abandons it; the thread keeps the
+ * lookup alive until getaddrinfo returns and frees the result itself.
+ */
+struct SystemLookup {
+    std::mutex mutex;
+    std::condition_variable finished;
+    bool done;
+    bool abandoned;
+    int result;
+    addrinfo* addresses;
+
+    SystemLookup() : done(false), abandoned(false), result(0), addresses(nullptr) {}
+
+    ~SystemLookup() {
+        if (addresses != nullptr) {
+            freeaddrinfo(addresses);
+        }
+    }
+};
+
+std::atomic<int> abandonedLookups(0);
+
+Gauge& AbandonedLookupsGauge() {
+    static Gauge& gauge = Metrics::GetGauge("fqdn_resolver_abandoned_lookups",
+        "System resolver calls still running after their deadline or cancellation");
+    return gauge;
+}
+
+/**
+ * @brief Start a system resolver lookup on a detached thread
+ */
+std::shared_ptr<SystemLookup> StartSystemLookup(const std::string& fqdn) {
+    auto lookup = std::make_shared<SystemLookup>();
+    std::thread([lookup, fqdn]() {
+        addrinfo hints = {};
+        hints.ai_family = AF_UNSPEC;    // Allow IPv4 or IPv6
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_protocol = IPPROTO_TCP;
+
+        addrinfo* addresses = nullptr;
+        int result = getaddrinfo(fqdn.c_str(), nullptr, &hints, &addresses);
+
+        std::lock_guard<std::mutex> lock(lookup->mutex);
+        lookup->result = result;
+        lookup->addresses = result == 0 ? addresses : nullptr;
+        lookup->done = true;
+        if (lookup->abandoned) {
+            abandonedLookups--;   // The gauge is updated by the next lookup; this thread may outlive Metrics
+        }
+        lookup->finished.notify_all();
+    }).detach();
+    return lookup;
+}
+
+} // namespace
+
+/**
+ * @brief An upstream DNS server, its metrics and its recent latency and health
+ *
+ * Latency is tracked as an EWMA, which ranks the servers, and as the p95 of
+ * the last kLatencySamples answers, which sets how long to wait before
+ * hedging. kEjectAfterFailures failed resolutions in a row eject the
+ * server; once the ejection period has passed it is probed with one real
+ * resolution, and either rejoins or is ejected again for twice as long.
+ */
+struct Resolver::Upstream {
+    std::string server;
+    std::vector<unsigned char> address;   // sockaddr of the server
+    Counter& resolutions;
+    Counter& timeouts;
+    Counter& addresses;
+    Counter& uniqueAddresses;
+    Counter& hedged;
+    Counter& hedgeWins;
+    Counter& ejections;
+    Gauge& healthy;
+    Histogram& latency;
+
+    std::mutex mutex;
+    double ewmaMs;
+    double p95Ms;
+    double samples[kLatencySamples];
+    size_t sampleCount;
+    int consecutiveFailures;
+    int ejectedTimes;                     // Ejections since it last answered, for the backoff
+    bool ejected;
+    bool probing;
+    std::chrono::steady_clock::time_point ejectedUntil;
+
+    Upstream(const std::string& server, const std::vector<unsigned char>& address)
+        : server(server), address(address),
+          resolutions(Metrics::GetCounter("fqdn_resolver_upstream_resolutions_total",
+              "FQDNs sent to each upstream DNS server", Label(server))),
+          timeouts(Metrics::GetCounter("fqdn_resolver_upstream_timeouts_total",
+              "FQDNs an upstream DNS server had not fully answered by the deadline", Label(server))),
+          addresses(Metrics::GetCounter("fqdn_resolver_upstream_addresses_total",
+              "Addresses returned by each upstream DNS server", Label(server))),
+          uniqueAddresses(Metrics::GetCounter("fqdn_resolver_upstream_unique_addresses_total",
+              "Addresses returned by one upstream DNS server only", Label(server))),
+          hedged(Metrics::GetCounter("fqdn_resolver_upstream_hedged_total",
+              "Resolutions hedged to another server because this one was slow", Label(server))),
+          hedgeWins(Metrics::GetCounter("fqdn_resolver_upstream_hedge_wins_total",
+              "Hedged resolutions answered by the other server first", Label(server))),
+          ejections(Metrics::GetCounter("fqdn_resolver_upstream_ejections_total",
+              "Times an upstream DNS server was ejected after failing", Label(server))),
+          healthy(Metrics::GetGauge("fqdn_resolver_upstream_healthy",
+              "1 while an upstream DNS server takes queries, 0 while ejected", Label(server))),
+          latency(Metrics::GetHistogram("fqdn_resolver_upstream_seconds",
+              "Time until an upstream DNS server answered both queries of an FQDN", Label(server))),
+          ewmaMs(0), p95Ms(0), samples(), sampleCount(0), consecutiveFailures(0), ejectedTimes(0),
+          ejected(false), probing(false) {
+        healthy.Set(1);
+    }
+
+    static std::string Label(const std::string& server) {
+        return "upstream=\"" + server + "\"";
+    }
+
+    /**
+     * @brief Whether the server takes queries
+     */
+    bool Healthy() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return !ejected;
+    }
+
+    /**
+     * @brief Claim the probe of an ejected server whose ejection has run out
+     */
+    bool TryStartProbe(std::chrono::steady_clock::time_point now) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!ejected || probing || now < ejectedUntil) {
+            return false;
+        }
+        probing = true;
+        return true;
+    }
+
+    /**
+     * @brief Ranking key: the EWMA, 0 until measured so every server gets measured
+     */
+    double RankMs() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return sampleCount > 0 ? ewmaMs : 0.0;
+    }
+
+    /**
+     * @brief How long to wait for this server before hedging
+     * @param fallbackMs Delay to use until enough answers have been seen
+     */
+    double HedgeDelayMs(double fallbackMs) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return sampleCount >= kMinHedgeSamples ? std::max(p95Ms, kMinHedgeDelayMs) : fallbackMs;
+    }
+
+    /**
+     * @brief Record a full answer
+     */
+    void RecordSuccess(double elapsedMs) {
+        latency.ObserveSeconds(elapsedMs / 1000.0);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        ewmaMs = sampleCount == 0 ? elapsedMs : ewmaMs * (1.0 - kEwmaWeight) + elapsedMs * kEwmaWeight;
+        samples[sampleCount % kLatencySamples] = elapsedMs;
+        sampleCount++;
+
+        double recent[kLatencySamples];
+        const size_t count = std::min(sampleCount, kLatencySamples);
+        std::copy(samples, samples + count, recent);
+        const size_t rank = std::min(count - 1, count * 95 / 100);
+        std::nth_element(recent, recent + rank, recent + count);
+        p95Ms = recent[rank];
+
+        consecutiveFailures = 0;
+        if (ejected) {
+            LOG_INFO("DNS server " << server << " answered its probe; taking queries again");
+            ejected = false;
+            probing = false;
+            ejectedTimes = 0;
+            healthy.Set(1);
+        }
+    }
+
+    /**
+     * @brief Record a resolution the server did not answer in full
+     * @param elapsedMs Time it was given; at least this slow, so it counts toward the EWMA
+     */
+    void RecordFailure(double elapsedMs, std::chrono::steady_clock::time_point now) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (sampleCount > 0) {
+            ewmaMs = std::max(ewmaMs, ewmaMs * (1.0 - kEwmaWeight) + elapsedMs * kEwmaWeight);
+        }
+        consecutiveFailures++;
+
+        if (probing || (!ejected && consecutiveFailures >= kEjectAfterFailures)) {
+            int seconds = std::min(kEjectMaxSeconds, kEjectBaseSeconds << std::min(ejectedTimes, 6));
+            LOG_WARNING("Ejecting DNS server " << server << " for " << seconds << " s after "
+                        << consecutiveFailures << " failed resolution(s) in a row");
+            ejected = true;
+            probing = false;
+            ejectedTimes++;
+            ejectedUntil = now + std::chrono::seconds(seconds);
+            ejections.Increment();
+            healthy.Set(0);
+        }
+    }
+
+    /**
+     * @brief Record an exchange cut short because another server answered first
+     *
+     * Neither a success nor a failure: the server was at least this slow,
+     * so its EWMA rises, but it does not count toward ejection. A probe
+     * cut short gives no verdict, so the next resolution may probe again.
+     */
+    void RecordOutpaced(double elapsedMs) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (sampleCount > 0) {
+            ewmaMs = std::max(ewmaMs, ewmaMs * (1.0 - kEwmaWeight) + elapsedMs * kEwmaWeight);
+        }
+        probing = false;
+    }
+
+    /**
+     * @brief End a claimed probe without a verdict, so a later resolution can probe again
+     */
+    void CancelProbe() {
+        std::lock_guard<std::mutex> lock(mutex);
+        probing = false;
+    }
+};
+
+// Initialize static members
+Resolver::Backend Resolver::backend;
+std::shared_ptr<const Resolver::UpstreamSet> Resolver::active = std::make_shared<Resolver::UpstreamSet>();
 
 std::vector<std::string> Resolver::ResolveFqdn(const std::string& fqdn) {
-    std::vector<std::string> ipAddresses;
+    uint32_t ttlSeconds;
+    return ResolveFqdn(fqdn, ttlSeconds);
+}
 
+std::vector<std::string> Resolver::ResolveFqdn(const std::string& fqdn, uint32_t& ttlSeconds,
+                                               const CancellationToken* cancel) {
+    Resolution resolution = Resolve(fqdn, cancel);
+    ttlSeconds = resolution.ttlSeconds;
+    return std::move(resolution.addresses);
+}
+
+Resolver::Resolution Resolver::Resolve(const std::string& fqdn, const CancellationToken* cancel) {
+    static Histogram& resolveSeconds = Metrics::GetHistogram("fqdn_resolver_resolve_seconds",
+        "Time spent resolving one FQDN");
+    static Counter& resolveFailures = Metrics::GetCounter("fqdn_resolver_failures_total",
+        "FQDN resolutions that returned no addresses");
+    static Counter& resolvedAddresses = Metrics::GetCounter("fqdn_resolver_addresses_total",
+        "Addresses returned by FQDN resolutions");
+    static Counter& resolveCancelled = Metrics::GetCounter("fqdn_resolver_cancelled_total",
+        "FQDN resolutions abandoned because their caller was cancelled");
+
+    TraceSpan span("resolve", "dns", fqdn);
+    auto start = std::chrono::steady_clock::now();
+    Resolution resolution;
+    if (CancellationToken::IsCancelled(cancel)) {
+        resolution.cancelled = true;
+        return resolution;
+    }
+    // Finish on the servers this resolution started with, even if SetUpstreams replaces them meanwhile
+    std::shared_ptr<const UpstreamSet> set = std::atomic_load(&active);
+    if (backend) {
+        resolution.addresses = backend(fqdn);
+    }
+    else if (!set->servers.empty()) {
+        ResolveWithUpstreams(*set, fqdn, resolution, cancel);
+    }
+    else {
+        ResolveWithSystemResolver(*set, fqdn, resolution, cancel);
+    }
+    resolution.sources.resize(resolution.addresses.size(), 0);
+    resolveSeconds.ObserveSince(start);
+
+    if (resolution.cancelled) {
+        resolveCancelled.Increment();
+        LOG_DEBUG("Resolution of " << fqdn << " cancelled");
+    }
+    else if (resolution.addresses.empty()) {
+        resolveFailures.Increment();
+    }
+    resolvedAddresses.Increment(resolution.addresses.size());
+
+    return resolution;
+}
+void Resolver::ResolveWithSystemResolver(const UpstreamSet& set, const std::string& fqdn, Resolution& resolution,
+                                         const CancellationToken* cancel) {
+    const int timeoutMs = set.timeoutMs;
+    std::vector<std::string>& ipAddresses = resolution.addresses;
+
+#ifdef _WIN32
     // Initialize Winsock
     WSADATA wsaData;
-    int result = WSAStartup(MAKEWORD(2, 2), &wsaData);
-    if (result != 0) {
-        std::cerr << "WSAStartup failed: " << result << std::endl;
-        return ipAddresses;
+    int startup = WSAStartup(MAKEWORD(2, 2), &wsaData);
+    if (startup != 0) {
+        LOG_ERROR("WSAStartup failed: " << startup);
+        return;
     }
+#endif
 
-    // Setup hints for getaddrinfo
-    struct addrinfo hints = {};
-    hints.ai_family = AF_UNSPEC;    // Allow IPv4 or IPv6
-    hints.ai_socktype = SOCK_STREAM;
-    hints.ai_protocol = IPPROTO_TCP;
+    AbandonedLookupsGauge().Set(abandonedLookups.load());
+    if (abandonedLookups.load() >= kMaxAbandonedLookups) {
+        LOG_WARNING("System resolver is not answering (" << abandonedLookups.load()
+                    << " lookups pending); not resolving: " << fqdn);
+#ifdef _WIN32
+        WSACleanup();
+#endif
+        return;
+    }
 
-    struct addrinfo* addrResult = nullptr;
+    // Resolve the domain name on a helper thread, waiting only until the deadline
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    std::shared_ptr<SystemLookup> lookup = StartSystemLookup(fqdn);
+    std::unique_lock<std::mutex> lock(lookup->mutex);
+    while (!lookup->done && !CancellationToken::IsCancelled(cancel)) {
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline) {
+            break;
+        }
+        lookup->finished.wait_for(lock, CancellationToken::Slice(deadline - now, cancel));
+    }
 
-    // Resolve the domain name
-    result = getaddrinfo(fqdn.c_str(), nullptr, &hints, &addrResult);
-    if (result != 0) {
-        std::cerr << "getaddrinfo failed for '" << fqdn << "': " << gai_strerror(result) << std::endl;
+    if (!lookup->done) {
+        lookup->abandoned = true;
+        AbandonedLookupsGauge().Set(++abandonedLookups);
+        resolution.cancelled = CancellationToken::IsCancelled(cancel);
+        if (!resolution.cancelled) {
+            LOG_WARNING("System resolver timed out after " << timeoutMs << " ms for: " << fqdn);
+        }
+#ifdef _WIN32
         WSACleanup();
-        return ipAddresses;
+#endif
+        return;
+    }
+    if (lookup->result != 0) {
+        LOG_WARNING("getaddrinfo failed for '" << fqdn << "': " << gai_strerror(lookup->result));
+#ifdef _WIN32
+        WSACleanup();
+#endif
+        return;
     }
 
     // Iterate through all resolved addresses
-    for (struct addrinfo* ptr = addrResult; ptr != nullptr; ptr = ptr->ai_next) {
+    for (struct addrinfo* ptr = lookup->addresses; ptr != nullptr; ptr = ptr->ai_next) {
         std::string ipAddress;
 
         if (ptr->ai_family == AF_INET) {
@@ -51,22 +595,445 @@ std::vector<std::string> Resolver::ResolveFqdn(const std::string& fqdn) {
             ipAddresses.push_back(ipAddress);
         }
     }
-
-    // Free the address info
-    freeaddrinfo(addrResult);
+#ifdef _WIN32
     WSACleanup();
+#endif
 
     if (ipAddresses.empty()) {
-        std::cerr << "No IP addresses found for FQDN: " << fqdn << std::endl;
+        LOG_WARNING("No IP addresses found for FQDN: " << fqdn);
+    }
+    else {
+        LOG_DEBUG("Resolved " << fqdn << " to " << ipAddresses.size() << " address(es)");
+    }
+}
+
+void Resolver::ResolveWithUpstreams(const UpstreamSet& set, const std::string& fqdn, Resolution& resolution,
+                                    const CancellationToken* cancel) {
+    if (set.policy == Policy::Fastest && set.servers.size() > 1) {
+        ResolveFastest(set, fqdn, resolution, cancel);
+    }
+    else {
+        ResolveFanOut(set, fqdn, resolution, cancel);
+    }
+
+    if (!resolution.addresses.empty()) {
+        LOG_DEBUG("Resolved " << fqdn << " to " << resolution.addresses.size() << " address(es)");
+    }
+}
+
+void Resolver::ResolveFanOut(const UpstreamSet& set, const std::string& fqdn, Resolution& resolution,
+                             const CancellationToken* cancel) {
+    static Counter& timeouts = Metrics::GetCounter("fqdn_resolver_dns_timeouts_total",
+        "Upstream DNS resolutions that did not receive every answer in time");
+    const auto& upstreams = set.servers;
+    const int timeoutMs = set.timeoutMs;
+
+    QueryPair queries;
+    if (!BuildQueries(fqdn, queries)) {
+        return;
+    }
+
+    // Every server that takes queries, plus any whose ejection has run out
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<Exchange> exchanges;
+    std::vector<size_t> probes;
+    for (size_t u = 0; u < upstreams.size(); u++) {
+        if (upstreams[u]->Healthy()) {
+            exchanges.emplace_back(u);
+        }
+        else if (upstreams[u]->TryStartProbe(start)) {
+            exchanges.emplace_back(u);
+            probes.push_back(u);
+        }
+    }
+    if (exchanges.empty()) {
+        for (size_t u = 0; u < upstreams.size(); u++) {
+            exchanges.emplace_back(u);   // All ejected: ask them anyway
+        }
+    }
+    for (auto& exchange : exchanges) {
+        Upstream& upstream = *upstreams[exchange.upstream];
+        upstream.resolutions.Increment();
+        Send(upstream.address, upstream.server, queries, exchange);
+    }
+
+    const auto deadline = start + std::chrono::milliseconds(timeoutMs);
+    for (;;) {
+        auto now = std::chrono::steady_clock::now();
+        bool pending = std::any_of(exchanges.begin(), exchanges.end(), [](const Exchange& e) { return !e.Done(); });
+        if (!pending || now >= deadline || CancellationToken::IsCancelled(cancel)) {
+            break;
+        }
+        for (size_t i : PollExchanges(exchanges, MillisecondsBetween(now, deadline), cancel)) {
+            Receive(queries, exchanges[i]);
+        }
+    }
+
+    // Cancelled: drop the partial answers, and do not hold the missing ones against the servers
+    if (std::any_of(exchanges.begin(), exchanges.end(), [](const Exchange& e) { return !e.Done(); }) &&
+        CancellationToken::IsCancelled(cancel)) {
+        for (auto& exchange : exchanges) {
+            if (exchange.sock != kInvalidSocket) {
+                CloseSocket(exchange.sock);
+            }
+        }
+        for (size_t u : probes) {
+            upstreams[u]->CancelProbe();
+        }
+        resolution.cancelled = true;
+        return;
+    }
+
+    const auto end = std::chrono::steady_clock::now();
+    bool timedOut = false;
+    bool nxdomain = false;
+    bool haveTtl = false;
+    for (auto& exchange : exchanges) {
+        Upstream& upstream = *upstreams[exchange.upstream];
+        if (exchange.sock != kInvalidSocket) {
+            CloseSocket(exchange.sock);
+        }
+        if (!exchange.Complete()) {
+            upstream.RecordFailure(MillisecondsBetween(exchange.sentAt, end), end);
+            if (!exchange.Done()) {
+                upstream.timeouts.Increment();
+                timedOut = true;
+            }
+            continue;
+        }
+        upstream.RecordSuccess(MillisecondsBetween(exchange.sentAt, exchange.completedAt));
+        nxdomain = nxdomain || exchange.nxdomain;
+
+        const uint32_t bit = 1u << exchange.upstream;
+        for (const auto& answer : exchange.answers) {
+            auto it = std::find(resolution.addresses.begin(), resolution.addresses.end(), answer.first);
+            if (it == resolution.addresses.end()) {
+                resolution.addresses.push_back(answer.first);
+                resolution.sources.push_back(0);
+                it = resolution.addresses.end() - 1;
+            }
+            uint32_t& sources = resolution.sources[static_cast<size_t>(it - resolution.addresses.begin())];
+            if ((sources & bit) == 0) {
+                sources |= bit;
+                upstream.addresses.Increment();
+            }
+            resolution.ttlSeconds = haveTtl ? std::min(resolution.ttlSeconds, answer.second) : answer.second;
+            haveTtl = true;
+        }
+    }
+
+    for (uint32_t sources : resolution.sources) {
+        // A single set bit: no other server returned this address
+        if (sources != 0 && (sources & (sources - 1)) == 0) {
+            for (size_t u = 0; u < upstreams.size(); u++) {
+                if (sources == (1u << u)) {
+                    upstreams[u]->uniqueAddresses.Increment();
+                }
+            }
+        }
+    }
+    if (timedOut) {
+        timeouts.Increment();
+    }
+    if (resolution.addresses.empty()) {
+        const std::string via = upstreams.size() == 1 ? upstreams[0]->server : std::string("upstream DNS servers");
+        if (nxdomain) {
+            LOG_WARNING("DNS server " << via << " returned NXDOMAIN for: " << fqdn);
+        }
+        else if (timedOut) {
+            LOG_WARNING("DNS query to " << via << " timed out for: " << fqdn);
+        }
+        else {
+            LOG_WARNING("No IP addresses found for FQDN: " << fqdn);
+        }
+    }
+}
+
+void Resolver::ResolveFastest(const UpstreamSet& set, const std::string& fqdn, Resolution& resolution,
+                              const CancellationToken* cancel) {
+    static Counter& timeouts = Metrics::GetCounter("fqdn_resolver_dns_timeouts_total",
+        "Upstream DNS resolutions that did not receive every answer in time");
+    const auto& upstreams = set.servers;
+    const int timeoutMs = set.timeoutMs;
+
+    QueryPair queries;
+    if (!BuildQueries(fqdn, queries)) {
+        return;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    const auto deadline = start + std::chrono::milliseconds(timeoutMs);
+    const size_t none = upstreams.size();
+
+    // Rank the servers taking queries by EWMA latency
+    std::vector<std::pair<double, size_t>> ranked;
+    for (size_t u = 0; u < upstreams.size(); u++) {
+        if (upstreams[u]->Healthy()) {
+            ranked.emplace_back(upstreams[u]->RankMs(), u);
+        }
+    }
+    std::sort(ranked.begin(), ranked.end());
+
+    // An ejected server whose time is up is probed with this FQDN, hedged by the fastest one
+    size_t primary = none;
+    for (size_t u = 0; u < upstreams.size() && primary == none; u++) {
+        if (upstreams[u]->TryStartProbe(start)) {
+            primary = u;
+        }
+    }
+    const bool probe = primary != none;
+    size_t hedge = none;
+    if (probe) {
+        hedge = ranked.empty() ? none : ranked[0].second;
+    }
+    else if (!ranked.empty()) {
+        primary = ranked[0].second;
+        hedge = ranked.size() > 1 ? ranked[1].second : none;
     }
     else {
-        std::cout << "Resolved " << fqdn << " to " << ipAddresses.size() << " address(es)" << std::endl;
+        primary = 0;   // All ejected and none due for a probe: ask the first anyway
     }
 
-    return ipAddresses;
+    // Hedge once the primary is slower than its recent p95. A probe, or a server not
+    // measured yet, is held to the hedge's p95 instead, so trying it costs little.
+    const double fallbackMs = hedge != none ? upstreams[hedge]->HedgeDelayMs(timeoutMs / 4.0)
+                                            : timeoutMs / 4.0;
+    const double hedgeDelayMs = probe ? fallbackMs : upstreams[primary]->HedgeDelayMs(fallbackMs);
+    const auto hedgeAt = start + std::chrono::microseconds(static_cast<int64_t>(hedgeDelayMs * 1000.0));
+
+    std::vector<Exchange> exchanges;
+    exchanges.reserve(2);
+    exchanges.emplace_back(primary);
+    upstreams[primary]->resolutions.Increment();
+    Send(upstreams[primary]->address, upstreams[primary]->server, queries, exchanges[0]);
+
+    const Exchange* winner = nullptr;
+    for (;;) {
+        auto now = std::chrono::steady_clock::now();
+        if (winner || now >= deadline || CancellationToken::IsCancelled(cancel)) {
+            break;
+        }
+        if (hedge != none && exchanges.size() == 1 && (now >= hedgeAt || exchanges[0].failed)) {
+            exchanges.emplace_back(hedge);
+            upstreams[hedge]->resolutions.Increment();
+            upstreams[primary]->hedged.Increment();
+            Send(upstreams[hedge]->address, upstreams[hedge]->server, queries, exchanges[1]);
+            continue;
+        }
+        bool hedgePending = hedge != none && exchanges.size() == 1;
+        if (!hedgePending && std::all_of(exchanges.begin(), exchanges.end(), [](const Exchange& e) { return e.Done(); })) {
+            break;
+        }
+
+        auto wakeAt = hedgePending ? std::min(hedgeAt, deadline) : deadline;
+        for (size_t i : PollExchanges(exchanges, MillisecondsBetween(now, wakeAt), cancel)) {
+            Receive(queries, exchanges[i]);
+            if (!winner && exchanges[i].Complete()) {
+                winner = &exchanges[i];
+            }
+        }
+    }
+
+    if (!winner && CancellationToken::IsCancelled(cancel)) {
+        for (auto& exchange : exchanges) {
+            if (exchange.sock != kInvalidSocket) {
+                CloseSocket(exchange.sock);
+            }
+        }
+        if (probe) {
+            upstreams[primary]->CancelProbe();
+        }
+        resolution.cancelled = true;
+        return;
+    }
+
+    const auto end = std::chrono::steady_clock::now();
+    bool timedOut = false;
+    for (auto& exchange : exchanges) {
+        Upstream& upstream = *upstreams[exchange.upstream];
+        if (exchange.sock != kInvalidSocket) {
+            CloseSocket(exchange.sock);
+        }
+        if (exchange.Complete()) {
+            upstream.RecordSuccess(MillisecondsBetween(exchange.sentAt, exchange.completedAt));
+        }
+        else if (winner && !exchange.Done() && end < deadline) {
+            // Still waiting when the other server answered: it lost the race, it did not fail
+            upstream.RecordOutpaced(MillisecondsBetween(exchange.sentAt, end));
+        }
+        else {
+            // Timed out, or answered SERVFAIL / REFUSED
+            upstream.RecordFailure(MillisecondsBetween(exchange.sentAt, end), end);
+            if (!exchange.Done() && end >= deadline) {
+                upstream.timeouts.Increment();
+                timedOut = true;
+            }
+        }
+    }
+    if (winner && winner != &exchanges[0]) {
+        upstreams[primary]->hedgeWins.Increment();
+    }
+    if (timedOut) {
+        timeouts.Increment();
+    }
+
+    if (!winner) {
+        LOG_WARNING("DNS query to " << upstreams[primary]->server << (hedge != none && exchanges.size() > 1 ? " and "
+                    + upstreams[hedge]->server : std::string()) << " failed for: " << fqdn);
+        return;
+    }
+    Upstream& source = *upstreams[winner->upstream];
+    bool haveTtl = false;
+    for (const auto& answer : winner->answers) {
+        if (std::find(resolution.addresses.begin(), resolution.addresses.end(), answer.first) != resolution.addresses.end()) {
+            continue;
+        }
+        resolution.addresses.push_back(answer.first);
+        resolution.sources.push_back(1u << winner->upstream);
+        resolution.ttlSeconds = haveTtl ? std::min(resolution.ttlSeconds, answer.second) : answer.second;
+        haveTtl = true;
+    }
+    source.addresses.Increment(resolution.addresses.size());
+    if (winner->nxdomain) {
+        LOG_WARNING("DNS server " << source.server << " returned NXDOMAIN for: " << fqdn);
+    }
+    else if (resolution.addresses.empty()) {
+        LOG_WARNING("No IP addresses found for FQDN: " << fqdn);
+    }
+}
+
+bool Resolver::ParseServer(const std::string& server, std::vector<unsigned char>& address) {
+    // Split "host", "host:port" and "[v6]:port"; a bare IPv6 address has several colons
+    std::string host = server;
+    std::string port = "53";
+    if (!server.empty() && server[0] == '[') {
+        size_t close = server.find(']');
+        if (close == std::string::npos) {
+            LOG_ERROR("Invalid DNS server address: " << server);
+            return false;
+        }
+        host = server.substr(1, close - 1);
+        if (close + 1 < server.size() && server[close + 1] == ':') {
+            port = server.substr(close + 2);
+        }
+    }
+    else if (server.find(':') != std::string::npos && server.find(':') == server.rfind(':')) {
+        host = server.substr(0, server.find(':'));
+        port = server.substr(server.find(':') + 1);
+    }
+
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_protocol = IPPROTO_UDP;
+
+    struct addrinfo* addrResult = nullptr;
+    int result = getaddrinfo(host.c_str(), port.c_str(), &hints, &addrResult);
+    if (result != 0 || addrResult == nullptr) {
+        LOG_ERROR("Invalid DNS server address '" << server << "': " << gai_strerror(result));
+        return false;
+    }
+
+    const unsigned char* raw = reinterpret_cast<const unsigned char*>(addrResult->ai_addr);
+    address.assign(raw, raw + addrResult->ai_addrlen);
+    freeaddrinfo(addrResult);
+    return true;
+}
+
+bool Resolver::SetUpstreams(const std::vector<std::string>& servers, int newTimeoutMs, Policy newPolicy) {
+    auto next = std::make_shared<UpstreamSet>();
+    next->timeoutMs = newTimeoutMs > 0 ? newTimeoutMs : 2000;
+    next->policy = newPolicy;
+    std::shared_ptr<const UpstreamSet> previous = std::atomic_load(&active);
+
+#ifdef _WIN32
+    // Winsock stays initialized for the lifetime of the process once an upstream is used
+    WSADATA wsaData;
+    if (!servers.empty() && WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        LOG_ERROR("WSAStartup failed");
+        return false;
+    }
+#endif
+
+    bool ok = true;
+    for (const auto& server : servers) {
+        if (next->servers.size() == MaxUpstreams) {
+            LOG_ERROR("Too many DNS servers; using the first " << MaxUpstreams);
+            ok = false;
+            break;
+        }
+
+        // A server that stays keeps its latency history, health and counts
+        auto kept = std::find_if(previous->servers.begin(), previous->servers.end(),
+            [&](const std::shared_ptr<Upstream>& upstream) { return upstream->server == server; });
+        if (kept != previous->servers.end()) {
+            next->servers.push_back(*kept);
+            continue;
+        }
+        std::vector<unsigned char> address;
+        if (!ParseServer(server, address)) {
+            ok = false;
+            continue;
+        }
+        next->servers.push_back(std::make_shared<Upstream>(server, address));
+        LOG_INFO("Resolving through DNS server: " << server);
+    }
+    if (next->servers.size() > 1 && next->policy == Policy::FanOut) {
+        LOG_INFO("Fanning each FQDN out to " << next->servers.size() << " DNS servers within "
+                 << next->timeoutMs << " ms");
+    }
+    else if (next->servers.size() > 1) {
+        LOG_INFO("Sending each FQDN to the fastest of " << next->servers.size()
+                 << " DNS servers, hedging past its p95");
+    }
+
+    std::atomic_store(&active, std::shared_ptr<const UpstreamSet>(next));
+    return ok;
+}
+
+std::vector<Resolver::UpstreamStats> Resolver::GetUpstreamStats() {
+    std::vector<UpstreamStats> stats;
+    std::shared_ptr<const UpstreamSet> set = std::atomic_load(&active);
+    for (const auto& upstream : set->servers) {
+        UpstreamStats entry;
+        entry.server = upstream->server;
+        entry.resolutions = upstream->resolutions.Value();
+        entry.timeouts = upstream->timeouts.Value();
+        entry.meanLatencyMs = upstream->latency.Count() > 0
+            ? upstream->latency.SumSeconds() * 1000.0 / upstream->latency.Count() : 0.0;
+        entry.addresses = upstream->addresses.Value();
+        entry.uniqueAddresses = upstream->uniqueAddresses.Value();
+        entry.hedged = upstream->hedged.Value();
+        entry.hedgeWins = upstream->hedgeWins.Value();
+        entry.ejections = upstream->ejections.Value();
+        {
+            std::lock_guard<std::mutex> lock(upstream->mutex);
+            entry.ewmaMs = upstream->ewmaMs;
+            entry.p95Ms = upstream->p95Ms;
+            entry.healthy = !upstream->ejected;
+        }
+        stats.push_back(entry);
+    }
+    return stats;
+}
+
+bool Resolver::ParsePolicy(const std::string& text, Policy& parsed) {
+    if (text == "fanout") {
+        parsed = Policy::FanOut;
+        return true;
+    }
+    if (text == "fastest") {
+        parsed = Policy::Fastest;
+        return true;
+    }
+    return false;
+}
+
+void Resolver::SetBackend(Backend newBackend) {
+    backend = std::move(newBackend);
 }
 
 bool Resolver::IsAvailable() {
+#ifdef _WIN32
     WSADATA wsaData;
     int result = WSAStartup(MAKEWORD(2, 2), &wsaData);
     if (result == 0) {
@@ -74,6 +1041,9 @@ bool Resolver::IsAvailable() {
         return true;
     }
     return false;
+#else
+    return true;
+#endif
 }
 
 std::string Resolver::IPv4ToString(const void* addr) {
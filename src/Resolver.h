@@ -3,15 +3,31 @@
 
 #include <string>
 #include <vector>
+#include <functional>
+#include <cstdint>
+#include <memory>
+
+class CancellationToken;
 
 /**
  * @brief DNS Resolution utilities
  * 
  * Provides DNS resolution functionality to convert FQDNs to IP addresses.
  * Supports both IPv4 and IPv6.
+ *
+ * Every resolution has a deadline (the timeout given to SetUpstreams) and
+ * may be given a cancellation token. The system resolver cannot be
+ * interrupted, so it runs on a helper thread that the resolution abandons
+ * at its deadline or on cancellation; the helper frees its result when
+ * the call eventually returns.
  */
 class Resolver {
 public:
+    /**
+     * @brief Function that resolves an FQDN in place of the system resolver
+     */
+    using Backend = std::function<std::vector<std::string>(const std::string& fqdn)>;
+
     /**
      * @brief Resolve an FQDN to a list of IP addresses
      * @param fqdn Fully Qualified Domain Name to resolve
@@ -19,13 +35,161 @@ public:
      */
     static std::vector<std::string> ResolveFqdn(const std::string& fqdn);
 
+    /**
+     * @brief Resolve an FQDN and report how long the answer may be cached
+     * @param fqdn Fully Qualified Domain Name to resolve
+     * @param ttlSeconds Set to the lowest TTL of the answers, 0 when the
+     *        source does not report TTLs (system resolver, backends)
+     * @param cancel Token that abandons the resolution when cancelled, or nullptr
+     * @return Vector of IP addresses (IPv4 and IPv6) as strings
+     */
+    static std::vector<std::string> ResolveFqdn(const std::string& fqdn, uint32_t& ttlSeconds,
+                                                const CancellationToken* cancel = nullptr);
+
     /**
      * @brief Check if DNS resolution is available
      * @return true if resolution can be performed, false otherwise
      */
     static bool IsAvailable();
 
+    /**
+     * @brief Replace the resolution backend (e.g. with a stub for benchmarks)
+     *
+     * Must not be called while resolutions are in flight. Metrics and
+     * tracing still apply to resolutions served by the backend.
+     * @param backend Backend to use; an empty function restores the system resolver
+     */
+    static void SetBackend(Backend backend);
+
+    /**
+     * @brief How an FQDN is spread over several upstream DNS servers
+     */
+    enum class Policy {
+        FanOut,    // Every server at once; answers merged
+        Fastest    // The server with the lowest latency EWMA, hedged to the next past its p95
+    };
+
+    /**
+     * @brief Send queries straight to DNS servers instead of the system resolver
+     *
+     * Used to point the resolver at specific servers, such as the synthetic
+     * load server (fqdn_dns_loadserver). A and AAAA queries are sent over
+     * UDP in parallel and their answers combined. With several servers,
+     * FanOut sends every FQDN to all of them at once and merges the answers,
+     * since each server may see a different part of a CDN's address pool;
+     * servers that have not answered by the deadline are left out. Fastest
+     * sends it to one server and, if that is slower than its recent p95, to
+     * a second, and takes whichever answers first. Either way a server that
+     * fails several resolutions in a row is ejected for a while and then
+     * probed with a real resolution before it takes queries again.
+     * @param servers "host", "host:port", "ipv4:port" or "[ipv6]:port" each, at most
+     *        MaxUpstreams; empty restores the system resolver
+     * @param timeoutMs Deadline for each FQDN's answers, across all servers; also
+     *        bounds system resolver lookups when servers is empty
+     * @param policy How several servers share the queries
+     * @return true if every server address is valid (the valid ones are used either way)
+     * @note Safe while resolutions are in flight: they finish on the servers
+     *       they started with. Servers in both lists keep their statistics.
+     */
+    static bool SetUpstreams(const std::vector<std::string>& servers, int timeoutMs, Policy policy = Policy::FanOut);
+
+    /**
+     * @brief Parse a policy name ("fanout" or "fastest")
+     * @return false if the name is unknown
+     */
+    static bool ParsePolicy(const std::string& text, Policy& policy);
+
+    static const size_t MaxUpstreams = 32;
+
+    /**
+     * @brief Addresses of one FQDN and the servers that returned them
+     */
+    struct Resolution {
+        std::vector<std::string> addresses;
+        std::vector<uint32_t> sources;   // Per address, bit i set if upstream i returned it (0 without upstreams)
+        uint32_t ttlSeconds;             // Lowest TTL of the answers, 0 when unknown
+        bool cancelled;                  // Abandoned because the token was cancelled; addresses empty
+
+        Resolution() : ttlSeconds(0), cancelled(false) {}
+    };
+
+    /**
+     * @brief Resolve an FQDN, keeping which upstream returned each address
+     * @param fqdn Fully Qualified Domain Name to resolve
+     * @param cancel Token that abandons the resolution when cancelled, or nullptr
+     * @return Merged, deduplicated addresses
+     */
+    static Resolution Resolve(const std::string& fqdn, const CancellationToken* cancel = nullptr);
+
+    /**
+     * @brief What one upstream DNS server has contributed since it was set
+     */
+    struct UpstreamStats {
+        std::string server;
+        uint64_t resolutions;       // FQDNs sent to the server
+        uint64_t timeouts;          // FQDNs it had not fully answered by the deadline
+        double meanLatencyMs;       // Mean time to its last answer, for FQDNs it answered in time
+        uint64_t addresses;         // Addresses it returned
+        uint64_t uniqueAddresses;   // Addresses no other server returned for the same FQDN
+        double ewmaMs;              // Smoothed recent latency, which ranks the servers
+        double p95Ms;               // p95 of its recent answers, after which it is hedged
+        uint64_t hedged;            // Resolutions hedged to another server because it was slow
+        uint64_t hedgeWins;         // Of those, resolutions the other server answered first
+        uint64_t ejections;         // Times it was ejected after failing
+        bool healthy;               // false while ejected
+    };
+
+    /**
+     * @brief Per-server counts, in configuration order (upstream i is bit i of Resolution::sources)
+     */
+    static std::vector<UpstreamStats> GetUpstreamStats();
+
 private:
+    struct Upstream;
+
+    /**
+     * @brief The servers and settings of one SetUpstreams call, never changed once published
+     */
+    struct UpstreamSet {
+        std::vector<std::shared_ptr<Upstream>> servers;
+        int timeoutMs;
+        Policy policy;
+
+        UpstreamSet() : timeoutMs(2000), policy(Policy::FanOut) {}
+    };
+
+    /**
+     * @brief Resolve through the operating system resolver (getaddrinfo)
+     * @param set Settings to resolve with (its timeout bounds the lookup)
+     * @param fqdn Fully Qualified Domain Name to resolve
+     * @param resolution Addresses, or cancelled
+     * @param cancel Token to give up on, or nullptr
+     */
+    static void ResolveWithSystemResolver(const UpstreamSet& set, const std::string& fqdn, Resolution& resolution,
+                                          const CancellationToken* cancel);
+
+    /**
+     * @brief Resolve by querying the configured upstream DNS servers directly
+     * @param set Servers, timeout and policy to resolve with
+     * @param fqdn Fully Qualified Domain Name to resolve
+     * @param resolution Merged answers of every server that replied in time
+     * @param cancel Token to give up on, or nullptr
+     */
+    static void ResolveWithUpstreams(const UpstreamSet& set, const std::string& fqdn, Resolution& resolution,
+                                     const CancellationToken* cancel);
+    static void ResolveFanOut(const UpstreamSet& set, const std::string& fqdn, Resolution& resolution,
+                              const CancellationToken* cancel);
+    static void ResolveFastest(const UpstreamSet& set, const std::string& fqdn, Resolution& resolution,
+                               const CancellationToken* cancel);
+
+    /**
+     * @brief Parse a server address into a socket address
+     * @param server "host", "host:port", "ipv4:port" or "[ipv6]:port"
+     * @param address sockaddr bytes
+     * @return true if the address is valid
+     */
+    static bool ParseServer(const std::string& server, std::vector<unsigned char>& address);
+
     /**
      * @brief Convert IPv4 address to string
      * @param addr Pointer to sockaddr_in structure
@@ -39,6 +203,9 @@ private:
      * @return IP address as string
      */
     static std::string IPv6ToString(const void* addr);
+
+    static Backend backend;
+    static std::shared_ptr<const UpstreamSet> active;   // Read with std::atomic_load
 };
 
 #endif // RESOLVER_H
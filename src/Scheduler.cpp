@@ -1,29 +1,49 @@
 #include "Scheduler.h"
 #include "AuditLogger.h"
 #include "Resolver.h"
-#include "FirewallManager.h"
+#include "RefreshCoordinator.h"
+#include "Log.h"
+#include "Metrics.h"
+#include "Trace.h"
 #include <iostream>
 #include <algorithm>
+#include <vector>
 
 // Initialize static members
-std::map<std::string, Scheduler::Task> Scheduler::tasks;
+std::vector<Scheduler::Task> Scheduler::tasks;
+size_t Scheduler::taskCount = 0;
+int32_t Scheduler::minIntervalMinutes = 0;
+const std::chrono::steady_clock::time_point Scheduler::epoch = std::chrono::steady_clock::now();
 std::mutex Scheduler::taskMutex;
 std::thread Scheduler::schedulerThread;
+CancellationToken Scheduler::stopToken;
+std::mutex Scheduler::loopMutex;
+std::condition_variable Scheduler::loopExited;
+bool Scheduler::loopActive = false;
 std::atomic<bool> Scheduler::running(false);
 std::atomic<bool> Scheduler::initialized(false);
 
+namespace {
+
+Gauge& TaskCountGauge() {
+    static Gauge& gauge = Metrics::GetGauge("fqdn_scheduler_tasks", "Scheduled refresh tasks");
+    return gauge;
+}
+
+} // namespace
+
 void Scheduler::Initialize() {
     if (initialized) {
         return;
     }
 
-    std::cout << "Scheduler initialized" << std::endl;
+    LOG_INFO("Scheduler initialized");
     initialized = true;
 }
 
 void Scheduler::Start() {
     if (running) {
-        std::cout << "Scheduler is already running" << std::endl;
+        LOG_INFO("Scheduler is already running");
         return;
     }
 
@@ -31,149 +51,299 @@ void Scheduler::Start() {
         Initialize();
     }
 
+    {
+        std::lock_guard<std::mutex> lock(loopMutex);
+        if (loopActive) {
+            LOG_WARNING("Scheduler is still finishing its previous refresh; not started");
+            return;
+        }
+        loopActive = true;
+    }
+    // A loop that outlived an earlier Stop() has exited by now
+    if (schedulerThread.joinable()) {
+        schedulerThread.join();
+    }
+
+    stopToken.Reset();
     running = true;
     schedulerThread = std::thread(SchedulerLoop);
-    std::cout << "Scheduler started" << std::endl;
+    LOG_INFO("Scheduler started");
 }
 
-void Scheduler::Stop() {
+bool Scheduler::Stop(int timeoutMs) {
     if (!running) {
-        return;
+        return true;
     }
 
     running = false;
+    stopToken.Cancel();
+
+    bool finished;
+    {
+        std::unique_lock<std::mutex> lock(loopMutex);
+        finished = loopExited.wait_for(lock, std::chrono::milliseconds(std::max(0, timeoutMs)),
+                                       []() { return !loopActive; });
+    }
+
+    if (!finished) {
+        // Everything the loop waits on honours the token, so it will not take much longer
+        LOG_WARNING("Scheduler did not stop within " << timeoutMs << " ms; leaving it to finish in the background");
+        return false;
+    }
+
+    if (schedulerThread.joinable()) {
+        schedulerThread.join();
+    }
+
+    LOG_INFO("Scheduler stopped");
+    return true;
+}
 
+void Scheduler::Join() {
     if (schedulerThread.joinable()) {
         schedulerThread.join();
+        LOG_INFO("Scheduler stopped");
     }
+}
+
+uint32_t Scheduler::ToTick(std::chrono::steady_clock::time_point time) {
+    auto seconds = std::chrono::duration_cast<std::chrono::seconds>(time - epoch).count();
+    return static_cast<uint32_t>(std::max<int64_t>(0, seconds));
+}
 
-    std::cout << "Scheduler stopped" << std::endl;
+uint32_t Scheduler::EffectiveSeconds(int32_t intervalMinutes) {
+    return static_cast<uint32_t>(std::max(intervalMinutes, minIntervalMinutes)) * 60;
 }
 
-bool Scheduler::AddTask(const std::string& fqdn, int intervalMinutes) {
+bool Scheduler::AddTask(const std::string& fqdn) {
+    RecordStore::Slot slot = AuditLogger::Snapshot()->store.Find(fqdn);
+    if (slot == RecordStore::InvalidSlot) {
+        LOG_WARNING("Cannot schedule " << fqdn << ": not in the audit store");
+        return false;
+    }
+    return AddTask(slot);
+}
+
+bool Scheduler::AddTask(RecordStore::Slot slot) {
+    AuditSnapshotPtr snapshot = AuditLogger::Snapshot();
+    if (!snapshot->store.IsLive(slot)) {
+        return false;
+    }
+    int intervalMinutes = snapshot->store.Interval(slot);
+    if (intervalMinutes <= 0) {
+        return false;
+    }
+
     std::lock_guard<std::mutex> lock(taskMutex);
 
-    if (tasks.find(fqdn) != tasks.end()) {
-        std::cout << "Task for " << fqdn << " already exists, updating interval" << std::endl;
-        tasks[fqdn] = Task(fqdn, intervalMinutes);
-        return true;
+    if (slot >= tasks.size()) {
+        tasks.resize(static_cast<size_t>(slot) + 1);
     }
 
-    tasks[fqdn] = Task(fqdn, intervalMinutes);
-    std::cout << "Added scheduled task for " << fqdn << " (every " << intervalMinutes << " minutes)" << std::endl;
+    Task& task = tasks[slot];
+    if (task.nextRun != 0) {
+        LOG_DEBUG("Task for slot " << slot << " already exists, updating interval");
+    }
+    else {
+        taskCount++;
+        TaskCountGauge().Set(static_cast<int64_t>(taskCount));
+        LOG_DEBUG("Added scheduled task for slot " << slot << " (every " << intervalMinutes << " minutes)");
+    }
+
+    task.nextRun = ToTick(std::chrono::steady_clock::now()) + EffectiveSeconds(intervalMinutes);
     return true;
 }
 
 bool Scheduler::RemoveTask(const std::string& fqdn) {
+    RecordStore::Slot slot = AuditLogger::Snapshot()->store.Find(fqdn);
+
     std::lock_guard<std::mutex> lock(taskMutex);
 
-    auto it = tasks.find(fqdn);
-    if (it != tasks.end()) {
-        tasks.erase(it);
-        std::cout << "Removed scheduled task for " << fqdn << std::endl;
+    if (slot < tasks.size() && tasks[slot].nextRun != 0) {
+        tasks[slot] = Task();
+        taskCount--;
+        TaskCountGauge().Set(static_cast<int64_t>(taskCount));
+        LOG_DEBUG("Removed scheduled task for " << fqdn);
         return true;
     }
 
-    std::cout << "Task not found for " << fqdn << std::endl;
+    LOG_DEBUG("Task not found for " << fqdn);
     return false;
 }
 
 int Scheduler::GetTaskCount() {
     std::lock_guard<std::mutex> lock(taskMutex);
-    return static_cast<int>(tasks.size());
+    return static_cast<int>(taskCount);
 }
 
 bool Scheduler::IsRunning() {
     return running;
 }
 
-void Scheduler::SchedulerLoop() {
-    std::cout << "Scheduler loop started" << std::endl;
+std::vector<RecordStore::Slot> Scheduler::CollectDueTasks(std::chrono::steady_clock::time_point now) {
+    static Histogram& lateness = Metrics::GetHistogram("fqdn_scheduler_lateness_seconds",
+        "Delay between a task's due time and the tick that picked it up", "",
+        { 1, 5, 10, 15, 30, 60, 120, 300, 600, 1800 });
 
-    while (running) {
-        // Sleep for a short interval (e.g., 10 seconds)
-        std::this_thread::sleep_for(std::chrono::seconds(10));
+    std::vector<RecordStore::Slot> due;
+    uint32_t tick = ToTick(now);
+    AuditSnapshotPtr snapshot = AuditLogger::Snapshot();
+    const RecordStore& store = snapshot->store;
+    std::lock_guard<std::mutex> lock(taskMutex);
 
-        if (!running) {
-            break;
+    for (size_t slot = 0; slot < tasks.size(); slot++) {
+        Task& task = tasks[slot];
+
+        if (task.nextRun != 0 && tick >= task.nextRun) {
+            RecordStore::Slot recordSlot = static_cast<RecordStore::Slot>(slot);
+            int intervalMinutes = store.IsLive(recordSlot) ? store.Interval(recordSlot) : 0;
+            if (intervalMinutes <= 0) {
+                // The record is gone (or no longer refreshed): drop the task
+                task = Task();
+                taskCount--;
+                TaskCountGauge().Set(static_cast<int64_t>(taskCount));
+                continue;
+            }
+
+            due.push_back(recordSlot);
+            lateness.ObserveSeconds(static_cast<double>(tick - task.nextRun));
+
+            // Schedule next run
+            task.nextRun = tick + EffectiveSeconds(intervalMinutes);
         }
+    }
 
-        // Check if any tasks are due
-        std::lock_guard<std::mutex> lock(taskMutex);
-        auto now = std::chrono::steady_clock::now();
+    return due;
+}
 
-        for (auto& pair : tasks) {
-            Task& task = pair.second;
+size_t Scheduler::SetMinInterval(int minutes) {
+    uint32_t tick = ToTick(std::chrono::steady_clock::now());
+    AuditSnapshotPtr snapshot = AuditLogger::Snapshot();
+    const RecordStore& store = snapshot->store;
+    std::lock_guard<std::mutex> lock(taskMutex);
 
-            if (now >= task.nextRun) {
-                // Task is due, trigger refresh
-                std::cout << "\n[Scheduler] Triggering refresh for: " << task.fqdn << std::endl;
-                TriggerRefresh(task.fqdn);
+    int32_t previous = minIntervalMinutes;
+    minIntervalMinutes = std::max(0, minutes);
+    if (minIntervalMinutes == previous) {
+        return 0;
+    }
 
-                // Schedule next run
-                task.nextRun = now + std::chrono::minutes(task.intervalMinutes);
-                std::cout << "[Scheduler] Next refresh in " << task.intervalMinutes << " minutes" << std::endl;
-            }
+    size_t rescheduled = 0;
+    for (size_t slot = 0; slot < tasks.size(); slot++) {
+        Task& task = tasks[slot];
+        RecordStore::Slot recordSlot = static_cast<RecordStore::Slot>(slot);
+        if (task.nextRun == 0 || !store.IsLive(recordSlot)) {
+            continue;
+        }
+        int32_t intervalMinutes = store.Interval(recordSlot);
+        uint32_t before = static_cast<uint32_t>(std::max(intervalMinutes, previous)) * 60;
+        uint32_t after = EffectiveSeconds(intervalMinutes);
+        if (before == after) {
+            continue;
         }
+
+        int64_t lastRun = static_cast<int64_t>(task.nextRun) - before;
+        task.nextRun = static_cast<uint32_t>(std::max<int64_t>(tick, lastRun + after));
+        rescheduled++;
     }
 
-    std::cout << "Scheduler loop ended" << std::endl;
+    LOG_INFO("Minimum refresh interval set to " << minIntervalMinutes << " minute(s); "
+             << rescheduled << " task(s) rescheduled");
+    return rescheduled;
 }
 
-void Scheduler::TriggerRefresh(const std::string& fqdn) {
-    try {
-        // Get the record from audit logger
-        Record record;
-        if (!AuditLogger::GetRecord(fqdn, record)) {
-            std::cerr << "[Scheduler] Record not found for: " << fqdn << std::endl;
-            return;
-        }
+void Scheduler::SchedulerLoop() {
+    static Counter& ticks = Metrics::GetCounter("fqdn_scheduler_ticks_total",
+        "Scheduler loop iterations");
 
-        // Resolve the FQDN to get new IPs
-        std::vector<std::string> newIPs = Resolver::ResolveFqdn(fqdn);
+    Trace::SetThreadName("scheduler");
+    LOG_INFO("Scheduler loop started");
 
-        if (newIPs.empty()) {
-            std::cerr << "[Scheduler] DNS resolution failed for: " << fqdn << std::endl;
-            return;
+    while (running) {
+        // Wait for the next tick; Stop() ends the wait at once
+        if (stopToken.WaitFor(std::chrono::seconds(10)) || !running) {
+            break;
         }
 
-        // Check if IPs have changed
-        bool ipsChanged = false;
-        if (newIPs.size() != record.lastResolvedIPs.size()) {
-            ipsChanged = true;
+        ticks.Increment();
+        TraceSpan tickSpan("scheduler_tick", "scheduler");
+
+        // Collect due tasks, then refresh them without holding the task lock
+        std::vector<RecordStore::Slot> due = CollectDueTasks(std::chrono::steady_clock::now());
+
+        if (!due.empty()) {
+            LOG_INFO("\n[Scheduler] Triggering refresh for " << due.size() << " FQDN(s)");
+            TriggerRefresh(due);
         }
-        else {
-            // Sort both vectors and compare
-            std::vector<std::string> sortedNew = newIPs;
-            std::vector<std::string> sortedOld = record.lastResolvedIPs;
-            std::sort(sortedNew.begin(), sortedNew.end());
-            std::sort(sortedOld.begin(), sortedOld.end());
-
-            if (sortedNew != sortedOld) {
-                ipsChanged = true;
+    }
+
+    LOG_INFO("Scheduler loop ended");
+
+    std::lock_guard<std::mutex> lock(loopMutex);
+    loopActive = false;
+    loopExited.notify_all();
+}
+
+void Scheduler::TriggerRefresh(const std::vector<RecordStore::Slot>& slots) {
+    static Histogram& refreshSeconds = Metrics::GetHistogram("fqdn_scheduler_refresh_seconds",
+        "Duration of one scheduled refresh batch");
+    static Counter& refreshedUpdated = Metrics::GetCounter("fqdn_scheduler_refreshed_total",
+        "FQDNs processed by scheduled refreshes", "outcome=\"updated\"");
+    static Counter& refreshedUnchanged = Metrics::GetCounter("fqdn_scheduler_refreshed_total",
+        "FQDNs processed by scheduled refreshes", "outcome=\"unchanged\"");
+    static Counter& refreshedFailed = Metrics::GetCounter("fqdn_scheduler_refreshed_total",
+        "FQDNs processed by scheduled refreshes", "outcome=\"failed\"");
+    ScopedTimer timer(refreshSeconds);
+    TraceSpan span("scheduled_refresh", "scheduler", std::to_string(slots.size()) + " FQDN(s)");
+
+    try {
+        // Resolve the slots against one consistent snapshot of the audit store
+        auto snapshot = AuditLogger::Snapshot();
+        std::vector<RecordStore::Slot> records;
+        records.reserve(slots.size());
+        for (RecordStore::Slot slot : slots) {
+            if (snapshot->store.IsLive(slot)) {
+                records.push_back(slot);
+            }
+            else {
+                LOG_WARNING("[Scheduler] Record not found for slot " << slot);
             }
         }
 
-        if (ipsChanged) {
-            std::cout << "[Scheduler] IP addresses changed for: " << fqdn << std::endl;
-            std::cout << "[Scheduler] Old IPs: " << record.lastResolvedIPs.size() 
-                     << ", New IPs: " << newIPs.size() << std::endl;
+        if (records.empty()) {
+            return;
+        }
 
-            // Update the dynamic keyword address
-            if (FirewallManager::UpdateDynamicKeywordAddress(record.keywordId, newIPs)) {
-                // Update the audit record
-                AuditLogger::UpdateRecord(fqdn, newIPs);
-                std::cout << "[Scheduler] Successfully updated firewall rules for: " << fqdn << std::endl;
+        RefreshPipeline::Options options = RefreshPipeline::OptionsFromConfig();
+        options.cancel = &stopToken;
+        auto result = RefreshCoordinator::Refresh(snapshot, records, options);
+        refreshedUpdated.Increment(result.updated);
+        refreshedUnchanged.Increment(result.unchanged);
+        refreshedFailed.Increment(result.failed);
+
+        for (const auto& item : result.items) {
+            if (item.outcome == RefreshPipeline::ItemResult::Unchanged ||
+                item.outcome == RefreshPipeline::ItemResult::Skipped ||
+                item.outcome == RefreshPipeline::ItemResult::Cancelled) {
+                continue;
+            }
+            if (item.outcome == RefreshPipeline::ItemResult::Updated) {
+                LOG_DEBUG("[Scheduler] " << item.fqdn << ": " << RefreshPipeline::DescribeOutcome(item.outcome));
             }
             else {
-                std::cerr << "[Scheduler] Failed to update firewall rules for: " << fqdn << std::endl;
+                LOG_WARNING("[Scheduler] " << item.fqdn << ": " << RefreshPipeline::DescribeOutcome(item.outcome));
             }
         }
-        else {
-            std::cout << "[Scheduler] No IP changes detected for: " << fqdn << std::endl;
-        }
+
+        LOG_INFO("[Scheduler] Refresh complete: " << result.updated << " updated, "
+                 << result.unchanged << " unchanged, " << result.skipped << " skipped, "
+                 << result.failed << " failed in " << result.elapsedMs << " ms"
+                 << (result.cancelled > 0 ? ", " + std::to_string(result.cancelled) + " cancelled by shutdown" : std::string()));
     }
     catch (const std::exception& e) {
-        std::cerr << "[Scheduler] Error refreshing " << fqdn << ": " << e.what() << std::endl;
+        LOG_ERROR("[Scheduler] Error during refresh: " << e.what());
     }
+
+    // The loop may now sleep for a long time; do not leave the summary buffered
+    Log::Flush();
 }
@@ -2,17 +2,30 @@
 #define SCHEDULER_H
 
 #include <string>
-#include <map>
+#include <vector>
 #include <mutex>
 #include <thread>
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cstdint>
+
+#include "CancellationToken.h"
+#include "RecordStore.h"
 
 /**
  * @brief Task scheduling for periodic DNS hydration
  * 
  * Manages background tasks that periodically refresh DNS resolutions
  * for blocked FQDNs and update the firewall rules accordingly.
+ *
+ * Tasks are kept in a flat table indexed by the record's audit store slot
+ * (4 bytes per slot) rather than keyed by FQDN string. A task holds only
+ * its next run; the interval is read from the record in the audit store.
+ *
+ * The loop waits between ticks on a cancellation token that is also handed
+ * to its refreshes, so Stop() interrupts both the wait and any DNS lookups
+ * and queued firewall writes in flight.
  */
 class Scheduler {
 public:
@@ -29,19 +42,41 @@ public:
 
     /**
      * @brief Stop the scheduler and cleanup
+     *
+     * Cancels the refresh in progress, if any, and waits for the loop to
+     * finish. If it has not finished in time the loop thread is left to
+     * wind down on its own, Start() refuses to run until it has, and
+     * Join() must be called before the process exits.
+     * @param timeoutMs Longest time to wait for the loop
+     * @return true if the loop finished in time
+     */
+    static bool Stop(int timeoutMs = 5000);
+
+    /**
+     * @brief Wait for a loop thread that Stop() left winding down
+     *
+     * Call before the process exits: the loop uses the audit store,
+     * metrics and other statics that are destroyed at exit.
      */
-    static void Stop();
+    static void Join();
 
     /**
-     * @brief Add a scheduled task for an FQDN
-     * @param fqdn FQDN to refresh periodically
-     * @param intervalMinutes Refresh interval in minutes
+     * @brief Add a scheduled task for an FQDN, refreshed at its record's interval
+     * @param fqdn FQDN to refresh periodically; must be in the audit store
      * @return true if task added successfully, false otherwise
      */
-    static bool AddTask(const std::string& fqdn, int intervalMinutes);
+    static bool AddTask(const std::string& fqdn);
+
+    /**
+     * @brief Add a scheduled task for an audit store slot, refreshed at its record's interval
+     * @param slot Slot of the record to refresh periodically
+     * @return true if task added successfully, false otherwise
+     */
+    static bool AddTask(RecordStore::Slot slot);
 
     /**
      * @brief Remove a scheduled task
+     * @note Call before removing the audit record, while the FQDN still maps to its slot
      * @param fqdn FQDN task to remove
      * @return true if task removed successfully, false otherwise
      */
@@ -59,32 +94,64 @@ public:
      */
     static bool IsRunning();
 
+    /**
+     * @brief Collect the tasks due at a point in time and schedule their next run
+     * @param now Time to compare against each task's next run
+     * @return Audit store slots of the due tasks
+     */
+    static std::vector<RecordStore::Slot> CollectDueTasks(std::chrono::steady_clock::time_point now);
+
+    /**
+     * @brief Set the shortest interval any task is refreshed at
+     *
+     * Tasks whose effective interval changes are rescheduled from their
+     * last run (due at once if that is already past); the others keep
+     * their next run. Nothing is refreshed here.
+     * @param minutes Floor in minutes, 0 for none
+     * @return Number of tasks rescheduled
+     */
+    static size_t SetMinInterval(int minutes);
+
 private:
     struct Task {
-        std::string fqdn;
-        int intervalMinutes;
-        std::chrono::steady_clock::time_point nextRun;
-
-        Task() : intervalMinutes(0) {}
-        Task(const std::string& f, int interval)
-            : fqdn(f), intervalMinutes(interval),
-              nextRun(std::chrono::steady_clock::now() + std::chrono::minutes(interval)) {}
+        uint32_t nextRun;   // Seconds since the scheduler epoch, 0 for a slot without a task
+
+        Task() : nextRun(0) {}
     };
 
+    /**
+     * @brief Convert a time point to seconds since the scheduler epoch
+     */
+    static uint32_t ToTick(std::chrono::steady_clock::time_point time);
+
+    /**
+     * @brief Interval a task actually runs at, with the floor applied (taskMutex held)
+     * @param intervalMinutes Interval of the record
+     * @return Interval in seconds
+     */
+    static uint32_t EffectiveSeconds(int32_t intervalMinutes);
+
     /**
      * @brief Main scheduler loop (runs in background thread)
      */
     static void SchedulerLoop();
 
     /**
-     * @brief Trigger refresh for a specific FQDN
-     * @param fqdn FQDN to refresh
+     * @brief Refresh a batch of due records through the refresh pipeline
+     * @param slots Audit store slots to refresh
      */
-    static void TriggerRefresh(const std::string& fqdn);
+    static void TriggerRefresh(const std::vector<RecordStore::Slot>& slots);
 
-    static std::map<std::string, Task> tasks;
+    static std::vector<Task> tasks;   // Indexed by audit store slot
+    static size_t taskCount;
+    static int32_t minIntervalMinutes;   // Guarded by taskMutex
+    static const std::chrono::steady_clock::time_point epoch;
     static std::mutex taskMutex;
     static std::thread schedulerThread;
+    static CancellationToken stopToken;
+    static std::mutex loopMutex;
+    static std::condition_variable loopExited;
+    static bool loopActive;            // Loop thread still running, guarded by loopMutex
     static std::atomic<bool> running;
     static std::atomic<bool> initialized;
 };
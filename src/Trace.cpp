@@ -0,0 +1,207 @@
+#include "Trace.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+struct TraceEvent {
+    const char* name;
+    const char* category;
+    double startUs;
+    double durationUs;
+    std::string detail;
+};
+
+/**
+ * @brief Events recorded by one thread
+ *
+ * Only the owning thread appends, so the mutex is uncontended except while
+ * Stop() drains the buffer.
+ */
+struct ThreadBuffer {
+    int tid;
+    std::string threadName;
+    std::mutex mutex;
+    std::vector<TraceEvent> events;
+};
+
+std::mutex registryMutex;
+std::vector<std::shared_ptr<ThreadBuffer>> buffers;   // Outlive their threads until written
+std::string tracePath;
+std::atomic<int64_t> epochNs(0);
+int nextTid = 1;
+
+int64_t SteadyNowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ThreadBuffer& LocalBuffer() {
+    thread_local std::shared_ptr<ThreadBuffer> buffer;
+    if (!buffer) {
+        buffer = std::make_shared<ThreadBuffer>();
+        std::lock_guard<std::mutex> lock(registryMutex);
+        buffer->tid = nextTid++;
+        buffers.push_back(buffer);
+    }
+    return *buffer;
+}
+
+void WriteEscaped(std::ostream& out, const std::string& text) {
+    for (char c : text) {
+        switch (c) {
+        case '"':  out << "\\\""; break;
+        case '\\': out << "\\\\"; break;
+        case '\n': out << "\\n"; break;
+        case '\r': out << "\\r"; break;
+        case '\t': out << "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned char>(c));
+                out << escaped;
+            }
+            else {
+                out << c;
+            }
+        }
+    }
+}
+
+} // namespace
+
+// Initialize static members
+std::atomic<bool> Trace::enabled(false);
+
+bool Trace::Start(const std::string& path) {
+    if (path.empty()) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    if (enabled) {
+        return false;
+    }
+
+    tracePath = path;
+    for (auto& buffer : buffers) {
+        std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+        buffer->events.clear();
+    }
+
+    epochNs = SteadyNowNs();
+    enabled = true;
+
+    std::cout << "Tracing enabled, writing trace to: " << path << std::endl;
+    return true;
+}
+
+bool Trace::Stop() {
+    std::vector<std::shared_ptr<ThreadBuffer>> snapshot;
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        if (!enabled) {
+            return false;
+        }
+        enabled = false;
+        snapshot = buffers;
+        path = tracePath;
+    }
+
+    std::ofstream file(path, std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open trace file for writing: " << path << std::endl;
+        return false;
+    }
+
+    size_t eventCount = 0;
+    bool first = true;
+    char number[64];
+
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    for (auto& buffer : snapshot) {
+        std::vector<TraceEvent> events;
+        std::string threadName;
+        {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+            events.swap(buffer->events);
+            threadName = buffer->threadName;
+        }
+
+        if (!threadName.empty()) {
+            file << (first ? "" : ",\n")
+                 << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << buffer->tid
+                 << ",\"args\":{\"name\":\"";
+            WriteEscaped(file, threadName);
+            file << "\"}}";
+            first = false;
+        }
+
+        for (const auto& event : events) {
+            std::snprintf(number, sizeof(number), "%.3f,\"dur\":%.3f", event.startUs, event.durationUs);
+            file << (first ? "" : ",\n")
+                 << "{\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid
+                 << ",\"name\":\"" << event.name << "\",\"cat\":\"" << event.category
+                 << "\",\"ts\":" << number;
+            if (!event.detail.empty()) {
+                file << ",\"args\":{\"detail\":\"";
+                WriteEscaped(file, event.detail);
+                file << "\"}";
+            }
+            file << "}";
+            first = false;
+        }
+        eventCount += events.size();
+    }
+    file << "\n]}\n";
+    file.close();
+
+    // Forget buffers of threads that have exited; live threads keep theirs
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        snapshot.clear();
+        buffers.erase(std::remove_if(buffers.begin(), buffers.end(),
+            [](const std::shared_ptr<ThreadBuffer>& buffer) { return buffer.use_count() == 1; }),
+            buffers.end());
+    }
+
+    if (!file) {
+        std::cerr << "Failed to write trace file: " << path << std::endl;
+        return false;
+    }
+
+    std::cout << "Trace with " << eventCount << " span(s) written to: " << path << std::endl;
+    return true;
+}
+
+void Trace::SetThreadName(const char* name) {
+    if (!IsEnabled()) {
+        return;
+    }
+
+    ThreadBuffer& buffer = LocalBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.threadName = name;
+}
+
+void Trace::Record(const char* name, const char* category, double startUs, double durationUs,
+                   const std::string& detail) {
+    // Spans still open when tracing stops are dropped
+    if (!IsEnabled()) {
+        return;
+    }
+
+    ThreadBuffer& buffer = LocalBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.events.push_back(TraceEvent{ name, category, startUs, durationUs, detail });
+}
+
+double Trace::NowUs() {
+    return (SteadyNowNs() - epochNs.load(std::memory_order_relaxed)) / 1000.0;
+}
@@ -0,0 +1,105 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+/**
+ * @brief Optional span tracing in the Chrome trace-event format
+ *
+ * While tracing is enabled, every TraceSpan records a complete ("X") event
+ * into a buffer owned by the calling thread, so recording never contends
+ * with other threads. Stop() merges all buffers into a JSON file that
+ * chrome://tracing and Perfetto open directly.
+ *
+ * When tracing is disabled a span costs one relaxed atomic load.
+ */
+class Trace {
+public:
+    /**
+     * @brief Start recording spans
+     * @param path File the trace is written to on Stop()
+     * @return true if tracing was started
+     */
+    static bool Start(const std::string& path);
+
+    /**
+     * @brief Stop recording and write the trace file
+     * @return true if the trace file was written
+     */
+    static bool Stop();
+
+    /**
+     * @brief Check whether spans are being recorded
+     * @return true if tracing is enabled
+     */
+    static bool IsEnabled() {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Name the calling thread in the trace viewer
+     * @param name Thread name, e.g. "pipeline-resolve"
+     */
+    static void SetThreadName(const char* name);
+
+    /**
+     * @brief Record a complete event for the calling thread
+     * @param name Span name (must outlive the trace, e.g. a string literal)
+     * @param category Span category (string literal)
+     * @param startUs Start time in microseconds since tracing started
+     * @param durationUs Duration in microseconds
+     * @param detail Optional value shown as the span's "detail" argument
+     */
+    static void Record(const char* name, const char* category, double startUs, double durationUs,
+                       const std::string& detail);
+
+    /**
+     * @brief Microseconds elapsed since tracing started
+     */
+    static double NowUs();
+
+private:
+    static std::atomic<bool> enabled;
+};
+
+/**
+ * @brief RAII span covering the lifetime of a scope
+ */
+class TraceSpan {
+public:
+    TraceSpan(const char* name, const char* category = "fqdn")
+        : name(name), category(category), active(Trace::IsEnabled()), startUs(0) {
+        if (active) {
+            startUs = Trace::NowUs();
+        }
+    }
+
+    TraceSpan(const char* name, const char* category, const std::string& detail)
+        : name(name), category(category), active(Trace::IsEnabled()), startUs(0) {
+        if (active) {
+            this->detail = detail;
+            startUs = Trace::NowUs();
+        }
+    }
+
+    ~TraceSpan() {
+        if (active) {
+            Trace::Record(name, category, startUs, Trace::NowUs() - startUs, detail);
+        }
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* name;
+    const char* category;
+    bool active;
+    double startUs;
+    std::string detail;
+};
+
+#endif // TRACE_H
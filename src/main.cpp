@@ -1,31 +1,133 @@
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <vector>
-#include <iomanip>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <csignal>
+#include <mutex>
+#include <algorithm>
+#include <ctime>
+#include <sys/stat.h>
+
+#ifdef _WIN32
 #include <Windows.h>
+#else
+#include <unistd.h>
+#endif
 
 #include "Config.h"
 #include "AuditLogger.h"
 #include "FirewallManager.h"
-#include "Resolver.h"
+#include "FirewallWriteQueue.h"
 #include "Scheduler.h"
+#include "Commands.h"
+#include "ControlChannel.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "Resolver.h"
+#include "Replication.h"
+#include "Log.h"
 
 // Function declarations
-void PrintUsage();
-void HandleBlockCommand(int argc, char* argv[]);
-void HandleRefreshCommand();
-void HandleListCommand();
-void HandleRemoveCommand(int argc, char* argv[]);
-void HandleSetIntervalCommand(int argc, char* argv[]);
-void PerformBootPreHydration();
+int RunLocal(const std::vector<std::string>& args, const std::string& traceFile);
+int RunService(const std::string& traceFile);
+std::string ExtractTraceOption(std::vector<std::string>& args);
+void ExtractLogOptions(std::vector<std::string>& args);
+void ConfigureResolver();
+bool ReloadConfig(const std::string& configPath, std::ostream& out);
+bool ConfigFileStamp(const std::string& configPath, std::pair<time_t, long long>& stamp);
 bool IsAdministrator();
+void OnStopSignal(int signal);
+void OnReloadSignal(int signal);
+
+// Set by Ctrl+C / SIGTERM or the "shutdown" command to stop the service
+static std::atomic<bool> stopRequested(false);
+
+// Set by SIGHUP to reload the configuration file
+static std::atomic<bool> reloadRequested(false);
+
+// Serializes service commands that change state; cancelled at shutdown
+static std::mutex commandMutex;
+static CancellationToken commandStop;
+
+static const std::string configPath = "config/config.json";
 
 int main(int argc, char* argv[]) {
+    // Let std::cout buffer; component logging no longer flushes every line
+    std::ios::sync_with_stdio(false);
+
     std::cout << "==================================================" << std::endl;
     std::cout << "     FQDN Blocker CLI - Windows Firewall Tool    " << std::endl;
     std::cout << "==================================================" << std::endl;
     std::cout << std::endl;
 
+    // Parse command line arguments
+    if (argc < 2) {
+        Commands::PrintUsage(std::cout);
+        return 1;
+    }
+
+    std::vector<std::string> args(argv + 1, argv + argc);
+    std::string traceFile = ExtractTraceOption(args);
+    ExtractLogOptions(args);
+    if (args.empty()) {
+        Commands::PrintUsage(std::cout);
+        return 1;
+    }
+    const std::string command = args[0];
+
+    if (command == "help" || command == "--help" || command == "-h") {
+        Commands::PrintUsage(std::cout);
+        return 0;
+    }
+
+    // Load configuration
+    Config::Load(configPath);
+
+    if (traceFile.empty()) {
+        traceFile = Config::GetTraceFilePath();
+    }
+
+    if (command == "service") {
+        return RunService(traceFile);
+    }
+
+    // Answered from the compiled file alone: no audit store, firewall or service needed
+    if (command == "check") {
+        int result = Commands::Execute(args, std::cout, std::cerr);
+        std::cout << std::flush;
+        return result;
+    }
+
+    // List files and stdin belong to the caller, so read them before forwarding
+    bool inputsOk = true;
+    args = Commands::ExpandBatchInputs(args, std::cerr, inputsOk);
+    if (!inputsOk) {
+        return 1;
+    }
+
+    // Hand the command to the resident service when one is running
+    int exitCode = 0;
+    std::string response;
+    if (ControlChannel::SendRequest(Config::GetControlChannelPath(), args, exitCode, response)) {
+        if (!traceFile.empty()) {
+            std::cerr << "Note: command was handled by the running service; start the service with --trace to trace it" << std::endl;
+        }
+        std::cout << response << std::flush;
+        return exitCode;
+    }
+
+    if (command == "shutdown" || command == "reload") {
+        std::cerr << "No running service found on: " << Config::GetControlChannelPath() << std::endl;
+        return 1;
+    }
+
+    return RunLocal(args, traceFile);
+}
+
+int RunLocal(const std::vector<std::string>& args, const std::string& traceFile) {
     // Check for Administrator privileges
     if (!IsAdministrator()) {
         std::cerr << "ERROR: This application requires Administrator privileges." << std::endl;
@@ -33,54 +135,37 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    // Load configuration
-    std::string configPath = "config/config.json";
-    Config::Load(configPath);
+    Trace::Start(traceFile);
+    Trace::SetThreadName("main");
 
     // Initialize components
     AuditLogger::Initialize(Config::GetAuditStorePath());
-    
+    ConfigureResolver();
+
     if (!FirewallManager::Initialize()) {
         std::cerr << "Failed to initialize Firewall Manager" << std::endl;
+        Trace::Stop();
         return 1;
     }
+    FirewallWriteQueue::Configure(Config::GetFirewallMaxOpsPerSecond(), Config::GetFirewallBurst());
 
     Scheduler::Initialize();
+    Scheduler::SetMinInterval(Config::GetMinRefreshIntervalMinutes());
+    Metrics::StartExporter(Config::GetMetricsFilePath(), Config::GetMetricsIntervalSeconds());
 
     // Perform boot pre-hydration
-    PerformBootPreHydration();
-
-    // Parse command line arguments
-    if (argc < 2) {
-        PrintUsage();
-        FirewallManager::Cleanup();
-        return 1;
+    if (Commands::NeedsHydration(args[0])) {
+        Commands::PerformBootPreHydration();
     }
 
-    std::string command = argv[1];
-
     try {
-        if (command == "block") {
-            HandleBlockCommand(argc, argv);
-        }
-        else if (command == "refresh") {
-            HandleRefreshCommand();
-        }
-        else if (command == "list") {
-            HandleListCommand();
-        }
-        else if (command == "remove") {
-            HandleRemoveCommand(argc, argv);
-        }
-        else if (command == "set-interval") {
-            HandleSetIntervalCommand(argc, argv);
-        }
-        else if (command == "help" || command == "--help" || command == "-h") {
-            PrintUsage();
-        }
-        else {
-            std::cerr << "Unknown command: " << command << std::endl;
-            PrintUsage();
+        int commandResult = Commands::Execute(args, std::cout, std::cerr);
+
+        // The trace covers hydration and the command, not the idle scheduler that may follow
+        Trace::Stop();
+
+        if (commandResult != 0) {
+            Metrics::StopExporter();
             FirewallManager::Cleanup();
             return 1;
         }
@@ -93,322 +178,313 @@ int main(int argc, char* argv[]) {
 
             // Keep the application running
             while (Scheduler::IsRunning()) {
+                Log::Flush();
                 std::this_thread::sleep_for(std::chrono::seconds(1));
             }
         }
     }
     catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
+        Trace::Stop();
+        Metrics::StopExporter();
         FirewallManager::Cleanup();
         return 1;
     }
 
     // Cleanup
-    Scheduler::Stop();
+    Scheduler::Stop(Config::GetShutdownTimeoutMs());
+    Scheduler::Join();   // A loop past the timeout still uses the firewall and audit store
+    Metrics::StopExporter();
     FirewallManager::Cleanup();
 
     return 0;
 }
 
-void PrintUsage() {
-    std::cout << "Usage: FqdnBlockerCli <command> [options]" << std::endl;
-    std::cout << std::endl;
-    std::cout << "Commands:" << std::endl;
-    std::cout << "  block <fqdn> [interval]    Block an FQDN with optional refresh interval (minutes)" << std::endl;
-    std::cout << "                             Example: FqdnBlockerCli block example.com 60" << std::endl;
-    std::cout << std::endl;
-    std::cout << "  refresh                    Manually refresh all blocked FQDNs" << std::endl;
-    std::cout << "                             Example: FqdnBlockerCli refresh" << std::endl;
-    std::cout << std::endl;
-    std::cout << "  list                       List all blocked FQDNs and their status" << std::endl;
-    std::cout << "                             Example: FqdnBlockerCli list" << std::endl;
-    std::cout << std::endl;
-    std::cout << "  remove <fqdn>              Remove a blocked FQDN and its firewall rule" << std::endl;
-    std::cout << "                             Example: FqdnBlockerCli remove example.com" << std::endl;
-    std::cout << std::endl;
-    std::cout << "  set-interval <minutes>     Set the default refresh interval" << std::endl;
-    std::cout << "                             Example: FqdnBlockerCli set-interval 120" << std::endl;
-    std::cout << std::endl;
-    std::cout << "  help                       Display this help message" << std::endl;
-    std::cout << std::endl;
-    std::cout << "Note: This application requires Administrator privileges." << std::endl;
-}
-
-void HandleBlockCommand(int argc, char* argv[]) {
-    if (argc < 3) {
-        std::cerr << "Error: Missing FQDN parameter" << std::endl;
-        std::cout << "Usage: FqdnBlockerCli block <fqdn> [interval]" << std::endl;
-        return;
-    }
-
-    std::string fqdn = argv[2];
-    int interval = Config::GetDefaultInterval();
-
-    if (argc >= 4) {
-        try {
-            interval = std::stoi(argv[3]);
-            if (interval <= 0) {
-                std::cerr << "Error: Interval must be a positive number" << std::endl;
-                return;
-            }
-        }
-        catch (const std::exception&) {
-            std::cerr << "Error: Invalid interval value" << std::endl;
-            return;
-        }
+int RunService(const std::string& traceFile) {
+    if (!IsAdministrator()) {
+        std::cerr << "ERROR: This application requires Administrator privileges." << std::endl;
+        std::cerr << "Please run as Administrator." << std::endl;
+        return 1;
     }
 
-    std::cout << "\nBlocking FQDN: " << fqdn << std::endl;
-    std::cout << "Refresh interval: " << interval << " minutes" << std::endl;
-    std::cout << std::endl;
-
-    // Resolve the FQDN
-    std::cout << "Resolving " << fqdn << "..." << std::endl;
-    std::vector<std::string> ips = Resolver::ResolveFqdn(fqdn);
+    Trace::Start(traceFile);
+    Trace::SetThreadName("main");
 
-    if (ips.empty()) {
-        std::cerr << "Error: Could not resolve FQDN" << std::endl;
-        return;
-    }
-
-    // Create dynamic keyword address
-    std::cout << "Creating dynamic keyword address..." << std::endl;
-    std::string keywordId = FirewallManager::CreateDynamicKeywordAddress(fqdn, ips, true);
+    AuditLogger::Initialize(Config::GetAuditStorePath());
+    ConfigureResolver();
 
-    if (keywordId.empty()) {
-        std::cerr << "Error: Failed to create dynamic keyword address" << std::endl;
-        return;
+    if (!FirewallManager::Initialize()) {
+        std::cerr << "Failed to initialize Firewall Manager" << std::endl;
+        Trace::Stop();
+        return 1;
     }
+    FirewallWriteQueue::Configure(Config::GetFirewallMaxOpsPerSecond(), Config::GetFirewallBurst());
 
-    // Create firewall rule
-    std::string ruleName = "Block " + fqdn;
-    std::cout << "Creating firewall rule: " << ruleName << std::endl;
-    
-    if (!FirewallManager::CreateFirewallRule(ruleName, keywordId, "Outbound", "Block")) {
-        std::cerr << "Error: Failed to create firewall rule" << std::endl;
-        FirewallManager::DeleteDynamicKeywordAddress(keywordId);
-        return;
+    Scheduler::Initialize();
+    Scheduler::SetMinInterval(Config::GetMinRefreshIntervalMinutes());
+    Metrics::StartExporter(Config::GetMetricsFilePath(), Config::GetMetricsIntervalSeconds());
+
+    // Replication settings are read once; a reload reports them as needing a restart
+    Commands::ReplicationSettings replication;
+    replication.listen = Config::GetReplicationListen();
+    replication.secret = Config::GetReplicationSecret();
+    replication.statePath = Config::GetReplicationStatePath();
+    Commands::SetReplicationSettings(replication);
+
+    if (!Config::GetReplicationLeader().empty()) {
+        // Warm standby: the leader's records and addresses arrive by replication
+        if (!Replication::StartFollower(Config::GetReplicationLeader(), replication.secret, replication.statePath)) {
+            Trace::Stop();
+            Metrics::StopExporter();
+            FirewallManager::Cleanup();
+            return 1;
+        }
     }
+    else {
+        // Hydrate once for the lifetime of the service, not once per command
+        Commands::PerformBootPreHydration();
+        Scheduler::Start();
 
-    // Add to audit logger
-    Record record(fqdn, keywordId, ruleName, ips, interval);
-    if (!AuditLogger::AddRecord(record)) {
-        std::cerr << "Error: Failed to add audit record" << std::endl;
-        FirewallManager::DeleteFirewallRule(ruleName);
-        FirewallManager::DeleteDynamicKeywordAddress(keywordId);
-        return;
+        if (!replication.listen.empty() && !Replication::StartLeader(replication.listen, replication.secret)) {
+            std::cerr << "Failed to start replication on " << replication.listen << std::endl;
+        }
     }
 
-    // Add to scheduler
-    Scheduler::AddTask(fqdn, interval);
+    Commands::SetCancellation(&commandStop);
+    bool started = ControlChannel::StartServer(Config::GetControlChannelPath(),
+        [](const std::vector<std::string>& args, std::string& response) -> int {
+            const std::string& command = args[0];
 
-    std::cout << "\nSuccessfully blocked " << fqdn << std::endl;
-    std::cout << "Resolved to " << ips.size() << " IP address(es):" << std::endl;
-    for (const auto& ip : ips) {
-        std::cout << "  - " << ip << std::endl;
-    }
-}
-
-void HandleRefreshCommand() {
-    std::cout << "\nRefreshing all blocked FQDNs..." << std::endl;
+            if (command == "ping") {
+                response = "pong\n";
+                return 0;
+            }
+            if (command == "shutdown") {
+                stopRequested = true;
+                response = "Service is shutting down\n";
+                return 0;
+            }
+            if (command == "service") {
+                response = "Service is already running\n";
+                return 1;
+            }
+            if (command == "reload") {
+                std::ostringstream out;
+                bool reloaded = ReloadConfig(configPath, out);
+                response = out.str();
+                return reloaded ? 0 : 1;
+            }
 
-    auto records = AuditLogger::ListRecords();
+            // Requests arrive on their own threads: reads run at once, changes one at a time
+            std::unique_lock<std::mutex> serial(commandMutex, std::defer_lock);
+            if (!Commands::IsReadOnly(command)) {
+                serial.lock();
+            }
 
-    if (records.empty()) {
-        std::cout << "No FQDNs are currently blocked." << std::endl;
-        return;
+            std::ostringstream out;
+            int exitCode = Commands::Execute(args, out, out);
+            response = out.str();
+            return exitCode;
+        });
+
+    if (!started) {
+        Replication::Stop();
+        Scheduler::Stop(Config::GetShutdownTimeoutMs());
+        Scheduler::Join();
+        Trace::Stop();
+        Metrics::StopExporter();
+        FirewallManager::Cleanup();
+        return 1;
     }
 
-    int successCount = 0;
-    int failureCount = 0;
+    std::signal(SIGINT, OnStopSignal);
+    std::signal(SIGTERM, OnStopSignal);
+#ifndef _WIN32
+    std::signal(SIGHUP, OnReloadSignal);
+#endif
 
-    for (const auto& record : records) {
-        std::cout << "\nRefreshing: " << record.fqdn << std::endl;
+    std::cout << "\nService running. Press Ctrl+C or run 'FqdnBlockerCli shutdown' to stop." << std::endl;
 
-        // Resolve new IPs
-        std::vector<std::string> newIPs = Resolver::ResolveFqdn(record.fqdn);
+    // Reload when the file changes, on SIGHUP or on the "reload" command
+    std::pair<time_t, long long> configStamp;
+    bool configExists = ConfigFileStamp(configPath, configStamp);
 
-        if (newIPs.empty()) {
-            std::cerr << "  Failed to resolve" << std::endl;
-            failureCount++;
-            continue;
-        }
+    while (!stopRequested) {
+        Log::Flush();
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
 
-        // Check if IPs changed
-        bool changed = (newIPs.size() != record.lastResolvedIPs.size());
-        if (!changed) {
-            std::vector<std::string> sortedNew = newIPs;
-            std::vector<std::string> sortedOld = record.lastResolvedIPs;
-            std::sort(sortedNew.begin(), sortedNew.end());
-            std::sort(sortedOld.begin(), sortedOld.end());
-            changed = (sortedNew != sortedOld);
-        }
+        std::pair<time_t, long long> stamp;
+        bool exists = ConfigFileStamp(configPath, stamp);
+        bool fileChanged = exists && (!configExists || stamp != configStamp);
+        configExists = exists;
+        configStamp = stamp;
 
-        if (changed) {
-            std::cout << "  IP addresses changed" << std::endl;
-            
-            // Update dynamic keyword address
-            if (FirewallManager::UpdateDynamicKeywordAddress(record.keywordId, newIPs)) {
-                // Update audit record
-                AuditLogger::UpdateRecord(record.fqdn, newIPs);
-                std::cout << "  Updated successfully" << std::endl;
-                successCount++;
-            }
-            else {
-                std::cerr << "  Failed to update firewall" << std::endl;
-                failureCount++;
-            }
-        }
-        else {
-            std::cout << "  No changes detected" << std::endl;
-            successCount++;
+        if (fileChanged || reloadRequested.exchange(false)) {
+            // The outcome is logged; the report is for the "reload" command
+            std::ostringstream report;
+            ReloadConfig(configPath, report);
         }
     }
 
-    std::cout << "\n==================================================" << std::endl;
-    std::cout << "Refresh complete: " << successCount << " successful, " 
-              << failureCount << " failed" << std::endl;
-}
-
-void HandleListCommand() {
-    auto records = AuditLogger::ListRecords();
+    // Cleanup: abandon a refresh command in progress, then wait for the requests
+    commandStop.Cancel();
+    ControlChannel::StopServer();
+    Replication::Stop();
+    Scheduler::Stop(Config::GetShutdownTimeoutMs());
+    Scheduler::Join();   // A loop past the timeout still uses the firewall and audit store
+    Trace::Stop();
+    Metrics::StopExporter();
+    FirewallManager::Cleanup();
 
-    if (records.empty()) {
-        std::cout << "\nNo FQDNs are currently blocked." << std::endl;
-        return;
-    }
+    return 0;
+}
 
-    std::cout << "\n==================================================" << std::endl;
-    std::cout << "Blocked FQDNs (" << records.size() << ")" << std::endl;
-    std::cout << "==================================================" << std::endl;
+std::string ExtractTraceOption(std::vector<std::string>& args) {
+    std::string traceFile;
 
-    for (const auto& record : records) {
-        std::cout << "\nFQDN: " << record.fqdn << std::endl;
-        std::cout << "  Rule Name: " << record.ruleName << std::endl;
-        std::cout << "  Keyword ID: " << record.keywordId << std::endl;
-        std::cout << "  Refresh Interval: " << record.interval << " minutes" << std::endl;
-        std::cout << "  IP Addresses (" << record.lastResolvedIPs.size() << "):" << std::endl;
-        
-        for (const auto& ip : record.lastResolvedIPs) {
-            std::cout << "    - " << ip << std::endl;
+    for (size_t i = 0; i < args.size(); ) {
+        if (args[i] == "--trace" && i + 1 < args.size()) {
+            traceFile = args[i + 1];
+            args.erase(args.begin() + i, args.begin() + i + 2);
+        }
+        else {
+            i++;
         }
-
-        // Convert blocked time
-        std::tm tm;
-        localtime_s(&tm, &record.blockedAt);
-        std::cout << "  Blocked At: " << std::put_time(&tm, "%Y-%m-%d %H:%M:%S") << std::endl;
     }
 
-    std::cout << "==================================================" << std::endl;
+    return traceFile;
 }
 
-void HandleRemoveCommand(int argc, char* argv[]) {
-    if (argc < 3) {
-        std::cerr << "Error: Missing FQDN parameter" << std::endl;
-        std::cout << "Usage: FqdnBlockerCli remove <fqdn>" << std::endl;
-        return;
-    }
-
-    std::string fqdn = argv[2];
-
-    std::cout << "\nRemoving block for: " << fqdn << std::endl;
-
-    // Get the record
-    Record record;
-    if (!AuditLogger::GetRecord(fqdn, record)) {
-        std::cerr << "Error: FQDN not found in blocked list" << std::endl;
-        return;
-    }
-
-    // Delete firewall rule
-    std::cout << "Deleting firewall rule..." << std::endl;
-    if (!FirewallManager::DeleteFirewallRule(record.ruleName)) {
-        std::cerr << "Warning: Failed to delete firewall rule" << std::endl;
-    }
-
-    // Delete dynamic keyword address
-    std::cout << "Deleting dynamic keyword address..." << std::endl;
-    if (!FirewallManager::DeleteDynamicKeywordAddress(record.keywordId)) {
-        std::cerr << "Warning: Failed to delete dynamic keyword address" << std::endl;
+void ExtractLogOptions(std::vector<std::string>& args) {
+    for (size_t i = 0; i < args.size(); ) {
+        if (args[i] == "--quiet" || args[i] == "-q") {
+            Log::SetLevel(LogLevel::Warning);
+            args.erase(args.begin() + i);
+        }
+        else if (args[i] == "--verbose" || args[i] == "-v") {
+            Log::SetLevel(LogLevel::Debug);
+            args.erase(args.begin() + i);
+        }
+        else {
+            i++;
+        }
     }
+}
 
-    // Remove from audit logger
-    if (!AuditLogger::RemoveRecord(fqdn)) {
-        std::cerr << "Error: Failed to remove audit record" << std::endl;
-        return;
+void ConfigureResolver() {
+    Resolver::Policy policy = Resolver::Policy::FanOut;
+    if (!Resolver::ParsePolicy(Config::GetDnsUpstreamPolicy(), policy)) {
+        LOG_WARNING("Unknown dnsUpstreamPolicy '" << Config::GetDnsUpstreamPolicy() << "'; using fanout");
     }
-
-    // Remove from scheduler
-    Scheduler::RemoveTask(fqdn);
-
-    std::cout << "\nSuccessfully removed block for: " << fqdn << std::endl;
+    Resolver::SetUpstreams(Config::GetDnsUpstreams(), Config::GetDnsTimeoutMs(), policy);
 }
 
-void HandleSetIntervalCommand(int argc, char* argv[]) {
-    if (argc < 3) {
-        std::cerr << "Error: Missing interval parameter" << std::endl;
-        std::cout << "Usage: FqdnBlockerCli set-interval <minutes>" << std::endl;
-        return;
+bool ReloadConfig(const std::string& configPath, std::ostream& out) {
+    static Counter& reloads = Metrics::GetCounter("fqdn_config_reloads_total",
+        "Configuration reloads applied");
+    static Counter& rejected = Metrics::GetCounter("fqdn_config_reload_failures_total",
+        "Configuration reloads rejected because the file was invalid");
+    static std::mutex reloadMutex;
+
+    std::lock_guard<std::mutex> lock(reloadMutex);
+    auto started = std::chrono::steady_clock::now();
+
+    std::vector<std::string> changed;
+    std::string error;
+    if (!Config::Reload(configPath, changed, error)) {
+        rejected.Increment();
+        LOG_WARNING("Configuration not reloaded, keeping the current settings: " << error);
+        out << "Configuration not reloaded, keeping the current settings: " << error << std::endl;
+        return false;
+    }
+    reloads.Increment();
+    if (changed.empty()) {
+        out << "Configuration reloaded: nothing changed" << std::endl;
+        return true;
     }
 
-    try {
-        int interval = std::stoi(argv[2]);
-        
-        if (interval <= 0) {
-            std::cerr << "Error: Interval must be a positive number" << std::endl;
-            return;
+    auto changedAny = [&changed](std::initializer_list<const char*> keys) {
+        for (const char* key : keys) {
+            if (std::find(changed.begin(), changed.end(), key) != changed.end()) {
+                return true;
+            }
         }
+        return false;
+    };
 
-        Config::SetDefaultInterval(interval);
-        Config::Save("config/config.json");
-
-        std::cout << "\nDefault refresh interval set to: " << interval << " minutes" << std::endl;
+    // Only the components whose settings changed are touched; records are neither resolved nor pushed
+    if (changedAny({ "dnsUpstream", "dnsUpstreams", "dnsTimeoutMs", "dnsUpstreamPolicy" })) {
+        ConfigureResolver();
     }
-    catch (const std::exception&) {
-        std::cerr << "Error: Invalid interval value" << std::endl;
+    if (changedAny({ "firewallMaxOpsPerSecond", "firewallBurst" })) {
+        FirewallWriteQueue::Configure(Config::GetFirewallMaxOpsPerSecond(), Config::GetFirewallBurst());
     }
-}
-
-void PerformBootPreHydration() {
-    auto records = AuditLogger::ListRecords();
-
-    if (records.empty()) {
-        return;
+    if (changedAny({ "metricsFilePath", "metricsIntervalSeconds" })) {
+        Metrics::StopExporter();
+        Metrics::StartExporter(Config::GetMetricsFilePath(), Config::GetMetricsIntervalSeconds());
+    }
+    size_t rescheduled = 0;
+    if (changedAny({ "minRefreshIntervalMinutes" })) {
+        rescheduled = Scheduler::SetMinInterval(Config::GetMinRefreshIntervalMinutes());
     }
 
-    std::cout << "\n==================================================" << std::endl;
-    std::cout << "Performing boot pre-hydration for " << records.size() << " FQDN(s)..." << std::endl;
-    std::cout << "==================================================" << std::endl;
-
-    for (const auto& record : records) {
-        std::cout << "\nHydrating: " << record.fqdn << std::endl;
-
-        // Resolve the FQDN
-        std::vector<std::string> ips = Resolver::ResolveFqdn(record.fqdn);
-
-        if (ips.empty()) {
-            std::cerr << "  Warning: Failed to resolve" << std::endl;
-            continue;
+    // Read once at startup; everything else is read when it is next used
+    const std::vector<std::string> restartKeys = {
+        "auditStorePath", "controlChannelPath", "traceFilePath",
+        "replicationListen", "replicationLeader", "replicationSecret", "replicationStatePath"
+    };
+    const std::vector<std::string> unusedKeys = { "logFilePath" };
+
+    std::string keyList;
+    out << "Configuration reloaded:" << std::endl;
+    for (const auto& key : changed) {
+        keyList += (keyList.empty() ? "" : ", ") + key;
+        out << "  " << key;
+        if (std::find(restartKeys.begin(), restartKeys.end(), key) != restartKeys.end()) {
+            out << " (takes effect after a restart)";
         }
-
-        // Update the dynamic keyword address
-        if (FirewallManager::UpdateDynamicKeywordAddress(record.keywordId, ips)) {
-            AuditLogger::UpdateRecord(record.fqdn, ips);
-            std::cout << "  Successfully hydrated with " << ips.size() << " IP(s)" << std::endl;
+        else if (std::find(unusedKeys.begin(), unusedKeys.end(), key) != unusedKeys.end()) {
+            out << " (not used by this version)";
         }
-        else {
-            std::cerr << "  Warning: Failed to update firewall" << std::endl;
+        else if (key == "minRefreshIntervalMinutes") {
+            out << " (" << rescheduled << " task(s) rescheduled)";
         }
+        out << std::endl;
+    }
+
+    auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - started).count();
+    out << "Applied in " << elapsedMs << " ms" << std::endl;
+    LOG_INFO("Configuration reloaded in " << elapsedMs << " ms; changed: " << keyList);
+    return true;
+}
 
-        // Re-add to scheduler
-        Scheduler::AddTask(record.fqdn, record.interval);
+bool ConfigFileStamp(const std::string& configPath, std::pair<time_t, long long>& stamp) {
+#ifdef _WIN32
+    struct _stat info;
+    if (_stat(configPath.c_str(), &info) != 0) {
+        return false;
     }
+#else
+    struct stat info;
+    if (stat(configPath.c_str(), &info) != 0) {
+        return false;
+    }
+#endif
+    stamp = std::make_pair(info.st_mtime, static_cast<long long>(info.st_size));
+    return true;
+}
 
-    std::cout << "\nBoot pre-hydration complete." << std::endl;
-    std::cout << "==================================================" << std::endl;
+void OnStopSignal(int) {
+    stopRequested = true;
+}
+
+void OnReloadSignal(int) {
+    reloadRequested = true;
 }
 
 bool IsAdministrator() {
+#ifdef _WIN32
     BOOL isAdmin = FALSE;
     PSID administratorsGroup = nullptr;
     SID_IDENTIFIER_AUTHORITY ntAuthority = SECURITY_NT_AUTHORITY;
@@ -418,7 +494,7 @@ bool IsAdministrator() {
         DOMAIN_ALIAS_RID_ADMINS,
         0, 0, 0, 0, 0, 0,
         &administratorsGroup)) {
-        
+
         if (!CheckTokenMembership(nullptr, administratorsGroup, &isAdmin)) {
             isAdmin = FALSE;
         }
@@ -426,4 +502,7 @@ bool IsAdministrator() {
     }
 
     return isAdmin == TRUE;
+#else
+    return geteuid() == 0;
+#endif
 }
@@ -0,0 +1,550 @@
+/**
+ * @file DnsLoadServer.cpp
+ * @brief Synthetic DNS server for reproducible refresh benchmarking
+ *
+ * Answers A and AAAA queries over UDP for synthetic zones. Each zone sets
+ * how many addresses a name has, how often its answer set changes (churn),
+ * whether answers rotate between responses, the TTL, a response latency
+ * distribution, and SERVFAIL / NXDOMAIN / drop injection rates. Answers are
+ * derived deterministically from the name, the seed and the (optionally
+ * accelerated) clock, so runs can be repeated and day-long churn profiles
+ * replayed in minutes with --speed.
+ *
+ * Point the blocker at it with "dnsUpstream": "127.0.0.1:5353".
+ *
+ * Usage: fqdn_dns_loadserver [--bind 127.0.0.1] [--port 5353] [--zones <file>]
+ *                            [--speed <factor>] [--seed <n>]
+ *                            [--stats-interval <seconds>] [--stats-file <file>]
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "DnsMessage.h"
+#include "json.hpp"
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+/**
+ * @brief Response latency distribution
+ */
+struct Latency {
+    std::string distribution = "fixed";   // fixed, uniform, exponential, lognormal
+    double fixedMs = 0;
+    double minMs = 0;
+    double maxMs = 0;
+    double meanMs = 0;
+    double medianMs = 0;
+    double sigma = 0.5;
+    double capMs = 10000;
+
+    double Sample(std::mt19937_64& rng) const {
+        double ms = fixedMs;
+        if (distribution == "uniform") {
+            ms = std::uniform_real_distribution<double>(minMs, std::max(minMs, maxMs))(rng);
+        }
+        else if (distribution == "exponential" && meanMs > 0) {
+            ms = std::exponential_distribution<double>(1.0 / meanMs)(rng);
+        }
+        else if (distribution == "lognormal" && medianMs > 0) {
+            ms = std::lognormal_distribution<double>(std::log(medianMs), sigma)(rng);
+        }
+        return std::min(std::max(ms, 0.0), capMs);
+    }
+};
+
+/**
+ * @brief Behaviour of every name under a suffix
+ */
+struct Zone {
+    std::string suffix;          // Empty or "*" matches every name
+    int ipv4 = 2;                // A records per answer
+    int ipv6 = 1;                // AAAA records per answer
+    int pool = 0;                // Addresses per name to pick answers from; 0 = fresh addresses on churn
+    uint32_t ttl = 300;
+    double churnSeconds = 3600;  // Mean time between answer-set changes per name; 0 = never
+    bool roundRobin = true;      // Rotate address order between responses
+    double servfailRate = 0;
+    double nxdomainRate = 0;
+    double dropRate = 0;
+    Latency latency;
+};
+
+struct Options {
+    std::string bindAddress = "127.0.0.1";
+    int port = 5353;
+    std::string zonesPath;
+    double speed = 1.0;
+    uint64_t seed = 1;
+    int statsIntervalSeconds = 10;
+    std::string statsPath;
+};
+
+struct Stats {
+    std::atomic<uint64_t> queries{0};
+    std::atomic<uint64_t> queriesA{0};
+    std::atomic<uint64_t> queriesAAAA{0};
+    std::atomic<uint64_t> queriesOther{0};
+    std::atomic<uint64_t> noError{0};
+    std::atomic<uint64_t> nxdomain{0};
+    std::atomic<uint64_t> servfail{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> malformed{0};
+    std::atomic<uint64_t> delayedTotalUs{0};
+};
+
+struct DelayedResponse {
+    Clock::time_point due;
+    sockaddr_storage peer;
+    socklen_t peerLength;
+    std::vector<uint8_t> packet;
+
+    bool operator>(const DelayedResponse& other) const { return due > other.due; }
+};
+
+std::atomic<bool> stopRequested(false);
+
+void OnStopSignal(int) {
+    stopRequested = true;
+}
+
+uint64_t Mix(uint64_t x) {
+    // splitmix64 finalizer
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+uint64_t HashName(const std::string& name, uint64_t seed) {
+    uint64_t h = 1469598103934665603ULL ^ seed;
+    for (char c : name) {
+        h ^= static_cast<unsigned char>(std::tolower(static_cast<unsigned char>(c)));
+        h *= 1099511628211ULL;
+    }
+    return Mix(h);
+}
+
+// Synthetic addresses come from the benchmarking (198.18.0.0/15) and documentation (2001:db8::/32) ranges
+std::vector<uint8_t> SyntheticV4(uint64_t h) {
+    return { 198, static_cast<uint8_t>(18 + ((h >> 16) & 1)),
+             static_cast<uint8_t>((h >> 8) & 0xFF), static_cast<uint8_t>(1 + (h % 254)) };
+}
+
+std::vector<uint8_t> SyntheticV6(uint64_t h) {
+    std::vector<uint8_t> bytes = { 0x20, 0x01, 0x0d, 0xb8 };
+    uint64_t more = Mix(h);
+    for (int i = 0; i < 4; i++) {
+        bytes.push_back(static_cast<uint8_t>(h >> (8 * i)));
+    }
+    for (int i = 0; i < 8; i++) {
+        bytes.push_back(static_cast<uint8_t>(more >> (8 * i)));
+    }
+    return bytes;
+}
+
+/**
+ * @brief Addresses of one family for a name in its current churn generation
+ */
+std::vector<std::vector<uint8_t>> AnswerSet(const Zone& zone, uint64_t nameHash, uint64_t generation,
+                                            int count, bool v6) {
+    std::vector<std::vector<uint8_t>> addresses;
+    const uint64_t family = v6 ? 0x66 : 0x44;
+
+    if (zone.pool > count) {
+        // Stable pool per name; each generation picks a different subset of it
+        std::vector<int> slots(zone.pool);
+        for (int i = 0; i < zone.pool; i++) {
+            slots[i] = i;
+        }
+        std::mt19937_64 pick(Mix(nameHash ^ Mix(generation) ^ family));
+        for (int i = 0; i < count; i++) {
+            std::uniform_int_distribution<int> next(i, zone.pool - 1);
+            std::swap(slots[i], slots[next(pick)]);
+            uint64_t h = Mix(nameHash ^ Mix(family + static_cast<uint64_t>(slots[i])));
+            addresses.push_back(v6 ? SyntheticV6(h) : SyntheticV4(h));
+        }
+    }
+    else {
+        for (int i = 0; i < count; i++) {
+            uint64_t h = Mix(nameHash ^ Mix(generation * 1315423911ULL + family + static_cast<uint64_t>(i)));
+            addresses.push_back(v6 ? SyntheticV6(h) : SyntheticV4(h));
+        }
+    }
+
+    return addresses;
+}
+
+const Zone* FindZone(const std::vector<Zone>& zones, const std::string& name) {
+    const Zone* best = nullptr;
+    size_t bestLength = 0;
+
+    for (const auto& zone : zones) {
+        const std::string& suffix = zone.suffix;
+        bool matches = suffix.empty() || suffix == "*" ||
+            name == suffix ||
+            (name.size() > suffix.size() &&
+             name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0 &&
+             name[name.size() - suffix.size() - 1] == '.');
+        size_t length = (suffix == "*") ? 0 : suffix.size();
+        if (matches && (best == nullptr || length > bestLength)) {
+            best = &zone;
+            bestLength = length;
+        }
+    }
+
+    return best;
+}
+
+Latency ParseLatency(const json& j) {
+    Latency latency;
+    latency.distribution = j.value("distribution", latency.distribution);
+    latency.fixedMs = j.value("ms", latency.fixedMs);
+    latency.minMs = j.value("minMs", latency.minMs);
+    latency.maxMs = j.value("maxMs", latency.maxMs);
+    latency.meanMs = j.value("meanMs", latency.meanMs);
+    latency.medianMs = j.value("medianMs", latency.medianMs);
+    latency.sigma = j.value("sigma", latency.sigma);
+    latency.capMs = j.value("capMs", latency.capMs);
+    return latency;
+}
+
+bool LoadZones(const std::string& path, std::vector<Zone>& zones) {
+    if (path.empty()) {
+        Zone zone;
+        zone.suffix = "*";
+        zone.pool = 8;
+        zone.latency.fixedMs = 1;
+        zones.push_back(zone);
+        return true;
+    }
+
+    try {
+        std::ifstream file(path);
+        if (!file.is_open()) {
+            std::cerr << "Failed to open zones file: " << path << std::endl;
+            return false;
+        }
+
+        json j;
+        file >> j;
+        for (const auto& item : j.at("zones")) {
+            Zone zone;
+            zone.suffix = item.value("suffix", std::string("*"));
+            std::transform(zone.suffix.begin(), zone.suffix.end(), zone.suffix.begin(),
+                [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+            zone.ipv4 = item.value("ipv4", zone.ipv4);
+            zone.ipv6 = item.value("ipv6", zone.ipv6);
+            zone.pool = item.value("pool", zone.pool);
+            zone.ttl = item.value("ttl", zone.ttl);
+            zone.churnSeconds = item.value("churnSeconds", zone.churnSeconds);
+            zone.roundRobin = item.value("roundRobin", zone.roundRobin);
+            zone.servfailRate = item.value("servfailRate", zone.servfailRate);
+            zone.nxdomainRate = item.value("nxdomainRate", zone.nxdomainRate);
+            zone.dropRate = item.value("dropRate", zone.dropRate);
+            if (item.contains("latency")) {
+                zone.latency = ParseLatency(item["latency"]);
+            }
+            zones.push_back(zone);
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error loading zones file: " << e.what() << std::endl;
+        return false;
+    }
+
+    if (zones.empty()) {
+        std::cerr << "Zones file defines no zones: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool ParseOptions(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--bind" && hasValue) {
+            options.bindAddress = argv[++i];
+        }
+        else if (arg == "--port" && hasValue) {
+            options.port = std::stoi(argv[++i]);
+        }
+        else if (arg == "--zones" && hasValue) {
+            options.zonesPath = argv[++i];
+        }
+        else if (arg == "--speed" && hasValue) {
+            options.speed = std::stod(argv[++i]);
+        }
+        else if (arg == "--seed" && hasValue) {
+            options.seed = std::stoull(argv[++i]);
+        }
+        else if (arg == "--stats-interval" && hasValue) {
+            options.statsIntervalSeconds = std::stoi(argv[++i]);
+        }
+        else if (arg == "--stats-file" && hasValue) {
+            options.statsPath = argv[++i];
+        }
+        else {
+            std::cerr << "Usage: fqdn_dns_loadserver [--bind 127.0.0.1] [--port 5353] [--zones <file>]" << std::endl;
+            std::cerr << "                           [--speed <factor>] [--seed <n>]" << std::endl;
+            std::cerr << "                           [--stats-interval <seconds>] [--stats-file <file>]" << std::endl;
+            return false;
+        }
+    }
+    return options.speed > 0;
+}
+
+json StatsToJson(const Stats& stats, size_t uniqueNames, double elapsedSeconds, double speed) {
+    json j;
+    j["elapsed_seconds"] = elapsedSeconds;
+    j["simulated_seconds"] = elapsedSeconds * speed;
+    j["queries"] = stats.queries.load();
+    j["queries_a"] = stats.queriesA.load();
+    j["queries_aaaa"] = stats.queriesAAAA.load();
+    j["queries_other"] = stats.queriesOther.load();
+    j["unique_names"] = uniqueNames;
+    j["noerror"] = stats.noError.load();
+    j["nxdomain"] = stats.nxdomain.load();
+    j["servfail"] = stats.servfail.load();
+    j["dropped"] = stats.dropped.load();
+    j["malformed"] = stats.malformed.load();
+    uint64_t answered = stats.noError + stats.nxdomain + stats.servfail;
+    j["mean_latency_ms"] = answered > 0 ? stats.delayedTotalUs.load() / 1000.0 / answered : 0.0;
+    return j;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    std::vector<Zone> zones;
+    if (!ParseOptions(argc, argv, options) || !LoadZones(options.zonesPath, zones)) {
+        return 1;
+    }
+
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(options.port));
+    if (sock < 0 || inet_pton(AF_INET, options.bindAddress.c_str(), &address.sin_addr) != 1 ||
+        bind(sock, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        std::cerr << "Failed to bind " << options.bindAddress << ":" << options.port
+                  << ": " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+
+    std::signal(SIGINT, OnStopSignal);
+    std::signal(SIGTERM, OnStopSignal);
+
+    std::cout << "Synthetic DNS server listening on " << options.bindAddress << ":" << options.port
+              << " (" << zones.size() << " zone(s), speed x" << options.speed << ")" << std::endl;
+
+    Stats stats;
+    std::unordered_set<std::string> names;
+    const auto startTime = Clock::now();
+
+    // Responses with latency wait in a queue served by a sender thread, so a
+    // slow answer never holds up the next query
+    std::priority_queue<DelayedResponse, std::vector<DelayedResponse>, std::greater<DelayedResponse>> delayed;
+    std::mutex delayedMutex;
+    std::condition_variable delayedCv;
+
+    std::thread sender([&]() {
+        std::unique_lock<std::mutex> lock(delayedMutex);
+        while (!stopRequested) {
+            if (delayed.empty()) {
+                delayedCv.wait_for(lock, std::chrono::milliseconds(200));
+                continue;
+            }
+            if (Clock::now() < delayed.top().due) {
+                delayedCv.wait_until(lock, delayed.top().due);
+                continue;
+            }
+            DelayedResponse response = delayed.top();
+            delayed.pop();
+            lock.unlock();
+            sendto(sock, response.packet.data(), response.packet.size(), 0,
+                   reinterpret_cast<sockaddr*>(&response.peer), response.peerLength);
+            lock.lock();
+        }
+    });
+
+    std::mt19937_64 rng(options.seed);
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+    uint64_t rotation = 0;
+    auto nextReport = startTime + std::chrono::seconds(std::max(1, options.statsIntervalSeconds));
+    uint64_t lastReportQueries = 0;
+    uint8_t buffer[4096];
+
+    while (!stopRequested) {
+        pollfd pfd = {};
+        pfd.fd = sock;
+        pfd.events = POLLIN;
+        int ready = poll(&pfd, 1, 200);
+
+        auto now = Clock::now();
+        if (options.statsIntervalSeconds > 0 && now >= nextReport) {
+            uint64_t total = stats.queries.load();
+            std::cout << "[stats] " << total << " queries (" << (total - lastReportQueries) / options.statsIntervalSeconds
+                      << " qps), " << names.size() << " names, " << stats.nxdomain << " NXDOMAIN, "
+                      << stats.servfail << " SERVFAIL, " << stats.dropped << " dropped" << std::endl;
+            lastReportQueries = total;
+            nextReport = now + std::chrono::seconds(options.statsIntervalSeconds);
+        }
+
+        if (ready <= 0) {
+            continue;
+        }
+
+        sockaddr_storage peer = {};
+        socklen_t peerLength = sizeof(peer);
+        ssize_t received = recvfrom(sock, buffer, sizeof(buffer), 0,
+                                    reinterpret_cast<sockaddr*>(&peer), &peerLength);
+        if (received <= 0) {
+            continue;
+        }
+
+        DnsMessage::Message query;
+        if (!DnsMessage::Decode(buffer, static_cast<size_t>(received), query) ||
+            (query.flags & DnsMessage::FlagResponse) || query.questions.size() != 1) {
+            stats.malformed++;
+            continue;
+        }
+
+        const DnsMessage::Question& question = query.questions[0];
+        std::string name = question.name;
+        std::transform(name.begin(), name.end(), name.begin(),
+            [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+        stats.queries++;
+        if (question.type == DnsMessage::TypeA) {
+            stats.queriesA++;
+        }
+        else if (question.type == DnsMessage::TypeAAAA) {
+            stats.queriesAAAA++;
+        }
+        else {
+            stats.queriesOther++;
+        }
+        names.insert(name);
+
+        DnsMessage::Message response;
+        response.id = query.id;
+        response.flags = DnsMessage::FlagResponse | DnsMessage::FlagAuthoritative |
+                         (query.flags & DnsMessage::FlagRecursionDesired);
+        response.questions.push_back(question);
+
+        const Zone* zone = FindZone(zones, name);
+        if (zone != nullptr && chance(rng) < zone->dropRate) {
+            stats.dropped++;
+            continue;
+        }
+
+        if (zone == nullptr || chance(rng) < zone->nxdomainRate) {
+            response.flags |= DnsMessage::RcodeNxDomain;
+            stats.nxdomain++;
+        }
+        else if (chance(rng) < zone->servfailRate) {
+            response.flags |= DnsMessage::RcodeServFail;
+            stats.servfail++;
+        }
+        else {
+            stats.noError++;
+
+            bool v6 = question.type == DnsMessage::TypeAAAA;
+            int count = v6 ? zone->ipv6 : zone->ipv4;
+            if (count > 0 && (question.type == DnsMessage::TypeA || v6)) {
+                uint64_t nameHash = HashName(name, options.seed);
+                uint64_t generation = 0;
+                if (zone->churnSeconds > 0) {
+                    // Each name changes on its own phase of the (accelerated) clock
+                    double simulated = std::chrono::duration<double>(now - startTime).count() * options.speed;
+                    double phase = static_cast<double>(nameHash % 1000000) / 1000000.0 * zone->churnSeconds;
+                    generation = static_cast<uint64_t>((simulated + phase) / zone->churnSeconds);
+                }
+
+                auto addresses = AnswerSet(*zone, nameHash, generation, count, v6);
+                if (zone->roundRobin) {
+                    std::rotate(addresses.begin(), addresses.begin() + (rotation++ % addresses.size()),
+                                addresses.end());
+                }
+
+                for (auto& bytes : addresses) {
+                    DnsMessage::ResourceRecord record;
+                    record.name = question.name;
+                    record.type = question.type;
+                    record.rclass = DnsMessage::ClassIN;
+                    record.ttl = zone->ttl;
+                    record.data = std::move(bytes);
+                    response.answers.push_back(std::move(record));
+                }
+            }
+        }
+
+        std::vector<uint8_t> packet;
+        if (!DnsMessage::Encode(response, packet)) {
+            stats.malformed++;
+            continue;
+        }
+
+        double delayMs = zone != nullptr ? zone->latency.Sample(rng) : 0.0;
+        stats.delayedTotalUs += static_cast<uint64_t>(delayMs * 1000);
+
+        if (delayMs <= 0) {
+            sendto(sock, packet.data(), packet.size(), 0, reinterpret_cast<sockaddr*>(&peer), peerLength);
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(delayedMutex);
+            delayed.push(DelayedResponse{
+                now + std::chrono::microseconds(static_cast<int64_t>(delayMs * 1000)),
+                peer, peerLength, std::move(packet) });
+        }
+        delayedCv.notify_one();
+    }
+
+    delayedCv.notify_all();
+    sender.join();
+    close(sock);
+
+    double elapsed = std::chrono::duration<double>(Clock::now() - startTime).count();
+    json summary = StatsToJson(stats, names.size(), elapsed, options.speed);
+    std::cout << "\nFinal statistics:\n" << summary.dump(2) << std::endl;
+
+    if (!options.statsPath.empty()) {
+        std::ofstream file(options.statsPath, std::ios::trunc);
+        if (!file.is_open()) {
+            std::cerr << "Failed to open stats file: " << options.statsPath << std::endl;
+            return 1;
+        }
+        file << summary.dump(2) << std::endl;
+    }
+
+    return 0;
+}
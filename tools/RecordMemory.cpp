@@ -0,0 +1,209 @@
+/**
+ * @file RecordMemory.cpp
+ * @brief Report memory per blocked FQDN for the in-memory record layouts
+ *
+ * Builds the compact RecordStore from an existing audit store file or from
+ * synthetic records, and reports its bytes per record by component next to
+ * the scheduler's per-task cost and the owning Record layout (one Record
+ * with its strings and address vector per FQDN) for comparison. Byte
+ * counts come from container capacities plus an allocator overhead estimate
+ * per heap block; on Linux the resident set growth of each build is shown
+ * as a cross-check.
+ *
+ * Usage: fqdn_record_memory [--store <audit store file>] [--records <n>]
+ *                           [--ipv4 <per record>] [--ipv6 <per record>]
+ */
+
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "AuditLogger.h"
+#include "RecordStore.h"
+
+namespace {
+
+// Typical glibc malloc header and rounding per heap block
+const size_t kAllocationOverhead = 16;
+
+struct Options {
+    std::string storePath;
+    size_t records = 1000000;
+    int ipv4 = 2;
+    int ipv6 = 1;
+};
+
+/**
+ * @brief Resident set size of this process in bytes, 0 where unavailable
+ */
+size_t ResidentBytes() {
+#ifdef __linux__
+    FILE* statm = std::fopen("/proc/self/statm", "r");
+    if (!statm) {
+        return 0;
+    }
+    unsigned long size = 0;
+    unsigned long resident = 0;
+    int fields = std::fscanf(statm, "%lu %lu", &size, &resident);
+    std::fclose(statm);
+    return fields == 2 ? resident * static_cast<size_t>(sysconf(_SC_PAGESIZE)) : 0;
+#else
+    return 0;
+#endif
+}
+
+size_t HeapBytes(const std::string& text) {
+    // Short strings live inside the object (small string optimization)
+    return text.capacity() > std::string().capacity() ? text.capacity() + 1 + kAllocationOverhead : 0;
+}
+
+/**
+ * @brief Estimated bytes held by the owning layout: vector<Record> and everything it points to
+ */
+size_t OwningLayoutBytes(const std::vector<Record>& records) {
+    size_t bytes = records.capacity() * sizeof(Record) + kAllocationOverhead;
+    for (const auto& record : records) {
+        bytes += HeapBytes(record.fqdn) + HeapBytes(record.keywordId) + HeapBytes(record.ruleName);
+        if (record.lastResolvedIPs.capacity() > 0) {
+            bytes += record.lastResolvedIPs.capacity() * sizeof(std::string) + kAllocationOverhead;
+        }
+        for (const auto& ip : record.lastResolvedIPs) {
+            bytes += HeapBytes(ip);
+        }
+    }
+    return bytes;
+}
+
+std::vector<Record> SyntheticRecords(const Options& options) {
+    std::mt19937_64 rng(42);
+    std::vector<Record> records;
+    records.reserve(options.records);
+
+    for (size_t i = 0; i < options.records; i++) {
+        Record record;
+        record.fqdn = "host" + std::to_string(i) + ".zone" + std::to_string(i % 997) + ".example.com";
+        char guid[64];
+        std::snprintf(guid, sizeof(guid), "%08llx-%04llx-4%03llx-8%03llx-%012llx",
+                      static_cast<unsigned long long>(rng() & 0xffffffffULL),
+                      static_cast<unsigned long long>(rng() & 0xffffULL),
+                      static_cast<unsigned long long>(rng() & 0xfffULL),
+                      static_cast<unsigned long long>(rng() & 0xfffULL),
+                      static_cast<unsigned long long>(rng() & 0xffffffffffffULL));
+        record.keywordId = guid;
+        record.ruleName = "Block " + record.fqdn;
+        record.blockedAt = 1700000000 + static_cast<std::time_t>(i);
+        record.interval = 60;
+
+        for (int a = 0; a < options.ipv4; a++) {
+            record.lastResolvedIPs.push_back(std::to_string(rng() % 223 + 1) + "." + std::to_string(rng() % 256) +
+                                             "." + std::to_string(rng() % 256) + "." +
+                                             std::to_string(rng() % 254 + 1));
+        }
+        for (int a = 0; a < options.ipv6; a++) {
+            char ip[64];
+            std::snprintf(ip, sizeof(ip), "2001:db8:%llx::%llx",
+                          static_cast<unsigned long long>(rng() & 0xffff),
+                          static_cast<unsigned long long>((rng() & 0xfffe) + 1));
+            record.lastResolvedIPs.push_back(ip);
+        }
+        records.push_back(std::move(record));
+    }
+
+    return records;
+}
+
+bool ParseOptions(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--store" && hasValue) {
+            options.storePath = argv[++i];
+        }
+        else if (arg == "--records" && hasValue) {
+            options.records = static_cast<size_t>(std::stoull(argv[++i]));
+        }
+        else if (arg == "--ipv4" && hasValue) {
+            options.ipv4 = std::stoi(argv[++i]);
+        }
+        else if (arg == "--ipv6" && hasValue) {
+            options.ipv6 = std::stoi(argv[++i]);
+        }
+        else {
+            std::cerr << "Usage: fqdn_record_memory [--store <audit store file>] [--records <n>]" << std::endl;
+            std::cerr << "                          [--ipv4 <per record>] [--ipv6 <per record>]" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+void PrintRow(const char* label, size_t bytes, size_t records) {
+    std::cout << "  " << std::left << std::setw(24) << label << std::right
+              << std::setw(14) << bytes << " B"
+              << std::setw(12) << std::fixed << std::setprecision(1)
+              << (records > 0 ? static_cast<double>(bytes) / records : 0.0) << " B/record\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        return 1;
+    }
+
+    // Owning layout first, so its records can seed the compact store
+    size_t rssBefore = ResidentBytes();
+    std::vector<Record> records;
+    if (!options.storePath.empty()) {
+        AuditLogger::Initialize(options.storePath);
+        records = AuditLogger::ListRecords();
+        AuditLogger::Initialize(options.storePath);   // Drop the loaded snapshot
+    }
+    else {
+        records = SyntheticRecords(options);
+    }
+    size_t owningRss = ResidentBytes() - rssBefore;
+    size_t owningBytes = OwningLayoutBytes(records);
+
+    rssBefore = ResidentBytes();
+    RecordStore store;
+    store.Reserve(records.size());
+    for (const auto& record : records) {
+        store.Insert(record);
+    }
+    store.ShrinkToFit();
+    size_t compactRss = ResidentBytes() - rssBefore;
+
+    const size_t count = store.Size();
+    RecordStore::MemoryUsage usage = store.Memory();
+    const size_t schedulerBytes = count * 4;   // One Scheduler::Task per slot
+
+    std::cout << "Records: " << count
+              << (options.storePath.empty() ? " (synthetic)" : " (from " + options.storePath + ")") << "\n\n";
+
+    std::cout << "Compact record store\n";
+    PrintRow("columns", usage.columns, count);
+    PrintRow("string arena", usage.strings, count);
+    PrintRow("address pool", usage.addresses, count);
+    PrintRow("index", usage.index, count);
+    PrintRow("total", usage.Total(), count);
+    PrintRow("+ scheduler task", usage.Total() + schedulerBytes, count);
+    if (compactRss > 0) {
+        PrintRow("resident growth", compactRss, count);
+    }
+
+    std::cout << "\nOwning Record layout\n";
+    PrintRow("estimated", owningBytes, count);
+    if (owningRss > 0) {
+        PrintRow("resident growth", owningRss, count);
+    }
+
+    return 0;
+}